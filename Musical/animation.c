@@ -1,15 +1,116 @@
 ﻿/*
 * @file animation.c
 * @brief animation構造体処理の実装
+*
+* アニメーションは「対象のSpriteの1つの値（位置・大きさ・色など）を変化させる」
+* チャンネル単位のレコードで、項目ごとの配列（SoA）に持つ。
+* easingUpdateが毎フレーム触るのは対象・種類・時間・開始値・終了値の35バイトだけで、
+* コールバックなどは終了時にしか読まない。
+* イージングは番号ごとに割合を集めてeasingBatchでまとめて求める。
+*
+* スロットはanimationInitで確保したプールから取る。
+* 空きスロットはフリーリスト（スタック）で管理してO(1)で取り出し、
+* 動いているスロットは詰めた配列（active）に並べて、easingUpdateはその分だけ回す。
+* 更新中（onFinishedの中など）の停止は印を付けて後回しにし、ループの後でまとめて
+* 入れ替え削除する。更新中に作ったアニメーションは配列の後ろに足され、次のフレームから動く。
+* Sprite*ごとのアニメーションは、ポインタをキーにしたオープンアドレスの表から
+* スロットの双方向リストをたどるので、停止・一時停止はそのSpriteの分だけ見ればよい
+*
+* 時間はSDL_GetTicksの差分（従来どおり1フレーム20msまで）で進めるほか、setTimebaseで
+* 曲の再生位置や拍を時計にできる。その場合は作ったときに読んだ時計の値（origin）からの差で進めるので、
+* フレームの揺れに関係なく曲に揃い、MIDIハンドラの中で作ればイベントの時刻から始まる
 */
 #include "animation.h"
 #include "sprite.h"
 #include "easing.h"
+#include "timebase.h"
 #include <stdio.h>
 #include <stdbool.h>
 
-static Animation list[ANIMATION_MAX];
-static Animation *current;
+#define EASING_TABLE_MAX 256        ///< 使えるイージング関数の種類（IDは1バイト）
+
+/**
+* @brief アニメーションで変化させる値
+*/
+typedef enum {
+    TWEEN_TIMEOUT,                  ///< 値は変えず、終了時のコールバックだけ
+    TWEEN_POSITION,
+    TWEEN_SCALE,
+    TWEEN_SCALE_X,
+    TWEEN_SCALE_Y,
+    TWEEN_ROTATION,
+    TWEEN_ALPHA,
+    TWEEN_COLOR
+} TweenProperty;
+
+/**
+* @brief 開始値・終了値（位置はf[0],f[1]、1つの値はf[0]、透明度と色はc）
+*/
+typedef union {
+    float f[2];
+    SDL_Color c;
+} TweenValue;
+
+#define TWEEN_LOOP      0x01
+#define TWEEN_PING_PONG 0x02
+#define TWEEN_PAUSE     0x04
+#define TWEEN_DEAD      0x08        ///< 更新中に止められ、ループの後で片付ける
+#define TWEEN_CLOCK_SHIFT 4         ///< 上位4ビットに時計（Timebase）を持つ
+#define TWEEN_CLOCK(flags) ((Timebase)((flags) >> TWEEN_CLOCK_SHIFT))
+
+/**
+* @brief アニメーションのプール（スロット番号で引く配列の集まり）
+*/
+typedef struct {
+    // easingUpdateで毎フレーム読む
+    Sprite **target;                ///< 対象のSprite
+    Uint8 *prop;                    ///< TweenProperty
+    Uint8 *easing;                  ///< EasingId（EASING_COUNT以降はcustomEasingの番号）
+    Uint8 *flags;                   ///< TWEEN_LOOPなど（上位4ビットは時計）
+    float *time;                    ///< 経過時間（負なら開始前、単位は時計による）
+    float *duration;                ///< 長さ
+    double *origin;                 ///< 前回時間を進めたときの時計の値（TIMEBASE_TICKS以外）
+    TweenValue *from;
+    TweenValue *to;
+
+    // 終了時・操作時だけ読む
+    void (**onFinished)();
+    void **callbackTarget;
+    int *activePos;                 ///< activeの中の位置（-1なら空きスロット）
+    int *linkNext;                  ///< 同じSpriteの次のスロット（-1で終わり）
+    int *linkPrev;                  ///< 同じSpriteの前のスロット（-1で先頭）
+
+    int capacity;
+    int *freeStack;                 ///< 空きスロットの番号（末尾から取り出す）
+    int freeCount;
+    int *active;                    ///< 動いているスロット（作った順、削除は末尾と入れ替え）
+    int activeCount;
+    int *cancelQueue;               ///< 更新中に止められたスロット
+    int cancelCount;
+
+    // easingUpdateの作業用（activeの位置kごと、またはイージング番号順に並べた位置jごと）
+    Uint8 *running;                 ///< [k] このフレームに値を書くか
+    float *eased;                   ///< [k] イージング後の割合
+    int *batchPos;                  ///< [j] activeの位置
+    float *batchRatio;              ///< [j] 割合（easingBatchでその場で置き換える）
+    bool updating;                  ///< easingUpdateのループ中
+} TweenPool;
+
+/**
+* @brief Sprite*から、そのSpriteのアニメーションのリストの先頭を引く表の要素
+*/
+typedef struct {
+    Sprite *key;
+    int head;                       ///< 先頭のスロット（-1なら空き）
+} SpriteEntry;
+
+static TweenPool pool;
+static SpriteEntry *spriteMap;
+static int spriteMapMask;           ///< 表の大きさ-1（大きさは2の累乗でプールの2倍以上）
+static int current = -1;            ///< setDurationなどの対象（直前に作ったスロット）
+
+static float (*customEasing[EASING_TABLE_MAX - EASING_COUNT])(float ratio);
+static int customCount;
 
 static Uint8 alphaFromFloat(float alpha) {
     if (alpha <= 0.0f) {
@@ -22,237 +123,477 @@ static Uint8 alphaFromFloat(float alpha) {
 }
 
 /**
-* @brief イージングアニメーションを1つ有効化して、それを返す
+* @brief イージング関数の番号（組み込みでない初めての関数なら表に追加する）
 *
-* @param g グラフィック
-* @return 有効化したイージングデータへの参照
+* @param easing イージング関数
+* @return 番号（表が一杯ならEASING_LINEAR）
 */
-static Animation* get(Sprite* g) {
-
-    int i;
-    Animation* data;
-
-    for (i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (!list[i].isEnabled) {
-            data = &list[i];
-            break;
-        }
+static Uint8 easingId(float (*easing)(float ratio)) {
+    EasingId id = easingIdOf(easing);
+    if (id != EASING_COUNT) return (Uint8)id;
+    for (int i = 0; i < customCount; i++) {
+        if (customEasing[i] == easing) return (Uint8)(EASING_COUNT + i);
     }
-    if (i == ANIMATION_MAX) return NULL;
-
-    data->id = i;
-    if(g != NULL)
-        data->startValue = data->targetValue = *g;
-    data->g = g;
-    data->easing = linear;
-    data->onFinished = NULL;
-    data->isEnabled = true;
-    data->startTime = SDL_GetTicks();
-    data->duration = 500;
-    data->endTime = data->startTime + data->duration;
-    data->delay = 0;
-    data->position = data->scale = data->scaleX = data->scaleY = false;
-    data->rotation = data->alpha = data->color = false;
-    data->loop = false;
-    data->pastTime = 0;
-    data->pause = false;
-    data->loopType = STRAIGHT;
-    data->callbackTarget = NULL;
-
-    return data;
+    if (EASING_COUNT + customCount == EASING_TABLE_MAX) {
+        SDL_Log("setEasing: too many easing functions, using linear");
+        return EASING_LINEAR;
+    }
+    customEasing[customCount] = easing;
+    return (Uint8)(EASING_COUNT + customCount++);
 }
 
 /**
-* @brief イージングアニメーションの更新
+* @brief Sprite*のハッシュ値（表の最初の位置）
 */
-void easingUpdate() {
-
-    int deltaTime = 0;
-    static int time;
-
-    if (time > 0) {
-        deltaTime = SDL_GetTicks() - time;
-        deltaTime = deltaTime > 20 ? 20 : deltaTime;
-    }
-    time = SDL_GetTicks();
-
-    for (int i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (list[i].isEnabled) {
-            Animation *e = &list[i];
-
-            if (e->pause) {
-                continue;
-            }
-
-            e->pastTime += deltaTime;
-            if (e->pastTime < 0)
-                continue;
-
-            float ratio = e->easing((float)e->pastTime / e->duration);
-
-            if (e->position) {
-                e->g->position.x = e->startValue.position.x + (e->targetValue.position.x - e->startValue.position.x) * ratio;
-                e->g->position.y = e->startValue.position.y + (e->targetValue.position.y - e->startValue.position.y) * ratio;
-            }
-            if (e->scale) {
-                e->g->scale = e->startValue.scale + (e->targetValue.scale - e->startValue.scale) * ratio;
-            }
-            if (e->scaleX) {
-                e->g->scaleX = e->startValue.scaleX + (e->targetValue.scaleX - e->startValue.scaleX) * ratio;
-            }
-            if (e->scaleY) {
-                e->g->scaleY = e->startValue.scaleY + (e->targetValue.scaleY - e->startValue.scaleY) * ratio;
-            }
-            if(e->rotation)
-                e->g->rotation = e->startValue.rotation + (e->targetValue.rotation - e->startValue.rotation) * ratio;
-            if (e->alpha) {
-                float start = (float)e->startValue.color.a;
-                float target = (float)e->targetValue.color.a;
-                e->g->color.a = (Uint8)(start + (target - start) * ratio + 0.5f);
-            }
-            if (e->color) {
-                SDL_Color start = e->startValue.color;
-                SDL_Color target = e->targetValue.color;
-                e->g->color.r = (Uint8)(start.r + (target.r - start.r) * ratio + 0.5f);
-                e->g->color.g = (Uint8)(start.g + (target.g - start.g) * ratio + 0.5f);
-                e->g->color.b = (Uint8)(start.b + (target.b - start.b) * ratio + 0.5f);
-            }
-
-            //easingの終了
-            if (e->startTime + e->pastTime >= e->endTime) {
+static int spriteHash(const Sprite* g) {
+    uint64_t h = (uint64_t)(uintptr_t)g;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (int)(h & (uint64_t)spriteMapMask);
+}
 
-                if (e->onFinished) {
-                    e->onFinished(e->callbackTarget ? e->callbackTarget : e->g);
-                }
-                if (e->loop) {
-                    if (e->loopType == STRAIGHT) {
-                        if (e->position) e->g->position = e->startValue.position;
-                        if (e->scale) e->g->scale = e->startValue.scale;
-                        if (e->rotation) e->g->rotation = e->startValue.rotation;
-                        if (e->alpha) e->g->color.a = e->startValue.color.a;
-                    }
-                    else if (e->loopType == PING_PONG) {
-                        Sprite t = e->targetValue;
-                        e->targetValue = e->startValue;
-                        e->startValue = t;
-                    }
-                    e->startTime = time;
-                    e->endTime = e->startTime + e->duration;
-                    e->pastTime = 0;
-                    e->delay = 0;
-                }
-                else {
-                    e->isEnabled = false;
-                }
-                
-                continue;
-            }
-        }
+/**
+* @brief gの要素の位置を探す（無ければ入れるべき空きの位置）
+*/
+static int spriteFind(const Sprite* g) {
+    int k = spriteHash(g);
+    while (spriteMap[k].head >= 0 && spriteMap[k].key != g) {
+        k = (k + 1) & spriteMapMask;
     }
+    return k;
 }
 
-
 /**
-* @brief 移動アニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
+* @brief 表から位置kの要素を消して、後ろの要素を詰める（線形探査の削除）
 */
-static void stopMove(Sprite* g) {
-
-    for (int i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (list[i].isEnabled && list[i].g == g && list[i].position) {
-            list[i].isEnabled = false;
-        }
+static void spriteErase(int k) {
+    int hole = k;
+    spriteMap[hole].head = -1;
+    for (int j = (hole + 1) & spriteMapMask; spriteMap[j].head >= 0; j = (j + 1) & spriteMapMask) {
+        int home = spriteHash(spriteMap[j].key);
+        // homeが(hole, j]の外にあれば、holeへ動かしても探索で見つかる
+        bool stay = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (stay) continue;
+        spriteMap[hole] = spriteMap[j];
+        spriteMap[j].head = -1;
+        hole = j;
     }
 }
+
 /**
-* @brief スケールアニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
+* @brief gのアニメーションのリストの先頭（無ければ-1）
 */
-static void stopScale(Sprite* g) {
+static int firstOnSprite(const Sprite* g) {
+    if (!spriteMap) return -1;
+    return spriteMap[spriteFind(g)].head;
+}
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (list[i].isEnabled && list[i].g == g && list[i].scale) {
-            list[i].isEnabled = false;
-        }
+/**
+* @brief スロットiをgのリストの先頭につなぐ
+*/
+static void linkSprite(int i, Sprite* g) {
+    int k = spriteFind(g);
+    if (spriteMap[k].head < 0) {
+        spriteMap[k].key = g;
+    }
+    else {
+        pool.linkPrev[spriteMap[k].head] = i;
     }
+    pool.linkNext[i] = spriteMap[k].head;
+    pool.linkPrev[i] = -1;
+    spriteMap[k].head = i;
 }
+
 /**
-* @brief スケールXアニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
+* @brief スロットiをSpriteのリストから外す
 */
-static void stopScaleX(Sprite* g) {
+static void unlinkSprite(int i) {
+    int prev = pool.linkPrev[i];
+    int next = pool.linkNext[i];
+    if (prev >= 0) {
+        pool.linkNext[prev] = next;
+    }
+    else {
+        int k = spriteFind(pool.target[i]);
+        spriteMap[k].head = next;
+        if (next < 0) spriteErase(k);
+    }
+    if (next >= 0) pool.linkPrev[next] = prev;
+    pool.linkNext[i] = pool.linkPrev[i] = -1;
+}
+
+/**
+* @brief アニメーションのプールを確保する
+*
+* 呼ばずに使った場合はANIMATION_DEFAULT_CAPACITYで確保する。
+* 確保し直すと実行中のアニメーションは全て破棄される
+*
+* @param count 同時に動かせるアニメーションの数
+* @return 確保できたらtrue
+*/
+bool animationInit(int count) {
+    if (count <= 0) count = ANIMATION_DEFAULT_CAPACITY;
+    animationQuit();
+
+    size_t n = (size_t)count;
+    int mapSize = 16;
+    while (mapSize < count * 2) mapSize <<= 1;
+
+    pool.target = (Sprite**)SDL_malloc(sizeof(Sprite*) * n);
+    pool.prop = (Uint8*)SDL_malloc(n);
+    pool.easing = (Uint8*)SDL_malloc(n);
+    pool.flags = (Uint8*)SDL_malloc(n);
+    pool.time = (float*)SDL_malloc(sizeof(float) * n);
+    pool.duration = (float*)SDL_malloc(sizeof(float) * n);
+    pool.origin = (double*)SDL_malloc(sizeof(double) * n);
+    pool.from = (TweenValue*)SDL_malloc(sizeof(TweenValue) * n);
+    pool.to = (TweenValue*)SDL_malloc(sizeof(TweenValue) * n);
+    pool.onFinished = (void (**)())SDL_malloc(sizeof(void (*)()) * n);
+    pool.callbackTarget = (void**)SDL_malloc(sizeof(void*) * n);
+    pool.activePos = (int*)SDL_malloc(sizeof(int) * n);
+    pool.linkNext = (int*)SDL_malloc(sizeof(int) * n);
+    pool.linkPrev = (int*)SDL_malloc(sizeof(int) * n);
+    pool.freeStack = (int*)SDL_malloc(sizeof(int) * n);
+    pool.active = (int*)SDL_malloc(sizeof(int) * n);
+    pool.cancelQueue = (int*)SDL_malloc(sizeof(int) * n);
+    pool.running = (Uint8*)SDL_malloc(n);
+    pool.eased = (float*)SDL_malloc(sizeof(float) * n);
+    pool.batchPos = (int*)SDL_malloc(sizeof(int) * n);
+    pool.batchRatio = (float*)SDL_malloc(sizeof(float) * n);
+    spriteMap = (SpriteEntry*)SDL_malloc(sizeof(SpriteEntry) * (size_t)mapSize);
+    if (!pool.target || !pool.prop || !pool.easing || !pool.flags || !pool.time || !pool.duration ||
+        !pool.origin || !pool.from || !pool.to || !pool.onFinished || !pool.callbackTarget || !pool.activePos ||
+        !pool.linkNext || !pool.linkPrev || !pool.freeStack || !pool.active || !pool.cancelQueue ||
+        !pool.running || !pool.eased || !pool.batchPos || !pool.batchRatio || !spriteMap) {
+        SDL_Log("animationInit: out of memory (%d slots)", count);
+        animationQuit();
+        return false;
+    }
+    pool.capacity = count;
+    spriteMapMask = mapSize - 1;
+    for (int k = 0; k < mapSize; k++) {
+        spriteMap[k].key = NULL;
+        spriteMap[k].head = -1;
+    }
+    // 番号の小さいスロットから使われるように逆順に積む
+    for (int i = 0; i < count; i++) {
+        pool.freeStack[i] = count - 1 - i;
+        pool.activePos[i] = -1;
+    }
+    pool.freeCount = count;
+    return true;
+}
+
+/**
+* @brief アニメーションのプールを解放する
+*/
+void animationQuit(void) {
+    SDL_free(pool.target);
+    SDL_free(pool.prop);
+    SDL_free(pool.easing);
+    SDL_free(pool.flags);
+    SDL_free(pool.time);
+    SDL_free(pool.duration);
+    SDL_free(pool.origin);
+    SDL_free(pool.from);
+    SDL_free(pool.to);
+    SDL_free(pool.onFinished);
+    SDL_free(pool.callbackTarget);
+    SDL_free(pool.activePos);
+    SDL_free(pool.linkNext);
+    SDL_free(pool.linkPrev);
+    SDL_free(pool.freeStack);
+    SDL_free(pool.active);
+    SDL_free(pool.cancelQueue);
+    SDL_free(pool.running);
+    SDL_free(pool.eased);
+    SDL_free(pool.batchPos);
+    SDL_free(pool.batchRatio);
+    SDL_free(spriteMap);
+    SDL_zero(pool);
+    spriteMap = NULL;
+    spriteMapMask = 0;
+    current = -1;
+}
+
+/**
+* @brief スロットをactiveから外して空きに戻す（末尾の要素をその位置へ移す）
+*
+* @param i スロット番号
+*/
+static void removeActive(int i) {
+    int pos = pool.activePos[i];
+    int last = pool.active[--pool.activeCount];
+    pool.active[pos] = last;
+    pool.activePos[last] = pos;
+    pool.activePos[i] = -1;
+    pool.freeStack[pool.freeCount++] = i;
+}
+
+/**
+* @brief アニメーションを止める（既に止まっていれば何もしない）
+*
+* 更新中はSpriteのリストからだけ外し、スロットはループの後で空きに戻す。
+* そうすれば同じフレームのうちに別のアニメーションに再利用されることはない
+*
+* @param i スロット番号
+*/
+static void release(int i) {
+    if (pool.activePos[i] < 0 || (pool.flags[i] & TWEEN_DEAD)) return;
+    unlinkSprite(i);
+    if (pool.updating) {
+        pool.flags[i] |= TWEEN_DEAD;
+        pool.cancelQueue[pool.cancelCount++] = i;
+    }
+    else {
+        removeActive(i);
+    }
+}
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (list[i].isEnabled && list[i].g == g && list[i].scaleX) {
-            list[i].isEnabled = false;
-        }
+/**
+* @brief スプライトの今の値を読む
+*/
+static TweenValue readValue(const Sprite* g, TweenProperty prop) {
+    TweenValue v;
+    SDL_zero(v);
+    switch (prop) {
+    case TWEEN_POSITION:
+        v.f[0] = g->position.x;
+        v.f[1] = g->position.y;
+        break;
+    case TWEEN_SCALE: v.f[0] = g->scale; break;
+    case TWEEN_SCALE_X: v.f[0] = g->scaleX; break;
+    case TWEEN_SCALE_Y: v.f[0] = g->scaleY; break;
+    case TWEEN_ROTATION: v.f[0] = g->rotation; break;
+    case TWEEN_ALPHA:
+    case TWEEN_COLOR: v.c = g->color; break;
+    default: break;
+    }
+    return v;
+}
+
+/**
+* @brief 開始値と終了値の間の値をスプライトに書く
+*
+* @param i スロット番号
+* @param ratio イージング後の割合
+*/
+static void applyValue(int i, float ratio) {
+    Sprite* g = pool.target[i];
+    const TweenValue* a = &pool.from[i];
+    const TweenValue* b = &pool.to[i];
+
+    switch (pool.prop[i]) {
+    case TWEEN_POSITION:
+        g->position.x = a->f[0] + (b->f[0] - a->f[0]) * ratio;
+        g->position.y = a->f[1] + (b->f[1] - a->f[1]) * ratio;
+        break;
+    case TWEEN_SCALE:
+        g->scale = a->f[0] + (b->f[0] - a->f[0]) * ratio;
+        break;
+    case TWEEN_SCALE_X:
+        g->scaleX = a->f[0] + (b->f[0] - a->f[0]) * ratio;
+        break;
+    case TWEEN_SCALE_Y:
+        g->scaleY = a->f[0] + (b->f[0] - a->f[0]) * ratio;
+        break;
+    case TWEEN_ROTATION:
+        g->rotation = a->f[0] + (b->f[0] - a->f[0]) * ratio;
+        break;
+    case TWEEN_ALPHA:
+        g->color.a = (Uint8)(a->c.a + (b->c.a - a->c.a) * ratio + 0.5f);
+        break;
+    case TWEEN_COLOR:
+        g->color.r = (Uint8)(a->c.r + (b->c.r - a->c.r) * ratio + 0.5f);
+        g->color.g = (Uint8)(a->c.g + (b->c.g - a->c.g) * ratio + 0.5f);
+        g->color.b = (Uint8)(a->c.b + (b->c.b - a->c.b) * ratio + 0.5f);
+        break;
+    default:
+        break;
     }
 }
+
 /**
-* @brief スケールYアニメーションの停止
+* @brief gの同じ値のアニメーションを止めて、新しいアニメーションを1つ有効化する
 *
-* @param g 停止させたいアニメーションのSprite型構造体の参照
+* @param g グラフィック
+* @param prop 変化させる値（TWEEN_TIMEOUTなら他のアニメーションは止めない）
+* @return スロット番号（空きが無ければ-1）
 */
-static void stopScaleY(Sprite* g) {
+static int get(Sprite* g, TweenProperty prop) {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
-    {
-        if (list[i].isEnabled && list[i].g == g && list[i].scaleY) {
-            list[i].isEnabled = false;
+    if (!pool.target && !animationInit(ANIMATION_DEFAULT_CAPACITY)) return -1;
+
+    if (prop != TWEEN_TIMEOUT) {
+        for (int i = firstOnSprite(g), next; i >= 0; i = next)
+        {
+            next = pool.linkNext[i];
+            if (pool.prop[i] == prop) {
+                release(i);
+            }
         }
     }
+    current = -1;
+    if (pool.freeCount == 0) return -1;
+
+    int i = pool.freeStack[--pool.freeCount];
+    pool.activePos[i] = pool.activeCount;
+    pool.active[pool.activeCount++] = i;
+
+    pool.target[i] = g;
+    pool.prop[i] = (Uint8)prop;
+    pool.easing[i] = EASING_LINEAR;
+    pool.flags[i] = TIMEBASE_TICKS << TWEEN_CLOCK_SHIFT;
+    pool.time[i] = 0.0f;
+    pool.duration[i] = 500.0f;
+    pool.origin[i] = 0.0;
+    pool.from[i] = pool.to[i] = prop != TWEEN_TIMEOUT ? readValue(g, prop) : (TweenValue){ { 0.0f, 0.0f } };
+    pool.onFinished[i] = NULL;
+    pool.callbackTarget[i] = NULL;
+    linkSprite(i, g);
+
+    current = i;
+    return i;
 }
+
 /**
-* @brief 回転アニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
+* @brief イージングアニメーションの更新
 */
-static void stopRotation(Sprite* g) {
+void easingUpdate() {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    int deltaTime = 0;
+    static int time;
+
+    if (time > 0) {
+        deltaTime = SDL_GetTicks() - time;
+        deltaTime = deltaTime > 20 ? 20 : deltaTime;
+    }
+    time = SDL_GetTicks();
+
+    // 曲の時計などはフレームに1回だけ読む
+    timebaseUpdate();
+    double clockNow[TIMEBASE_BEATS + 1];
+    for (int b = 0; b <= TIMEBASE_BEATS; b++) {
+        clockNow[b] = timebaseNow((Timebase)b);
+    }
+
+    // ループ中に足されたアニメーションは次のフレームから
+    int count = pool.activeCount;
+
+    // 時間を進め、動くものの割合をイージング番号ごとに並べる
+    int start[EASING_TABLE_MAX + 1];
+    SDL_zero(start);
+    for (int k = 0; k < count; k++)
     {
-        if (list[i].isEnabled && list[i].g == g && list[i].rotation) {
-            list[i].isEnabled = false;
+        int i = pool.active[k];
+        pool.running[k] = 0;
+        Timebase clock = TWEEN_CLOCK(pool.flags[i]);
+        if (pool.flags[i] & (TWEEN_PAUSE | TWEEN_DEAD)) {
+            // 一時停止中は時計だけ追いかけて、再開時に飛ばないようにする
+            pool.origin[i] = clockNow[clock];
+            continue;
         }
+        if (clock == TIMEBASE_TICKS) {
+            pool.time[i] += deltaTime;
+        }
+        else {
+            pool.time[i] += (float)(clockNow[clock] - pool.origin[i]);
+            pool.origin[i] = clockNow[clock];
+        }
+        if (pool.time[i] < 0)
+            continue;
+        pool.running[k] = 1;
+        start[pool.easing[i] + 1]++;
     }
-}
-/**
-* @brief 透明度アニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
-*/
-static void stopAlpha(Sprite* g) {
-
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int e = 0; e < EASING_TABLE_MAX; e++) {
+        start[e + 1] += start[e];
+    }
+    int fill[EASING_TABLE_MAX];
+    SDL_memcpy(fill, start, sizeof(fill));
+    for (int k = 0; k < count; k++)
     {
-        if (list[i].isEnabled && list[i].g == g && list[i].alpha) {
-            list[i].isEnabled = false;
+        if (!pool.running[k]) continue;
+        int i = pool.active[k];
+        int j = fill[pool.easing[i]]++;
+        pool.batchPos[j] = k;
+        pool.batchRatio[j] = (float)pool.time[i] / pool.duration[i];
+    }
+    for (int e = 0; e < EASING_TABLE_MAX; e++) {
+        int n = start[e + 1] - start[e];
+        if (n == 0) continue;
+        float* r = pool.batchRatio + start[e];
+        if (e < EASING_COUNT) {
+            easingBatch((EasingId)e, r, r, n);
+        }
+        else {
+            float (*f)(float) = customEasing[e - EASING_COUNT];
+            for (int j = 0; j < n; j++) r[j] = f(r[j]);
         }
     }
-}
-/**
-* @brief 色のアニメーションの停止
-*
-* @param g 停止させたいアニメーションのSprite型構造体の参照
-*/
-static void stopColor(Sprite* g) {
+    for (int j = 0; j < start[EASING_TABLE_MAX]; j++) {
+        pool.eased[pool.batchPos[j]] = pool.batchRatio[j];
+    }
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    // 値を書いて、終わったものを処理する（コールバックはactiveの順）
+    pool.updating = true;
+    for (int k = 0; k < count; k++)
     {
-        if (list[i].isEnabled && list[i].g == g && list[i].color) {
-            list[i].isEnabled = false;
+        int i = pool.active[k];
+        // 先に呼ばれたコールバックで止められていることがある
+        if (!pool.running[k] || (pool.flags[i] & TWEEN_DEAD)) {
+            continue;
+        }
+        Uint8 flags = pool.flags[i];
+        float t = pool.time[i];
+        float duration = pool.duration[i];
+        applyValue(i, pool.eased[k]);
+
+        //easingの終了
+        if (t >= duration) {
+
+            if (pool.onFinished[i]) {
+                pool.onFinished[i](pool.callbackTarget[i] ? pool.callbackTarget[i] : pool.target[i]);
+                // コールバック内で止められた場合は触らない
+                flags = pool.flags[i];
+                if (flags & TWEEN_DEAD) continue;
+            }
+            if (flags & TWEEN_LOOP) {
+                if (flags & TWEEN_PING_PONG) {
+                    TweenValue v = pool.to[i];
+                    pool.to[i] = pool.from[i];
+                    pool.from[i] = v;
+                }
+                else {
+                    applyValue(i, 0.0f);
+                }
+                // 時計を使うものは超えた分を次の周に回して曲からずれないようにする
+                if (TWEEN_CLOCK(flags) != TIMEBASE_TICKS && t - duration < duration) {
+                    pool.time[i] = t - duration;
+                }
+                else {
+                    pool.time[i] = 0.0f;
+                }
+            }
+            else {
+                release(i);
+            }
+
+            continue;
         }
     }
+    pool.updating = false;
+
+    // 止められたスロットを片付ける
+    for (int k = 0; k < pool.cancelCount; k++) {
+        int i = pool.cancelQueue[k];
+        pool.flags[i] &= ~TWEEN_DEAD;
+        removeActive(i);
+    }
+    pool.cancelCount = 0;
 }
 
+
 /**
 * @brief 指定座標に移動
 *
@@ -261,15 +602,11 @@ static void stopColor(Sprite* g) {
 * @param y 目標Y座標
 */
 void moveTo(Sprite* g, float x, float y) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_POSITION);
+    if (i < 0)return;
 
-    stopMove(g);
-
-    data->targetValue.position.x = x;
-    data->targetValue.position.y = y;
-    data->position = true;
-    current = data;
+    pool.to[i].f[0] = x;
+    pool.to[i].f[1] = y;
 }
 
 /**
@@ -279,14 +616,10 @@ void moveTo(Sprite* g, float x, float y) {
 * @param scale 目標の大きさ
 */
 void scaleTo(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopScale(g);
+    int i = get(g, TWEEN_SCALE);
+    if (i < 0)return;
 
-    data->targetValue.scale = scale;
-    data->scale = true;
-    current = data;
+    pool.to[i].f[0] = scale;
 }
 
 /**
@@ -296,14 +629,10 @@ void scaleTo(Sprite* g, float scale) {
 * @param scale 目標の大きさ
 */
 void scaleXTo(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopScaleX(g);
+    int i = get(g, TWEEN_SCALE_X);
+    if (i < 0)return;
 
-    data->targetValue.scaleX = scale;
-    data->scaleX = true;
-    current = data;
+    pool.to[i].f[0] = scale;
 }
 
 /**
@@ -313,14 +642,10 @@ void scaleXTo(Sprite* g, float scale) {
 * @param scale 目標の大きさ
 */
 void scaleYTo(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_SCALE_Y);
+    if (i < 0)return;
 
-    stopScaleY(g);
-
-    data->targetValue.scaleY = scale;
-    data->scaleY = true;
-    current = data;
+    pool.to[i].f[0] = scale;
 }
 
 /**
@@ -330,14 +655,10 @@ void scaleYTo(Sprite* g, float scale) {
 * @param rotation 目標角度
 */
 void rotateTo(Sprite* g, float rotation) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopRotation(g);
+    int i = get(g, TWEEN_ROTATION);
+    if (i < 0)return;
 
-    data->targetValue.rotation = rotation;
-    data->rotation = true;
-    current = data;
+    pool.to[i].f[0] = rotation;
 }
 
 /**
@@ -347,14 +668,10 @@ void rotateTo(Sprite* g, float rotation) {
 * @param alpha 目標の透明度
 */
 void alphaTo(Sprite* g, float alpha) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopAlpha(g);
+    int i = get(g, TWEEN_ALPHA);
+    if (i < 0)return;
 
-    data->targetValue.color.a = alphaFromFloat(alpha);
-    data->alpha = true;
-    current = data;
+    pool.to[i].c.a = alphaFromFloat(alpha);
 }
 
 /**
@@ -364,14 +681,12 @@ void alphaTo(Sprite* g, float alpha) {
 * @param color 目標の色
 */
 void colorTo(Sprite* g, SDL_Color color) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_COLOR);
+    if (i < 0)return;
 
-    stopColor(g);
-
-    data->targetValue.color = color;
-    data->color = true;
-    current = data;
+    pool.to[i].c.r = color.r;
+    pool.to[i].c.g = color.g;
+    pool.to[i].c.b = color.b;
 }
 
 /**
@@ -382,15 +697,11 @@ void colorTo(Sprite* g, SDL_Color color) {
 * @param y 目標Y座標
 */
 void moveAdd(Sprite* g, float x, float y) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopMove(g);
+    int i = get(g, TWEEN_POSITION);
+    if (i < 0)return;
 
-    data->targetValue.position.x = data->startValue.position.x + x;
-    data->targetValue.position.y = data->startValue.position.y + y;
-    data->position = true;
-    current = data;
+    pool.to[i].f[0] = pool.from[i].f[0] + x;
+    pool.to[i].f[1] = pool.from[i].f[1] + y;
 }
 
 /**
@@ -400,14 +711,10 @@ void moveAdd(Sprite* g, float x, float y) {
 * @param scale 目標の大きさ
 */
 void scaleAdd(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_SCALE);
+    if (i < 0)return;
 
-    stopScale(g);
-
-    data->targetValue.scale = data->startValue.scale + scale;
-    data->scale = true;
-    current = data;
+    pool.to[i].f[0] = pool.from[i].f[0] + scale;
 }
 
 /**
@@ -417,14 +724,10 @@ void scaleAdd(Sprite* g, float scale) {
 * @param scale 目標の大きさ
 */
 void scaleXAdd(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopScaleX(g);
+    int i = get(g, TWEEN_SCALE_X);
+    if (i < 0)return;
 
-    data->targetValue.scaleX = data->startValue.scaleX + scale;
-    data->scaleX = true;
-    current = data;
+    pool.to[i].f[0] = pool.from[i].f[0] + scale;
 }
 
 /**
@@ -434,14 +737,10 @@ void scaleXAdd(Sprite* g, float scale) {
 * @param scale 目標の大きさ
 */
 void scaleYAdd(Sprite* g, float scale) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopScaleY(g);
+    int i = get(g, TWEEN_SCALE_Y);
+    if (i < 0)return;
 
-    data->targetValue.scaleY = data->startValue.scaleY + scale;
-    data->scaleY = true;
-    current = data;
+    pool.to[i].f[0] = pool.from[i].f[0] + scale;
 }
 
 /**
@@ -451,14 +750,10 @@ void scaleYAdd(Sprite* g, float scale) {
 * @param rotation 目標角度
 */
 void rotateAdd(Sprite* g, float rotation) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_ROTATION);
+    if (i < 0)return;
 
-    stopRotation(g);
-
-    data->targetValue.rotation = data->startValue.rotation + rotation;
-    data->rotation = true;
-    current = data;
+    pool.to[i].f[0] = pool.from[i].f[0] + rotation;
 }
 
 /**
@@ -468,23 +763,19 @@ void rotateAdd(Sprite* g, float rotation) {
 * @param alpha 目標の透明度
 */
 void alphaAdd(Sprite* g, float alpha) {
-    Animation* data = get(g);
-    if (data == NULL)return;
-
-    stopAlpha(g);
+    int i = get(g, TWEEN_ALPHA);
+    if (i < 0)return;
 
-    int value = (int)data->startValue.color.a + (int)alphaFromFloat(alpha);
+    int value = (int)pool.from[i].c.a + (int)alphaFromFloat(alpha);
     if (value > 255) {
-        data->targetValue.color.a = 255;
+        pool.to[i].c.a = 255;
     }
     else if (value < 0) {
-        data->targetValue.color.a = 0;
+        pool.to[i].c.a = 0;
     }
     else {
-        data->targetValue.color.a = (Uint8)value;
+        pool.to[i].c.a = (Uint8)value;
     }
-    data->alpha = true;
-    current = data;
 }
 
 /**
@@ -494,15 +785,12 @@ void alphaAdd(Sprite* g, float alpha) {
 * @param alpha 目標の透明度
 */
 void colorAdd(Sprite* g, SDL_Color color) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_COLOR);
+    if (i < 0)return;
 
-    stopColor(g);
-    data->targetValue.color.r = SDL_clamp(data->startValue.color.r + color.r, 0, 255);
-    data->targetValue.color.g = SDL_clamp(data->startValue.color.g + color.g, 0, 255);
-    data->targetValue.color.b = SDL_clamp(data->startValue.color.b + color.b, 0, 255);
-    data->color = true;
-    current = data;
+    pool.to[i].c.r = SDL_clamp(pool.from[i].c.r + color.r, 0, 255);
+    pool.to[i].c.g = SDL_clamp(pool.from[i].c.g + color.g, 0, 255);
+    pool.to[i].c.b = SDL_clamp(pool.from[i].c.b + color.b, 0, 255);
 }
 
 /**
@@ -512,11 +800,10 @@ void colorAdd(Sprite* g, SDL_Color color) {
 */
 void stopAnimation(Sprite* g) {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int i = firstOnSprite(g), next; i >= 0; i = next)
     {
-        if (list[i].isEnabled && list[i].g == g) {
-            list[i].isEnabled = false;
-        }
+        next = pool.linkNext[i];
+        release(i);
     }
 
 }
@@ -528,11 +815,9 @@ void stopAnimation(Sprite* g) {
 */
 void pauseAnimation(Sprite* g) {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int i = firstOnSprite(g); i >= 0; i = pool.linkNext[i])
     {
-        if (list[i].isEnabled && list[i].g == g) {
-            list[i].pause = true;
-        }
+        pool.flags[i] |= TWEEN_PAUSE;
     }
 
 }
@@ -544,11 +829,9 @@ void pauseAnimation(Sprite* g) {
 */
 void resumeAnimation(Sprite* g) {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int i = firstOnSprite(g); i >= 0; i = pool.linkNext[i])
     {
-        if (list[i].isEnabled && list[i].g == g) {
-            list[i].pause = false;
-        }
+        pool.flags[i] &= ~TWEEN_PAUSE;
     }
 }
 
@@ -557,9 +840,10 @@ void resumeAnimation(Sprite* g) {
 */
 void stopAnimationAll() {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    // 末尾から外せば入れ替えが起きない
+    for (int k = pool.activeCount - 1; k >= 0; k--)
     {
-        list[i].isEnabled = false;
+        release(pool.active[k]);
     }
 }
 
@@ -568,11 +852,10 @@ void stopAnimationAll() {
 */
 void pauseAnimationAll() {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int k = 0; k < pool.activeCount; k++)
     {
-        if (list[i].isEnabled) {
-            list[i].pause = true;
-        }
+        int i = pool.active[k];
+        pool.flags[i] |= TWEEN_PAUSE;
     }
 }
 
@@ -581,24 +864,21 @@ void pauseAnimationAll() {
 */
 void resumeAnimationAll() {
 
-    for (int i = 0; i < ANIMATION_MAX; i++)
+    for (int k = 0; k < pool.activeCount; k++)
     {
-        if (list[i].isEnabled) {
-            list[i].pause = false;
-        }
+        int i = pool.active[k];
+        pool.flags[i] &= ~TWEEN_PAUSE;
     }
 }
 
 /**
 * @brief アニメーションの開始までの時間を設定する
-* 
+*
 * @param delay 設定したい遅延時間（ミリ秒）
 */
 void setDelay(int delay) {
-    current->delay = delay;
-    current->startTime = SDL_GetTicks() + delay;
-    current->endTime = current->startTime + current->duration;
-    current->pastTime = -delay;
+    if (current < 0) return;
+    pool.time[current] = (float)-delay;
 }
 
 /**
@@ -607,8 +887,44 @@ void setDelay(int delay) {
 * @param duration 設定したい長さ
 */
 void setDuration(int duration) {
-    current->endTime = current->startTime + duration;
-    current->duration = duration;
+    if (current < 0) return;
+    pool.duration[current] = (float)duration;
+}
+
+/**
+* @brief アニメーションの時計を設定する
+*
+* TIMEBASE_TICKS以外では、ここで読んだ時刻から時間を数える。
+* setDuration・setDelayの単位は、TIMEBASE_FRAMEならフレーム数、TIMEBASE_MUSICならms、TIMEBASE_BEATSなら拍になる
+*
+* @param base 時間の基準（既定はTIMEBASE_TICKS）
+*/
+void setTimebase(Timebase base) {
+    if (current < 0) return;
+    pool.flags[current] = (Uint8)((pool.flags[current] & ((1 << TWEEN_CLOCK_SHIFT) - 1)) | (base << TWEEN_CLOCK_SHIFT));
+    pool.origin[current] = timebaseSample(base);
+}
+
+/**
+* @brief アニメーションの長さを拍で設定する（時計をTIMEBASE_BEATSにする）
+*
+* @param beats 設定したい長さ（4分音符単位）
+*/
+void setDurationBeats(float beats) {
+    if (current < 0) return;
+    if (TWEEN_CLOCK(pool.flags[current]) != TIMEBASE_BEATS) setTimebase(TIMEBASE_BEATS);
+    pool.duration[current] = beats;
+}
+
+/**
+* @brief アニメーションの開始までの時間を拍で設定する（時計をTIMEBASE_BEATSにする）
+*
+* @param beats 設定したい遅延（4分音符単位）
+*/
+void setDelayBeats(float beats) {
+    if (current < 0) return;
+    if (TWEEN_CLOCK(pool.flags[current]) != TIMEBASE_BEATS) setTimebase(TIMEBASE_BEATS);
+    pool.time[current] = -beats;
 }
 
 /**
@@ -617,7 +933,8 @@ void setDuration(int duration) {
 * @param easing 設定したいeasing
 */
 void setEasing(float(*easing)(float ratio)) {
-    current->easing = easing;
+    if (current < 0) return;
+    pool.easing[current] = easingId(easing);
 }
 
 /**
@@ -626,14 +943,16 @@ void setEasing(float(*easing)(float ratio)) {
 * @param onFinished 設定したい関数
 */
 void setOnFinished(void(*onFinished)()) {
-    current->onFinished = onFinished;
+    if (current < 0) return;
+    pool.onFinished[current] = onFinished;
 }
 
 /**
 * @brief アニメーションのループ設定をする
 */
 void setLoop() {
-    current->loop = true;
+    if (current < 0) return;
+    pool.flags[current] |= TWEEN_LOOP;
 }
 
 /**
@@ -642,7 +961,13 @@ void setLoop() {
 * @param type 設定したいループタイプ
 */
 void setLoopType(LoopType type) {
-    current->loopType = type;
+    if (current < 0) return;
+    if (type == PING_PONG) {
+        pool.flags[current] |= TWEEN_PING_PONG;
+    }
+    else {
+        pool.flags[current] &= ~TWEEN_PING_PONG;
+    }
 }
 
 /**
@@ -652,13 +977,11 @@ void setLoopType(LoopType type) {
 * @param duration 遅延実行時間
 */
 void setTimeout(Sprite* g, void(*onFinished)(), int duration) {
-    Animation* data = get(g);
-    if (data == NULL)return;
+    int i = get(g, TWEEN_TIMEOUT);
+    if (i < 0)return;
 
-    data->onFinished = onFinished;
-    data->endTime = data->startTime + duration;
-    data->duration = duration;
-    current = data;
+    pool.onFinished[i] = onFinished;
+    pool.duration[i] = duration;
 }
 
 /**
@@ -667,7 +990,8 @@ void setTimeout(Sprite* g, void(*onFinished)(), int duration) {
 * @param p 引数に渡される変数の参照
 */
 void setCallbackTarget(void* p) {
-    current->callbackTarget = p;
+    if (current < 0) return;
+    pool.callbackTarget[current] = p;
 }
 
 /**
@@ -2,7 +2,8 @@
 * @file animation.h
 * @brief animation構造体処理ヘッダ
 *
-* animation構造体を定義
+* スプライトの値を時間で変化させるアニメーションの操作を定義
+* （データはanimation.cのプールにチャンネル単位で持つ）
 */
 
 #pragma once
@@ -10,45 +11,16 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include "sprite.h"
+#include "timebase.h"
 
-#define ANIMATION_MAX    4000
+#define ANIMATION_DEFAULT_CAPACITY 4000   ///< animationInitを呼ばなかった場合のプールの大きさ
 typedef enum LoopType{
     STRAIGHT,
     PING_PONG
 }LoopType;
 
-/**
-* @brief アニメーションの構造体
-* @author 秋山
-* @version 1.0
-* @date 2017/10/17
-*/
-typedef struct {
-    int id;                             ///< ID
-    Sprite *g;                          ///< アニメーション対象のSprite変数への参照
-    Sprite startValue;                  ///< 開始時の値
-    Sprite targetValue;                 ///< 終了時の値
-    int startTime;                      ///< 開始時間
-    int endTime;                        ///< 終了時間
-    int pastTime;                       ///< 経過時間
-    int duration;                       ///< 長さ
-    int delay;                          ///< 開始までの時間
-    void (*onFinished)();               ///< 終了時コールバック関数
-    void* callbackTarget;
-    float (*easing)(float ratio);     ///< イージング関数
-    bool position;                       ///< 位置のアニメーションが有効かどうかのフラグ
-    bool scale;                          ///< 大きさのアニメーションが有効かどうかのフラグ
-    bool scaleX;                          ///< 大きさのアニメーションが有効かどうかのフラグ
-    bool scaleY;                          ///< 大きさのアニメーションが有効かどうかのフラグ
-    bool rotation;                       ///< 角度のアニメーションが有効かどうかのフラグ
-    bool alpha;                          ///< 透明度のアニメーションが有効かどうかのフラグ
-    bool color;                          ///< 色のアニメーションが有効かどうかのフラグ
-    bool isEnabled;                     ///< アクティブかどうかのフラグ
-    bool loop;                          ///< ループするかどうかのフラグ
-    bool pause;                         ///< ポーズ中かどうかのフラグ
-    LoopType loopType;                  ///< ループのタイプ
-} Animation;
-
+bool animationInit(int capacity);
+void animationQuit(void);
 void easingUpdate(void);
 void moveTo(Sprite* g, float x, float y);
 void scaleTo(Sprite* g, float scale);
@@ -72,6 +44,9 @@ void pauseAnimationAll(void);
 void resumeAnimationAll(void);
 void setDelay(int delay);
 void setDuration(int duration);
+void setTimebase(Timebase base);
+void setDurationBeats(float beats);
+void setDelayBeats(float beats);
 void setEasing(float(*easing)(float ratio));
 void setOnFinished(void(*onFinished)());
 void setLoop(void); 
@@ -0,0 +1,211 @@
+/**
+* @file assetLoader.c
+* @brief 画像をワーカースレッドで読み込むローダーの実装
+*
+* 要求は先入れ先出しの待ち行列に入れ、ワーカーが1つずつIMG_Loadする。
+* 結果は受け取られるまで別の列に置く。assetLoaderWaitで待たれた要求は列の先頭に回す。
+* スレッドは最初の要求で作る
+*/
+#include "assetLoader.h"
+#include "threadPolicy.h"
+#include <SDL2/SDL_image.h>
+#include <string.h>
+
+#define ASSET_LOADER_PATH_MAX   256
+
+/**
+* @brief 読み込みの要求
+*/
+typedef struct {
+    int key;
+    Uint32 tag;
+    char path[ASSET_LOADER_PATH_MAX];
+} AssetJob;
+
+/**
+* @brief 読み込みの結果（失敗したらsurfaceはNULL）
+*/
+typedef struct {
+    int key;
+    Uint32 tag;
+    SDL_Surface* surface;
+} AssetResult;
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* mtx;
+    SDL_cond* cv;               ///< 要求が来た・終了
+    SDL_cond* doneCv;           ///< 1つ読み終えた
+    AssetJob queue[ASSET_LOADER_QUEUE_MAX];
+    int head, count;
+    AssetResult done[ASSET_LOADER_QUEUE_MAX];
+    int doneCount;
+    bool busy;                  ///< currentを読み込み中
+    AssetJob current;
+    bool quit;
+} AssetLoader;
+
+static AssetLoader loader;
+
+static int loader_main(void* ud)
+{
+    (void)ud;
+    threadPolicyApply(THREAD_ROLE_WORKER);
+    for (;;) {
+        SDL_LockMutex(loader.mtx);
+        while (!loader.quit && loader.count == 0) {
+            SDL_CondWait(loader.cv, loader.mtx);
+        }
+        if (loader.quit) {
+            SDL_UnlockMutex(loader.mtx);
+            break;
+        }
+        loader.current = loader.queue[loader.head];
+        loader.head = (loader.head + 1) % ASSET_LOADER_QUEUE_MAX;
+        loader.count--;
+        loader.busy = true;
+        SDL_UnlockMutex(loader.mtx);
+
+        Uint64 begin = SDL_GetPerformanceCounter();
+        SDL_Surface* s = IMG_Load(loader.current.path);
+        if (!s) {
+            SDL_Log("[asset] cannot load %s: %s", loader.current.path, IMG_GetError());
+        }
+        else {
+            SDL_Log("[asset] decoded %s (%.1f ms)", loader.current.path,
+                (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+        }
+
+        SDL_LockMutex(loader.mtx);
+        // 要求を受け付けるときに空きを確かめているので、結果の列はあふれない
+        loader.done[loader.doneCount++] = (AssetResult){ loader.current.key, loader.current.tag, s };
+        loader.busy = false;
+        SDL_CondBroadcast(loader.doneCv);
+        SDL_UnlockMutex(loader.mtx);
+    }
+    return 0;
+}
+
+static bool loader_start(void)
+{
+    loader.mtx = SDL_CreateMutex();
+    loader.cv = SDL_CreateCond();
+    loader.doneCv = SDL_CreateCond();
+    if (!loader.mtx || !loader.cv || !loader.doneCv) return false;
+    loader.thread = SDL_CreateThread(loader_main, "AssetLoader", NULL);
+    if (!loader.thread) {
+        SDL_Log("[asset] cannot start loader thread: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+/**
+* @brief 読み込みを要求する
+*
+* @param key 呼び出し側が決める番号（結果と一緒に返る）
+* @param tag 同じkeyの古い要求と見分けるための値
+* @param path ファイル名
+* @return 受け付けられなければfalse（スレッドが作れない、列がいっぱい）
+*/
+bool assetLoaderRequest(int key, Uint32 tag, const char* path)
+{
+    if (strlen(path) >= ASSET_LOADER_PATH_MAX) return false;
+    if (!loader.thread && !loader_start()) {
+        assetLoaderQuit();
+        return false;
+    }
+    SDL_LockMutex(loader.mtx);
+    bool ok = loader.count + loader.doneCount + (loader.busy ? 1 : 0) < ASSET_LOADER_QUEUE_MAX;
+    if (ok) {
+        AssetJob* j = &loader.queue[(loader.head + loader.count) % ASSET_LOADER_QUEUE_MAX];
+        j->key = key;
+        j->tag = tag;
+        strcpy(j->path, path);
+        loader.count++;
+        SDL_CondSignal(loader.cv);
+    }
+    SDL_UnlockMutex(loader.mtx);
+    return ok;
+}
+
+/**
+* @brief 読み終えた結果を1つ受け取る（描画スレッドでテクスチャにする）
+*
+* @param key 要求のkey
+* @param tag 要求のtag
+* @param surface 読み込んだ画像（失敗したらNULL、受け取った側で開放する）
+* @return 結果が無ければfalse
+*/
+bool assetLoaderTake(int* key, Uint32* tag, SDL_Surface** surface)
+{
+    if (!loader.thread) return false;
+    SDL_LockMutex(loader.mtx);
+    bool ok = loader.doneCount > 0;
+    if (ok) {
+        *key = loader.done[0].key;
+        *tag = loader.done[0].tag;
+        *surface = loader.done[0].surface;
+        loader.doneCount--;
+        memmove(loader.done, loader.done + 1, (size_t)loader.doneCount * sizeof(AssetResult));
+    }
+    SDL_UnlockMutex(loader.mtx);
+    return ok;
+}
+
+/**
+* @brief 要求が読み終わるまで待つ（結果はassetLoaderTakeで受け取る）
+*
+* 列の途中にあれば先頭に回してから待つ
+*
+* @param key 要求のkey
+* @param tag 要求のtag
+*/
+void assetLoaderWait(int key, Uint32 tag)
+{
+    if (!loader.thread) return;
+    SDL_LockMutex(loader.mtx);
+    for (;;) {
+        int found = -1;
+        for (int i = 0; i < loader.count; i++) {
+            const AssetJob* j = &loader.queue[(loader.head + i) % ASSET_LOADER_QUEUE_MAX];
+            if (j->key == key && j->tag == tag) {
+                found = i;
+                break;
+            }
+        }
+        if (found > 0) {
+            AssetJob job = loader.queue[(loader.head + found) % ASSET_LOADER_QUEUE_MAX];
+            for (int i = found; i > 0; i--) {
+                loader.queue[(loader.head + i) % ASSET_LOADER_QUEUE_MAX] =
+                    loader.queue[(loader.head + i - 1) % ASSET_LOADER_QUEUE_MAX];
+            }
+            loader.queue[loader.head] = job;
+        }
+        bool running = loader.busy && loader.current.key == key && loader.current.tag == tag;
+        if (found < 0 && !running) break;
+        SDL_CondWait(loader.doneCv, loader.mtx);
+    }
+    SDL_UnlockMutex(loader.mtx);
+}
+
+/**
+* @brief スレッドを止め、受け取られていない結果を捨てる
+*/
+void assetLoaderQuit(void)
+{
+    if (loader.thread) {
+        SDL_LockMutex(loader.mtx);
+        loader.quit = true;
+        SDL_CondSignal(loader.cv);
+        SDL_UnlockMutex(loader.mtx);
+        SDL_WaitThread(loader.thread, NULL);
+    }
+    for (int i = 0; i < loader.doneCount; i++) {
+        SDL_FreeSurface(loader.done[i].surface);
+    }
+    if (loader.doneCv) SDL_DestroyCond(loader.doneCv);
+    if (loader.cv) SDL_DestroyCond(loader.cv);
+    if (loader.mtx) SDL_DestroyMutex(loader.mtx);
+    memset(&loader, 0, sizeof(loader));
+}
@@ -0,0 +1,19 @@
+/**
+* @file assetLoader.h
+* @brief 画像をワーカースレッドで読み込むローダーのヘッダ
+*
+* PNGなどの読み込みと展開（IMG_Load）だけをワーカーで行い、SDL_Surfaceにして返す。
+* テクスチャの作成は描画スレッドでしかできないので、呼び出し側がassetLoaderTakeで受け取って行う。
+* 要求にはキーとタグを付け、受け取ったときに同じものか確かめる（途中で要らなくなった結果を捨てるため）
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define ASSET_LOADER_QUEUE_MAX  128     ///< 待っている要求と、受け取られていない結果の数の上限
+
+bool assetLoaderRequest(int key, Uint32 tag, const char* path);
+bool assetLoaderTake(int* key, Uint32* tag, SDL_Surface** surface);
+void assetLoaderWait(int key, Uint32 tag);
+void assetLoaderQuit(void);
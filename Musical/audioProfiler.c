@@ -0,0 +1,195 @@
+/**
+* @file audioProfiler.c
+* @brief オーディオコールバックの負荷計測の実装
+*
+* 計測はオーディオスレッドがリングに書き込むだけ（ロック無し、1書き手1読み手）。
+* 集計と警告ログはメインスレッドのaudioProfilerPoll()で行う。
+* 直近の計測値の区間ごとの数と合計は取り込むたびに足し引きしておき、
+* audioProfilerGetStats()は並べ替えずに区間を数えるだけにする（毎フレーム呼ばれるので）
+*/
+#include "audioProfiler.h"
+#include <string.h>
+
+static AudioProfileSample ring[AUDIO_PROFILE_RING];
+static SDL_atomic_t writeIndex;     ///< オーディオスレッドが書き込んだ数
+static unsigned readIndex;          ///< メインスレッドが読み出した数
+
+static AudioProfileSample history[AUDIO_PROFILE_RING];
+static int historyHead;
+static int historyCount;
+static int pctCount[AUDIO_PROFILE_PCT_BINS];   ///< historyの負荷率の1%刻みの区間ごとの数
+static int binCount[AUDIO_PROFILE_BINS];       ///< historyの負荷率の5%刻みの区間ごとの数
+static double loadSum;
+static float maxLoad;
+static float maxDurationUs;
+static bool maxStale;                           ///< 最大値だったものがhistoryから外れた
+
+static uint64_t total;
+static uint64_t overBudget;
+static uint64_t dropped;
+static float warnLoad = AUDIO_PROFILE_WARN_LOAD;
+static Uint32 lastWarnTicks;
+
+/**
+* @brief 負荷率の区間（0～bins-1、範囲外は端の区間）
+*/
+static int load_bin(float load, int perUnit, int bins) {
+    int bin = (int)(load * perUnit);
+    if (bin < 0) bin = 0;
+    if (bin >= bins) bin = bins - 1;
+    return bin;
+}
+
+/**
+* @brief 計測値をhistoryの集計に足す（sign = 1）・から引く（sign = -1）
+*/
+static void count_sample(const AudioProfileSample* s, int sign) {
+    pctCount[load_bin(s->load, 100, AUDIO_PROFILE_PCT_BINS)] += sign;
+    binCount[load_bin(s->load, AUDIO_PROFILE_BINS, AUDIO_PROFILE_BINS)] += sign;
+    loadSum += sign * (double)s->load;
+    if (sign > 0) {
+        if (s->load > maxLoad) maxLoad = s->load;
+        if (s->durationUs > maxDurationUs) maxDurationUs = s->durationUs;
+    }
+    else if (s->load >= maxLoad || s->durationUs >= maxDurationUs) {
+        maxStale = true;
+    }
+}
+
+/**
+* @brief 小さい方からrank番目（0から）の計測値が入っている区間の中央（最大値は超えない）
+*/
+static float load_at_rank(int rank) {
+    int seen = 0;
+    for (int b = 0; b < AUDIO_PROFILE_PCT_BINS; b++) {
+        seen += pctCount[b];
+        if (seen > rank) {
+            float v = ((float)b + 0.5f) / 100.0f;
+            return (v < maxLoad && b < AUDIO_PROFILE_PCT_BINS - 1) ? v : maxLoad;
+        }
+    }
+    return maxLoad;
+}
+
+/**
+* @brief 計測結果をすべて破棄する
+*/
+void audioProfilerReset(void) {
+    SDL_AtomicSet(&writeIndex, 0);
+    readIndex = 0;
+    historyHead = historyCount = 0;
+    memset(pctCount, 0, sizeof(pctCount));
+    memset(binCount, 0, sizeof(binCount));
+    loadSum = 0.0;
+    maxLoad = maxDurationUs = 0.0f;
+    maxStale = false;
+    total = overBudget = dropped = 0;
+    lastWarnTicks = 0;
+}
+
+/**
+* @brief コールバック1回分の計測値を記録する（オーディオスレッドから呼ぶ）
+*
+* @param begin コールバック開始時のSDL_GetPerformanceCounter()
+* @param end コールバック終了時のSDL_GetPerformanceCounter()
+* @param frames 処理したフレーム数
+* @param freq サンプリング周波数
+*/
+void audioProfilerRecord(Uint64 begin, Uint64 end, int frames, int freq) {
+    static Uint64 perfFreq;
+    if (frames <= 0 || freq <= 0) return;
+    if (perfFreq == 0) perfFreq = SDL_GetPerformanceFrequency();
+
+    unsigned w = (unsigned)SDL_AtomicGet(&writeIndex);
+    AudioProfileSample* s = &ring[w & (AUDIO_PROFILE_RING - 1)];
+    s->durationUs = (float)((double)(end - begin) * 1000000.0 / (double)perfFreq);
+    s->periodUs = (float)((double)frames * 1000000.0 / (double)freq);
+    s->load = s->durationUs / s->periodUs;
+
+    // 書き込みが終わってから公開する
+    SDL_AtomicSet(&writeIndex, (int)(w + 1));
+}
+
+/**
+* @brief リングの新しい計測値を取り込む（メインスレッドから毎フレーム呼ぶ）
+*
+* しきい値を超えたコールバックがあれば、1秒に1回まで警告ログを出す
+*/
+void audioProfilerPoll(void) {
+    unsigned w = (unsigned)SDL_AtomicGet(&writeIndex);
+    unsigned n = w - readIndex;
+    if (n > AUDIO_PROFILE_RING) {
+        dropped += n - AUDIO_PROFILE_RING;
+        readIndex = w - AUDIO_PROFILE_RING;
+    }
+
+    AudioProfileSample worst = { 0 };
+    while (readIndex != w) {
+        AudioProfileSample s = ring[readIndex & (AUDIO_PROFILE_RING - 1)];
+        readIndex++;
+
+        // 一番古いものを集計から外して入れ替える
+        if (historyCount == AUDIO_PROFILE_RING) count_sample(&history[historyHead], -1);
+        else historyCount++;
+        history[historyHead] = s;
+        historyHead = (historyHead + 1) % AUDIO_PROFILE_RING;
+        count_sample(&s, 1);
+
+        total++;
+        if (s.load > warnLoad) overBudget++;
+        if (s.load > worst.load) worst = s;
+    }
+
+    if (worst.load > warnLoad) {
+        Uint32 now = SDL_GetTicks();
+        if (lastWarnTicks == 0 || now - lastWarnTicks >= 1000) {
+            SDL_Log("[audioProfiler] callback load %.0f%% over %.0f%% (%.0f us / %.0f us)",
+                worst.load * 100.0f, warnLoad * 100.0f, worst.durationUs, worst.periodUs);
+            lastWarnTicks = now;
+        }
+    }
+}
+
+/**
+* @brief 直近の計測値から統計を求める
+*
+* パーセンタイルは1%刻みの区間の数から求める。最大値は、最大だったものが外れたときだけ数え直す
+*
+* @param out 集計結果の格納先
+*/
+void audioProfilerGetStats(AudioProfileStats* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+
+    out->total = total;
+    out->overBudget = overBudget;
+    out->dropped = dropped;
+    out->count = historyCount;
+    if (historyCount == 0) return;
+
+    if (maxStale) {
+        maxLoad = maxDurationUs = 0.0f;
+        for (int i = 0; i < historyCount; i++) {
+            if (history[i].load > maxLoad) maxLoad = history[i].load;
+            if (history[i].durationUs > maxDurationUs) maxDurationUs = history[i].durationUs;
+        }
+        maxStale = false;
+    }
+
+    memcpy(out->histogram, binCount, sizeof(out->histogram));
+    out->p50 = load_at_rank((historyCount - 1) / 2);
+    out->p99 = load_at_rank((int)((historyCount - 1) * 0.99));
+    out->max = maxLoad;
+    out->maxDurationUs = maxDurationUs;
+    out->mean = (float)(loadSum / historyCount);
+    out->periodUs = history[(historyHead + AUDIO_PROFILE_RING - 1) % AUDIO_PROFILE_RING].periodUs;
+}
+
+/**
+* @brief 警告を出す負荷率のしきい値を設定する
+*
+* @param load 負荷率（1.0で周期いっぱい）
+*/
+void audioProfilerSetWarnThreshold(float load) {
+    warnLoad = load;
+}
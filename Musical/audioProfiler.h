@@ -0,0 +1,48 @@
+/**
+* @file audioProfiler.h
+* @brief オーディオコールバックの負荷計測ヘッダ
+*
+* コールバック1回ごとの処理時間を計測し、周期に対する負荷率を集計する
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AUDIO_PROFILE_RING      1024    ///< 計測サンプルのリングバッファ長（2の累乗）
+#define AUDIO_PROFILE_BINS      20      ///< 負荷ヒストグラムの区間数（5%刻み、最後は100%以上）
+#define AUDIO_PROFILE_PCT_BINS  256     ///< パーセンタイル用の負荷の区間数（1%刻み、最後は255%以上）
+#define AUDIO_PROFILE_WARN_LOAD 0.7f    ///< 既定の警告しきい値（負荷率）
+
+/**
+* @brief コールバック1回分の計測値
+*/
+typedef struct {
+    float durationUs;   ///< 処理時間(us)
+    float periodUs;     ///< バッファ1回分の周期(us)
+    float load;         ///< 負荷率 = durationUs / periodUs
+} AudioProfileSample;
+
+/**
+* @brief 集計結果
+*/
+typedef struct {
+    int count;                          ///< 集計対象のサンプル数（直近AUDIO_PROFILE_RING個まで）
+    float p50;                          ///< 負荷率の中央値（1%刻みの区間の中央）
+    float p99;                          ///< 負荷率の99パーセンタイル（1%刻みの区間の中央）
+    float max;                          ///< 負荷率の最大値
+    float mean;                         ///< 負荷率の平均
+    float maxDurationUs;                ///< 処理時間の最大値(us)
+    float periodUs;                     ///< 直近の周期(us)
+    int histogram[AUDIO_PROFILE_BINS];  ///< 負荷率のヒストグラム
+    uint64_t total;                     ///< 計測したコールバック数（累計）
+    uint64_t overBudget;                ///< しきい値を超えたコールバック数（累計）
+    uint64_t dropped;                   ///< 読み出しが間に合わず捨てたサンプル数
+} AudioProfileStats;
+
+void audioProfilerReset(void);
+void audioProfilerRecord(Uint64 begin, Uint64 end, int frames, int freq);
+void audioProfilerPoll(void);
+void audioProfilerGetStats(AudioProfileStats* out);
+void audioProfilerSetWarnThreshold(float load);
@@ -0,0 +1,626 @@
+/**
+* @file chartDraft.c
+* @brief 曲からの譜面の下書き生成の実装
+*
+* 1. 帯域ごとのスペクトルフラックスを求める（CHART_HOPごと、区間に分けて並列）
+* 2. 全帯域のオンセット包絡の自己相関でテンポの候補を選び、
+*    周期と位相を細かく振って拍の並びに最も合うものを探す（周期の候補ごとに並列）
+* 3. 帯域ごとに局所平均を超える極大をオンセットとして拾う（帯域ごとに並列）
+* 4. 最初の拍までを1拍目の前の弱起として、拍が小節の頭に揃うSMFを書き出す
+*/
+#include "chartDraft.h"
+#include "onset.h"
+#include "parallel.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHART_MEAN_RADIUS   8       // 包絡から引く移動平均の半径(hops)
+#define CHART_PEAK_RADIUS   3       // 極大とみなす範囲(hops)
+#define CHART_THRESH_RADIUS 32      // しきい値の局所平均の半径(hops)
+#define CHART_PEAK_DELTA    0.1f    // 局所平均に足すしきい値（正規化後）
+#define CHART_PEAK_FLOOR    0.25f   // これより弱いものは拾わない（正規化後）
+#define CHART_MIN_GAP_MS    70.0    // 同じ帯域のオンセットの最小間隔
+#define CHART_LOW_HZ        200.0   // 低域の上限
+#define CHART_HIGH_HZ       4000.0  // 高域の下限
+#define CHART_TEMPO_SIGMA   1.4     // テンポの重みの幅(octaves)
+#define CHART_PERIOD_SPAN   0.03    // 自己相関の結果から前後に振る周期の幅（割合）
+#define CHART_PERIOD_STEP   0.02    // 周期を振る刻み(hops)
+#define CHART_PHASE_STEP    0.25    // 位相を振る刻み(hops)
+#define CHART_ONSET_LAG     0.5     // 包絡のピークから音の立ち上がりまでの遅れ(hops)。対数振幅は窓の前端で反応するので早めに出る
+
+typedef struct {
+    OnsetSource src;
+    int count;
+    int lowBin;
+    int highBin;
+    float* flux[CHART_LANE_MAX];    // [count] 帯域ごとのスペクトルフラックス
+    float* env[CHART_LANE_MAX];     // [count] 移動平均を引いて正規化した包絡
+    float* beatEnv;                 // [count] テンポ検出用（全帯域 + 低域）
+
+    // テンポ
+    int lagMin, lagMax;
+    double* acf;                    // [lagMax + 1]
+    int periodCount;
+    double periodBase;
+    double* periodScore;            // [periodCount]
+    double* periodPhase;            // [periodCount]
+    double* periodMean;             // [periodCount]
+
+    // オンセット
+    double minGap;                  // hops
+    ChartOnset* laneOnsets[CHART_LANE_MAX];
+    int laneCount[CHART_LANE_MAX];
+
+    SDL_atomic_t failed;            // どこかの区間で作業用のメモリが取れなかった
+} ChartJob;
+
+/**
+* @brief フレーム[begin, end)の帯域ごとのスペクトルフラックス
+*/
+static void flux_task(void* ctx, int begin, int end) {
+    ChartJob* job = (ChartJob*)ctx;
+    OnsetBand bands[CHART_LANE_MAX];
+    bands[CHART_LANE_ALL] = (OnsetBand){ 1, job->src.plan->n / 2, job->flux[CHART_LANE_ALL] };
+    bands[CHART_LANE_LOW] = (OnsetBand){ 1, job->lowBin, job->flux[CHART_LANE_LOW] };
+    bands[CHART_LANE_HIGH] = (OnsetBand){ job->highBin, job->src.plan->n / 2, job->flux[CHART_LANE_HIGH] };
+    if (!onsetFlux(&job->src, CHART_HOP, begin, end, true, bands, CHART_LANE_MAX)) {
+        SDL_AtomicSet(&job->failed, 1);
+    }
+}
+
+static int cmp_float(const void* a, const void* b) {
+    float A = *(const float*)a;
+    float B = *(const float*)b;
+    return (A > B) - (A < B);
+}
+
+/**
+* @brief 帯域[begin, end)の包絡を作る
+*
+* 移動平均を引いて半波整流（立ち上がりだけ残す）し、上位1%の値が1になるよう正規化する。
+* 一か所の大きな音で全体が小さくならないよう最大値ではなく分位点を使う
+*/
+static void envelope_task(void* ctx, int begin, int end) {
+    ChartJob* job = (ChartJob*)ctx;
+    int count = job->count;
+    float* sorted = (float*)SDL_malloc((size_t)count * sizeof(float));
+    if (!sorted) {
+        SDL_AtomicSet(&job->failed, 1);
+        return;
+    }
+    for (int lane = begin; lane < end; lane++) {
+        const float* flux = job->flux[lane];
+        float* env = job->env[lane];
+        double acc = 0.0;
+        int lo = 0, hi = 0;
+        for (int t = 0; t < count; t++) {
+            while (hi < count && hi <= t + CHART_MEAN_RADIUS) acc += flux[hi++];
+            while (lo < t - CHART_MEAN_RADIUS) acc -= flux[lo++];
+            float v = flux[t] - (float)(acc / (double)(hi - lo));
+            env[t] = v > 0.0f ? v : 0.0f;
+        }
+        SDL_memcpy(sorted, env, (size_t)count * sizeof(float));
+        qsort(sorted, (size_t)count, sizeof(float), cmp_float);
+        float ref = sorted[(int)((double)(count - 1) * 0.99)];
+        if (ref <= 1e-9f) ref = sorted[count - 1];
+        if (ref <= 1e-9f) continue;
+        float inv = 1.0f / ref;
+        for (int t = 0; t < count; t++) env[t] *= inv;
+    }
+    SDL_free(sorted);
+}
+
+/**
+* @brief 自己相関（遅れlagMin + [begin, end)）
+*/
+static void acf_task(void* ctx, int begin, int end) {
+    ChartJob* job = (ChartJob*)ctx;
+    const float* env = job->beatEnv;
+    for (int i = begin; i < end; i++) {
+        int lag = job->lagMin + i;
+        double s = 0.0;
+        for (int t = lag; t < job->count; t++) s += (double)env[t] * env[t - lag];
+        job->acf[lag] = s / (double)(job->count - lag);
+    }
+}
+
+/**
+* @brief 周期periodと位相phaseの拍の並びに包絡がどれだけ乗るか
+*/
+static double comb_score(const ChartJob* job, double period, double phase) {
+    const float* env = job->beatEnv;
+    double s = 0.0;
+    for (double x = phase; x < job->count; x += period) s += onsetSampleEnv(env, job->count, x);
+    return s;
+}
+
+/**
+* @brief 周期の候補[begin, end)ごとに、拍の並びに最も合う位相を探す
+*/
+static void period_task(void* ctx, int begin, int end) {
+    ChartJob* job = (ChartJob*)ctx;
+    for (int i = begin; i < end; i++) {
+        double period = job->periodBase + (double)i * CHART_PERIOD_STEP;
+        double best = -1.0, bestPhase = 0.0, sum = 0.0;
+        int phases = 0;
+        for (double phase = 0.0; phase < period; phase += CHART_PHASE_STEP) {
+            double s = comb_score(job, period, phase);
+            sum += s;
+            phases++;
+            if (s > best) {
+                best = s;
+                bestPhase = phase;
+            }
+        }
+        job->periodScore[i] = best;
+        job->periodPhase[i] = bestPhase;
+        job->periodMean[i] = phases > 0 ? sum / phases : 0.0;
+    }
+}
+
+/**
+* @brief テンポと最初の拍の位置を求める
+*
+* 自己相関は倍・半分のテンポでも高くなるので、120BPM付近を好む重みをかけて選ぶ。
+* 全帯域だけだと細かい刻み（ハイハット等）に引っ張られるので低域を足して拍の頭を強める
+*/
+static bool detect_tempo(ChartJob* job, int freq, ChartDraft* d) {
+    double hopsPerSec = (double)freq / CHART_HOP;
+    job->beatEnv = (float*)SDL_malloc((size_t)job->count * sizeof(float));
+    if (!job->beatEnv) return false;
+    for (int t = 0; t < job->count; t++) {
+        job->beatEnv[t] = job->env[CHART_LANE_ALL][t] + job->env[CHART_LANE_LOW][t];
+    }
+
+    job->lagMin = (int)floor(hopsPerSec * 60.0 / CHART_BPM_MAX);
+    job->lagMax = (int)ceil(hopsPerSec * 60.0 / CHART_BPM_MIN);
+    if (job->lagMin < 2 || job->lagMax * 4 >= job->count) return false;
+
+    job->acf = (double*)SDL_calloc((size_t)job->lagMax + 2, sizeof(double));
+    if (!job->acf) return false;
+    parallelFor(job->lagMax + 2 - job->lagMin, acf_task, job);
+
+    int bestLag = 0;
+    double bestV = -1.0;
+    for (int lag = job->lagMin + 1; lag <= job->lagMax; lag++) {
+        double bpm = 60.0 * hopsPerSec / lag;
+        double oct = log2(bpm / 120.0);
+        double v = job->acf[lag] * exp(-0.5 * oct * oct / (CHART_TEMPO_SIGMA * CHART_TEMPO_SIGMA));
+        if (v > bestV) {
+            bestV = v;
+            bestLag = lag;
+        }
+    }
+    double lag = bestLag + onsetParabolicPeak(job->acf[bestLag - 1], job->acf[bestLag], job->acf[bestLag + 1]);
+
+    // 自己相関の分解能（1hop）では曲の終わりまでに拍がずれるので、周期と位相を同時に詰める
+    job->periodBase = lag * (1.0 - CHART_PERIOD_SPAN);
+    job->periodCount = (int)(2.0 * CHART_PERIOD_SPAN * lag / CHART_PERIOD_STEP) + 1;
+    job->periodScore = (double*)SDL_calloc((size_t)job->periodCount * 3, sizeof(double));
+    if (!job->periodScore) return false;
+    job->periodPhase = job->periodScore + job->periodCount;
+    job->periodMean = job->periodPhase + job->periodCount;
+    parallelFor(job->periodCount, period_task, job);
+
+    int best = 0;
+    for (int i = 1; i < job->periodCount; i++) {
+        if (job->periodScore[i] > job->periodScore[best]) best = i;
+    }
+    double x = 0.0;
+    if (best > 0 && best < job->periodCount - 1) {
+        x = onsetParabolicPeak(job->periodScore[best - 1], job->periodScore[best], job->periodScore[best + 1]);
+    }
+    double period = job->periodBase + ((double)best + x) * CHART_PERIOD_STEP;
+
+    // 補間した周期で位相を細かく詰め直す
+    double phase = job->periodPhase[best];
+    double bestS = -1.0;
+    for (double p = job->periodPhase[best] - CHART_PHASE_STEP; p <= job->periodPhase[best] + CHART_PHASE_STEP; p += CHART_PHASE_STEP / 8.0) {
+        double s = comb_score(job, period, p < 0.0 ? p + period : p);
+        if (s > bestS) {
+            bestS = s;
+            phase = p;
+        }
+    }
+
+    double beatLen = period * CHART_HOP;
+    d->bpm = 60.0 * (double)freq / beatLen;
+    d->beatFrame = (phase + CHART_ONSET_LAG) * CHART_HOP;
+    while (d->beatFrame < 0.0) d->beatFrame += beatLen;
+    while (d->beatFrame >= beatLen) d->beatFrame -= beatLen;
+    d->tempoConfidence = job->periodMean[best] > 0.0 ? (float)(job->periodScore[best] / job->periodMean[best]) : 0.0f;
+    return true;
+}
+
+/**
+* @brief 帯域[begin, end)のオンセットを拾う
+*/
+static void peak_task(void* ctx, int begin, int end) {
+    ChartJob* job = (ChartJob*)ctx;
+    int count = job->count;
+    double* prefix = (double*)SDL_malloc(((size_t)count + 1) * sizeof(double));
+    if (!prefix) {
+        SDL_AtomicSet(&job->failed, 1);
+        return;
+    }
+
+    for (int lane = begin; lane < end; lane++) {
+        const float* env = job->env[lane];
+        ChartOnset* out = job->laneOnsets[lane];
+        int n = 0;
+        int cap = (int)(count / job->minGap) + 1;
+        double last = -1e9;
+
+        prefix[0] = 0.0;
+        for (int t = 0; t < count; t++) prefix[t + 1] = prefix[t] + env[t];
+
+        for (int t = 1; t < count - 1 && n < cap; t++) {
+            float v = env[t];
+            if (v < CHART_PEAK_FLOOR) continue;
+
+            int lo = t - CHART_PEAK_RADIUS < 0 ? 0 : t - CHART_PEAK_RADIUS;
+            int hi = t + CHART_PEAK_RADIUS >= count ? count - 1 : t + CHART_PEAK_RADIUS;
+            bool isMax = true;
+            for (int k = lo; k <= hi && isMax; k++) {
+                // 同じ値が並ぶときは先頭だけを極大とする
+                if (env[k] > v || (k < t && env[k] == v)) isMax = false;
+            }
+            if (!isMax) continue;
+
+            int mlo = t - CHART_THRESH_RADIUS < 0 ? 0 : t - CHART_THRESH_RADIUS;
+            int mhi = t + CHART_THRESH_RADIUS >= count ? count - 1 : t + CHART_THRESH_RADIUS;
+            double mean = (prefix[mhi + 1] - prefix[mlo]) / (double)(mhi - mlo + 1);
+            if (v < mean + CHART_PEAK_DELTA) continue;
+
+            double x = t + onsetParabolicPeak(env[t - 1], v, env[t + 1]);
+            if (x - last < job->minGap) continue;
+            last = x;
+
+            float s = v > 1.0f ? 1.0f : v;
+            int vel = 1 + (int)(126.0f * sqrtf(s) + 0.5f);
+            out[n].frame = (int64_t)((x + CHART_ONSET_LAG) * CHART_HOP + 0.5);
+            if (out[n].frame < 0) out[n].frame = 0;
+            out[n].lane = (uint8_t)lane;
+            out[n].vel = (uint8_t)(vel > 127 ? 127 : vel);
+            n++;
+        }
+        job->laneCount[lane] = n;
+    }
+    SDL_free(prefix);
+}
+
+static int cmp_onset(const void* a, const void* b) {
+    const ChartOnset* A = (const ChartOnset*)a;
+    const ChartOnset* B = (const ChartOnset*)b;
+    if (A->frame != B->frame) return A->frame < B->frame ? -1 : 1;
+    return (int)A->lane - (int)B->lane;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double A = *(const double*)a;
+    double B = *(const double*)b;
+    return (A > B) - (A < B);
+}
+
+/**
+* @brief 拍の位置を、拍の近く（±1/8拍）にある全帯域のオンセットとのずれの中央値で詰める
+*
+* 包絡の拍の並びによる位相は刻みと補間の分だけ粗いので、拾ったオンセットの位置で直す
+*/
+static void refine_beat_phase(ChartDraft* d) {
+    double beatLen = 60.0 * (double)d->freq / d->bpm;
+    double* res = (double*)SDL_malloc((size_t)(d->count > 0 ? d->count : 1) * sizeof(double));
+    if (!res) return;
+    int n = 0;
+    for (int i = 0; i < d->count; i++) {
+        if (d->onsets[i].lane != CHART_LANE_ALL) continue;
+        double x = ((double)d->onsets[i].frame - d->beatFrame) / beatLen;
+        double r = x - floor(x + 0.5);
+        if (fabs(r) <= 0.125) res[n++] = r * beatLen;
+    }
+    if (n >= 8) {
+        qsort(res, (size_t)n, sizeof(double), cmp_double);
+        d->beatFrame += res[n / 2];
+        while (d->beatFrame < 0.0) d->beatFrame += beatLen;
+        while (d->beatFrame >= beatLen) d->beatFrame -= beatLen;
+    }
+    SDL_free(res);
+}
+
+static void free_job(ChartJob* job) {
+    for (int lane = 0; lane < CHART_LANE_MAX; lane++) {
+        SDL_free(job->flux[lane]);
+        SDL_free(job->env[lane]);
+        SDL_free(job->laneOnsets[lane]);
+    }
+    SDL_free(job->beatEnv);
+    SDL_free(job->acf);
+    SDL_free(job->periodScore);
+}
+
+/**
+* @brief 曲からオンセットとテンポを検出する
+*
+* @param d 結果（使い終わったらchartDraftFree）
+* @param music インターリーブのfloat32
+* @param frames フレーム数
+* @param channels チャンネル数
+* @param freq サンプリング周波数
+* @return 成功したらtrue
+*/
+bool chartDraftBuild(ChartDraft* d, const float* music, int64_t frames, int channels, int freq) {
+    SDL_zerop(d);
+    if (!music || frames <= CHART_FFT_SIZE || channels <= 0 || freq <= 0) return false;
+    if (frames / CHART_HOP >= INT32_MAX) return false;
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+
+    ChartJob job;
+    SDL_zero(job);
+    job.src.music = music;
+    job.src.frames = frames;
+    job.src.channels = channels;
+    job.count = (int)(frames / CHART_HOP) + 1;
+    job.lowBin = (int)(CHART_LOW_HZ * CHART_FFT_SIZE / freq);
+    job.highBin = (int)ceil(CHART_HIGH_HZ * CHART_FFT_SIZE / freq);
+    job.minGap = CHART_MIN_GAP_MS * 0.001 * freq / CHART_HOP;
+
+    int cap = (int)(job.count / job.minGap) + 1;
+    bool ok = true;
+    for (int lane = 0; lane < CHART_LANE_MAX; lane++) {
+        job.flux[lane] = (float*)SDL_calloc((size_t)job.count, sizeof(float));
+        job.env[lane] = (float*)SDL_calloc((size_t)job.count, sizeof(float));
+        job.laneOnsets[lane] = (ChartOnset*)SDL_malloc((size_t)cap * sizeof(ChartOnset));
+        ok = ok && job.flux[lane] && job.env[lane] && job.laneOnsets[lane];
+    }
+    FFTPlan plan;
+    float window[CHART_FFT_SIZE];
+    if (!ok || !fftPlanInit(&plan, CHART_FFT_SIZE)) {
+        free_job(&job);
+        return false;
+    }
+    fftHannWindow(window, CHART_FFT_SIZE);
+    job.src.plan = &plan;
+    job.src.window = window;
+
+    int threads = parallelFor(job.count, flux_task, &job);
+    fftPlanFree(&plan);
+    parallelFor(CHART_LANE_MAX, envelope_task, &job);
+    if (SDL_AtomicGet(&job.failed)) {
+        SDL_Log("[chartDraft] out of memory during onset envelope");
+        free_job(&job);
+        return false;
+    }
+
+    d->freq = freq;
+    d->frames = frames;
+    if (!detect_tempo(&job, freq, d)) {
+        SDL_Log("[chartDraft] song too short for tempo detection");
+        d->bpm = 120.0;
+        d->beatFrame = 0.0;
+        d->tempoConfidence = 0.0f;
+    }
+
+    parallelFor(CHART_LANE_MAX, peak_task, &job);
+    if (SDL_AtomicGet(&job.failed)) {
+        SDL_Log("[chartDraft] out of memory during onset picking");
+        free_job(&job);
+        return false;
+    }
+
+    int total = 0;
+    for (int lane = 0; lane < CHART_LANE_MAX; lane++) total += job.laneCount[lane];
+    d->onsets = (ChartOnset*)SDL_malloc((size_t)(total > 0 ? total : 1) * sizeof(ChartOnset));
+    if (!d->onsets) {
+        free_job(&job);
+        return false;
+    }
+    for (int lane = 0; lane < CHART_LANE_MAX; lane++) {
+        SDL_memcpy(d->onsets + d->count, job.laneOnsets[lane], (size_t)job.laneCount[lane] * sizeof(ChartOnset));
+        d->count += job.laneCount[lane];
+    }
+    qsort(d->onsets, (size_t)d->count, sizeof(ChartOnset), cmp_onset);
+    refine_beat_phase(d);
+
+    double ms = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    SDL_Log("[chartDraft] %.1f BPM (confidence %.2f), first beat %.1f ms, onsets all=%d low=%d high=%d (%.1f ms, %d threads)",
+        d->bpm, d->tempoConfidence, d->beatFrame * 1000.0 / freq,
+        job.laneCount[CHART_LANE_ALL], job.laneCount[CHART_LANE_LOW], job.laneCount[CHART_LANE_HIGH], ms, threads);
+
+    free_job(&job);
+    return true;
+}
+
+void chartDraftFree(ChartDraft* d) {
+    if (!d) return;
+    SDL_free(d->onsets);
+    SDL_zerop(d);
+}
+
+// ---------------- SMF ----------------
+
+typedef struct {
+    uint8_t* p;
+    size_t n, cap;
+    bool failed;
+} SmfBuf;
+
+static void put_u8(SmfBuf* b, uint8_t v) {
+    if (b->failed) return;
+    if (b->n == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 1024;
+        uint8_t* p = (uint8_t*)SDL_realloc(b->p, cap);
+        if (!p) {
+            b->failed = true;
+            return;
+        }
+        b->p = p;
+        b->cap = cap;
+    }
+    b->p[b->n++] = v;
+}
+
+static void put_vlq(SmfBuf* b, uint32_t v) {
+    uint8_t tmp[5];
+    int n = 0;
+    tmp[n++] = (uint8_t)(v & 0x7F);
+    while ((v >>= 7) != 0) tmp[n++] = (uint8_t)(0x80 | (v & 0x7F));
+    while (n > 0) put_u8(b, tmp[--n]);
+}
+
+static void put_meta(SmfBuf* b, uint32_t delta, uint8_t type, const uint8_t* data, uint32_t len) {
+    put_vlq(b, delta);
+    put_u8(b, 0xFF);
+    put_u8(b, type);
+    put_vlq(b, len);
+    for (uint32_t i = 0; i < len; i++) put_u8(b, data[i]);
+}
+
+static void put_tempo(SmfBuf* b, uint32_t delta, uint32_t usPerQN) {
+    uint8_t t[3] = { (uint8_t)(usPerQN >> 16), (uint8_t)(usPerQN >> 8), (uint8_t)usPerQN };
+    put_meta(b, delta, 0x51, t, 3);
+}
+
+static void put_name(SmfBuf* b, const char* name) {
+    put_meta(b, 0, 0x03, (const uint8_t*)name, (uint32_t)SDL_strlen(name));
+}
+
+static bool write_chunk(FILE* fp, const SmfBuf* b) {
+    uint8_t h[8] = { 'M', 'T', 'r', 'k',
+        (uint8_t)(b->n >> 24), (uint8_t)(b->n >> 16), (uint8_t)(b->n >> 8), (uint8_t)b->n };
+    return fwrite(h, 1, 8, fp) == 8 && fwrite(b->p, 1, b->n, fp) == b->n;
+}
+
+/**
+* @brief 弱起とテンポ
+*
+* 最初の拍までの長さを4分音符1つ分の弱起にして、以降の拍が整数tickに乗るようにする。
+* 弱起の小節はテンポが違うので、グリッドに寄せるときも弱起の長さを分割した刻みを使う
+*/
+typedef struct {
+    double pickup;      // 弱起の長さ(frames)
+    double beatLen;     // 1拍の長さ(frames)
+    int subdivision;
+} ChartGrid;
+
+static int32_t frame_to_tick(const ChartGrid* g, int64_t frame) {
+    double f = (double)frame;
+    bool inPickup = f < g->pickup;
+    double beat = inPickup ? f / g->pickup : (f - g->pickup) / g->beatLen;
+    if (g->subdivision > 0) beat = floor(beat * g->subdivision + 0.5) / g->subdivision;
+    int32_t tick = (int32_t)floor(beat * CHART_TPQN + 0.5);
+    return inPickup ? tick : CHART_TPQN + tick;
+}
+
+/**
+* @brief 帯域1つ分のトラックを作る（同じtickのノートは強い方だけ残す）
+*/
+static int32_t build_lane_track(SmfBuf* b, const ChartDraft* d, const ChartGrid* g, int lane) {
+    static const char* names[CHART_LANE_MAX] = { "onset", "low", "high" };
+    static const uint8_t notes[CHART_LANE_MAX] = { CHART_NOTE_ALL, CHART_NOTE_LOW, CHART_NOTE_HIGH };
+    uint8_t ch = (uint8_t)lane;
+    put_name(b, names[lane]);
+
+    int32_t now = 0;
+    int i = 0;
+    while (i < d->count) {
+        if (d->onsets[i].lane != lane) {
+            i++;
+            continue;
+        }
+        int32_t tick = frame_to_tick(g, d->onsets[i].frame);
+        uint8_t vel = d->onsets[i].vel;
+        int next = i + 1;
+        int32_t nextTick = INT32_MAX;
+        for (; next < d->count; next++) {
+            if (d->onsets[next].lane != lane) continue;
+            nextTick = frame_to_tick(g, d->onsets[next].frame);
+            if (nextTick != tick) break;
+            if (d->onsets[next].vel > vel) vel = d->onsets[next].vel;
+            nextTick = INT32_MAX;
+        }
+        if (tick < now) tick = now;
+
+        int32_t len = CHART_TPQN / 4;
+        if (nextTick != INT32_MAX && nextTick - tick < len) len = nextTick - tick;
+        if (len < 1) len = 1;
+
+        put_vlq(b, (uint32_t)(tick - now));
+        put_u8(b, (uint8_t)(0x90 | ch));
+        put_u8(b, notes[lane]);
+        put_u8(b, vel);
+        put_vlq(b, (uint32_t)len);
+        put_u8(b, (uint8_t)(0x80 | ch));
+        put_u8(b, notes[lane]);
+        put_u8(b, 0);
+        now = tick + len;
+        i = next;
+    }
+    return now;
+}
+
+/**
+* @brief 下書きをType-1のSMFとして書き出す
+*
+* トラック0: テンポと拍子、トラック1～3: ChartLaneの順のオンセット
+*
+* @param d 下書き
+* @param path 出力先
+* @param subdivision 1拍をいくつに分けたグリッドに寄せるか（0なら寄せない）
+* @return 成功したらtrue
+*/
+bool chartDraftWriteSmf(const ChartDraft* d, const char* path, int subdivision) {
+    if (!d || !path || d->bpm <= 0.0 || d->freq <= 0) return false;
+    if (subdivision < 0) subdivision = 0;
+    if (subdivision > CHART_TPQN) subdivision = CHART_TPQN;
+
+    ChartGrid g;
+    g.beatLen = 60.0 * (double)d->freq / d->bpm;
+    g.pickup = d->beatFrame;
+    if (g.pickup < g.beatLen * 0.25) g.pickup += g.beatLen;
+    g.subdivision = subdivision;
+
+    SmfBuf tracks[1 + CHART_LANE_MAX];
+    SDL_memset(tracks, 0, sizeof(tracks));
+
+    int32_t endTick = 0;
+    for (int lane = 0; lane < CHART_LANE_MAX; lane++) {
+        SmfBuf* b = &tracks[1 + lane];
+        int32_t t = build_lane_track(b, d, &g, lane);
+        put_meta(b, 0, 0x2F, NULL, 0);
+        if (t > endTick) endTick = t;
+    }
+
+    // 曲の最後までをトラック0の長さにする
+    int32_t songEnd = frame_to_tick(&(ChartGrid){ g.pickup, g.beatLen, 0 }, d->frames);
+    if (songEnd > endTick) endTick = songEnd;
+
+    SmfBuf* c = &tracks[0];
+    static const uint8_t timeSig[4] = { 4, 2, 24, 8 };
+    put_name(c, "conductor");
+    put_meta(c, 0, 0x58, timeSig, 4);
+    put_tempo(c, 0, (uint32_t)(g.pickup * 1000000.0 / d->freq + 0.5));
+    put_tempo(c, CHART_TPQN, (uint32_t)(g.beatLen * 1000000.0 / d->freq + 0.5));
+    put_meta(c, (uint32_t)(endTick > CHART_TPQN ? endTick - CHART_TPQN : 0), 0x2F, NULL, 0);
+
+    bool ok = true;
+    for (int i = 0; i <= CHART_LANE_MAX; i++) ok = ok && !tracks[i].failed;
+
+    FILE* fp = ok ? fopen(path, "wb") : NULL;
+    if (fp) {
+        uint8_t h[14] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6,
+            0, 1, 0, 1 + CHART_LANE_MAX, (uint8_t)(CHART_TPQN >> 8), (uint8_t)CHART_TPQN };
+        ok = fwrite(h, 1, sizeof(h), fp) == sizeof(h);
+        for (int i = 0; i <= CHART_LANE_MAX && ok; i++) ok = write_chunk(fp, &tracks[i]);
+        if (fclose(fp) != 0) ok = false;
+    }
+    else {
+        if (ok) SDL_Log("[chartDraft] cannot open %s", path);
+        ok = false;
+    }
+
+    for (int i = 0; i <= CHART_LANE_MAX; i++) SDL_free(tracks[i].p);
+    return ok;
+}
@@ -0,0 +1,56 @@
+/**
+* @file chartDraft.h
+* @brief 曲からの譜面の下書き生成ヘッダ
+*
+* 曲のスペクトルフラックスからオンセットとテンポを検出し、
+* load_midi_build_eventsで読めるType-1のSMFとして書き出す
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CHART_HOP           256     ///< オンセット包絡の間隔(frames)
+#define CHART_FFT_SIZE      1024    ///< スペクトルフラックスのFFTサイズ
+#define CHART_TPQN          480     ///< 書き出すSMFの分解能
+#define CHART_BPM_MIN       70.0    ///< テンポの探索範囲
+#define CHART_BPM_MAX       190.0
+#define CHART_NOTE_ALL      60      ///< トラック1（全帯域）のノート番号
+#define CHART_NOTE_LOW      36      ///< トラック2（低域、キック等）のノート番号
+#define CHART_NOTE_HIGH     42      ///< トラック3（高域、ハイハット等）のノート番号
+
+/**
+* @brief オンセットを検出する帯域（SMFのトラック1～3に対応）
+*/
+typedef enum {
+    CHART_LANE_ALL,     ///< 全帯域
+    CHART_LANE_LOW,     ///< 低域（～200Hz）
+    CHART_LANE_HIGH,    ///< 高域（4kHz～）
+    CHART_LANE_MAX
+} ChartLane;
+
+/**
+* @brief 検出したオンセット
+*/
+typedef struct {
+    int64_t frame;      ///< 曲の先頭からのフレーム位置
+    uint8_t lane;       ///< ChartLane
+    uint8_t vel;        ///< 強さ（1～127）
+} ChartOnset;
+
+/**
+* @brief 譜面の下書き
+*/
+typedef struct {
+    int freq;                   ///< 曲のサンプリング周波数
+    int64_t frames;             ///< 曲の長さ(frames)
+    double bpm;                 ///< 検出したテンポ
+    double beatFrame;           ///< 最初の拍の位置(frames)
+    float tempoConfidence;      ///< 拍の並びのスコア/平均（大きいほど確か）
+    ChartOnset* onsets;         ///< フレーム順
+    int count;
+} ChartDraft;
+
+bool chartDraftBuild(ChartDraft* d, const float* music, int64_t frames, int channels, int freq);
+bool chartDraftWriteSmf(const ChartDraft* d, const char* path, int subdivision);
+void chartDraftFree(ChartDraft* d);
@@ -0,0 +1,482 @@
+/**
+* @file dspChain.c
+* @brief 音楽バスのエフェクトチェーンの実装
+*
+* 組み込みの段はダッキング → ローパス → リバーブ → 音量の順。
+* 音量系はブロック内の変化を指数/直線の閉じた式で求めるので、4要素（2フレーム）ずつSIMD化できる。
+* バイクアッドはL/Rを1本のベクタに載せ、リバーブは4本の遅延線を1本のベクタで回す
+*/
+#include "dspChain.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DSP_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DSP_SIMD_NEON 1
+#endif
+
+#define DSP_SUBBLOCK        64      // カットオフ・wetを更新する間隔(frames)
+#define DSP_DUCK_ATTACK_MS  2.0f    // ダッキングの立ち上がり（クリック防止）
+#define DSP_REVERB_INPUT    0.3f
+#define DSP_REVERB_DAMP     0.6f    // フィードバック内ローパスの係数（大きいほど高域が残る）
+#define DSP_SILENT          1.0e-5f
+
+static const int reverbLength[DSP_REVERB_LINES] = { 1687, 1931, 2053, 2251 };  // 44.1kHz基準
+
+static inline float param(const DspChain* c, DspParam p) {
+    int bits = SDL_AtomicGet((SDL_atomic_t*)&c->param[p]);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static inline float ms_to_coef(float ms, int freq) {
+    float frames = ms * (float)freq / 1000.0f;
+    return frames > 1.0f ? expf(-1.0f / frames) : 0.0f;
+}
+
+/**
+* @brief g_k = target + d * b^k を掛ける（kはフレーム番号）
+*/
+static void apply_exp_gain(float* buf, int frames, float target, float d, float b) {
+    int k = 0;
+    float b2 = b * b;
+#if defined(DSP_SIMD_SSE)
+    __m128 P = _mm_setr_ps(1.0f, 1.0f, b, b);
+    __m128 T = _mm_set1_ps(target), D = _mm_set1_ps(d), B2 = _mm_set1_ps(b2);
+    for (; k + 2 <= frames; k += 2) {
+        __m128 G = _mm_add_ps(T, _mm_mul_ps(D, P));
+        _mm_storeu_ps(buf + k * 2, _mm_mul_ps(_mm_loadu_ps(buf + k * 2), G));
+        P = _mm_mul_ps(P, B2);
+    }
+    d *= _mm_cvtss_f32(P);
+#elif defined(DSP_SIMD_NEON)
+    const float p0[4] = { 1.0f, 1.0f, b, b };
+    float32x4_t P = vld1q_f32(p0);
+    float32x4_t T = vdupq_n_f32(target);
+    for (; k + 2 <= frames; k += 2) {
+        float32x4_t G = vmlaq_n_f32(T, P, d);
+        vst1q_f32(buf + k * 2, vmulq_f32(vld1q_f32(buf + k * 2), G));
+        P = vmulq_n_f32(P, b2);
+    }
+    d *= vgetq_lane_f32(P, 0);
+#endif
+    for (; k < frames; k++) {
+        float g = target + d;
+        buf[k * 2] *= g;
+        buf[k * 2 + 1] *= g;
+        d *= b;
+    }
+}
+
+/**
+* @brief g_k = g0 + step * k を掛ける
+*/
+static void apply_linear_gain(float* buf, int frames, float g0, float step) {
+    int k = 0;
+#if defined(DSP_SIMD_SSE)
+    __m128 G = _mm_setr_ps(g0, g0, g0 + step, g0 + step);
+    __m128 S = _mm_set1_ps(step * 2.0f);
+    for (; k + 2 <= frames; k += 2) {
+        _mm_storeu_ps(buf + k * 2, _mm_mul_ps(_mm_loadu_ps(buf + k * 2), G));
+        G = _mm_add_ps(G, S);
+    }
+#elif defined(DSP_SIMD_NEON)
+    const float g[4] = { g0, g0, g0 + step, g0 + step };
+    float32x4_t G = vld1q_f32(g);
+    float32x4_t S = vdupq_n_f32(step * 2.0f);
+    for (; k + 2 <= frames; k += 2) {
+        vst1q_f32(buf + k * 2, vmulq_f32(vld1q_f32(buf + k * 2), G));
+        G = vaddq_f32(G, S);
+    }
+#endif
+    for (; k < frames; k++) {
+        float v = g0 + step * (float)k;
+        buf[k * 2] *= v;
+        buf[k * 2 + 1] *= v;
+    }
+}
+
+/**
+* @brief サイドチェインダッキング（トリガ位置で立ち上がり、指数で戻る）
+*/
+static void dsp_duck_process(void* node, float* buf, int frames) {
+    DspGainNode* n = (DspGainNode*)node;
+    const DspChain* c = n->chain;
+    float depth = param(c, DSP_PARAM_DUCK_DEPTH);
+    if (depth <= 0.0f) {
+        n->env = 0.0f;
+        n->attack = false;
+        n->triggerCount = 0;
+        return;
+    }
+    if (depth > 1.0f) depth = 1.0f;
+
+    float rel = ms_to_coef(param(c, DSP_PARAM_DUCK_RELEASE_MS), c->freq);
+    float attackStep = 1000.0f / (DSP_DUCK_ATTACK_MS * (float)c->freq);
+    int ti = 0;
+    int pos = 0;
+    while (pos < frames) {
+        while (ti < n->triggerCount && n->triggers[ti] <= pos) {
+            n->attack = true;
+            ti++;
+        }
+        int next = frames;
+        if (ti < n->triggerCount && n->triggers[ti] < next) next = n->triggers[ti];
+        float* seg = buf + pos * 2;
+
+        if (n->attack) {
+            int left = (int)ceilf((1.0f - n->env) / attackStep);
+            if (left < 1) left = 1;
+            if (pos + left < next) next = pos + left;
+            int len = next - pos;
+            apply_linear_gain(seg, len, 1.0f - depth * n->env, -depth * attackStep);
+            n->env += attackStep * (float)len;
+            if (n->env >= 1.0f) {
+                n->env = 1.0f;
+                n->attack = false;
+            }
+        }
+        else {
+            int len = next - pos;
+            if (n->env > DSP_SILENT) {
+                apply_exp_gain(seg, len, 1.0f, -depth * n->env, rel);
+                n->env *= powf(rel, (float)len);
+            }
+            else {
+                n->env = 0.0f;
+            }
+        }
+        pos = next;
+    }
+    n->triggerCount = 0;
+}
+
+/**
+* @brief 出力音量の平滑化（1次のスムーザ）
+*/
+static void dsp_gain_process(void* node, float* buf, int frames) {
+    DspGainNode* n = (DspGainNode*)node;
+    const DspChain* c = n->chain;
+    float target = param(c, DSP_PARAM_GAIN);
+    float d = n->gain - target;
+
+    if (fabsf(d) < DSP_SILENT) {
+        n->gain = target;
+        if (target != 1.0f) apply_linear_gain(buf, frames, target, 0.0f);
+        return;
+    }
+    float b = ms_to_coef(param(c, DSP_PARAM_SMOOTH_MS), c->freq);
+    apply_exp_gain(buf, frames, target, d, b);
+    n->gain = target + d * powf(b, (float)frames);
+}
+
+static void biquad_lowpass(DspBiquadNode* n, float fc, int freq) {
+    const float q = 0.70710678f;
+    float w0 = 2.0f * 3.14159265f * fc / (float)freq;
+    float cw = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float inv = 1.0f / (1.0f + alpha);
+    n->b0 = (1.0f - cw) * 0.5f * inv;
+    n->b1 = (1.0f - cw) * inv;
+    n->b2 = n->b0;
+    n->a1 = -2.0f * cw * inv;
+    n->a2 = (1.0f - alpha) * inv;
+    n->cutoff = fc;
+}
+
+/**
+* @brief ステレオのローパス（転置直接形II）
+*/
+static void dsp_lowpass_process(void* node, float* buf, int frames) {
+    DspBiquadNode* n = (DspBiquadNode*)node;
+    const DspChain* c = n->chain;
+    float maxFc = (float)c->freq * 0.45f;
+    float target = param(c, DSP_PARAM_CUTOFF);
+    if (target > maxFc) target = maxFc;
+    if (target < 20.0f) target = 20.0f;
+    float a = ms_to_coef(param(c, DSP_PARAM_SMOOTH_MS), c->freq);
+    float aBlock = powf(a, (float)DSP_SUBBLOCK);
+
+    for (int pos = 0; pos < frames; pos += DSP_SUBBLOCK) {
+        int len = frames - pos < DSP_SUBBLOCK ? frames - pos : DSP_SUBBLOCK;
+
+        // カットオフは対数で近づける
+        if (fabsf(n->cutoff - target) > 0.5f) {
+            float lf = logf(target) + (logf(n->cutoff) - logf(target)) * aBlock;
+            biquad_lowpass(n, expf(lf), c->freq);
+        }
+        else if (n->cutoff != target) {
+            biquad_lowpass(n, target, c->freq);
+        }
+
+        float* p = buf + pos * 2;
+#if defined(DSP_SIMD_SSE)
+        __m128 b0 = _mm_set1_ps(n->b0), b1 = _mm_set1_ps(n->b1), b2 = _mm_set1_ps(n->b2);
+        __m128 a1 = _mm_set1_ps(n->a1), a2 = _mm_set1_ps(n->a2);
+        __m128 z1 = _mm_setr_ps(n->z1[0], n->z1[1], 0.0f, 0.0f);
+        __m128 z2 = _mm_setr_ps(n->z2[0], n->z2[1], 0.0f, 0.0f);
+        for (int k = 0; k < len; k++) {
+            __m128 x = _mm_castpd_ps(_mm_load_sd((const double*)(p + k * 2)));
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+            z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+            z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_store_sd((double*)(p + k * 2), _mm_castps_pd(y));
+        }
+        float t1[4], t2[4];
+        _mm_storeu_ps(t1, z1);
+        _mm_storeu_ps(t2, z2);
+        n->z1[0] = t1[0]; n->z1[1] = t1[1];
+        n->z2[0] = t2[0]; n->z2[1] = t2[1];
+#elif defined(DSP_SIMD_NEON)
+        float32x2_t z1 = vld1_f32(n->z1), z2 = vld1_f32(n->z2);
+        for (int k = 0; k < len; k++) {
+            float32x2_t x = vld1_f32(p + k * 2);
+            float32x2_t y = vmla_n_f32(z1, x, n->b0);
+            z1 = vmls_n_f32(vmla_n_f32(z2, x, n->b1), y, n->a1);
+            z2 = vmls_n_f32(vmul_n_f32(x, n->b2), y, n->a2);
+            vst1_f32(p + k * 2, y);
+        }
+        vst1_f32(n->z1, z1);
+        vst1_f32(n->z2, z2);
+#else
+        for (int k = 0; k < len; k++) {
+            for (int ch = 0; ch < 2; ch++) {
+                float x = p[k * 2 + ch];
+                float y = n->b0 * x + n->z1[ch];
+                n->z1[ch] = n->b1 * x - n->a1 * y + n->z2[ch];
+                n->z2[ch] = n->b2 * x - n->a2 * y;
+                p[k * 2 + ch] = y;
+            }
+        }
+#endif
+    }
+}
+
+/**
+* @brief 4本の遅延線をアダマール行列で混ぜるFDNリバーブ
+*/
+static void dsp_reverb_process(void* node, float* buf, int frames) {
+    DspReverbNode* n = (DspReverbNode*)node;
+    const DspChain* c = n->chain;
+    float target = param(c, DSP_PARAM_REVERB_WET);
+    float decay = param(c, DSP_PARAM_REVERB_DECAY);
+    if (decay < 0.0f) decay = 0.0f;
+    if (decay > 0.98f) decay = 0.98f;
+    if (!n->line[0]) return;
+
+    if (target <= 0.0f && n->wet <= DSP_SILENT) {
+        n->wet = 0.0f;
+        if (!n->cleared) {
+            for (int i = 0; i < DSP_REVERB_LINES; i++) {
+                SDL_memset(n->line[i], 0, (size_t)n->length[i] * sizeof(float));
+                n->lp[i] = 0.0f;
+            }
+            n->cleared = true;
+        }
+        return;
+    }
+    n->cleared = false;
+
+    // wetはブロックの中で直線的に目標へ
+    float wetStep = (target - n->wet) / (float)frames;
+    float wet = n->wet;
+    float fb = decay * 0.5f;    // アダマール行列の正規化(1/2)込み
+
+#if defined(DSP_SIMD_SSE)
+    __m128 lp = _mm_loadu_ps(n->lp);
+    const __m128 damp = _mm_set1_ps(DSP_REVERB_DAMP);
+    const __m128 sign1 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+    const __m128 sign2 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+    const __m128 vfb = _mm_set1_ps(fb);
+#elif defined(DSP_SIMD_NEON)
+    float32x4_t lp = vld1q_f32(n->lp);
+    const float sgn[2] = { 1.0f, -1.0f };
+    const float32x2_t sign = vld1_f32(sgn);
+#endif
+
+    for (int k = 0; k < frames; k++) {
+        float* f = buf + k * 2;
+        float in = (f[0] + f[1]) * 0.5f * DSP_REVERB_INPUT;
+        float o[DSP_REVERB_LINES];
+        float w[DSP_REVERB_LINES];
+#if defined(DSP_SIMD_SSE)
+        __m128 d = _mm_setr_ps(n->line[0][n->pos[0]], n->line[1][n->pos[1]],
+            n->line[2][n->pos[2]], n->line[3][n->pos[3]]);
+        lp = _mm_add_ps(lp, _mm_mul_ps(_mm_sub_ps(d, lp), damp));
+        __m128 p = _mm_shuffle_ps(lp, lp, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 q = _mm_shuffle_ps(lp, lp, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 s = _mm_add_ps(p, _mm_mul_ps(q, sign1));
+        p = _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 1, 0));
+        q = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 2, 3, 2));
+        __m128 h = _mm_add_ps(p, _mm_mul_ps(q, sign2));
+        _mm_storeu_ps(w, _mm_add_ps(_mm_mul_ps(h, vfb), _mm_set1_ps(in)));
+        _mm_storeu_ps(o, lp);
+#elif defined(DSP_SIMD_NEON)
+        const float dv[4] = { n->line[0][n->pos[0]], n->line[1][n->pos[1]],
+            n->line[2][n->pos[2]], n->line[3][n->pos[3]] };
+        float32x4_t d = vld1q_f32(dv);
+        lp = vmlaq_n_f32(lp, vsubq_f32(d, lp), DSP_REVERB_DAMP);
+        float32x2_t lo = vget_low_f32(lp), hi = vget_high_f32(lp);
+        float32x2_t sums = vpadd_f32(lo, hi);                               // s0, s2
+        float32x2_t diffs = vpadd_f32(vmul_f32(lo, sign), vmul_f32(hi, sign)); // s1, s3
+        float32x2_t h01 = vpadd_f32(sums, diffs);
+        float32x2_t h23 = vpadd_f32(vmul_f32(sums, sign), vmul_f32(diffs, sign));
+        float32x4_t h = vcombine_f32(h01, h23);
+        vst1q_f32(w, vmlaq_n_f32(vdupq_n_f32(in), h, fb));
+        vst1q_f32(o, lp);
+#else
+        for (int i = 0; i < DSP_REVERB_LINES; i++) {
+            float d = n->line[i][n->pos[i]];
+            n->lp[i] += (d - n->lp[i]) * DSP_REVERB_DAMP;
+            o[i] = n->lp[i];
+        }
+        float s0 = o[0] + o[1], s1 = o[0] - o[1], s2 = o[2] + o[3], s3 = o[2] - o[3];
+        w[0] = (s0 + s2) * fb + in;
+        w[1] = (s1 + s3) * fb + in;
+        w[2] = (s0 - s2) * fb + in;
+        w[3] = (s1 - s3) * fb + in;
+#endif
+        for (int i = 0; i < DSP_REVERB_LINES; i++) {
+            n->line[i][n->pos[i]] = w[i];
+            if (++n->pos[i] >= n->length[i]) n->pos[i] = 0;
+        }
+        f[0] += (o[0] + o[2]) * 0.5f * wet;
+        f[1] += (o[1] + o[3]) * 0.5f * wet;
+        wet += wetStep;
+    }
+    n->wet = target;
+
+#if defined(DSP_SIMD_SSE)
+    _mm_storeu_ps(n->lp, lp);
+#elif defined(DSP_SIMD_NEON)
+    vst1q_f32(n->lp, lp);
+#endif
+}
+
+/**
+* @brief チェーンを初期化し、組み込みの段を登録する
+*
+* @param freq サンプリング周波数
+* @return リバーブの遅延線を確保できたらtrue
+*/
+bool dspChainInit(DspChain* c, int freq) {
+    SDL_zerop(c);
+    c->freq = freq > 0 ? freq : 44100;
+
+    dspChainSetParam(c, DSP_PARAM_GAIN, 1.0f);
+    dspChainSetParam(c, DSP_PARAM_CUTOFF, 20000.0f);
+    dspChainSetParam(c, DSP_PARAM_SMOOTH_MS, 120.0f);
+    dspChainSetParam(c, DSP_PARAM_DUCK_DEPTH, 0.0f);
+    dspChainSetParam(c, DSP_PARAM_DUCK_RELEASE_MS, 150.0f);
+    dspChainSetParam(c, DSP_PARAM_REVERB_WET, 0.0f);
+    dspChainSetParam(c, DSP_PARAM_REVERB_DECAY, 0.7f);
+
+    c->duck.chain = c;
+    c->master.chain = c;
+    c->master.gain = 1.0f;
+    c->lowpass.chain = c;
+    biquad_lowpass(&c->lowpass, (float)c->freq * 0.45f, c->freq);
+    c->reverb.chain = c;
+    c->reverb.cleared = true;
+
+    bool ok = true;
+    for (int i = 0; i < DSP_REVERB_LINES; i++) {
+        int len = (int)((int64_t)reverbLength[i] * c->freq / 44100);
+        if (len < 1) len = 1;
+        c->reverb.length[i] = len;
+        c->reverb.line[i] = (float*)SDL_calloc((size_t)len, sizeof(float));
+        if (!c->reverb.line[i]) ok = false;
+    }
+    if (!ok) {
+        SDL_Log("[dspChain] cannot allocate reverb lines");
+        for (int i = 0; i < DSP_REVERB_LINES; i++) {
+            SDL_free(c->reverb.line[i]);
+            c->reverb.line[i] = NULL;
+        }
+    }
+
+    dspChainAddStage(c, dsp_duck_process, &c->duck);
+    dspChainAddStage(c, dsp_lowpass_process, &c->lowpass);
+    dspChainAddStage(c, dsp_reverb_process, &c->reverb);
+    dspChainAddStage(c, dsp_gain_process, &c->master);
+    return ok;
+}
+
+void dspChainFree(DspChain* c) {
+    for (int i = 0; i < DSP_REVERB_LINES; i++) {
+        SDL_free(c->reverb.line[i]);
+        c->reverb.line[i] = NULL;
+    }
+    c->stageCount = 0;
+}
+
+/**
+* @brief 段を末尾に追加する（オーディオ停止中に呼ぶこと）
+*
+* @return 追加できたらtrue
+*/
+bool dspChainAddStage(DspChain* c, DspProcess process, void* node) {
+    if (!process || c->stageCount >= DSP_STAGE_MAX) return false;
+    DspStage* s = &c->stage[c->stageCount++];
+    s->process = process;
+    s->node = node;
+    SDL_AtomicSet(&s->bypass, 0);
+    return true;
+}
+
+/**
+* @brief 段の有効/無効を切り替える（どのスレッドからでも可）
+*/
+void dspChainSetBypass(DspChain* c, int stage, bool bypass) {
+    if (stage < 0 || stage >= c->stageCount) return;
+    SDL_AtomicSet(&c->stage[stage].bypass, bypass ? 1 : 0);
+}
+
+/**
+* @brief パラメータを設定する（どのスレッドからでも可、次のブロックから反映）
+*/
+void dspChainSetParam(DspChain* c, DspParam p, float value) {
+    if (p < 0 || p >= DSP_PARAM_MAX) return;
+    int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    SDL_AtomicSet(&c->param[p], bits);
+}
+
+float dspChainGetParam(const DspChain* c, DspParam p) {
+    if (p < 0 || p >= DSP_PARAM_MAX) return 0.0f;
+    return param(c, p);
+}
+
+/**
+* @brief サイドチェインのトリガを予約する（オーディオスレッドから、次のdspChainProcessのフレーム位置）
+*/
+void dspChainTriggerSidechain(DspChain* c, int frame) {
+    DspGainNode* n = &c->duck;
+    if (n->triggerCount < DSP_TRIGGER_MAX) n->triggers[n->triggerCount++] = frame;
+}
+
+/**
+* @brief チェーン全体を処理する（オーディオスレッドから）
+*
+* @param stereo インターリーブのステレオ
+*/
+void dspChainProcess(DspChain* c, float* stereo, int frames) {
+    if (frames <= 0) return;
+    for (int i = 0; i < c->stageCount; i++) {
+        DspStage* s = &c->stage[i];
+        if (SDL_AtomicGet(&s->bypass)) continue;
+        s->process(s->node, stereo, frames);
+    }
+    c->duck.triggerCount = 0;
+}
+
+/**
+* @brief 音量スムーザの現在値（オーディオスレッドから）
+*/
+float dspChainCurrentGain(const DspChain* c) {
+    return c->master.gain;
+}
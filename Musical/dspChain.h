@@ -0,0 +1,99 @@
+/**
+* @file dspChain.h
+* @brief 音楽バスのエフェクトチェーンヘッダ
+*
+* ミックス後のステレオバッファにブロック単位でエフェクトを掛ける。
+* パラメータはメインスレッドからアトミックに書き込み、オーディオスレッドは
+* ブロックの先頭で読むだけなのでロックは要らない
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DSP_STAGE_MAX       8       ///< チェーンに登録できる段数
+#define DSP_TRIGGER_MAX     32      ///< 1ブロックで予約できるサイドチェイン入力
+#define DSP_REVERB_LINES    4       ///< リバーブの遅延線の本数（SIMDの幅）
+
+/**
+* @brief パラメータの種類
+*/
+typedef enum {
+    DSP_PARAM_GAIN,             ///< 出力の音量（0～1、DSP_PARAM_SMOOTH_MSで滑らかに変化）
+    DSP_PARAM_CUTOFF,           ///< ローパスのカットオフ(Hz)
+    DSP_PARAM_SMOOTH_MS,        ///< 音量・カットオフの時定数(ms)
+    DSP_PARAM_DUCK_DEPTH,       ///< サイドチェインで下げる量（0～1）
+    DSP_PARAM_DUCK_RELEASE_MS,  ///< サイドチェインの戻り時定数(ms)
+    DSP_PARAM_REVERB_WET,       ///< リバーブの混ぜる量（0で停止）
+    DSP_PARAM_REVERB_DECAY,     ///< リバーブのフィードバック（0～0.98）
+    DSP_PARAM_MAX
+} DspParam;
+
+/**
+* @brief 1段分の処理（stereoはインターリーブのLR）
+*/
+typedef void (*DspProcess)(void* node, float* stereo, int frames);
+
+typedef struct {
+    DspProcess process;
+    void* node;
+    SDL_atomic_t bypass;        ///< 1なら処理しない
+} DspStage;
+
+/**
+* @brief 音量の平滑化とサイドチェインダッキング
+*/
+typedef struct {
+    const struct DspChain* chain;
+    float gain;                 ///< 現在の音量
+    float env;                  ///< ダッキングのエンベロープ（1で最大）
+    bool attack;                ///< エンベロープが1へ向かって上昇中か
+    int triggers[DSP_TRIGGER_MAX];
+    int triggerCount;
+} DspGainNode;
+
+/**
+* @brief ステレオのバイクアッド（ローパス）
+*/
+typedef struct {
+    const struct DspChain* chain;
+    float cutoff;               ///< 現在のカットオフ(Hz)
+    float b0, b1, b2, a1, a2;
+    float z1[2], z2[2];         ///< 転置直接形IIの状態（L, R）
+} DspBiquadNode;
+
+/**
+* @brief フィードバックディレイネットワークのリバーブ
+*/
+typedef struct {
+    const struct DspChain* chain;
+    float* line[DSP_REVERB_LINES];
+    int length[DSP_REVERB_LINES];
+    int pos[DSP_REVERB_LINES];  ///< 読み書き位置
+    float lp[DSP_REVERB_LINES]; ///< フィードバック内のローパスの状態
+    float wet;                  ///< 現在のwet
+    bool cleared;               ///< 停止中に遅延線を消去済みか
+} DspReverbNode;
+
+typedef struct DspChain {
+    int freq;
+    SDL_atomic_t param[DSP_PARAM_MAX];  ///< floatのビット列
+    DspStage stage[DSP_STAGE_MAX];
+    int stageCount;
+
+    DspGainNode duck;
+    DspBiquadNode lowpass;
+    DspReverbNode reverb;
+    DspGainNode master;
+} DspChain;
+
+bool dspChainInit(DspChain* c, int freq);
+void dspChainFree(DspChain* c);
+bool dspChainAddStage(DspChain* c, DspProcess process, void* node);
+void dspChainSetBypass(DspChain* c, int stage, bool bypass);
+void dspChainSetParam(DspChain* c, DspParam p, float value);
+float dspChainGetParam(const DspChain* c, DspParam p);
+void dspChainTriggerSidechain(DspChain* c, int frame);
+void dspChainProcess(DspChain* c, float* stereo, int frames);
+float dspChainCurrentGain(const DspChain* c);
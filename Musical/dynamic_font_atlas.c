@@ -1,4 +1,5 @@
 #include "dynamic_font_atlas.h"
+#include "threadPolicy.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -312,6 +313,9 @@ typedef struct DFA_FontWorker {
 static int dfa_worker_main(void* ud) {
     DFA_FontWorker* w = (DFA_FontWorker*)ud;
 
+    /* 音声・描画のコアを避ける */
+    threadPolicyApply(THREAD_ROLE_WORKER);
+
     /* フォントをこのスレッドで生成 */
     w->font = TTF_OpenFont(w->font_path, w->ptsize);
     if (w->font) {
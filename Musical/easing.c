@@ -1,9 +1,24 @@
 ﻿/*
 * @file easinfg.c
 * @brief 値の変化関数を実装
+*
+* easingBatchは同じ曲線の値をまとめて求める。どの曲線もIn側の関数fから
+* Out(n) = 1 - f(1 - n)、InOut(n) = n < 0.5 ? f(2n) / 2 : 1 - f(2 - 2n) / 2 で作れるので、
+* べき乗・Back・Circ・Bounce（区分2次式）は閉じた式、Sine・Expo・Elasticは焼いておいた表の線形補間で
+* fを4つずつSIMDで計算する
 */
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <stdbool.h>
+#include "easing.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EASING_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EASING_SIMD_NEON 1
+#endif
 
 float cramp(float n) {
     if (n < 0) {
@@ -187,7 +202,7 @@ float easeInOutCirc(float n) {
     n = cramp(n);
     n = n * 2;
     if (n < 1) {
-        return -0.5f * (sqrtf(1 - powf(n, 2) - 1));
+        return -0.5f * (sqrtf(1 - powf(n, 2)) - 1);
     }
     else {
         n = n - 2;
@@ -306,3 +321,285 @@ float easeInOutBounce(float n) {
         return easeOutBounce(n * 2 - 1) * 0.5f + 0.5f;
     }
 }
+
+
+/**
+* @brief In側の曲線の種類
+*/
+typedef enum {
+    CURVE_LINEAR,
+    CURVE_QUAD,
+    CURVE_CUBIC,
+    CURVE_QUART,
+    CURVE_QUINT,
+    CURVE_SINE,
+    CURVE_EXPO,
+    CURVE_CIRC,
+    CURVE_ELASTIC,
+    CURVE_BACK,
+    CURVE_BOUNCE
+} EasingCurve;
+
+enum { MODE_IN, MODE_OUT, MODE_IN_OUT };
+
+#define BACK_S       1.70158f
+#define BACK_S_INOUT (1.70158f * 1.525f)
+
+static float (*const functions[EASING_COUNT])(float n) = {
+    linear,
+    easeInQuad, easeOutQuad, easeInOutQuad,
+    easeInCubic, easeOutCubic, easeInOutCubic,
+    easeInQuart, easeOutQuart, easeInOutQuart,
+    easeInQuint, easeOutQuint, easeInOutQuint,
+    easeInSine, easeOutSine, easeInOutSine,
+    easeInExpo, easeOutExpo, easeInOutExpo,
+    easeInCirc, easeOutCirc, easeInOutCirc,
+    easeInElastic, easeOutElastic, easeInOutElastic,
+    easeInBack, easeOutBack, easeInOutBack,
+    easeInBounce, easeOutBounce, easeInOutBounce,
+};
+
+// Sine/Expo/ElasticのIn側の値（端を含めてEASING_LUT_SIZE + 1点）
+// ExpoはeaseInExpoの0での飛び（0と2^-10）を補間すると端で1e-3近くずれるので、表は飛ばない式で焼き、0だけ別に0を返す
+static float lut[3][EASING_LUT_SIZE + 1];
+static bool lutBaked;
+
+/**
+* @brief 関数から番号を引く
+*
+* @return 番号（組み込みでなければEASING_COUNT）
+*/
+EasingId easingIdOf(float (*easing)(float n)) {
+    for (int i = 0; i < EASING_COUNT; i++) {
+        if (functions[i] == easing) return (EasingId)i;
+    }
+    return EASING_COUNT;
+}
+
+/**
+* @brief 番号から関数を引く（範囲外ならlinear）
+*/
+float (*easingFunction(EasingId id))(float n) {
+    return (unsigned)id < EASING_COUNT ? functions[id] : linear;
+}
+
+/**
+* @brief 番号を曲線の種類と向きに分ける
+*/
+static void decode(EasingId id, int* curve, int* mode) {
+    if ((unsigned)id >= EASING_COUNT || id == EASING_LINEAR) {
+        *curve = CURVE_LINEAR;
+        *mode = MODE_IN;
+        return;
+    }
+    *curve = CURVE_QUAD + (id - 1) / 3;
+    *mode = (id - 1) % 3;
+}
+
+/**
+* @brief 表で近似する曲線の表（それ以外はNULL）
+*/
+static const float* curve_lut(int curve) {
+    int t;
+    switch (curve) {
+    case CURVE_SINE: t = 0; break;
+    case CURVE_EXPO: t = 1; break;
+    case CURVE_ELASTIC: t = 2; break;
+    default: return NULL;
+    }
+    if (!lutBaked) {
+        for (int i = 0; i <= EASING_LUT_SIZE; i++) {
+            float x = (float)i / EASING_LUT_SIZE;
+            lut[0][i] = easeInSine(x);
+            lut[1][i] = powf(2, 10 * (x - 1));
+            lut[2][i] = easeInElastic(x);
+        }
+        lutBaked = true;
+    }
+    return lut[t];
+}
+
+static float lut_lookup(const float* table, float x) {
+    float pos = x * EASING_LUT_SIZE;
+    int i = (int)pos;
+    if (i > EASING_LUT_SIZE - 1) i = EASING_LUT_SIZE - 1;
+    float f = pos - (float)i;
+    // a(1 - f) + bfの形なら、端（f = 0, 1）で表の値がそのまま出る
+    return table[i] * (1.0f - f) + table[i + 1] * f;
+}
+
+/**
+* @brief In側の曲線f(x)（xは0〜1）
+*/
+static float curve_in(int curve, float x, float back, const float* table) {
+    float x2 = x * x;
+    switch (curve) {
+    case CURVE_QUAD: return x2;
+    case CURVE_CUBIC: return x2 * x;
+    case CURVE_QUART: return x2 * x2;
+    case CURVE_QUINT: return x2 * x2 * x;
+    case CURVE_CIRC: return 1.0f - sqrtf(fmaxf(1.0f - x2, 0.0f));
+    case CURVE_BACK: return x2 * ((back + 1.0f) * x - back);
+    case CURVE_BOUNCE: return 1.0f - easeOutBounce(1.0f - x);
+    case CURVE_SINE:
+    case CURVE_ELASTIC: return lut_lookup(table, x);
+    case CURVE_EXPO: return x > 0.0f ? lut_lookup(table, x) : 0.0f;
+    default: return x;
+    }
+}
+
+/**
+* @brief 組み込みの曲線の値（easingBatchと同じ計算）
+*
+* @param id 曲線の番号
+* @param n 割合（0〜1に丸める）
+*/
+float easingEval(EasingId id, float n) {
+    int curve, mode;
+    decode(id, &curve, &mode);
+    n = n > 0.0f ? (n < 1.0f ? n : 1.0f) : 0.0f;
+    float back = mode == MODE_IN_OUT ? BACK_S_INOUT : BACK_S;
+    const float* table = curve_lut(curve);
+
+    if (mode == MODE_IN) return curve_in(curve, n, back, table);
+    if (mode == MODE_OUT) return 1.0f - curve_in(curve, 1.0f - n, back, table);
+    if (n < 0.5f) return 0.5f * curve_in(curve, 2.0f * n, back, table);
+    return 1.0f - 0.5f * curve_in(curve, 2.0f - 2.0f * n, back, table);
+}
+
+#if defined(EASING_SIMD_SSE)
+typedef __m128 V4;
+typedef __m128 M4;
+static inline V4 v_set1(float a) { return _mm_set1_ps(a); }
+static inline V4 v_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void v_store(float* p, V4 a) { _mm_storeu_ps(p, a); }
+static inline V4 v_add(V4 a, V4 b) { return _mm_add_ps(a, b); }
+static inline V4 v_sub(V4 a, V4 b) { return _mm_sub_ps(a, b); }
+static inline V4 v_mul(V4 a, V4 b) { return _mm_mul_ps(a, b); }
+static inline V4 v_min(V4 a, V4 b) { return _mm_min_ps(a, b); }
+static inline V4 v_max(V4 a, V4 b) { return _mm_max_ps(a, b); }
+static inline V4 v_sqrt(V4 a) { return _mm_sqrt_ps(a); }
+static inline M4 v_lt(V4 a, V4 b) { return _mm_cmplt_ps(a, b); }
+static inline V4 v_select(M4 m, V4 a, V4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline void v_index(V4 a, int* out) { _mm_storeu_si128((__m128i*)out, _mm_cvttps_epi32(a)); }
+#define EASING_SIMD 1
+#elif defined(EASING_SIMD_NEON)
+typedef float32x4_t V4;
+typedef uint32x4_t M4;
+static inline V4 v_set1(float a) { return vdupq_n_f32(a); }
+static inline V4 v_load(const float* p) { return vld1q_f32(p); }
+static inline void v_store(float* p, V4 a) { vst1q_f32(p, a); }
+static inline V4 v_add(V4 a, V4 b) { return vaddq_f32(a, b); }
+static inline V4 v_sub(V4 a, V4 b) { return vsubq_f32(a, b); }
+static inline V4 v_mul(V4 a, V4 b) { return vmulq_f32(a, b); }
+static inline V4 v_min(V4 a, V4 b) { return vminq_f32(a, b); }
+static inline V4 v_max(V4 a, V4 b) { return vmaxq_f32(a, b); }
+static inline V4 v_sqrt(V4 a) {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return vsqrtq_f32(a);
+#else
+    // ARMv7には平方根命令が無いので逆数平方根の推定値をニュートン法で2回詰める
+    a = vmaxq_f32(a, vdupq_n_f32(1.0e-30f));
+    float32x4_t r = vrsqrteq_f32(a);
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+    return vmulq_f32(a, r);
+#endif
+}
+static inline M4 v_lt(V4 a, V4 b) { return vcltq_f32(a, b); }
+static inline V4 v_select(M4 m, V4 a, V4 b) { return vbslq_f32(m, a, b); }
+static inline void v_index(V4 a, int* out) { vst1q_s32(out, vcvtq_s32_f32(a)); }
+#define EASING_SIMD 1
+#endif
+
+#if defined(EASING_SIMD)
+/**
+* @brief 4つ分のIn側の曲線
+*/
+static inline V4 curve_in4(int curve, V4 x, float back, const float* table) {
+    V4 one = v_set1(1.0f);
+    V4 x2 = v_mul(x, x);
+    switch (curve) {
+    case CURVE_QUAD: return x2;
+    case CURVE_CUBIC: return v_mul(x2, x);
+    case CURVE_QUART: return v_mul(x2, x2);
+    case CURVE_QUINT: return v_mul(v_mul(x2, x2), x);
+    case CURVE_CIRC: return v_sub(one, v_sqrt(v_max(v_sub(one, x2), v_set1(0.0f))));
+    case CURVE_BACK: return v_mul(x2, v_sub(v_mul(v_set1(back + 1.0f), x), v_set1(back)));
+    case CURVE_BOUNCE: {
+        // 4つの放物線を全部求めて、区間で選ぶ
+        V4 u = v_sub(one, x);
+        V4 k = v_set1(7.5625f);
+        V4 d1 = v_sub(u, v_set1(1.5f / 2.75f));
+        V4 d2 = v_sub(u, v_set1(2.25f / 2.75f));
+        V4 d3 = v_sub(u, v_set1(2.65f / 2.75f));
+        V4 y = v_add(v_mul(k, v_mul(d3, d3)), v_set1(0.984375f));
+        y = v_select(v_lt(u, v_set1(2.5f / 2.75f)), v_add(v_mul(k, v_mul(d2, d2)), v_set1(0.9375f)), y);
+        y = v_select(v_lt(u, v_set1(2.0f / 2.75f)), v_add(v_mul(k, v_mul(d1, d1)), v_set1(0.75f)), y);
+        y = v_select(v_lt(u, v_set1(1.0f / 2.75f)), v_mul(k, v_mul(u, u)), y);
+        return v_sub(one, y);
+    }
+    case CURVE_SINE:
+    case CURVE_EXPO:
+    case CURVE_ELASTIC: {
+        // 位置の計算はSIMD、表を引くところだけ1つずつ
+        V4 pos = v_mul(x, v_set1((float)EASING_LUT_SIZE));
+        int idx[4];
+        float a[4], b[4], fi[4];
+        v_index(pos, idx);
+        for (int j = 0; j < 4; j++) {
+            int i = idx[j] > EASING_LUT_SIZE - 1 ? EASING_LUT_SIZE - 1 : idx[j];
+            a[j] = table[i];
+            b[j] = table[i + 1];
+            fi[j] = (float)i;
+        }
+        V4 f = v_sub(pos, v_load(fi));
+        V4 y = v_add(v_mul(v_load(a), v_sub(one, f)), v_mul(v_load(b), f));
+        if (curve == CURVE_EXPO) y = v_select(v_lt(v_set1(0.0f), x), y, v_set1(0.0f));
+        return y;
+    }
+    default: return x;
+    }
+}
+#endif
+
+/**
+* @brief 同じ曲線の値をまとめて求める
+*
+* @param id 曲線の番号（範囲外ならlinear）
+* @param n 割合の配列（0〜1に丸める）
+* @param out 結果（nと同じでもよい）
+* @param count 個数
+*/
+void easingBatch(EasingId id, const float* n, float* out, int count) {
+    int curve, mode;
+    decode(id, &curve, &mode);
+    float back = mode == MODE_IN_OUT ? BACK_S_INOUT : BACK_S;
+    const float* table = curve_lut(curve);
+    int k = 0;
+
+#if defined(EASING_SIMD)
+    V4 zero = v_set1(0.0f), one = v_set1(1.0f), half = v_set1(0.5f), two = v_set1(2.0f);
+    for (; k + 4 <= count; k += 4) {
+        // 丸めはmax→minの順（NaNは0になる）
+        V4 t = v_min(v_max(v_load(n + k), zero), one);
+        V4 y;
+        if (mode == MODE_IN) {
+            y = curve_in4(curve, t, back, table);
+        }
+        else if (mode == MODE_OUT) {
+            y = v_sub(one, curve_in4(curve, v_sub(one, t), back, table));
+        }
+        else {
+            M4 lo = v_lt(t, half);
+            V4 x = v_select(lo, v_mul(two, t), v_sub(two, v_mul(two, t)));
+            V4 f = v_mul(half, curve_in4(curve, x, back, table));
+            y = v_select(lo, f, v_sub(one, f));
+        }
+        v_store(out + k, y);
+    }
+#endif
+    for (; k < count; k++) {
+        out[k] = easingEval(id, n[k]);
+    }
+}
@@ -7,6 +7,26 @@
 
 #pragma once
 
+/**
+* @brief 組み込みのeasing関数の番号（easingBatchでまとめて計算するときに使う）
+*/
+typedef enum {
+    EASING_LINEAR,
+    EASING_IN_QUAD, EASING_OUT_QUAD, EASING_IN_OUT_QUAD,
+    EASING_IN_CUBIC, EASING_OUT_CUBIC, EASING_IN_OUT_CUBIC,
+    EASING_IN_QUART, EASING_OUT_QUART, EASING_IN_OUT_QUART,
+    EASING_IN_QUINT, EASING_OUT_QUINT, EASING_IN_OUT_QUINT,
+    EASING_IN_SINE, EASING_OUT_SINE, EASING_IN_OUT_SINE,
+    EASING_IN_EXPO, EASING_OUT_EXPO, EASING_IN_OUT_EXPO,
+    EASING_IN_CIRC, EASING_OUT_CIRC, EASING_IN_OUT_CIRC,
+    EASING_IN_ELASTIC, EASING_OUT_ELASTIC, EASING_IN_OUT_ELASTIC,
+    EASING_IN_BACK, EASING_OUT_BACK, EASING_IN_OUT_BACK,
+    EASING_IN_BOUNCE, EASING_OUT_BOUNCE, EASING_IN_OUT_BOUNCE,
+    EASING_COUNT                    ///< 組み込みではない関数
+} EasingId;
+
+#define EASING_LUT_SIZE 4096        ///< 表で近似する曲線（Sine/Expo/Elastic）の分割数
+
 float linear(float n);
 float easeInQuad(float n);
 float easeOutQuad(float n);
@@ -37,4 +57,9 @@ float easeOutBack(float n);
 float easeInOutBack(float n);
 float easeOutBounce(float n);
 float easeInBounce(float n);
-float easeInOutBounce(float n);
\ No newline at end of file
+float easeInOutBounce(float n);
+
+EasingId easingIdOf(float (*easing)(float n));
+float (*easingFunction(EasingId id))(float n);
+float easingEval(EasingId id, float n);
+void easingBatch(EasingId id, const float* n, float* out, int count);
@@ -1,24 +1,24 @@
 #include "enemy.h"
 #include "sprite.h"
 #include "animation.h"
+#include "timeline.h"
 #include "easing.h"
 #include "image.h"
+#include "renderQueue.h"
 #include "particle.h"
 #include "musicEvent.h"
 
 static Sprite enemy;
 static Sprite particle;
 static ParticleSetting crash;
+static Timeline* pop;        ///< LbNŖcމo
 
 static void kick(AppState* st, uint8_t track, uint8_t note, uint8_t vel, bool on) {
     if (!on)return;
     printf("[MIDI] track=%u note=%u vel=%u on=%d\n", track, note, vel, on);
     //printf("[MIDI] scale=%f alpha=%d x=%f y=%f\n", 
     //    enemy.scale, enemy.color.a, enemy.position.x, enemy.position.y);
-    enemy.scale = 1.5f;
-    scaleTo(&enemy, 2.0f);
-    setEasing(easeOutElastic);
-    setDuration(350);
+    timelinePlay(pop, (Sprite*[]) { &enemy }, 1);
     int range = 100;
     float x = -range / 2.0f + (float)(rand() % range) + 640 / 2.0f;
     float y = -range / 2.0f + (float)(rand() % range) + 480 / 2.0f;
@@ -30,18 +30,32 @@ static void kick(AppState* st, uint8_t track, uint8_t note, uint8_t vel, bool on
 }
 
 void enemyInit(int x, int y) {
-    //enemy̏
-    spriteInit(&enemy, loadImage("img/girl.png"), 0, 0, 32, 32);
-    spriteAnimeInit(&enemy, 4, 6, -1);
+    //enemy̏iAgXgirl.png1œǂނ̂ŁA32x324R}ɂj
+    spriteInitNamed(&enemy, "img/girl");
+    int frames = getImageFrameCount(enemy.image);
+    if (frames <= 1) {
+        frames = 4;
+        spriteInit(&enemy, enemy.image, 0, 0, 32, 32);
+    }
+    // 11ɂiR}̒̔.asepritê܂܁j
+    spriteAnimeInitTimed(&enemy, frames, 1.0 / frames, -1, TIMEBASE_BEATS);
     enemy.scale = 2;
     enemy.position.x = x;
     enemy.position.y = y;
 
+    if (!pop) {
+        timelineBegin();
+        timelineSet(TIMELINE_SCALE, 1.5f);
+        timelineTo(TIMELINE_SCALE, 2.0f, 350, easeOutElastic);
+        pop = timelineBake(TIMEBASE_MUSIC);
+    }
+
     musicEventRegisterMidiTrackHandler(1, kick);
     musicEventSetMidiTrackEnabled(1, true);
 
 
     spriteInit(&particle, loadImage("img/heart.png"), 0, 0, 32, 32);
+    particle.layer = RENDER_LAYER_BACK_EFFECT;
     crash = particleSettingDefault(&particle);
     crash.count = 8;
     crash.radius = 30;
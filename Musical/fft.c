@@ -0,0 +1,172 @@
+/**
+* @file fft.c
+* @brief FFTの実装
+*
+* 基数2の時間間引き。バタフライは4本ずつSSE/NEONでまとめて計算する
+*/
+#define _USE_MATH_DEFINES
+#include "fft.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FFT_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FFT_SIMD_NEON 1
+#endif
+
+/**
+* @brief FFTプランの作成
+*
+* @param p プラン
+* @param n サイズ（2の累乗、2以上）
+* @return 作成できたらtrue
+*/
+bool fftPlanInit(FFTPlan* p, int n) {
+    SDL_zerop(p);
+    if (n < 2 || (n & (n - 1)) != 0) return false;
+
+    int log2n = 0;
+    while ((1 << log2n) < n) log2n++;
+
+    p->bitrev = (int*)SDL_malloc((size_t)n * sizeof(int));
+    p->twRe = (float*)SDL_malloc((size_t)n * sizeof(float));
+    p->twIm = (float*)SDL_malloc((size_t)n * sizeof(float));
+    if (!p->bitrev || !p->twRe || !p->twIm) {
+        fftPlanFree(p);
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < log2n; b++) {
+            if (i & (1 << b)) r |= 1 << (log2n - 1 - b);
+        }
+        p->bitrev[i] = r;
+    }
+
+    // 半サイズmの段の回転因子 exp(-i*pi*k/m) をm-1から並べる
+    for (int m = 1; m < n; m <<= 1) {
+        for (int k = 0; k < m; k++) {
+            double a = M_PI * (double)k / (double)m;
+            p->twRe[m - 1 + k] = (float)cos(a);
+            p->twIm[m - 1 + k] = (float)-sin(a);
+        }
+    }
+
+    p->n = n;
+    p->log2n = log2n;
+    return true;
+}
+
+/**
+* @brief FFTプランの破棄
+*/
+void fftPlanFree(FFTPlan* p) {
+    if (!p) return;
+    SDL_free(p->bitrev);
+    SDL_free(p->twRe);
+    SDL_free(p->twIm);
+    SDL_zerop(p);
+}
+
+/**
+* @brief 順方向FFT（その場で変換、正規化なし）
+*
+* @param p プラン
+* @param re 実部（n要素）
+* @param im 虚部（n要素）
+*/
+void fftForward(const FFTPlan* p, float* re, float* im) {
+    int n = p->n;
+
+    for (int i = 0; i < n; i++) {
+        int j = p->bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (int m = 1; m < n; m <<= 1) {
+        const float* wr = p->twRe + (m - 1);
+        const float* wi = p->twIm + (m - 1);
+
+        for (int base = 0; base < n; base += 2 * m) {
+            float* ar = re + base;
+            float* ai = im + base;
+            float* br = ar + m;
+            float* bi = ai + m;
+            int k = 0;
+#if FFT_SIMD_SSE
+            for (; k + 4 <= m; k += 4) {
+                __m128 c = _mm_loadu_ps(wr + k);
+                __m128 s = _mm_loadu_ps(wi + k);
+                __m128 xr = _mm_loadu_ps(br + k);
+                __m128 xi = _mm_loadu_ps(bi + k);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, c), _mm_mul_ps(xi, s));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, s), _mm_mul_ps(xi, c));
+                __m128 yr = _mm_loadu_ps(ar + k);
+                __m128 yi = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+                _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+            }
+#elif FFT_SIMD_NEON
+            for (; k + 4 <= m; k += 4) {
+                float32x4_t c = vld1q_f32(wr + k);
+                float32x4_t s = vld1q_f32(wi + k);
+                float32x4_t xr = vld1q_f32(br + k);
+                float32x4_t xi = vld1q_f32(bi + k);
+                float32x4_t tr = vmlsq_f32(vmulq_f32(xr, c), xi, s);
+                float32x4_t ti = vmlaq_f32(vmulq_f32(xr, s), xi, c);
+                float32x4_t yr = vld1q_f32(ar + k);
+                float32x4_t yi = vld1q_f32(ai + k);
+                vst1q_f32(ar + k, vaddq_f32(yr, tr));
+                vst1q_f32(ai + k, vaddq_f32(yi, ti));
+                vst1q_f32(br + k, vsubq_f32(yr, tr));
+                vst1q_f32(bi + k, vsubq_f32(yi, ti));
+            }
+#endif
+            for (; k < m; k++) {
+                float tr = br[k] * wr[k] - bi[k] * wi[k];
+                float ti = br[k] * wi[k] + bi[k] * wr[k];
+                float yr = ar[k];
+                float yi = ai[k];
+                ar[k] = yr + tr;
+                ai[k] = yi + ti;
+                br[k] = yr - tr;
+                bi[k] = yi - ti;
+            }
+        }
+    }
+}
+
+/**
+* @brief 逆FFT（その場で変換、1/nで正規化する）
+*
+* 実部と虚部を入れ替えて順方向FFTを通すと共役の変換になることを利用する
+*/
+void fftInverse(const FFTPlan* p, float* re, float* im) {
+    fftForward(p, im, re);
+    float inv = 1.0f / (float)p->n;
+    for (int i = 0; i < p->n; i++) {
+        re[i] *= inv;
+        im[i] *= inv;
+    }
+}
+
+/**
+* @brief Hann窓の係数を作る
+*
+* @param w 係数の格納先（n要素）
+* @param n 窓の長さ
+*/
+void fftHannWindow(float* w, int n) {
+    for (int i = 0; i < n; i++) {
+        w[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (double)n));
+    }
+}
@@ -0,0 +1,28 @@
+/**
+* @file fft.h
+* @brief FFTヘッダ
+*
+* 2の累乗サイズの複素FFT（実部と虚部を別配列で持つ）
+*/
+#pragma once
+
+#include <stdbool.h>
+
+/**
+* @brief FFTの計算用テーブル
+*
+* 1つのプランは読み取り専用なので、複数スレッドから同時に使ってよい
+*/
+typedef struct {
+    int n;          ///< サイズ（2の累乗）
+    int log2n;      ///< log2(n)
+    int* bitrev;    ///< ビット反転の並べ替え表
+    float* twRe;    ///< 回転因子の実部（段ごとに連続、半サイズmの段はm-1から）
+    float* twIm;    ///< 回転因子の虚部
+} FFTPlan;
+
+bool fftPlanInit(FFTPlan* p, int n);
+void fftPlanFree(FFTPlan* p);
+void fftForward(const FFTPlan* p, float* re, float* im);
+void fftInverse(const FFTPlan* p, float* re, float* im);
+void fftHannWindow(float* w, int n);
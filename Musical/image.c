@@ -2,16 +2,60 @@
 * @file image.c
 * @brief 画像関係処理の実装
 */
+#define _USE_MATH_DEFINES
 #include "image.h"
+#include "spriteBatch.h"
+#include "renderQueue.h"
+#include "primitive.h"
+#include "assetLoader.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <math.h>
 
 #define IMAGE_MAX    64
+#define ATLAS_FILE          "atlas/atlas.txt"   ///< tools/atlasPack.cが書き出すフレーム表
+#define ATLAS_PAGE_MAX      16
+#define ATLAS_NAME_MAX      128
+
+/**
+* @brief アトラスのページ内の画像（.asepriteならフレームを横に並べた全体）
+*/
+typedef struct {
+    char name[ATLAS_NAME_MAX];      ///< 拡張子を除いたパス
+    int page;
+    SDL_Rect rect;                  ///< ページ内の位置と大きさ
+    int frames;
+    Uint16 duration[IMAGE_FRAME_MAX];   ///< フレームの長さ(ms)
+} AtlasRegion;
+
+/**
+* @brief 読み込んだ画像のキャッシュの1項目（IDと同じ番号）
+*/
+typedef struct {
+    char path[ATLAS_NAME_MAX];      ///< 読み込んだ名前（キャッシュのキー、空なら使っていない）
+    int refs;                       ///< 参照の数（0になってもテクスチャは残し、同じ名前で読まれたら使い回す）
+    bool pending;                   ///< ワーカーで読み込み中
+    Uint32 tag;                     ///< 読み込みの要求の番号
+    Uint32 released;                ///< 参照が0になった順番（空きが無いときは古いものから入れ替える）
+} ImageEntry;
 
 static SDL_Texture *image[IMAGE_MAX];
+static const AtlasRegion *region[IMAGE_MAX];    ///< アトラスの画像ならページ内の位置（テクスチャはページと共有）
+static ImageEntry entry[IMAGE_MAX];
+static Uint32 loadTag;
+static Uint32 releaseCount;
+static char atlasPageName[ATLAS_PAGE_MAX][ATLAS_NAME_MAX + sizeof "atlas/"];
+static SDL_Texture *atlasPage[ATLAS_PAGE_MAX];
+static bool atlasPagePending[ATLAS_PAGE_MAX];
+static Uint32 atlasPageTag[ATLAS_PAGE_MAX];
+static int atlasPageCount;
+static AtlasRegion *atlasRegion;
+static int atlasRegionCount;
+static bool atlasTried;         ///< フレーム表を読みに行ったかどうか（無ければ個別の画像を読む）
 static SDL_Window *window;
 static SDL_Renderer *renderer;
 
@@ -63,6 +107,9 @@ void screenInit(int width, int height) {
 * windowとrendererを破棄する
 */
 void screenQuit(void) {
+    primitiveQuit();
+    renderQueueQuit();
+    spriteBatchQuit();
     if (renderer) {
         SDL_DestroyRenderer(renderer);
     }
@@ -71,38 +118,361 @@ void screenQuit(void) {
     }
 }
 
+/**
+* @brief 拡張子を除いたパスの長さ
+*/
+static size_t stemLength(const char* path) {
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    if (!dot || (slash && dot < slash)) return strlen(path);
+    return (size_t)(dot - path);
+}
+
+/**
+* @brief アトラスのフレーム表を読む（1回だけ、ページの画像は使うときに読む）
+*/
+static void atlasLoad(void) {
+    atlasTried = true;
+    FILE* fp = fopen(ATLAS_FILE, "r");
+    if (!fp) {
+        return;
+    }
+    char line[1024];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char name[ATLAS_NAME_MAX];
+        AtlasRegion r;
+        int n = 0;
+        if (sscanf(line, "page %127s", name) == 1) {
+            if (atlasPageCount < ATLAS_PAGE_MAX) {
+                snprintf(atlasPageName[atlasPageCount++], sizeof atlasPageName[0], "atlas/%s", name);
+            }
+            continue;
+        }
+        if (sscanf(line, "region %127s %d %d %d %d %d %d%n", name, &r.page,
+            &r.rect.x, &r.rect.y, &r.rect.w, &r.rect.h, &r.frames, &n) != 7) {
+            continue;
+        }
+        if (r.page < 0 || r.page >= atlasPageCount || r.frames < 1 || r.frames > IMAGE_FRAME_MAX) {
+            SDL_Log("atlas: bad region %s", name);
+            continue;
+        }
+        const char* p = line + n;
+        for (int f = 0; f < r.frames; f++) {
+            int used = 0, ms = 0;
+            if (sscanf(p, "%d%n", &ms, &used) != 1) ms = 0;
+            p += used;
+            r.duration[f] = (Uint16)ms;
+        }
+        size_t len = stemLength(name);
+        memcpy(r.name, name, len);
+        r.name[len] = '\0';
+        if (atlasRegionCount == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            AtlasRegion* nr = (AtlasRegion*)realloc(atlasRegion, (size_t)capacity * sizeof(AtlasRegion));
+            if (!nr) break;
+            atlasRegion = nr;
+        }
+        atlasRegion[atlasRegionCount++] = r;
+    }
+    fclose(fp);
+    SDL_Log("atlas: %d regions in %d pages", atlasRegionCount, atlasPageCount);
+}
+
+/**
+* @brief ファイル名からアトラスの画像を探す（拡張子は見ないので、img/girl.pngでgirl.asepriteのフレームが見つかる）
+*/
+static const AtlasRegion* atlasFind(const char* fileName) {
+    if (!atlasTried) {
+        atlasLoad();
+    }
+    size_t len = stemLength(fileName);
+    for (int i = 0; i < atlasRegionCount; i++) {
+        if (strlen(atlasRegion[i].name) == len && strncmp(atlasRegion[i].name, fileName, len) == 0) {
+            return &atlasRegion[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+* @brief キャッシュの項目のテクスチャを開放して空きにする（アトラスのページはpurgeImageで開放する）
+*/
+static void destroyEntry(int id) {
+    if (image[id] && !region[id]) {
+        SDL_DestroyTexture(image[id]);
+    }
+    image[id] = NULL;
+    region[id] = NULL;
+    memset(&entry[id], 0, sizeof(ImageEntry));
+}
+
+/**
+* @brief キャッシュの空きを探す（無ければ参照の無い一番古いものを入れ替える）
+*/
+static int allocEntry(void) {
+    int oldest = -1;
+    for (int i = 0; i < IMAGE_MAX; i++) {
+        if (entry[i].path[0] == '\0') {
+            return i;
+        }
+        if (entry[i].refs == 0 && !entry[i].pending &&
+            (oldest < 0 || entry[i].released < entry[oldest].released)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) {
+        renderQueueFlush();
+        destroyEntry(oldest);
+    }
+    return oldest;
+}
+
+/**
+* @brief 画像を1枚のテクスチャとして読む（拡張子が無ければ.pngを付ける）
+*
+* @param async trueならワーカーに頼む（頼めなければその場で読む）
+*/
+static void loadStandalone(int id, bool async) {
+    char path[ATLAS_NAME_MAX + 8];
+    const char* fileName = entry[id].path;
+    if (stemLength(fileName) == strlen(fileName)) {
+        snprintf(path, sizeof(path), "%s.png", fileName);
+        fileName = path;
+    }
+    if (async && assetLoaderRequest(id, ++loadTag, fileName)) {
+        entry[id].pending = true;
+        entry[id].tag = loadTag;
+        return;
+    }
+    image[id] = IMG_LoadTexture(renderer, fileName);
+    if (!image[id]) {
+        SDL_Log("IMG_LoadTexture failed: %s", IMG_GetError());
+    }
+}
+
+/**
+* @brief アトラスのページを読む（読み込み済み・読み込み中なら何もしない）
+*/
+static void loadPage(int page, bool async) {
+    if (atlasPage[page] || atlasPagePending[page]) {
+        return;
+    }
+    if (async && assetLoaderRequest(IMAGE_MAX + page, ++loadTag, atlasPageName[page])) {
+        atlasPagePending[page] = true;
+        atlasPageTag[page] = loadTag;
+        return;
+    }
+    atlasPage[page] = IMG_LoadTexture(renderer, atlasPageName[page]);
+    if (!atlasPage[page]) {
+        SDL_Log("IMG_LoadTexture failed: %s", IMG_GetError());
+    }
+}
+
+/**
+* @brief ワーカーが読み終えた画像をテクスチャにする（描画スレッドで呼ぶ）
+*
+* 要求の後に入れ替えられた項目の結果は捨てる
+*/
+static void finishLoads(void) {
+    int key;
+    Uint32 tag;
+    SDL_Surface* surface;
+    while (assetLoaderTake(&key, &tag, &surface)) {
+        if (key < IMAGE_MAX) {
+            if (entry[key].pending && entry[key].tag == tag) {
+                entry[key].pending = false;
+                image[key] = surface ? SDL_CreateTextureFromSurface(renderer, surface) : NULL;
+            }
+        }
+        else {
+            int page = key - IMAGE_MAX;
+            if (atlasPagePending[page] && atlasPageTag[page] == tag) {
+                atlasPagePending[page] = false;
+                atlasPage[page] = surface ? SDL_CreateTextureFromSurface(renderer, surface) : NULL;
+                for (int i = 0; i < IMAGE_MAX; i++) {
+                    if (!region[i] || region[i]->page != page) {
+                        continue;
+                    }
+                    if (atlasPage[page]) {
+                        image[i] = atlasPage[page];
+                    }
+                    else {
+                        // ページが読めなければ元の画像を読む
+                        region[i] = NULL;
+                        loadStandalone(i, false);
+                    }
+                }
+            }
+        }
+        SDL_FreeSurface(surface);
+    }
+}
+
+/**
+* @brief 画像の読み込み（キャッシュの項目を探すか作る）
+*
+* 先読み（async）は参照を増やさず、参照の無い項目の中で一番最後に入れ替わるようにするだけ
+*/
+static int openImage(const char* fileName, bool async) {
+    for (int i = 0; i < IMAGE_MAX; i++) {
+        if (strcmp(entry[i].path, fileName) == 0) {
+            if (!async) {
+                entry[i].refs++;
+                waitImage(i);
+            }
+            else if (entry[i].refs == 0) {
+                entry[i].released = ++releaseCount;
+            }
+            return i;
+        }
+    }
+    if (strlen(fileName) >= ATLAS_NAME_MAX) {
+        SDL_Log("loadImage: name too long: %s", fileName);
+        return -1;
+    }
+    int id = allocEntry();
+    if (id < 0) {
+        return -1;
+    }
+    strcpy(entry[id].path, fileName);
+    if (async) {
+        entry[id].released = ++releaseCount;
+    }
+    else {
+        entry[id].refs = 1;
+    }
+
+    const AtlasRegion* r = atlasFind(fileName);
+    if (r) {
+        loadPage(r->page, async);
+        if (atlasPage[r->page] || atlasPagePending[r->page]) {
+            image[id] = atlasPage[r->page];
+            region[id] = r;
+            // ページを先読み中なら、同期の読み込みは読み終わるまで待つ
+            if (!async) {
+                waitImage(id);
+            }
+            return id;
+        }
+    }
+    loadStandalone(id, async);
+    return id;
+}
+
 /**
 * @brief 画像の読み込み
 *
-* 指定したIDで、指定したファイルの画像を読み込む
+* 指定したIDで、指定したファイルの画像を読み込む<br>
+* 同じ名前で読み込んだ画像があれば、同じIDを返して参照を増やす（freeImageで開放した後も残っていれば使い回す）。
+* ワーカーで読み込み中なら読み終わるのを待つ。<br>
+* アトラスに入っている画像ならページのテクスチャを共有し、IDごとにページ内の位置を覚えておく。
+* 入っていなければ画像を1枚のテクスチャとして読む（拡張子が無ければ.pngを付ける）
 *
 * @param fileName 画像のファイル名
 * @return 読み込みができない場合は-1を返す
 */
 int loadImage(const char* fileName) {
+    return openImage(fileName, false);
+}
 
-    for (int i = 0; i < IMAGE_MAX; i++)
-    {
-        if (image[i] == NULL) {
-            image[i] = IMG_LoadTexture(renderer, fileName);
-            return i;
-        }
+/**
+* @brief 画像をワーカースレッドで読み込む
+*
+* ファイルの読み込みと展開はワーカーで行い、テクスチャはflipのときに作る。
+* 読み終わるまでは描いても何も出ない。次のシーンの画像を先に読んでおく用<br>
+* 参照は増やさないので、使うときはloadImageで参照を取る（何度先読みしても参照は残らない）
+*
+* @param fileName 画像のファイル名
+* @return 画像のID（isImageReadyで読み終わったか確かめる）。空きが無い場合は-1を返す
+*/
+int loadImageAsync(const char* fileName) {
+    return openImage(fileName, true);
+}
+
+/**
+* @brief 画像が読み終わっているかどうか
+*
+* @param id 画像のID
+*/
+bool isImageReady(int id) {
+    if (id < 0 || id >= IMAGE_MAX || entry[id].path[0] == '\0' || entry[id].pending) {
+        return false;
+    }
+    return !region[id] || !atlasPagePending[region[id]->page];
+}
+
+/**
+* @brief 画像が読み終わるまで待つ
+*
+* @param id 画像のID
+*/
+void waitImage(int id) {
+    if (id < 0 || id >= IMAGE_MAX) {
+        return;
+    }
+    if (entry[id].pending) {
+        assetLoaderWait(id, entry[id].tag);
+        finishLoads();
+    }
+    if (region[id] && atlasPagePending[region[id]->page]) {
+        int page = region[id]->page;
+        assetLoaderWait(IMAGE_MAX + page, atlasPageTag[page]);
+        finishLoads();
+    }
+}
+
+/**
+* @brief 画像の参照を1つ減らす（テクスチャはキャッシュに残る）
+*
+* @param id 画像のID
+*/
+void releaseImage(int id) {
+    if (id >= 0 && id < IMAGE_MAX && entry[id].refs > 0 && --entry[id].refs == 0) {
+        entry[id].released = ++releaseCount;
     }
-    return -1;
 }
 
 /**
 * @brief 読み込んだ画像の開放
 *
-* 読み込んだ全ての画像を開放する<br>
-* 画像の取得に失敗したら強制終了する
+* 読み込んだ全ての画像の参照を0にする<br>
+* テクスチャはキャッシュに残すので、次のシーンで同じ画像を読んでもファイルは読み直さない。
+* 実際に開放するのはpurgeImage
 */
 void freeImage(void) {
     
+    renderQueueFlush();
+    for (int i = 0; i < IMAGE_MAX; i++) {
+        if (entry[i].refs > 0) {
+            entry[i].refs = 0;
+            entry[i].released = ++releaseCount;
+        }
+    }
+}
+
+/**
+* @brief 参照の無い画像のテクスチャを開放する
+*
+* 読み込み中のものは読み終わるのを待ってから開放する。
+* アトラスのページは共有しているので、使っている画像が無くなったら1回だけ開放する
+*/
+void purgeImage(void) {
+    renderQueueFlush();
     for (int i = 0; i < IMAGE_MAX; i++) {
-        if (image[i]) {
-            SDL_DestroyTexture(image[i]);
-            image[i] = NULL;
+        if (entry[i].path[0] != '\0' && entry[i].refs == 0) {
+            waitImage(i);
+            destroyEntry(i);
+        }
+    }
+    for (int page = 0; page < ATLAS_PAGE_MAX; page++) {
+        bool used = false;
+        for (int i = 0; i < IMAGE_MAX; i++) {
+            used |= region[i] && region[i]->page == page;
+        }
+        if (!used && atlasPage[page]) {
+            SDL_DestroyTexture(atlasPage[page]);
+            atlasPage[page] = NULL;
         }
     }
 }
@@ -117,6 +487,73 @@ static bool isLoaded(int id) {
     return id >= 0 && id < IMAGE_MAX && image[id];
 }
 
+/**
+* @brief 画像の中の矩形をテクスチャの中の矩形にする
+*
+* アトラスの画像ならページ内の位置だけずらす。
+* SDL_RenderCopyと同じく画像の範囲で切り取る（出力先の矩形はそのまま）
+*
+* @param id 画像のID
+* @param src 画像の中の矩形（NULLなら画像全体）
+* @param out テクスチャの中の矩形
+* @return 範囲が残っていればtrue
+*/
+bool getImageSource(int id, const SDL_Rect *src, SDL_Rect *out) {
+    if (!isLoaded(id)) {
+        return false;
+    }
+    SDL_Rect bounds = { 0, 0, 0, 0 };
+    if (region[id]) {
+        bounds = region[id]->rect;
+    }
+    else {
+        SDL_QueryTexture(image[id], NULL, NULL, &bounds.w, &bounds.h);
+    }
+    if (!src) {
+        *out = bounds;
+        return true;
+    }
+    SDL_Rect moved = { src->x + bounds.x, src->y + bounds.y, src->w, src->h };
+    return SDL_IntersectRect(&moved, &bounds, out) == SDL_TRUE;
+}
+
+/**
+* @brief 画像の大きさ（アトラスの画像ならページ内の大きさ）
+*
+* @param id 画像のID
+* @param w 幅
+* @param h 高さ
+*/
+void getImageSize(int id, int *w, int *h) {
+    SDL_Rect r = { 0, 0, 0, 0 };
+    getImageSource(id, NULL, &r);
+    *w = r.w;
+    *h = r.h;
+}
+
+/**
+* @brief 画像のフレーム数（.asepriteから作ったもの以外は1）
+*
+* @param id 画像のID
+*/
+int getImageFrameCount(int id) {
+    return isLoaded(id) && region[id] ? region[id]->frames : 1;
+}
+
+/**
+* @brief フレームの長さ
+*
+* @param id 画像のID
+* @param frame フレーム番号
+* @return ms（わからない場合は0）
+*/
+int getImageFrameDuration(int id, int frame) {
+    if (!isLoaded(id) || !region[id] || frame < 0 || frame >= region[id]->frames) {
+        return 0;
+    }
+    return region[id]->duration[frame];
+}
+
 /**
 * @brief 画像の描画
 *
@@ -130,13 +567,49 @@ static bool isLoaded(int id) {
 void drawImage(int id, SDL_Rect *src, SDL_FRect *dst, 
     double angle, const SDL_FPoint *center, SDL_RendererFlip flip) {
     if (isLoaded(id)) {
+        renderQueueFlush();
+        if (region[id]) {
+            SDL_Rect s;
+            if (getImageSource(id, src, &s)) {
+                SDL_RenderCopyExF(renderer, image[id], &s, dst, angle, center, flip);
+            }
+            return;
+        }
         SDL_RenderCopyExF(renderer, image[id], src, dst, angle, center, flip);
     }
 }
 
+/**
+* @brief 色とブレンドモードを指定して画像を描画（描画キューにためて、並べ替えてからまとめて描く）
+*
+* テクスチャの色・透明度・ブレンドモードの設定は変えない。
+* 画面の外のものと透明度0のものは描かない
+*
+* @param id 画像のID
+* @param src 描画元矩形
+* @param dst 出力先矩形
+* @param angle 表示角度
+* @param center 回転時の中心点
+* @param flip 上下、左右反転フラグ
+* @param color 色と透明度
+* @param mode ブレンドモード
+* @param layer レイヤー（RENDER_LAYER_～、大きいほど手前）
+* @param depth 同じレイヤー・画像の中での奥行き（小さいほど先に描く）
+*/
+void drawImageColored(int id, const SDL_Rect *src, const SDL_FRect *dst,
+    double angle, const SDL_FPoint *center, SDL_RendererFlip flip, SDL_Color color, SDL_BlendMode mode,
+    int layer, float depth) {
+    SDL_Rect s;
+    if (getImageSource(id, src, &s)) {
+        renderQueueSubmit(image[id], mode, &s, dst, angle, center, flip, color, layer, depth);
+    }
+}
+
 /**
 * @brief 透明度のセット
 *
+* アトラスの画像はページを共有しているので、同じページの画像すべてに効く
+*
 * @param id 画像のID
 * @param alpha 透明度の値(0-1)
 */
@@ -186,6 +659,7 @@ void setFullScreen(bool isFull) {
 * @brief 画面をクリア
 */
 void clearScreen(float r, float g, float b) {
+    renderQueueFlush();
     SDL_SetRenderDrawColor(
         renderer,
         (Uint8)(r * 255.0f),
@@ -197,9 +671,13 @@ void clearScreen(float r, float g, float b) {
 
 /**
 * @brief Windowの更新
+*
+* ワーカーで読み終えた画像もここでテクスチャにする
 */
 void flip(void) {
+    renderQueueEndFrame();
     SDL_RenderPresent(renderer);
+    finishLoads();
 }
 
 /**
@@ -213,6 +691,7 @@ void flip(void) {
 * @param a 線の色 ALPHA
 */
 void drawPoint(float x, float y, float r, float g, float b, float a) {
+    renderQueueFlush();
     SDL_SetRenderDrawColor(
         renderer,
         (Uint8)(r * 255.0f),
@@ -235,6 +714,7 @@ void drawPoint(float x, float y, float r, float g, float b, float a) {
 * @param a 線の色 ALPHA
 */
 void drawLine(float x1, float y1, float x2, float y2, float r, float g, float b, float a) {
+    renderQueueFlush();
     SDL_SetRenderDrawColor(
         renderer,
         (Uint8)(r * 255.0f),
@@ -253,6 +733,7 @@ void drawLine(float x1, float y1, float x2, float y2, float r, float g, float b,
 * @param a 線の色 ALPHA
 */
 void drawRect(const SDL_FRect* rect, float r, float g, float b, float a) {
+    renderQueueFlush();
     SDL_SetRenderDrawColor(
         renderer,
         (Uint8)(r * 255.0f),
@@ -271,6 +752,7 @@ void drawRect(const SDL_FRect* rect, float r, float g, float b, float a) {
 * @param a 線の色 ALPHA
 */
 void fillRect(const SDL_FRect* rect, float r, float g, float b, float a) {
+    renderQueueFlush();
     SDL_SetRenderDrawColor(
         renderer,
         (Uint8)(r * 255.0f),
@@ -287,9 +769,27 @@ void fillRect(const SDL_FRect* rect, float r, float g, float b, float a) {
 void setDrawMode(SDL_BlendMode mode) {
     SDL_SetRenderDrawBlendMode(renderer, mode);
 }
+/**
+* @brief 色の値(0-1)をSDL_Colorにする
+*/
+static SDL_Color toColor(float r, float g, float b, float a) {
+    return (SDL_Color){ (Uint8)(r * 255.0f), (Uint8)(g * 255.0f), (Uint8)(b * 255.0f), (Uint8)(a * 255.0f) };
+}
+
+/**
+* @brief 基本図形の描画モード（setDrawModeで設定したもの）
+*/
+static SDL_BlendMode drawMode(void) {
+    SDL_BlendMode mode = SDL_BLENDMODE_NONE;
+    SDL_GetRenderDrawBlendMode(renderer, &mode);
+    return mode;
+}
+
 /**
 * @brief 円形の描画
 *
+* 三角形にしてバッチにためるので、続けて描いた図形はまとめて1回で描かれる
+*
 * @param x x
 * @param y y
 * @param radius 半径
@@ -299,40 +799,7 @@ void setDrawMode(SDL_BlendMode mode) {
 * @param a 線の色 ALPHA
 */
 void drawCircle(float x, float y, float radius, float r, float g, float b, float a) {
-    SDL_SetRenderDrawColor(
-        renderer,
-        (Uint8)(r * 255.0f),
-        (Uint8)(g * 255.0f),
-        (Uint8)(b * 255.0f),
-        (Uint8)(a * 255.0f));
-    bool drawingLine = false;
-    SDL_FPoint start;
-    SDL_FPoint end;
-    for (int i = y - radius; i < y + radius; i++) {
-        drawingLine = false;
-        for (int j = x - radius; j < x + radius; j++) {
-            int dx = j - x;
-            int dy = i - y;
-            int d = dx * dx + dy * dy;
-            if (d < radius * radius) {
-                if (drawingLine) {
-                    end = (SDL_FPoint){ j, i };
-                }
-                else {
-                    drawingLine = true;
-                    start = (SDL_FPoint){ j, i };
-                    end = start;
-                }
-            }
-            else if (drawingLine) {
-                SDL_RenderDrawLineF(renderer, start.x, start.y, end.x, end.y);
-                drawingLine = false;
-            }
-        }
-        if (drawingLine) {
-            SDL_RenderDrawLineF(renderer, start.x, start.y, end.x, end.y);
-}
-    }
+    primitiveCircle(x, y, radius, toColor(r, g, b, a), drawMode());
 }
 /**
 * @brief 扇形の描画
@@ -348,50 +815,52 @@ void drawCircle(float x, float y, float radius, float r, float g, float b, float
 * @param a 線の色 ALPHA
 */
 void drawArc(float x, float y, float radius, float direction, double angle, float r, float g, float b, float a) {
-    SDL_SetRenderDrawColor(
-        renderer,
-        (Uint8)(r * 255.0f),
-        (Uint8)(g * 255.0f),
-        (Uint8)(b * 255.0f),
-        (Uint8)(a * 255.0f));
-    float cos_dir = cosf(direction);
-    float sin_dir = sinf(direction);
-    float cos_angle = cosf(angle);
-    bool drawingLine = false;
-    SDL_FPoint start;
-    SDL_FPoint end;
-    for (int i = y - radius; i < y + radius; i++) {
-        drawingLine = false;
-        for (int j = x - radius; j < x + radius; j++) {
-            int dx = j - x;
-            int dy = i - y;
-            int d = dx * dx + dy * dy;
-            double norm = sqrtf(d);
-            double product = dx * cos_dir + dy * sin_dir;
-            if (product / norm > cos_angle &&
-                d < radius * radius) {
-
-                if (drawingLine) {
-                    end = (SDL_FPoint){ j, i };
-                }
-                else{
-                    drawingLine = true;
-                    start = (SDL_FPoint){ j, i };
-                    end = start;
-                }
-            }
-            else if (drawingLine) {
-                SDL_RenderDrawLineF(renderer, start.x, start.y, end.x, end.y);
-                drawingLine = false;
-            }
-        }
-        if (drawingLine) {
-            SDL_RenderDrawLineF(renderer, start.x, start.y, end.x, end.y);
+    primitiveArc(x, y, radius, direction - (float)angle, (float)angle * 2.0f, toColor(r, g, b, a), drawMode());
 }
-    }
+/**
+* @brief 輪（円弧の太い線）の描画
+*
+* @param x x
+* @param y y
+* @param radius 線の中心の半径
+* @param width 線の太さ
+* @param r 線の色 RED
+* @param g 線の色 ENEMY_TYPE_GREEN
+* @param b 線の色 BLUE
+* @param a 線の色 ALPHA
+*/
+void drawRing(float x, float y, float radius, float width, float r, float g, float b, float a) {
+    primitiveRing(x, y, radius, width, 0.0f, 2.0f * (float)M_PI, toColor(r, g, b, a), drawMode());
+}
+/**
+* @brief 太さを指定した直線の描画
+*
+* @param x1 始点x
+* @param y1 始点y
+* @param x2 終点x
+* @param y2 終点y
+* @param width 線の太さ
+* @param r 線の色 RED
+* @param g 線の色 ENEMY_TYPE_GREEN
+* @param b 線の色 BLUE
+* @param a 線の色 ALPHA
+*/
+void drawThickLine(float x1, float y1, float x2, float y2, float width, float r, float g, float b, float a) {
+    primitiveLine(x1, y1, x2, y2, width, toColor(r, g, b, a), drawMode());
 }
 
 SDL_Renderer* getRenderer(void)
 {
     return renderer;
 }
+
+/**
+* @brief 画像のテクスチャ（SDL_RenderGeometryでまとめて描くとき用）
+*
+* @param id 画像のID
+* @return 読み込まれていなければNULL
+*/
+SDL_Texture* getTexture(int id)
+{
+    return isLoaded(id) ? image[id] : NULL;
+}
@@ -7,11 +7,24 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 
+#define IMAGE_FRAME_MAX     64      ///< アトラスの1つの画像のフレーム数の上限
+
 void screenInit(int width, int height);
 void screenQuit(void);
 int loadImage(const char* fileName);
+int loadImageAsync(const char* fileName);
+bool isImageReady(int id);
+void waitImage(int id);
+void releaseImage(int id);
 void freeImage(void);
+void purgeImage(void);
+bool getImageSource(int id, const SDL_Rect *src, SDL_Rect *out);
+void getImageSize(int id, int *w, int *h);
+int getImageFrameCount(int id);
+int getImageFrameDuration(int id, int frame);
 void drawImage(int id, SDL_Rect *src, SDL_FRect *dst, double angle, const SDL_FPoint *center, SDL_RendererFlip flip);
+void drawImageColored(int id, const SDL_Rect *src, const SDL_FRect *dst, double angle, const SDL_FPoint *center,
+    SDL_RendererFlip flip, SDL_Color color, SDL_BlendMode mode, int layer, float depth);
 void setAlpha(int id, Uint8 alpha);
 void setColor(int id, Uint8 r, Uint8 g, Uint8 b);
 void setBlendMode(int id, SDL_BlendMode mode);
@@ -25,4 +38,7 @@ void fillRect(const SDL_FRect* rect, float r, float g, float b, float a);
 void setDrawMode(SDL_BlendMode mode);
 void drawCircle(float x, float y, float radius, float r, float g, float b, float a);
 void drawArc(float x, float y, float radius, float direction, double angle, float r, float g, float b, float a);
+void drawRing(float x, float y, float radius, float width, float r, float g, float b, float a);
+void drawThickLine(float x1, float y1, float x2, float y2, float width, float r, float g, float b, float a);
 SDL_Renderer* getRenderer(void);
+SDL_Texture* getTexture(int id);
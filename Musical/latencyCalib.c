@@ -0,0 +1,181 @@
+/**
+* @file latencyCalib.c
+* @brief 出力レイテンシのキャリブレーションの実装
+*
+* 入力の時刻はフレーム単位のgetKeyDownではなくSDLイベントのtimestampを使う。
+* 中央値と中央絶対偏差(MAD)で外れ値を除いてから平均をとる
+*/
+#include "latencyCalib.h"
+#include "musicEvent.h"
+#include <stdlib.h>
+
+#define CALIB_CLICK_MAX 256
+
+static bool active;
+static Uint64 clicks[CALIB_CLICK_MAX];
+static int clickCount;
+static unsigned clickCursor;
+static Uint64 taps[CALIB_TAPS];
+static int tapCount;
+static bool hasResult;
+static LatencyCalibResult result;
+static char status[128];
+
+static int cmp_double(const void* a, const void* b) {
+    double A = *(const double*)a;
+    double B = *(const double*)b;
+    return (A > B) - (A < B);
+}
+
+static double median(double* v, int n) {
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+    return (n & 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) * 0.5;
+}
+
+/**
+* @brief キャリブレーションを開始する（クリックトラックを鳴らす）
+*/
+void latencyCalibStart(void) {
+    active = true;
+    clickCount = 0;
+    tapCount = 0;
+    hasResult = false;
+    musicEventReadClicks(clicks, CALIB_CLICK_MAX, &clickCursor);    // 古いクリックは読み捨てる
+    musicEventSetClickTrack(true, CALIB_INTERVAL_MS);
+    SDL_Log("[latencyCalib] start: tap with the click");
+}
+
+/**
+* @brief キャリブレーションを中止する（結果は反映しない）
+*/
+void latencyCalibCancel(void) {
+    if (!active) return;
+    active = false;
+    musicEventSetClickTrack(false, CALIB_INTERVAL_MS);
+    SDL_Log("[latencyCalib] cancelled");
+}
+
+/**
+* @brief 入力を記録する（イベント処理から呼ぶ）
+*
+* @param timestamp SDLイベントのtimestamp
+*/
+void latencyCalibTap(Uint32 timestamp) {
+    if (!active || tapCount >= CALIB_TAPS) return;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 back = (Uint64)(Uint32)(SDL_GetTicks() - timestamp) * freq / 1000;
+    taps[tapCount++] = now > back ? now - back : 0;
+}
+
+/**
+* @brief 入力とその直前のクリックとの差(ms)
+*
+* CALIB_EARLY_MSまではクリックより早い入力も認める
+*/
+static bool tap_delay(Uint64 tap, double* outMs) {
+    double freq = (double)SDL_GetPerformanceFrequency();
+    double early = CALIB_EARLY_MS * freq / 1000.0;
+    int best = -1;
+    for (int i = 0; i < clickCount; i++) {
+        if ((double)clicks[i] <= (double)tap + early) best = i;
+    }
+    if (best < 0) return false;
+    *outMs = ((double)tap - (double)clicks[best]) * 1000.0 / freq;
+    return true;
+}
+
+/**
+* @brief 外れ値を除いてレイテンシを求め、保存して反映する
+*/
+static void finish(void) {
+    double d[CALIB_TAPS];
+    double dev[CALIB_TAPS];
+    int n = 0;
+    for (int i = CALIB_SKIP_TAPS; i < tapCount; i++) {
+        if (tap_delay(taps[i], &d[n])) n++;
+    }
+
+    active = false;
+    musicEventSetClickTrack(false, CALIB_INTERVAL_MS);
+    if (n < CALIB_MIN_INLIERS) {
+        SDL_Log("[latencyCalib] not enough taps (%d)", n);
+        return;
+    }
+
+    double sorted[CALIB_TAPS];
+    SDL_memcpy(sorted, d, (size_t)n * sizeof(double));
+    double med = median(sorted, n);
+    for (int i = 0; i < n; i++) dev[i] = SDL_fabs(d[i] - med);
+    double mad = median(dev, n);
+
+    // 正規分布ならσ ≒ 1.4826 * MAD。3σを超えたものは外れ値
+    double limit = 3.0 * 1.4826 * mad;
+    if (limit < 4.0) limit = 4.0;
+    double sum = 0.0;
+    int inliers = 0;
+    for (int i = 0; i < n; i++) {
+        if (SDL_fabs(d[i] - med) <= limit) {
+            sum += d[i];
+            inliers++;
+        }
+    }
+    if (inliers < CALIB_MIN_INLIERS) {
+        SDL_Log("[latencyCalib] taps too scattered (MAD %.1f ms)", mad);
+        return;
+    }
+
+    result.totalMs = sum / inliers;
+    result.deviceMs = result.totalMs - musicEventGetBufferLatencyMs();
+    result.madMs = mad;
+    result.taps = n;
+    result.inliers = inliers;
+    hasResult = true;
+    musicEventSetOutputLatency(result.deviceMs, true);
+    SDL_Log("[latencyCalib] latency %.1f ms (device %.1f ms, MAD %.1f ms, %d/%d taps)",
+        result.totalMs, result.deviceMs, mad, inliers, n);
+}
+
+/**
+* @brief 毎フレーム呼ぶ（クリック時刻の取り込みと終了判定）
+*/
+void latencyCalibUpdate(void) {
+    if (!active) return;
+
+    Uint64 buf[CLICK_RING];
+    int n = musicEventReadClicks(buf, CLICK_RING, &clickCursor);
+    for (int i = 0; i < n; i++) {
+        if (clickCount == CALIB_CLICK_MAX) {
+            SDL_memmove(clicks, clicks + 1, (CALIB_CLICK_MAX - 1) * sizeof(Uint64));
+            clickCount--;
+        }
+        clicks[clickCount++] = buf[i];
+    }
+
+    SDL_snprintf(status, sizeof(status), "Latency calibration: tap with the click (%d/%d)  L: cancel",
+        tapCount, CALIB_TAPS);
+
+    if (tapCount >= CALIB_TAPS) finish();
+}
+
+bool latencyCalibIsActive(void) {
+    return active;
+}
+
+/**
+* @brief 直近のキャリブレーション結果
+*
+* @return 結果があればtrue
+*/
+bool latencyCalibGetResult(LatencyCalibResult* out) {
+    if (!hasResult) return false;
+    if (out) *out = result;
+    return true;
+}
+
+/**
+* @brief 画面表示用の状態文字列
+*/
+const char* latencyCalibStatus(void) {
+    return active ? status : "";
+}
@@ -0,0 +1,36 @@
+/**
+* @file latencyCalib.h
+* @brief 出力レイテンシのキャリブレーションヘッダ
+*
+* クリックに合わせて入力してもらい、クリックを出力した時刻と入力時刻の差から
+* デバイスの出力レイテンシを求める
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define CALIB_INTERVAL_MS   600.0   ///< クリックの間隔(ms)
+#define CALIB_TAPS          24      ///< 集める入力の数
+#define CALIB_SKIP_TAPS     4       ///< 慣れるまでの最初の入力は捨てる
+#define CALIB_MIN_INLIERS   8       ///< 外れ値を除いて最低限必要な数
+#define CALIB_EARLY_MS      100.0   ///< クリックより早い入力として許す範囲(ms)
+
+/**
+* @brief キャリブレーションの結果
+*/
+typedef struct {
+    double totalMs;     ///< 入力までの遅れ（バッファ + デバイス）
+    double deviceMs;    ///< バッファ1回分を除いたデバイス側の遅れ
+    double madMs;       ///< 中央値からの絶対偏差の中央値
+    int taps;           ///< 使った入力数
+    int inliers;        ///< 外れ値を除いた数
+} LatencyCalibResult;
+
+void latencyCalibStart(void);
+void latencyCalibCancel(void);
+void latencyCalibTap(Uint32 timestamp);
+void latencyCalibUpdate(void);
+bool latencyCalibIsActive(void);
+bool latencyCalibGetResult(LatencyCalibResult* out);
+const char* latencyCalibStatus(void);
@@ -8,14 +8,70 @@
 #include "mouse.h"        
 #include "title.h"
 #include "mainGame.h"
+#include "musicEvent.h"
+#include "latencyCalib.h"
+#include "threadPolicy.h"
+#include "animation.h"
+#include "assetLoader.h"
 #include <SDL2/SDL_mixer.h>
 #include <stdlib.h>
+#include <string.h>
 
 static int sequence;    ///< 流れの管理用変数
 static int score;
 static int hiscore;
 static float deltaTime;
 
+ /**
+ * @brief オフラインレンダリング
+ *
+ * Musical --render 出力.wav イベント.txt [曲.wav] [譜面.mid] [ブロックフレーム数]<br>
+ * 画面もオーディオデバイスも使わず（dummyドライバ）、曲全体を実時間より速くミックスする
+ *
+ * @param argc 実行時引数の数
+ * @param argv 実行時引数文字列の配列
+ * @return 終了コード
+ */
+static int renderMain(int argc, char* argv[]) {
+    const char* wavPath = argv[2];
+    const char* logPath = argv[3];
+    const char* musicPath = argc > 4 ? argv[4] : "sound/ss.wav";
+    const char* midiPath = argc > 5 ? argv[5] : "sound/song.mid";
+    int blockFrames = argc > 6 ? atoi(argv[6]) : 0;
+
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    SDL_Init(SDL_INIT_AUDIO);
+
+    bool ok = musicEventRenderOffline(musicPath, midiPath, wavPath, logPath, blockFrames);
+
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
+ /**
+ * @brief 譜面の下書き生成
+ *
+ * Musical --chart 出力.mid [曲.wav] [グリッド分割数]<br>
+ * 曲のオンセットとテンポを検出し、load_midi_build_eventsで読めるSMFを書き出す。
+ * グリッド分割数は1拍を何分割したグリッドに寄せるか（既定4で16分音符、0で寄せない）
+ *
+ * @param argc 実行時引数の数
+ * @param argv 実行時引数文字列の配列
+ * @return 終了コード
+ */
+static int chartMain(int argc, char* argv[]) {
+    const char* midiPath = argv[2];
+    const char* musicPath = argc > 3 ? argv[3] : "sound/ss.wav";
+    int subdivision = argc > 4 ? atoi(argv[4]) : 4;
+
+    SDL_Init(0);
+
+    bool ok = musicEventDraftChart(musicPath, midiPath, subdivision);
+
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
+
  /**
  * @brief メイン関数
  * 
@@ -24,9 +80,19 @@ static float deltaTime;
  */
 int main(int argc, char* argv[]){
 
+    if (argc >= 4 && strcmp(argv[1], "--render") == 0) {
+        return renderMain(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--chart") == 0) {
+        return chartMain(argc, argv);
+    }
+
     //ビデオとオーディオを初期化
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER | SDL_INIT_EVENTS);
 
+    //スレッドの優先度とコアの割り当て（オーディオやワーカーのスレッドを作る前に）
+    threadPolicyInit();
+
     //オーディオの初期化
     Mix_Init(MIX_INIT_MP3);
     Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048);
@@ -34,6 +100,14 @@ int main(int argc, char* argv[]){
     //画面の初期化
     screenInit(WINDOW_WIDTH, WINDOW_HEIGHT);
 
+    //メインスレッドを描画のコアへ。新しいスレッドは作ったスレッドのコアの割り当てを引き継ぐので、
+    //SDL_mixerなど役割を設定しないSDLのスレッドを作り終えてから固定する
+    //（この後に作るスレッドは、先頭でthreadPolicyApplyを呼んで自分の役割のコアへ移る）
+    threadPolicyApply(THREAD_ROLE_RENDER);
+
+    //アニメーションのプールを確保
+    animationInit(ANIMATION_DEFAULT_CAPACITY);
+
     //setFullScreen(true);
     sequence = TITLE;
     sequence = MAINGAME;
@@ -55,6 +129,9 @@ int main(int argc, char* argv[]){
 
     //読み込んだデータの開放                
     freeImage();
+    purgeImage();
+    assetLoaderQuit();
+    animationQuit();
 
     //終了処理
     Mix_CloseAudio();
@@ -134,6 +211,7 @@ void eventInput(bool* isLoop) {
         switch (event.type) {
         //キーダウンイベント
         case SDL_KEYDOWN:
+            if (!event.key.repeat) latencyCalibTap(event.key.timestamp);
             switch (event.key.keysym.scancode) {
             case SDL_SCANCODE_ESCAPE:
                 sequence = END;
@@ -148,6 +226,13 @@ void eventInput(bool* isLoop) {
             }
             break;
 
+        case SDL_CONTROLLERBUTTONDOWN:
+            latencyCalibTap(event.cbutton.timestamp);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            latencyCalibTap(event.button.timestamp);
+            break;
+
         case SDL_CONTROLLERDEVICEADDED:
             openPad(event.cdevice.which);
             break;
@@ -4,21 +4,25 @@
  */
 #define _USE_MATH_DEFINES
 #include "mainGame.h"   
+#include "title.h"
 #include "main.h"                                       
 #include "image.h"        
 #include "key.h"                                
 #include "mouse.h"     
 #include "sprite.h"
 #include "animation.h"
+#include "timeline.h"
 #include "easing.h"
 #include "dynamic_font_atlas.h"
+#include "renderQueue.h"
 #include "enemy.h"
  //#include "jewelry.h"
  //#include "player.h"
- //#include "particle.h"
+ #include "particle.h"
  #include "star.h"
 #include "gamepad.h"
 #include "musicEvent.h"
+#include "latencyCalib.h"
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
@@ -84,6 +88,7 @@ static void init() {
     //bgの初期化
     spriteInit(&bg, loadImage("img/stage.png"), 0, 0, 256, 192);
     bg.scale = 3;
+    bg.layer = RENDER_LAYER_BACKGROUND;
     bg.position.x = WINDOW_WIDTH / 2;
     bg.position.y = WINDOW_HEIGHT / 2;
     //infoTextの初期化
@@ -97,6 +102,7 @@ static void init() {
     fade.position.x = WINDOW_WIDTH / 2;
     fade.position.y = WINDOW_HEIGHT / 2;
     fade.scale = WINDOW_WIDTH / fade.src.w;
+    fade.layer = RENDER_LAYER_OVERLAY;
 
     //テキストの初期化
     TTF_Init();
@@ -117,6 +123,9 @@ static void init() {
     enemyInit(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
     starInit();
 
+    //タイトルの画像を先に読んでおく
+    titlePreload();
+
     nowSequence = START;
 
     isRunning = true;
@@ -127,10 +136,18 @@ static void init() {
  */
 static void update() {
     musicEventUpdate();
+
+    //レイテンシのキャリブレーション（Lで開始/中止）
+    if (getKeyDown(SDL_SCANCODE_L)) {
+        if (latencyCalibIsActive()) latencyCalibCancel();
+        else latencyCalibStart();
+    }
+    latencyCalibUpdate();
+
     bool pauseToggle =
         getKeyDown(SDL_SCANCODE_SPACE) ||
         getGamepadButtonDown(0, SDL_CONTROLLER_BUTTON_START);
-    if (pauseToggle) {
+    if (pauseToggle && !latencyCalibIsActive()) {
         musicEventTogglePaused();
     }
 
@@ -153,8 +170,12 @@ static void draw() {
     spriteDraw(&bg);
 
     //描画
-    fillRect(&(SDL_FRect) { 0, 0, WINDOW_WIDTH, 20 }, 0.0f, 0.0f, 0.05f, 0.5f); 
+    fillRect(&(SDL_FRect) { 0, 0, WINDOW_WIDTH, 36 }, 0.0f, 0.0f, 0.05f, 0.5f); 
     DFA_DrawText(text, 10, 2, infoText.scale, 0, infoText.color, &layoutLeftCenter, getInfo());
+    if (latencyCalibIsActive()) {
+        DFA_DrawText(text, 10, 40, infoText.scale, 0, infoText.color, &layoutLeftCenter, latencyCalibStatus());
+    }
+    renderQueueFlush();
     DFA_Update(64);
 
     starDraw();
@@ -174,12 +195,24 @@ static void quit() {
     Mix_FreeChunk(trackHiScore); 
 
     musicEventQuit();;
+    particleQuit();
 
     DFA_Quit();
     TTF_Quit();
     freeImage();
 }
 
+/**
+ * @brief メインゲームで使う画像をワーカーで先に読んでおく
+ */
+void mainGamePreload(void) {
+    loadImageAsync("img/stage.png");
+    loadImageAsync("img/white.png");
+    loadImageAsync("img/girl");
+    loadImageAsync("img/heart.png");
+    loadImageAsync("img/circle16x16.png");
+}
+
 /**
  * @brief メイン関数
  */
@@ -196,6 +229,8 @@ void mainGame() {
         draw();
 
         easingUpdate();
+        timelineUpdate();
+        particleUpdate();
         eventInput(&isRunning);
 
         //入力の更新
@@ -4,4 +4,5 @@
  */
 #pragma once
 
-void mainGame(void);
\ No newline at end of file
+void mainGame(void);
+void mainGamePreload(void);
\ No newline at end of file
@@ -0,0 +1,427 @@
+/**
+* @file musicAnalysis.c
+* @brief 曲の事前解析の実装
+*
+* 解析点ごとの処理は互いに独立なので、parallelForで区間に分けて並列に計算する。
+* 結果はキャッシュファイルに保存し、同じ曲なら次回から読み込むだけにする
+*/
+#include "musicAnalysis.h"
+#include "fft.h"
+#include "parallel.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <string.h>
+
+#define ANALYSIS_CACHE_MAGIC    0x414E414Du  // 'MANA'
+#define ANALYSIS_CACHE_VERSION  2u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t freq;
+    int32_t hop;
+    int32_t count;
+    uint32_t hash;
+    int32_t levels;
+    int32_t bands;
+    int32_t hasOffset;
+    uint32_t offsetMidiHash;
+    double offsetMs;
+    float offsetConfidence;
+} AnalysisCacheHeader;
+
+/**
+* @brief 並列解析の共有データ
+*/
+typedef struct {
+    MusicAnalysis* a;
+    const float* music;
+    int64_t frames;
+    int channels;
+    const FFTPlan* plan;
+    const float* window;
+    int bandBin[ANALYSIS_BAND_MAX + 1];   ///< 帯域ごとのFFTビン範囲
+    SDL_atomic_t failed;                ///< どこかの区間で作業用のメモリが取れなかった
+} AnalysisJob;
+
+static const float bandEdgeHz[ANALYSIS_BAND_MAX + 1] = { 20.0f, 150.0f, 600.0f, 4000.0f, 16000.0f };
+
+/**
+* @brief 曲データのハッシュ（全サンプルではなく間引いて計算する）
+*/
+static uint32_t analysis_hash(const float* music, int64_t frames, int channels, int freq) {
+    uint32_t h = 2166136261u;
+    int64_t header[3] = { frames, channels, freq };
+    const uint8_t* p = (const uint8_t*)header;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    int64_t total = frames * channels;
+    for (int64_t i = 0; i < total; i += 1021) {
+        uint32_t bits;
+        memcpy(&bits, &music[i], sizeof(bits));
+        for (int b = 0; b < 4; b++) {
+            h ^= (bits >> (b * 8)) & 0xFF;
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+/**
+* @brief 指定フレームのモノラル値
+*/
+static inline float mono_at(const AnalysisJob* job, int64_t frame) {
+    if (frame < 0 || frame >= job->frames) return 0.0f;
+    const float* f = job->music + frame * job->channels;
+    float v = 0.0f;
+    for (int c = 0; c < job->channels; c++) v += f[c];
+    return v / (float)job->channels;
+}
+
+/**
+* @brief 解析点[begin, end)のRMS・ピーク・帯域エネルギーを求める
+*/
+static void analysis_task(void* ctx, int begin, int end) {
+    AnalysisJob* job = (AnalysisJob*)ctx;
+    MusicAnalysis* a = job->a;
+    int n = job->plan->n;
+
+    float* re = (float*)SDL_malloc((size_t)n * sizeof(float));
+    float* im = (float*)SDL_malloc((size_t)n * sizeof(float));
+    if (!re || !im) {
+        SDL_free(re);
+        SDL_free(im);
+        SDL_AtomicSet(&job->failed, 1);
+        return;
+    }
+
+    for (int i = begin; i < end; i++) {
+        int64_t start = (int64_t)i * a->hop;
+
+        // RMSと最小/最大
+        double sum = 0.0;
+        float mn = 0.0f, mx = 0.0f;
+        int64_t len = 0;
+        for (int64_t f = start; f < start + a->hop && f < job->frames; f++) {
+            float v = mono_at(job, f);
+            sum += (double)v * v;
+            if (len == 0 || v < mn) mn = v;
+            if (len == 0 || v > mx) mx = v;
+            len++;
+        }
+        a->rms[i] = len > 0 ? (float)sqrt(sum / (double)len) : 0.0f;
+        a->peakMin[0][i] = mn;
+        a->peakMax[0][i] = mx;
+
+        // 解析点の中心に窓を置いてFFT
+        int64_t w0 = start + a->hop / 2 - n / 2;
+        for (int k = 0; k < n; k++) {
+            re[k] = mono_at(job, w0 + k) * job->window[k];
+            im[k] = 0.0f;
+        }
+        fftForward(job->plan, re, im);
+
+        for (int b = 0; b < ANALYSIS_BAND_MAX; b++) {
+            double e = 0.0;
+            for (int k = job->bandBin[b]; k < job->bandBin[b + 1]; k++) {
+                e += (double)re[k] * re[k] + (double)im[k] * im[k];
+            }
+            a->band[b][i] = (float)sqrt(e);
+        }
+    }
+
+    SDL_free(re);
+    SDL_free(im);
+}
+
+static bool analysis_alloc(MusicAnalysis* a) {
+    a->rms = (float*)SDL_calloc((size_t)a->count, sizeof(float));
+    if (!a->rms) return false;
+    for (int b = 0; b < ANALYSIS_BAND_MAX; b++) {
+        a->band[b] = (float*)SDL_calloc((size_t)a->count, sizeof(float));
+        if (!a->band[b]) return false;
+    }
+
+    int c = a->count;
+    a->levels = 0;
+    while (a->levels < ANALYSIS_PEAK_LEVELS) {
+        a->peakCount[a->levels] = c;
+        a->peakMin[a->levels] = (float*)SDL_calloc((size_t)c, sizeof(float));
+        a->peakMax[a->levels] = (float*)SDL_calloc((size_t)c, sizeof(float));
+        if (!a->peakMin[a->levels] || !a->peakMax[a->levels]) return false;
+        a->levels++;
+        if (c <= 1) break;
+        c = (c + 1) / 2;
+    }
+    return true;
+}
+
+/**
+* @brief 曲全体を解析する
+*
+* @param a 解析結果の格納先
+* @param music インターリーブのfloat32
+* @param frames フレーム数
+* @param channels チャンネル数
+* @param freq サンプリング周波数
+* @return 解析できたらtrue
+*/
+bool musicAnalysisBuild(MusicAnalysis* a, const float* music, int64_t frames, int channels, int freq) {
+    SDL_zerop(a);
+    if (!music || frames <= 0 || channels <= 0 || freq <= 0) return false;
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+
+    a->freq = freq;
+    a->hop = freq / ANALYSIS_RATE;
+    if (a->hop < 1) a->hop = 1;
+    a->count = (int)((frames + a->hop - 1) / a->hop);
+    a->hash = analysis_hash(music, frames, channels, freq);
+    if (!analysis_alloc(a)) {
+        musicAnalysisFree(a);
+        return false;
+    }
+
+    AnalysisJob job;
+    SDL_zero(job);
+    job.a = a;
+    job.music = music;
+    job.frames = frames;
+    job.channels = channels;
+
+    FFTPlan plan;
+    float* window = (float*)SDL_malloc(ANALYSIS_FFT_SIZE * sizeof(float));
+    if (!window || !fftPlanInit(&plan, ANALYSIS_FFT_SIZE)) {
+        SDL_free(window);
+        musicAnalysisFree(a);
+        return false;
+    }
+    fftHannWindow(window, ANALYSIS_FFT_SIZE);
+    job.plan = &plan;
+    job.window = window;
+
+    for (int b = 0; b <= ANALYSIS_BAND_MAX; b++) {
+        int k = (int)ceilf(bandEdgeHz[b] * ANALYSIS_FFT_SIZE / (float)freq);
+        if (k < 1) k = 1;
+        if (k > ANALYSIS_FFT_SIZE / 2) k = ANALYSIS_FFT_SIZE / 2;
+        job.bandBin[b] = k;
+    }
+
+    int threads = parallelFor(a->count, analysis_task, &job);
+
+    fftPlanFree(&plan);
+    SDL_free(window);
+
+    // 計算できなかった区間が0のまま残るので、結果ごと捨てる（キャッシュにも書かない）
+    if (SDL_AtomicGet(&job.failed)) {
+        SDL_Log("[musicAnalysis] out of memory during analysis");
+        musicAnalysisFree(a);
+        return false;
+    }
+
+    // 帯域ごとに曲中の最大値で正規化
+    for (int b = 0; b < ANALYSIS_BAND_MAX; b++) {
+        float mx = 0.0f;
+        for (int i = 0; i < a->count; i++) {
+            if (a->band[b][i] > mx) mx = a->band[b][i];
+        }
+        if (mx > 0.0f) {
+            float inv = 1.0f / mx;
+            for (int i = 0; i < a->count; i++) a->band[b][i] *= inv;
+        }
+    }
+
+    // ピークピラミッド（2点ずつまとめる）
+    for (int l = 1; l < a->levels; l++) {
+        int pc = a->peakCount[l - 1];
+        for (int i = 0; i < a->peakCount[l]; i++) {
+            int j = i * 2;
+            float mn = a->peakMin[l - 1][j];
+            float mx = a->peakMax[l - 1][j];
+            if (j + 1 < pc) {
+                if (a->peakMin[l - 1][j + 1] < mn) mn = a->peakMin[l - 1][j + 1];
+                if (a->peakMax[l - 1][j + 1] > mx) mx = a->peakMax[l - 1][j + 1];
+            }
+            a->peakMin[l][i] = mn;
+            a->peakMax[l][i] = mx;
+        }
+    }
+
+    double ms = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    SDL_Log("[musicAnalysis] %d points, %d levels in %.1f ms (%d threads)", a->count, a->levels, ms, threads);
+    return true;
+}
+
+static bool analysis_read(SDL_RWops* io, float* dst, int count) {
+    size_t bytes = (size_t)count * sizeof(float);
+    return SDL_RWread(io, dst, 1, bytes) == bytes;
+}
+
+static bool analysis_write(SDL_RWops* io, const float* src, int count) {
+    size_t bytes = (size_t)count * sizeof(float);
+    return SDL_RWwrite(io, src, 1, bytes) == bytes;
+}
+
+/**
+* @brief 解析結果をキャッシュファイルから読み込む
+*/
+static bool analysis_load(MusicAnalysis* a, const char* path, uint32_t hash, int freq) {
+    SDL_RWops* io = SDL_RWFromFile(path, "rb");
+    if (!io) return false;
+
+    AnalysisCacheHeader h;
+    if (SDL_RWread(io, &h, 1, sizeof(h)) != sizeof(h) ||
+        h.magic != ANALYSIS_CACHE_MAGIC || h.version != ANALYSIS_CACHE_VERSION ||
+        h.hash != hash || h.freq != freq || h.bands != ANALYSIS_BAND_MAX || h.count <= 0) {
+        SDL_RWclose(io);
+        return false;
+    }
+
+    SDL_zerop(a);
+    a->freq = h.freq;
+    a->hop = h.hop;
+    a->count = h.count;
+    a->hash = h.hash;
+    a->hasOffset = h.hasOffset != 0;
+    a->offsetMidiHash = h.offsetMidiHash;
+    a->offsetMs = h.offsetMs;
+    a->offsetConfidence = h.offsetConfidence;
+    bool ok = analysis_alloc(a) && a->levels == h.levels && analysis_read(io, a->rms, a->count);
+    for (int b = 0; ok && b < ANALYSIS_BAND_MAX; b++) {
+        ok = analysis_read(io, a->band[b], a->count);
+    }
+    for (int l = 0; ok && l < a->levels; l++) {
+        ok = analysis_read(io, a->peakMin[l], a->peakCount[l]) &&
+            analysis_read(io, a->peakMax[l], a->peakCount[l]);
+    }
+    SDL_RWclose(io);
+
+    if (!ok) musicAnalysisFree(a);
+    return ok;
+}
+
+/**
+* @brief 解析結果をキャッシュファイルに保存する
+*
+* @param a 解析結果
+* @param path 保存先
+* @return 保存できたらtrue
+*/
+bool musicAnalysisSave(const MusicAnalysis* a, const char* path) {
+    if (!a || !a->rms || !path) return false;
+    SDL_RWops* io = SDL_RWFromFile(path, "wb");
+    if (!io) return false;
+
+    AnalysisCacheHeader h;
+    SDL_zero(h);
+    h.magic = ANALYSIS_CACHE_MAGIC;
+    h.version = ANALYSIS_CACHE_VERSION;
+    h.freq = a->freq;
+    h.hop = a->hop;
+    h.count = a->count;
+    h.hash = a->hash;
+    h.levels = a->levels;
+    h.hasOffset = a->hasOffset ? 1 : 0;
+    h.offsetMidiHash = a->offsetMidiHash;
+    h.offsetMs = a->offsetMs;
+    h.offsetConfidence = a->offsetConfidence;
+    h.bands = ANALYSIS_BAND_MAX;
+
+    bool ok = SDL_RWwrite(io, &h, 1, sizeof(h)) == sizeof(h) && analysis_write(io, a->rms, a->count);
+    for (int b = 0; ok && b < ANALYSIS_BAND_MAX; b++) {
+        ok = analysis_write(io, a->band[b], a->count);
+    }
+    for (int l = 0; ok && l < a->levels; l++) {
+        ok = analysis_write(io, a->peakMin[l], a->peakCount[l]) &&
+            analysis_write(io, a->peakMax[l], a->peakCount[l]);
+    }
+    SDL_RWclose(io);
+    return ok;
+}
+
+/**
+* @brief キャッシュがあれば読み込み、なければ解析して保存する
+*
+* @param cachePath キャッシュファイル（NULLなら毎回解析）
+*/
+bool musicAnalysisLoadOrBuild(MusicAnalysis* a, const float* music, int64_t frames, int channels, int freq, const char* cachePath) {
+    if (!music || frames <= 0 || channels <= 0) return false;
+
+    uint32_t hash = analysis_hash(music, frames, channels, freq);
+    if (cachePath && analysis_load(a, cachePath, hash, freq)) {
+        SDL_Log("[musicAnalysis] loaded %s", cachePath);
+        return true;
+    }
+
+    if (!musicAnalysisBuild(a, music, frames, channels, freq)) return false;
+
+    if (cachePath && !musicAnalysisSave(a, cachePath)) {
+        SDL_Log("[musicAnalysis] cannot save %s", cachePath);
+    }
+    return true;
+}
+
+/**
+* @brief 解析結果の破棄
+*/
+void musicAnalysisFree(MusicAnalysis* a) {
+    if (!a) return;
+    SDL_free(a->rms);
+    for (int b = 0; b < ANALYSIS_BAND_MAX; b++) SDL_free(a->band[b]);
+    for (int l = 0; l < ANALYSIS_PEAK_LEVELS; l++) {
+        SDL_free(a->peakMin[l]);
+        SDL_free(a->peakMax[l]);
+    }
+    SDL_zerop(a);
+}
+
+/**
+* @brief 解析点の系列を指定フレームで線形補間して引く
+*/
+static float analysis_sample(const MusicAnalysis* a, const float* v, int64_t frame) {
+    if (!v || a->count <= 0) return 0.0f;
+    // 解析点iは区間[i*hop, (i+1)*hop)の中心を表す
+    float x = ((float)frame - (float)a->hop * 0.5f) / (float)a->hop;
+    if (x <= 0.0f) return v[0];
+    int i = (int)x;
+    if (i >= a->count - 1) return v[a->count - 1];
+    float t = x - (float)i;
+    return v[i] + (v[i + 1] - v[i]) * t;
+}
+
+/**
+* @brief 指定フレームのRMS
+*/
+float musicAnalysisRms(const MusicAnalysis* a, int64_t frame) {
+    return a ? analysis_sample(a, a->rms, frame) : 0.0f;
+}
+
+/**
+* @brief 指定フレームの帯域エネルギー（0～1）
+*/
+float musicAnalysisBand(const MusicAnalysis* a, AnalysisBand band, int64_t frame) {
+    if (!a || band < 0 || band >= ANALYSIS_BAND_MAX) return 0.0f;
+    return analysis_sample(a, a->band[band], frame);
+}
+
+/**
+* @brief 指定フレームを含む区間の波形の最小/最大
+*
+* @param level ピラミッドの段（0でhopフレーム、1段ごとに区間が倍）
+*/
+void musicAnalysisPeak(const MusicAnalysis* a, int level, int64_t frame, float* outMin, float* outMax) {
+    float mn = 0.0f, mx = 0.0f;
+    if (a && a->levels > 0 && frame >= 0) {
+        if (level < 0) level = 0;
+        if (level >= a->levels) level = a->levels - 1;
+        int64_t i = frame / ((int64_t)a->hop << level);
+        if (i < a->peakCount[level]) {
+            mn = a->peakMin[level][i];
+            mx = a->peakMax[level][i];
+        }
+    }
+    if (outMin) *outMin = mn;
+    if (outMax) *outMax = mx;
+}
@@ -0,0 +1,56 @@
+/**
+* @file musicAnalysis.h
+* @brief 曲の事前解析ヘッダ
+*
+* 読み込み時に曲全体を解析し、音量エンベロープ・波形ピーク・帯域エネルギーを
+* 約100Hzの解像度で保持する。描画側は再生位置からO(1)で値を引ける
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ANALYSIS_RATE           100     ///< 解析の解像度(Hz)
+#define ANALYSIS_FFT_SIZE       1024    ///< 帯域エネルギー用のFFTサイズ
+#define ANALYSIS_PEAK_LEVELS    16      ///< ピークピラミッドの最大段数
+
+/**
+* @brief 帯域の種類
+*/
+typedef enum {
+    ANALYSIS_BAND_LOW,      ///< 低域（～150Hz、キック・ベース）
+    ANALYSIS_BAND_LOWMID,   ///< 中低域（150～600Hz）
+    ANALYSIS_BAND_HIGHMID,  ///< 中高域（600～4kHz）
+    ANALYSIS_BAND_HIGH,     ///< 高域（4kHz～、ハイハット等）
+    ANALYSIS_BAND_MAX
+} AnalysisBand;
+
+/**
+* @brief 解析結果
+*/
+typedef struct {
+    int freq;                               ///< 曲のサンプリング周波数
+    int hop;                                ///< 解析1点あたりのフレーム数
+    int count;                              ///< 解析点の数
+    uint32_t hash;                          ///< 曲データのハッシュ（キャッシュ照合用）
+    float* rms;                             ///< RMSエンベロープ [count]
+    float* band[ANALYSIS_BAND_MAX];         ///< 帯域エネルギー（曲中の最大で0～1に正規化）[count]
+    int levels;                             ///< ピークピラミッドの段数
+    int peakCount[ANALYSIS_PEAK_LEVELS];    ///< 段ごとの点数（段lは2^l点を1点にまとめる）
+    float* peakMin[ANALYSIS_PEAK_LEVELS];   ///< 段ごとの最小値
+    float* peakMax[ANALYSIS_PEAK_LEVELS];   ///< 段ごとの最大値
+
+    // MIDIとのずれの推定結果（offsetEstimate）
+    bool hasOffset;                         ///< 推定済みか
+    uint32_t offsetMidiHash;                ///< 推定に使ったMIDIのハッシュ
+    double offsetMs;                        ///< audioOffsetMsとして使う値
+    float offsetConfidence;
+} MusicAnalysis;
+
+bool musicAnalysisBuild(MusicAnalysis* a, const float* music, int64_t frames, int channels, int freq);
+bool musicAnalysisLoadOrBuild(MusicAnalysis* a, const float* music, int64_t frames, int channels, int freq, const char* cachePath);
+bool musicAnalysisSave(const MusicAnalysis* a, const char* path);
+void musicAnalysisFree(MusicAnalysis* a);
+float musicAnalysisRms(const MusicAnalysis* a, int64_t frame);
+float musicAnalysisBand(const MusicAnalysis* a, AnalysisBand band, int64_t frame);
+void musicAnalysisPeak(const MusicAnalysis* a, int level, int64_t frame, float* outMin, float* outMax);
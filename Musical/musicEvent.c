@@ -1,11 +1,91 @@
 #include "musicEvent.h"
+#include "audioProfiler.h"
+#include "offsetEstimate.h"
+#include "chartDraft.h"
+#include "threadPolicy.h"
+#include "timebase.h"
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define AUDIO_BUFFER_SAVE_PATH  "save/audio_buffer.txt"
+#define LATENCY_SAVE_PATH       "save/output_latency.txt"
+#define CLICK_HZ                1000.0f // キャリブレーション用クリックの音程
+#define CLICK_MS                30      // クリックの長さ
+#define ANALYSIS_CACHE_DIR      "save/"
+#define AUDIO_CB_WARMUP         8       // 再オープン直後は間隔が乱れるので捨てる
+#define UNDERRUN_RATIO          1.75    // 周期の何倍空いたらアンダーランとみなすか
+#define BUFFER_STABLE_MS        10000   // この時間グリッチ無しならバッファを小さくしてみる
+#define PAUSE_CUTOFF_HZ         400.0f  // ポーズ時にこもらせるカットオフ
+#define PAUSE_SILENT_GAIN       0.001f  // フェードアウトがここまで下がったら止める
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MUSIC_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MUSIC_SIMD_NEON 1
+#endif
+
+/**
+* @brief 読み込んだ曲1つ分（プレイリストの先読みと差し替えに使う）
+*/
+typedef struct SongData {
+    int index;                  // プレイリスト上の位置
+    float* music;               // interleaved float32（MIDIのみならNULL）
+    int64_t frames;
+    MidiSong song;
+    bool midiOnly;
+    MusicAnalysis analysis;
+    double audioOffsetMs;
+} SongData;
+
+typedef struct {
+    char musicPath[PLAYLIST_PATH_MAX];
+    char midiPath[PLAYLIST_PATH_MAX];
+} PlaylistEntry;
+
+typedef struct {
+    int index;
+    unsigned generation;
+    char musicPath[PLAYLIST_PATH_MAX];
+    char midiPath[PLAYLIST_PATH_MAX];
+    SDL_AudioSpec spec;
+} PreloadRequest;
+
+typedef struct {
+    SDL_Thread* thread;
+    SDL_mutex* mtx;
+    SDL_cond* cv;
+    bool quit;
+    bool hasRequest;
+    bool busy;                  // 要求を出してから結果を置くまで
+    bool failed;                // 直前の読み込みが失敗した
+    unsigned generation;        // プレイリストを変えるたびに増やす（古い結果を捨てる）
+    PreloadRequest req;
+} PreloadWorker;
 
 static AppState st;
 static SDL_AudioSpec want;
+static Uint64 perfFreq;
 
 static Uint32 lastTitle = 0;
-static char info[256] = "";
+static char info[384] = "";
+static MusicAnalysis analysis;
+static int64_t analysisFrame;   // 解析値を引く再生位置（musicEventUpdateで更新）
+static bool dispatching;        // MIDIハンドラを呼んでいる間
+static double song_ms_at_counter(Uint64 at);
+static double dispatchMs;       // 呼んでいるイベントの曲位置(ms)
+
+// プレイリスト（メインスレッドだけが触る）
+static struct {
+    PlaylistEntry entry[PLAYLIST_MAX];
+    int count;
+    bool loop;
+    int preloadIndex;           // 先読みを要求した曲（-1で無し）
+    PreloadWorker worker;
+} playlist;
 
 static void dispatch_midi_note(AppState* st, const AppEvent* ev)
 {
@@ -24,7 +104,12 @@ static void dispatch_midi_note(AppState* st, const AppEvent* ev)
     }
 
     MidiTrackHandler h = st->midiTrackMap[ev->track];
-    if (h) h(st, ev->track, n, ev->vel, ev->on != 0);
+    if (!h) return;
+    // ハンドラの中ではmusicEventSongMsがイベントの時刻を返す（アニメーションをイベントに揃えられる）
+    dispatching = true;
+    dispatchMs = (double)ev->sample * 1000.0 / (double)st->spec.freq;
+    h(st, ev->track, n, ev->vel, ev->on != 0);
+    dispatching = false;
 }
 
 static void evq_push(EventQueue* q, AppEvent e) {
@@ -37,6 +122,21 @@ static void evq_push(EventQueue* q, AppEvent e) {
     SDL_AtomicUnlock(&q->lock);
 }
 
+/**
+* @brief 先頭のイベントが期限までに聞こえるものなら取り出す
+*/
+static bool evq_pop_due(EventQueue* q, Uint64 deadline, AppEvent* out) {
+    bool ok = false;
+    SDL_AtomicLock(&q->lock);
+    if (q->r != q->w && q->buf[q->r].due <= deadline) {
+        *out = q->buf[q->r];
+        q->r = (q->r + 1) % EVQ_CAP;
+        ok = true;
+    }
+    SDL_AtomicUnlock(&q->lock);
+    return ok;
+}
+
 static bool evq_pop(EventQueue* q, AppEvent* out) {
     bool ok = false;
     SDL_AtomicLock(&q->lock);
@@ -93,6 +193,31 @@ static bool load_wav_as_f32(const char* path, const SDL_AudioSpec* target, float
     return true;
 }
 
+/**
+* @brief 出力レイテンシ全体（バッファ1回分 + デバイス側）をPerformanceCounter単位で
+*/
+static Uint64 latency_counter(const AppState* st)
+{
+    double ms = st->outputLatencyMs + (double)st->bufferFrames * 1000.0 / (double)st->spec.freq;
+    if (ms < 0.0) ms = 0.0;
+    return (Uint64)(ms * (double)perfFreq / 1000.0);
+}
+
+/**
+* @brief 曲位置sampleのイベントが聞こえる時刻
+*
+* 現在のバッファ先頭（cbStartPos）からの距離を再生速度で割り、コールバック時刻とレイテンシを足す
+*/
+static Uint64 event_due(const AppState* st, int64_t sample)
+{
+    int64_t ahead = sample - st->cbStartPos;
+    if (ahead < 0 && st->musicLoop) ahead += st->musicFrames;
+    if (ahead < 0) ahead = 0;
+    double rate = (double)st->rateFixed / (double)PLAYBACK_RATE_ONE;
+    double sec = (double)ahead / ((double)st->spec.freq * rate);
+    return st->lastCbCounter + (Uint64)(sec * (double)perfFreq) + latency_counter(st);
+}
+
 static void push_midi_range(AppState* st, int64_t endSampleExclusive)
 {
     while (st->nextEvIndex < st->song.evCount &&
@@ -106,6 +231,7 @@ static void push_midi_range(AppState* st, int64_t endSampleExclusive)
         ae.note = e->note;
         ae.vel = e->vel;
         ae.sample = e->sample;
+        ae.due = event_due(st, e->sample);
         evq_push(&st->evq, ae);
         st->nextEvIndex++;
     }
@@ -121,57 +247,300 @@ static int64_t music_pos_with_audio_offset(const AppState* st)
     return pos;
 }
 
+/**
+* @brief 曲の終わり（WAVの最後のフレームの次）のMIDI側の位置
+*
+* ループの折り返しとプレイリストの差し替えはどちらもここで行う。
+* オフセットが曲の長さを超えるような値でもMIDI側が負や2周目の終わりを超えないよう、[1, 2L)に収める
+*/
+static int64_t song_end_pos(const AppState* st)
+{
+    int64_t L = st->musicFrames;
+    int64_t end = L - st->audioOffsetFrames;
+    if (end < 1) end = 1;
+    if (end > 2 * L - 1) end = 2 * L - 1;
+    return end;
+}
+
 static int64_t music_pos_for_midi(const AppState* st)
 {
+    // プレイリストで差し替えた直後は、新しい曲の先頭より前（負）になることがある
     int64_t pos = st->musicPos;
-    if (st->musicLoop && st->musicFrames > 0) {
-        pos %= st->musicFrames;
-        if (pos < 0) pos += st->musicFrames;
+    if (st->musicLoop && st->musicFrames > 0 && pos >= song_end_pos(st)) {
+        pos -= st->musicFrames;
     }
     return pos;
 }
 
-static void audio_cb(void* userdata, Uint8* stream, int len)
+/**
+* @brief コールバック間隔からアンダーランを検出する
+*
+* 前回コールバックからの経過時間がバッファ周期を大きく超えていたら、
+* デバイス側のバッファが空になった（グリッチした）とみなす
+*/
+static void measure_callback_interval(AppState* st, int frames, Uint64 now)
 {
-    AppState* st = (AppState*)userdata;
+    Uint64 last = st->lastCbCounter;
+    st->lastCbCounter = now;
+    st->cbCount++;
+
+    if (last == 0 || perfFreq == 0) return;
+    if (st->cbWarmup > 0) {
+        st->cbWarmup--;
+        return;
+    }
+
+    double ms = (double)(now - last) * 1000.0 / (double)perfFreq;
+    double periodMs = (double)frames * 1000.0 / (double)st->spec.freq;
+    st->lastCbIntervalMs = ms;
+    if (ms > st->maxCbIntervalMs) st->maxCbIntervalMs = ms;
+    if (ms > periodMs * UNDERRUN_RATIO) {
+        st->underrunAt[st->underrunCount % UNDERRUN_TOLERANCE] = now;
+        st->underrunCount++;
+    }
+}
+
+/**
+* @brief 曲の指定フレームの値（範囲外はループ時は折り返し、そうでなければ0）
+*/
+static float music_frame_sample(const AppState* st, int64_t frame, int c)
+{
+    if (frame < 0 || frame >= st->musicFrames) {
+        if (!st->musicLoop || st->musicFrames <= 0) return 0.0f;
+        frame %= st->musicFrames;
+        if (frame < 0) frame += st->musicFrames;
+    }
+    return st->music[frame * st->spec.channels + c];
+}
+
+/**
+* @brief pos + frac/2^32 の位置を3次（Catmull-Rom）補間して1フレーム分求める
+*
+* ステレオで範囲内なら、4フレーム×2chを2本のベクトルで一度に畳み込む
+*/
+static void resample_frame(const AppState* st, int64_t pos, uint32_t frac, float* out)
+{
+    int ch = st->spec.channels;
+    float t = (float)frac * (1.0f / 4294967296.0f);
+    float t2 = t * t;
+    float t3 = t2 * t;
+    float w0 = -0.5f * t3 + t2 - 0.5f * t;
+    float w1 = 1.5f * t3 - 2.5f * t2 + 1.0f;
+    float w2 = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+    float w3 = 0.5f * t3 - 0.5f * t2;
+
+    if (ch == 2 && pos >= 1 && pos + 2 < st->musicFrames) {
+        const float* p = st->music + (pos - 1) * 2;
+#if MUSIC_SIMD_SSE
+        __m128 a = _mm_loadu_ps(p);         // L-1 R-1 L0 R0
+        __m128 b = _mm_loadu_ps(p + 4);     // L1  R1  L2 R2
+        __m128 s = _mm_add_ps(
+            _mm_mul_ps(a, _mm_set_ps(w1, w1, w0, w0)),
+            _mm_mul_ps(b, _mm_set_ps(w3, w3, w2, w2)));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        _mm_storel_pi((__m64*)out, s);
+#elif MUSIC_SIMD_NEON
+        const float wa[4] = { w0, w0, w1, w1 };
+        const float wb[4] = { w2, w2, w3, w3 };
+        float32x4_t s = vmlaq_f32(vmulq_f32(vld1q_f32(p), vld1q_f32(wa)), vld1q_f32(p + 4), vld1q_f32(wb));
+        vst1_f32(out, vadd_f32(vget_low_f32(s), vget_high_f32(s)));
+#else
+        out[0] = w0 * p[0] + w1 * p[2] + w2 * p[4] + w3 * p[6];
+        out[1] = w0 * p[1] + w1 * p[3] + w2 * p[5] + w3 * p[7];
+#endif
+        return;
+    }
+
+    for (int c = 0; c < ch; c++) {
+        out[c] =
+            w0 * music_frame_sample(st, pos - 1, c) +
+            w1 * music_frame_sample(st, pos, c) +
+            w2 * music_frame_sample(st, pos + 1, c) +
+            w3 * music_frame_sample(st, pos + 2, c);
+    }
+}
+
+/**
+* @brief キャリブレーション用のクリックだけを鳴らす（曲とイベントは止める）
+*
+* 各クリックの出力時刻（コールバック時刻 + バッファ内の位置）をリングに記録する
+*/
+static void render_click_track(AppState* st, float* out, int frames)
+{
+    int ch = st->spec.channels;
+    int64_t clickLen = (int64_t)st->spec.freq * CLICK_MS / 1000;
+    float w = 2.0f * 3.14159265f * CLICK_HZ / (float)st->spec.freq;
+    float decay = 1.0f / (0.004f * (float)st->spec.freq);
+
+    for (int i = 0; i < frames; i++) {
+        int64_t pos = st->clickCounter % st->clickInterval;
+        if (pos == 0) {
+            unsigned wi = (unsigned)SDL_AtomicGet(&st->clickWrite);
+            st->clickTimes[wi & (CLICK_RING - 1)] =
+                st->lastCbCounter + (Uint64)((double)i * (double)perfFreq / (double)st->spec.freq);
+            SDL_AtomicSet(&st->clickWrite, (int)(wi + 1));
+        }
+        if (pos < clickLen) {
+            float v = 0.6f * sinf(w * (float)pos) * expf(-(float)pos * decay);
+            for (int c = 0; c < ch; c++) out[i * ch + c] = v;
+        }
+        st->clickCounter++;
+    }
+}
+
+/**
+* @brief ポーズのフェードアウトで進んだ分を、ポーズ要求時の位置へ戻す
+*/
+static void rewind_to_pause_anchor(AppState* st)
+{
+    st->pauseTail = false;
+    st->musicPos = st->pauseAnchorPos;
+    st->musicFrac = st->pauseAnchorFrac;
+    st->nextEvIndex = lower_bound_note_by_sample(st->song.ev, st->song.evCount, st->musicPos);
+    st->synthEvIndex = st->nextEvIndex;
+    for (int i = 0; i < 128; i++) st->lastFiredSample[i] = -1;
+}
+
+/**
+* @brief MIDIのみの曲は全トラックを内蔵シンセで鳴らす
+*/
+static void apply_midi_only_synth(AppState* st, bool wasMidiOnly)
+{
+    if (st->midiOnly) {
+        for (int t = 0; t < st->song.trackCount && t < 128; t++) {
+            synthSetTrack(&st->synth, (uint8_t)t, true, SYNTH_PATCH_PIANO, 1.0f, 0.0f);
+        }
+    }
+    else if (wasMidiOnly) {
+        for (int t = 0; t < 128; t++) synthSetTrack(&st->synth, (uint8_t)t, false, SYNTH_PATCH_PIANO, 1.0f, 0.0f);
+    }
+}
 
-    float* out = (float*)stream;
+/**
+* @brief 曲の終わり（WAVの最後のフレームの次）でプレイリストの次の曲へ差し替える
+*
+* 新しい曲のWAVが先頭から鳴るよう、位置を曲の長さと前後のオフセットの分だけずらす（端数はそのまま）。
+* このバッファの残りの範囲のイベントは新しい曲から発行する。外した曲はretiredSongに置き、
+* 解放はメインスレッドに任せる
+*
+* @param frame バッファ内の位置
+* @param blockEndS 古い曲の位置でのこのバッファの終端
+* @return 新しい曲の位置でのこのバッファの終端
+*/
+static int64_t swap_to_next_song(AppState* st, SongData* next, int frame, int64_t blockEndS, bool emitEvents)
+{
+    int64_t newOffset = (int64_t)llround(next->audioOffsetMs * (double)st->spec.freq / 1000.0);
+    int64_t shift = st->musicFrames + newOffset - st->audioOffsetFrames;
+    bool wasMidiOnly = st->midiOnly;
+
+    float* music = st->music;
+    int64_t frames = st->musicFrames;
+    MidiSong song = st->song;
+    st->music = next->music;
+    st->musicFrames = next->frames;
+    st->song = next->song;
+    st->midiOnly = next->midiOnly;
+    next->music = music;
+    next->frames = frames;
+    next->song = song;
+
+    st->audioOffsetMs = next->audioOffsetMs;
+    st->audioOffsetFrames = newOffset;
+    st->playlistIndex = next->index;
+    st->musicPos -= shift;
+    st->cbStartPos -= shift;
+    st->pauseAnchorPos -= shift;
+
+    st->nextEvIndex = lower_bound_note_by_sample(st->song.ev, st->song.evCount, st->musicPos);
+    st->synthEvIndex = st->nextEvIndex;
+    synthQueueAllNotesOff(&st->synth, frame);
+    apply_midi_only_synth(st, wasMidiOnly);
+    for (int i = 0; i < 128; i++) st->lastFiredSample[i] = -1;
+
+    int64_t end = blockEndS - shift;
+    if (emitEvents) push_midi_range(st, end);
+
+    SDL_AtomicSetPtr((void**)&st->nextSong, NULL);
+    SDL_AtomicSetPtr((void**)&st->retiredSong, next);
+    return end;
+}
+
+/**
+* @brief 1バッファ分のミックスとMIDIイベントの発行
+*
+* 再生速度が1以外のときは曲を補間しながら読み進める。
+* 速度の変更はバッファ内で線形に目標値へ近づけるので、途中で切り替えても音が飛ばない。
+* MIDIイベントは、このバッファで読み進める曲側の範囲（ソースのサンプル位置）で発行する。
+* プレイリストの次の曲が読み込み済みなら、曲の終わりでループせずに差し替える
+*/
+static void mix_audio(AppState* st, float* out, int frames)
+{
     int ch = st->spec.channels;
-    int frames = len / (int)(sizeof(float) * ch);
 
-    SDL_memset(out, 0, len);
+    SDL_memset(out, 0, (size_t)frames * ch * sizeof(float));
+
+    if (st->clickActive) {
+        render_click_track(st, out, frames);
+        return;
+    }
 
-    if (st->paused) {
+    if (st->paused && !st->pauseTail) {
         return;
     }
+    // ポーズのフェードアウト中は曲だけ鳴らし、イベントは出さない
+    bool emitEvents = !st->pauseTail;
+    int duckTrack = SDL_AtomicGet(&st->duckTrack);
+
+    // 1フレームごとの増分（32.32固定小数点）はrate + step*i
+    int64_t rate = (int64_t)st->rateFixed;
+    int64_t step = ((int64_t)st->targetRateFixed - rate) / frames;
+    int64_t advance = (int64_t)frames * rate + step * (int64_t)frames * (frames - 1) / 2;
+    bool resample = rate != (int64_t)PLAYBACK_RATE_ONE || step != 0 || st->musicFrac != 0;
+    SongData* next = (SongData*)SDL_AtomicGetPtr((void**)&st->nextSong);
+    int64_t endS;
 
     {
         int64_t startS = music_pos_for_midi(st);
-        int64_t endS = startS + (int64_t)frames;
+        st->cbStartPos = startS;
+        endS = startS + (int64_t)(((uint64_t)st->musicFrac + (uint64_t)advance) >> 32);
         int64_t L = (int64_t)st->musicFrames;
 
-        if (st->music && st->musicFrames > 0 && st->song.evCount > 0) {
-            if (!st->musicLoop || L <= 0 || endS < L) {
+        if (emitEvents && L > 0 && st->song.evCount > 0) {
+            int64_t songEnd = song_end_pos(st);
+            if (next) {
+                // 差し替える位置より後のイベントは出さない（残りは差し替え時に新しい曲から出す）
+                push_midi_range(st, endS < songEnd ? endS : songEnd);
+            }
+            else if (!st->musicLoop || endS < songEnd) {
                 push_midi_range(st, endS);
             }
             else {
-                push_midi_range(st, L);
-                st->nextEvIndex = 0;
-
-                int64_t wrapEnd = endS - L;
-                if (wrapEnd < 0) wrapEnd = 0;
-                push_midi_range(st, wrapEnd);
+                // 折り返すとMIDI側は曲の長さだけ戻る
+                push_midi_range(st, songEnd);
+                st->nextEvIndex = lower_bound_note_by_sample(st->song.ev, st->song.evCount, songEnd - L);
+                push_midi_range(st, endS - L);
             }
         }
     }
 
+    int64_t inc = rate;
+    int64_t songEnd = song_end_pos(st);
     for (int i = 0; i < frames; i++) {
-        bool musicOk = (st->music && st->musicFrames > 0);
+        bool musicOk = st->musicFrames > 0;
         int64_t musicCurPos = music_pos_with_audio_offset(st);
-        if (musicOk && st->musicPos >= st->musicFrames) {
+        // 曲の終わりでは、次の曲があれば差し替え、無ければループする
+        if (next && musicOk && st->musicPos >= songEnd) {
+            endS = swap_to_next_song(st, next, i, endS, emitEvents);
+            next = NULL;
+            songEnd = song_end_pos(st);
+            musicCurPos = music_pos_with_audio_offset(st);
+        }
+        if (musicOk && st->musicPos >= songEnd) {
             if (st->musicLoop) {
-                st->musicPos = 0;
-                st->nextEvIndex = 0;
+                // WAVが先頭から鳴るように曲の長さだけ戻す（発行するイベントはバッファの先頭で折り返し済み）
+                st->musicPos -= st->musicFrames;
+                st->synthEvIndex = lower_bound_note_by_sample(st->song.ev, st->song.evCount, st->musicPos);
+                synthQueueAllNotesOff(&st->synth, i);
                 for (int j = 0; j < 128; j++) st->lastFiredSample[j] = -1;
                 musicCurPos = music_pos_with_audio_offset(st);
             }
@@ -180,36 +549,249 @@ static void audio_cb(void* userdata, Uint8* stream, int len)
             }
         }
 
+        float frame[8] = { 0 };
+        bool inRange = musicOk && st->music && musicCurPos >= 0 && musicCurPos < st->musicFrames;
+        if (inRange && resample && ch <= 8) {
+            resample_frame(st, musicCurPos, st->musicFrac, frame);
+        }
+
         for (int c = 0; c < ch; c++) {
             float v = 0.0f;
-            if (musicOk && musicCurPos < st->musicFrames) {
-                v += st->music[musicCurPos * ch + c] * st->musicGain;
+            if (inRange) {
+                float src = (resample && c < 8) ? frame[c] : st->music[musicCurPos * ch + c];
+                v += src * st->musicGain;
             }
-            if (v > 1.0f) v = 1.0f;
-            if (v < -1.0f) v = -1.0f;
             out[i * ch + c] = v;
         }
 
-        if (musicOk && st->musicPos < st->musicFrames) {
-            st->musicPos++;
+        if (musicOk) {
+            // このフレームまでに来たノートをシンセへ（曲側のサンプル位置で判定）
+            while (emitEvents && st->synthEvIndex < st->song.evCount &&
+                st->song.ev[st->synthEvIndex].sample <= st->musicPos) {
+                const MidiNoteEvent* e = &st->song.ev[st->synthEvIndex++];
+                synthQueueNote(&st->synth, i, e->track, e->note, e->vel, e->on != 0);
+                if (e->on && e->vel > 0 && e->track == duckTrack) {
+                    dspChainTriggerSidechain(&st->dsp, i);
+                }
+            }
+            if (resample) {
+                uint64_t acc = (uint64_t)st->musicFrac + (uint64_t)inc;
+                st->musicPos += (int64_t)(acc >> 32);
+                st->musicFrac = (uint32_t)acc;
+                inc += step;
+            }
+            else {
+                st->musicPos++;
+            }
         }
     }
+    st->rateFixed = st->targetRateFixed;
+
+    synthRender(&st->synth, out, frames, ch, st->synthGain);
+    if (ch == 2) {
+        dspChainProcess(&st->dsp, out, frames);
+    }
+
+    if (st->pauseTail && (ch != 2 || dspChainCurrentGain(&st->dsp) < PAUSE_SILENT_GAIN)) {
+        rewind_to_pause_anchor(st);
+    }
+
+    for (int i = 0; i < frames * ch; i++) {
+        if (out[i] > 1.0f) out[i] = 1.0f;
+        if (out[i] < -1.0f) out[i] = -1.0f;
+    }
 }
 
-bool musicEventInit(const char* musicPath, const char* midiPath) {
-    SDL_zero(st);
-    st.musicLoop = true;
-    st.musicGain = 0.8f;
-    st.paused = false;
-    st.bpm = 188;
-    st.audioOffsetMs = 0.0;
-    st.audioOffsetFrames = 0;
+static void audio_cb(void* userdata, Uint8* stream, int len)
+{
+    AppState* st = (AppState*)userdata;
+    Uint64 begin = SDL_GetPerformanceCounter();
+
+    int frames = len / (int)(sizeof(float) * st->spec.channels);
 
+    // デバイスを開き直すとスレッドも変わるので、開くたびに最初のコールバックで設定する
+    if (!st->cbThreadPolicy) {
+        threadPolicyApply(THREAD_ROLE_AUDIO);
+        st->cbThreadPolicy = true;
+    }
+
+    measure_callback_interval(st, frames, begin);
+    mix_audio(st, (float*)stream, frames);
+
+    audioProfilerRecord(begin, SDL_GetPerformanceCounter(), frames, st->spec.freq);
+}
+
+/**
+* @brief 既定の出力デバイスを識別する文字列を作る（ドライバ名/デバイス名）
+*/
+static void build_device_key(char* out, size_t outSize)
+{
+    const char* driver = SDL_GetCurrentAudioDriver();
+    char* name = NULL;
+    SDL_AudioSpec spec;
+    if (SDL_GetDefaultAudioInfo(&name, &spec, 0) != 0) {
+        name = NULL;
+    }
+    SDL_snprintf(out, outSize, "%s/%s", driver ? driver : "unknown", name ? name : "default");
+    SDL_free(name);
+}
+
+/**
+* @brief 設定ファイルの1行から、先頭のfields個の値を飛ばしたデバイスのキーを返す
+*
+* 設定ファイルは1行1デバイスで「値... key」の形式（keyは空白を含んでもよい）
+*
+* @return 値が足りない行ならNULL
+*/
+static char* setting_line_key(char* line, int fields)
+{
+    char* p = line;
+    for (int i = 0; i < fields; i++) {
+        p += strspn(p, " \t");
+        size_t n = strcspn(p, " \t\r\n");
+        if (n == 0) return NULL;
+        p += n;
+    }
+    return p + strspn(p, " \t");
+}
+
+/**
+* @brief 設定ファイルからデバイスの行の値の部分を読む
+*
+* @param path 設定ファイル
+* @param key デバイスのキー
+* @param fields 1行の値の数
+* @param value 値の部分（空白区切りのまま、呼び出し側でsscanfする）
+* @param valueSize valueの大きさ
+* @return 見つからなければfalse
+*/
+static bool setting_load(const char* path, const char* key, int fields, char* value, size_t valueSize)
+{
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+
+    char line[512];
+    bool found = false;
+    while (fgets(line, sizeof(line), fp)) {
+        char* k = setting_line_key(line, fields);
+        if (!k) continue;
+        k[strcspn(k, "\r\n")] = '\0';
+        if (strcmp(k, key) != 0) continue;
+        size_t n = (size_t)(k - line);
+        if (n >= valueSize) n = valueSize - 1;
+        memcpy(value, line, n);
+        value[n] = '\0';
+        found = true;
+    }
+    fclose(fp);
+    return found;
+}
+
+/**
+* @brief 設定ファイルのデバイスの行を書き換える（他のデバイスの行はそのまま残す）
+*
+* @param path 設定ファイル
+* @param key デバイスのキー
+* @param fields 1行の値の数
+* @param value 値の部分（呼び出し側で書式を整えたもの）
+*/
+static void setting_save(const char* path, const char* key, int fields, const char* value)
+{
+    char* keep = NULL;
+    size_t keepLen = 0;
+
+    FILE* fp = fopen(path, "r");
+    if (fp) {
+        char line[512];
+        while (fgets(line, sizeof(line), fp)) {
+            char* k = setting_line_key(line, fields);
+            if (!k) continue;
+            size_t klen = strcspn(k, "\r\n");
+            if (klen == strlen(key) && strncmp(k, key, klen) == 0) continue;
+            size_t len = strlen(line);
+            char* p = (char*)realloc(keep, keepLen + len + 1);
+            if (!p) break;
+            keep = p;
+            memcpy(keep + keepLen, line, len + 1);
+            keepLen += len;
+        }
+        fclose(fp);
+    }
+
+    fp = fopen(path, "w");
+    if (!fp) {
+        SDL_Log("[musicEvent] cannot save %s", path);
+        free(keep);
+        return;
+    }
+    if (keep) fputs(keep, fp);
+    fprintf(fp, "%s %s\n", value, key);
+    fclose(fp);
+    free(keep);
+}
+
+/**
+* @brief 保存済みのバッファサイズを読み込む（1行は「samples floor key」）
+*/
+static bool load_buffer_setting(const char* key, int* outSamples, int* outFloor)
+{
+    char value[64];
+    int samples = 0, floor = 0;
+    if (!setting_load(AUDIO_BUFFER_SAVE_PATH, key, 2, value, sizeof(value)) ||
+        sscanf(value, "%d %d", &samples, &floor) < 2) {
+        return false;
+    }
+    *outSamples = samples;
+    *outFloor = floor;
+    return true;
+}
+
+/**
+* @brief 現在のバッファサイズをデバイスごとに保存する
+*/
+static void save_buffer_setting(const char* key, int samples, int floor)
+{
+    char value[64];
+    SDL_snprintf(value, sizeof(value), "%d %d", samples, floor);
+    setting_save(AUDIO_BUFFER_SAVE_PATH, key, 2, value);
+}
+
+/**
+* @brief 保存済みの出力レイテンシを読み込む（1行は「ms key」）
+*/
+static bool load_latency_setting(const char* key, double* outMs)
+{
+    char value[64];
+    double ms = 0.0;
+    if (!setting_load(LATENCY_SAVE_PATH, key, 1, value, sizeof(value)) || sscanf(value, "%lf", &ms) < 1) {
+        return false;
+    }
+    *outMs = ms;
+    return true;
+}
+
+/**
+* @brief 出力レイテンシをデバイスごとに保存する
+*/
+static void save_latency_setting(const char* key, double ms)
+{
+    char value[64];
+    SDL_snprintf(value, sizeof(value), "%.3f", ms);
+    setting_save(LATENCY_SAVE_PATH, key, 1, value);
+}
+
+/**
+* @brief 指定のバッファサイズでオーディオデバイスを開く
+*
+* 再生位置やイベントの状態はstに残っているので、開き直してもそのまま続きから鳴る
+*/
+static bool open_audio_device(int samples)
+{
     SDL_zero(want);
     want.freq = 44100;
     want.format = AUDIO_F32SYS;
     want.channels = 2;
-    want.samples = 256;
+    want.samples = (Uint16)samples;
     want.callback = audio_cb;
     want.userdata = &st;
 
@@ -219,26 +801,246 @@ bool musicEventInit(const char* musicPath, const char* midiPath) {
         return false;
     }
 
-    if (!load_wav_as_f32(musicPath, &st.spec, &st.music, &st.musicFrames)) {
-        SDL_Log("Failed to load music wav: %s", musicPath);
-        SDL_CloseAudioDevice(st.dev);
-        return false;
+    st.bufferFrames = st.spec.samples;
+    st.lastCbCounter = 0;
+    st.cbWarmup = AUDIO_CB_WARMUP;
+    st.cbThreadPolicy = false;
+    SDL_zeroa(st.underrunAt);
+    st.maxCbIntervalMs = 0.0;
+    st.lastCbIntervalMs = 0.0;
+    st.stableSinceMs = SDL_GetTicks();
+    return true;
+}
+
+/**
+* @brief バッファサイズを変えてオーディオデバイスを開き直す
+*/
+static bool reopen_audio_device(int samples)
+{
+    if (!st.dev) return false;
+
+    int prev = st.bufferFrames;
+    // 開き直してから最初のコールバックまでは、閉じる直前に聞こえていた位置で止めておく
+    st.heldSongMs = song_ms_at_counter(SDL_GetPerformanceCounter());
+    SDL_CloseAudioDevice(st.dev);
+    st.dev = 0;
+
+    if (!open_audio_device(samples)) {
+        if (!open_audio_device(prev)) return false;
+    }
+    st.reopenCount++;
+    SDL_PauseAudioDevice(st.dev, 0);
+
+    SDL_Log("[musicEvent] audio buffer %d -> %d frames", prev, st.bufferFrames);
+    return true;
+}
+
+/**
+* @brief 直近のアンダーランからバッファの次のサイズを決める（変えないならbufferFramesを返す）
+*
+* BUFFER_STABLE_MSの間にUNDERRUN_TOLERANCE回出ていたら倍（上限を超えていても倍の値を返す）に、
+* 最後のアンダーランと前回のサイズ変更からBUFFER_STABLE_MS経っていたら半分にしてみる。
+* 時刻の離れた1回ずつのアンダーランでは大きくしないし、小さくするのを止め続けることもない。
+* audio_cbと同時に呼ばないよう、呼ぶ側でデバイスをロックする
+*
+* @param now PerformanceCounter
+* @param nowMs SDL_GetTicks()
+*/
+static int next_buffer_frames(Uint64 now, Uint32 nowMs)
+{
+    int cur = st.bufferFrames;
+    Uint64 window = (Uint64)BUFFER_STABLE_MS * perfFreq / 1000;
+    int recent = 0;
+    Uint64 latest = 0;
+    for (int i = 0; i < UNDERRUN_TOLERANCE; i++) {
+        Uint64 at = st.underrunAt[i];
+        if (at == 0) continue;
+        if (now - at < window) recent++;
+        if (at > latest) latest = at;
+    }
+    if (recent >= UNDERRUN_TOLERANCE) return cur * 2;
+
+    bool stable = (latest == 0 || now - latest >= window) && nowMs - st.stableSinceMs >= BUFFER_STABLE_MS;
+    int smaller = cur / 2;
+    if (stable && smaller >= AUDIO_BUFFER_MIN && smaller > st.bufferFloor) return smaller;
+    return cur;
+}
+
+/**
+* @brief アンダーランの状況からバッファサイズを調整する
+*
+* グリッチが続いたら倍に、しばらく安定していたら半分にしてみる（next_buffer_frames）。
+* グリッチが出たサイズはfloorとして覚え、それ以下には下げない
+*/
+static void adapt_buffer_size(void)
+{
+    if (!st.adaptiveBuffer || !st.dev) return;
+
+    SDL_LockAudioDevice(st.dev);
+    int next = next_buffer_frames(SDL_GetPerformanceCounter(), SDL_GetTicks());
+    SDL_UnlockAudioDevice(st.dev);
+
+    int cur = st.bufferFrames;
+    if (next > cur) {
+        if (cur > st.bufferFloor) st.bufferFloor = cur;
+        if (next <= AUDIO_BUFFER_MAX && reopen_audio_device(next)) {
+            save_buffer_setting(st.deviceKey, st.bufferFrames, st.bufferFloor);
+        }
+        else {
+            // 大きくできなかったアンダーランで毎フレームやり直さない
+            SDL_LockAudioDevice(st.dev);
+            SDL_zeroa(st.underrunAt);
+            SDL_UnlockAudioDevice(st.dev);
+        }
+    }
+    else if (next < cur) {
+        if (reopen_audio_device(next)) {
+            save_buffer_setting(st.deviceKey, st.bufferFrames, st.bufferFloor);
+        }
+    }
+}
+
+/**
+* @brief AppStateを既定値で初期化する
+*/
+static void init_state_defaults(void)
+{
+    SDL_zero(st);
+    st.musicLoop = true;
+    st.musicGain = 0.8f;
+    st.paused = false;
+    st.bpm = 188;
+    st.audioOffsetMs = 0.0;
+    st.audioOffsetFrames = 0;
+    st.adaptiveBuffer = true;
+    st.rateFixed = st.targetRateFixed = PLAYBACK_RATE_ONE;
+    st.synthGain = 0.6f;
+    SDL_AtomicSet(&st.duckTrack, -1);
+}
+
+/**
+* @brief ANALYSIS_CACHE_DIR以下の解析キャッシュのパス
+*/
+static void build_cache_path(const char* musicPath, char* out, size_t outSize)
+{
+    const char* base = SDL_strrchr(musicPath, '/');
+    const char* base2 = SDL_strrchr(musicPath, '\\');
+    if (base2 > base) base = base2;
+    SDL_snprintf(out, outSize, ANALYSIS_CACHE_DIR "%s.analysis", base ? base + 1 : musicPath);
+}
+
+/**
+* @brief 曲とMIDIのずれを推定（キャッシュ済みならそれを使う）してaudioOffsetMsに反映する
+*
+* 曲のせいで推定できなかった場合もキャッシュに記録し、毎回やり直さないようにする。
+* メモリが取れなかっただけなら記録せず、既定のずれのまま次に読み込むときにやり直す
+*/
+static void apply_estimated_offset(SongData* d, const SDL_AudioSpec* spec, const char* cachePath)
+{
+    MusicAnalysis* a = &d->analysis;
+    uint32_t midiHash = offsetEstimateMidiHash(&d->song);
+    if (!a->hasOffset || a->offsetMidiHash != midiHash) {
+        OffsetEstimate est;
+        bool ok = offsetEstimate(d->music, d->frames, spec->channels, spec->freq, &d->song, 0.0, &est);
+        if (est.failed) return;
+        a->hasOffset = true;
+        a->offsetMidiHash = midiHash;
+        a->offsetMs = ok ? est.offsetMs : d->audioOffsetMs;
+        a->offsetConfidence = ok ? est.confidence : 0.0f;
+        if (!musicAnalysisSave(a, cachePath)) {
+            SDL_Log("[musicEvent] cannot save %s", cachePath);
+        }
     }
 
-    if (!load_midi_build_events(midiPath, st.spec.freq, &st.song)) {
+    if (a->offsetConfidence > 0.0f) {
+        d->audioOffsetMs = a->offsetMs;
+        SDL_Log("[musicEvent] estimated audioOffsetMs=%+0.2f (confidence %.1f)", d->audioOffsetMs, a->offsetConfidence);
+    }
+}
+
+/**
+* @brief specのフォーマットで曲とMIDIを読み込む（stには触れないのでワーカーからも呼べる）
+*
+* @param analyze trueなら解析とずれの推定も行う
+*/
+static bool decode_song(const char* musicPath, const char* midiPath, const SDL_AudioSpec* spec, bool analyze, SongData* d)
+{
+    SDL_zerop(d);
+    int frames = 0;
+    bool wavOk = musicPath && load_wav_as_f32(musicPath, spec, &d->music, &frames);
+    if (!wavOk) {
+        SDL_Log("Failed to load music wav: %s", musicPath ? musicPath : "(none)");
+        d->music = NULL;
+    }
+
+    bool midiOk = load_midi_build_events(midiPath, spec->freq, &d->song);
+    if (!midiOk) {
         SDL_Log("MIDI load failed");
+        if (!wavOk) return false;
+    }
+
+    d->audioOffsetMs = 840;
+    if (wavOk) {
+        d->frames = frames;
     }
     else {
-        st.nextEvIndex = lower_bound_note_by_sample(st.song.ev, st.song.evCount, (int64_t)st.musicPos);
+        // WAVが無ければMIDIのみ（WAV用のオフセットは不要）
+        d->midiOnly = true;
+        d->frames = d->song.lengthSamples + spec->freq;
+        d->audioOffsetMs = 0;
     }
 
+    if (analyze && d->music) {
+        char cachePath[512];
+        build_cache_path(musicPath, cachePath, sizeof(cachePath));
+        if (!musicAnalysisLoadOrBuild(&d->analysis, d->music, d->frames, spec->channels, spec->freq, cachePath)) {
+            SDL_Log("[musicEvent] music analysis failed");
+        }
+        else {
+            apply_estimated_offset(d, spec, cachePath);
+        }
+    }
+    return true;
+}
+
+static void free_song_data(SongData* d)
+{
+    if (!d) return;
+    SDL_free(d->music);
+    free_midi_song(&d->song);
+    musicAnalysisFree(&d->analysis);
+    SDL_zerop(d);
+}
+
+/**
+* @brief st.specのフォーマットで曲とMIDIを読み込み、イベント状態を初期化する
+*/
+static bool load_song(const char* musicPath, const char* midiPath, bool analyze)
+{
+    SongData d;
+    if (!decode_song(musicPath, midiPath, &st.spec, analyze, &d)) {
+        return false;
+    }
+
+    st.music = d.music;
+    st.musicFrames = d.frames;
+    st.song = d.song;
+    st.midiOnly = d.midiOnly;
+    musicAnalysisFree(&analysis);
+    analysis = d.analysis;
+
+    st.nextEvIndex = lower_bound_note_by_sample(st.song.ev, st.song.evCount, (int64_t)st.musicPos);
+    st.synthEvIndex = st.nextEvIndex;
+    synthInit(&st.synth, st.spec.freq);
+    dspChainInit(&st.dsp, st.spec.freq);
+    apply_midi_only_synth(&st, false);
+    if (st.midiOnly) SDL_Log("[musicEvent] MIDI only: %d tracks on the built-in synth", st.song.trackCount);
+
     SDL_zero(st.evq);
 
-    st.audioOffsetMs = 840;
+    st.audioOffsetMs = d.audioOffsetMs;
     st.audioOffsetFrames = (int64_t)llround(st.audioOffsetMs * (double)st.spec.freq / 1000.0);
 
-    SDL_PauseAudioDevice(st.dev, 0);
-
     for (int i = 0; i < 128; i++) {
         st.midiTrackMap[i] = NULL;
         st.midiTrackEnabled[i] = true;
@@ -246,7 +1048,406 @@ bool musicEventInit(const char* musicPath, const char* midiPath) {
     }
 
     st.debounceSamples = (int64_t)((double)st.spec.freq * 30.0 / 1000.0 + 0.5);
+    return true;
+}
+
+/**
+* @brief プレイリストの次の曲を読み込むスレッド
+*
+* 要求を1つずつ処理し、読み終えたものをst.nextSongに置く。
+* コールバックは曲の終わりでそれを受け取って差し替える
+*/
+static int preload_main(void* ud)
+{
+    PreloadWorker* w = (PreloadWorker*)ud;
+    threadPolicyApply(THREAD_ROLE_WORKER);
+    for (;;) {
+        SDL_LockMutex(w->mtx);
+        while (!w->quit && !w->hasRequest) {
+            SDL_CondWait(w->cv, w->mtx);
+        }
+        if (w->quit) {
+            SDL_UnlockMutex(w->mtx);
+            break;
+        }
+        PreloadRequest req = w->req;
+        w->hasRequest = false;
+        SDL_UnlockMutex(w->mtx);
+
+        Uint64 begin = SDL_GetPerformanceCounter();
+        SongData* d = (SongData*)SDL_malloc(sizeof(SongData));
+        bool ok = d && decode_song(req.musicPath[0] ? req.musicPath : NULL, req.midiPath, &req.spec, true, d);
+        if (ok) {
+            d->index = req.index;
+            SDL_Log("[playlist] preloaded #%d %s (%.1f ms)", req.index, req.musicPath,
+                (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+        }
+        else {
+            SDL_Log("[playlist] cannot load #%d %s", req.index, req.musicPath);
+        }
+
+        SDL_LockMutex(w->mtx);
+        // 読み込み中にプレイリストが変わっていたら捨てる
+        bool publish = ok && req.generation == w->generation;
+        if (publish) SDL_AtomicSetPtr((void**)&st.nextSong, d);
+        w->busy = false;
+        w->failed = !ok;
+        SDL_UnlockMutex(w->mtx);
+
+        if (!publish && d) {
+            if (ok) free_song_data(d);
+            SDL_free(d);
+        }
+    }
+    return 0;
+}
+
+static bool preload_start(PreloadWorker* w)
+{
+    w->mtx = SDL_CreateMutex();
+    w->cv = SDL_CreateCond();
+    if (!w->mtx || !w->cv) return false;
+    w->thread = SDL_CreateThread(preload_main, "MusicPreload", w);
+    if (!w->thread) {
+        SDL_Log("[playlist] cannot start preload thread: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+static void preload_stop(PreloadWorker* w)
+{
+    if (w->thread) {
+        SDL_LockMutex(w->mtx);
+        w->quit = true;
+        SDL_CondSignal(w->cv);
+        SDL_UnlockMutex(w->mtx);
+        SDL_WaitThread(w->thread, NULL);
+        w->thread = NULL;
+    }
+    if (w->cv) SDL_DestroyCond(w->cv);
+    if (w->mtx) SDL_DestroyMutex(w->mtx);
+    w->cv = NULL;
+    w->mtx = NULL;
+}
+
+/**
+* @brief 先読みした（または読み込み中の）曲を捨てる
+*/
+static void playlist_discard_preload(void)
+{
+    PreloadWorker* w = &playlist.worker;
+    if (w->mtx) {
+        SDL_LockMutex(w->mtx);
+        w->generation++;
+        w->hasRequest = false;
+        SDL_UnlockMutex(w->mtx);
+    }
+    // コールバックが使っている最中に外さないようロックする
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    SongData* d = (SongData*)SDL_AtomicSetPtr((void**)&st.nextSong, NULL);
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+    if (d) {
+        free_song_data(d);
+        SDL_free(d);
+    }
+    playlist.preloadIndex = -1;
+}
+
+/**
+* @brief curの次に再生する曲（無ければ-1）
+*/
+static int playlist_next_index(int cur)
+{
+    if (playlist.count <= 1 || cur < 0) return -1;
+    int next = cur + 1;
+    if (next >= playlist.count) next = playlist.loop ? 0 : -1;
+    return next;
+}
+
+/**
+* @brief 差し替えで外した曲を解放し、次の曲の先読みを要求する（メインスレッド）
+*/
+static void playlist_update(void)
+{
+    SongData* retired = (SongData*)SDL_AtomicSetPtr((void**)&st.retiredSong, NULL);
+    if (retired) {
+        // 解析結果も差し替えた曲のものにする
+        MusicAnalysis old = analysis;
+        analysis = retired->analysis;
+        retired->analysis = old;
+        free_song_data(retired);
+        SDL_free(retired);
+        playlist.preloadIndex = -1;
+        int cur = st.playlistIndex;
+        SDL_Log("[playlist] now playing #%d %s", cur, playlist.entry[cur].musicPath);
+    }
+
+    int next = playlist_next_index(st.playlistIndex);
+    if (next == playlist.preloadIndex) return;
+    if (playlist.preloadIndex >= 0) playlist_discard_preload();
+    if (next < 0) return;
+
+    PreloadWorker* w = &playlist.worker;
+    if (!w->thread && !preload_start(w)) {
+        preload_stop(w);
+        return;
+    }
+    SDL_LockMutex(w->mtx);
+    w->req.index = next;
+    w->req.generation = w->generation;
+    SDL_strlcpy(w->req.musicPath, playlist.entry[next].musicPath, PLAYLIST_PATH_MAX);
+    SDL_strlcpy(w->req.midiPath, playlist.entry[next].midiPath, PLAYLIST_PATH_MAX);
+    w->req.spec = st.spec;
+    w->hasRequest = true;
+    SDL_CondSignal(w->cv);
+    SDL_UnlockMutex(w->mtx);
+    playlist.preloadIndex = next;
+}
+
+bool musicEventInit(const char* musicPath, const char* midiPath) {
+    init_state_defaults();
+
+    perfFreq = SDL_GetPerformanceFrequency();
+    audioProfilerReset();
+
+    int samples = AUDIO_BUFFER_DEFAULT;
+    build_device_key(st.deviceKey, sizeof(st.deviceKey));
+    if (load_buffer_setting(st.deviceKey, &samples, &st.bufferFloor)) {
+        SDL_Log("[musicEvent] saved audio buffer for %s: %d frames", st.deviceKey, samples);
+    }
+    if (samples < AUDIO_BUFFER_MIN) samples = AUDIO_BUFFER_MIN;
+    if (samples > AUDIO_BUFFER_MAX) samples = AUDIO_BUFFER_MAX;
+    if (load_latency_setting(st.deviceKey, &st.outputLatencyMs)) {
+        SDL_Log("[musicEvent] saved output latency for %s: %.2f ms", st.deviceKey, st.outputLatencyMs);
+    }
+
+    if (!open_audio_device(samples)) {
+        return false;
+    }
+
+    if (!load_song(musicPath, midiPath, true)) {
+        SDL_CloseAudioDevice(st.dev);
+        st.dev = 0;
+        return false;
+    }
+    analysisFrame = 0;
+    timebaseSetMusicClock(musicEventSongMs, musicEventMsToBeat);
+
+    // 最初の曲をプレイリストの先頭にする
+    SDL_zero(playlist);
+    playlist.preloadIndex = -1;
+    SDL_strlcpy(playlist.entry[0].musicPath, musicPath, PLAYLIST_PATH_MAX);
+    SDL_strlcpy(playlist.entry[0].midiPath, midiPath, PLAYLIST_PATH_MAX);
+    playlist.count = 1;
+    st.playlistIndex = 0;
+
+    SDL_PauseAudioDevice(st.dev, 0);
+
+    return true;
+}
+
+static void wr_u16le(FILE* fp, uint16_t v) {
+    uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+    fwrite(b, 1, 2, fp);
+}
+static void wr_u32le(FILE* fp, uint32_t v) {
+    uint8_t b[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    fwrite(b, 1, 4, fp);
+}
+
+/**
+* @brief float32のWAVヘッダを書く（データ長は書き終わってから埋め直す）
+*/
+static void write_wav_header(FILE* fp, int channels, int freq, uint32_t dataBytes)
+{
+    fwrite("RIFF", 1, 4, fp);
+    wr_u32le(fp, 36 + dataBytes);
+    fwrite("WAVE", 1, 4, fp);
+    fwrite("fmt ", 1, 4, fp);
+    wr_u32le(fp, 16);
+    wr_u16le(fp, 3);                // WAVE_FORMAT_IEEE_FLOAT
+    wr_u16le(fp, (uint16_t)channels);
+    wr_u32le(fp, (uint32_t)freq);
+    wr_u32le(fp, (uint32_t)(freq * channels * sizeof(float)));
+    wr_u16le(fp, (uint16_t)(channels * sizeof(float)));
+    wr_u16le(fp, 32);
+    fwrite("data", 1, 4, fp);
+    wr_u32le(fp, dataBytes);
+}
+
+/**
+* @brief ループしない曲を終わりまでblockFramesずつミックスし、wavとlogへ書き出す
+*
+* 曲の終わりはMIDI側の位置（song_end_pos）で判定する。オフセットが正ならWAVの終わりはL - offsetで来て、
+* そこでmix_audioはmusicPosを進めなくなるので、musicFramesまで回すと終わらない。
+* 最後のブロックは曲の終わりまでで切るので、出力の長さはちょうどsong_end_posになる
+*
+* @param eventCount 発行したAppEventの数を足す
+* @return ミックスしたフレーム数
+*/
+static int64_t render_to_song_end(float* block, int blockFrames, FILE* wav, FILE* log, int64_t* eventCount)
+{
+    int ch = st.spec.channels;
+    int64_t rendered = 0;
+    int64_t end = song_end_pos(&st);
+    while (st.musicFrames > 0 && st.musicPos < end) {
+        int64_t before = st.musicPos;
+        int frames = (int)SDL_min((int64_t)blockFrames, end - st.musicPos);
+        mix_audio(&st, block, frames);
+        rendered += frames;
+
+        if (wav) fwrite(block, sizeof(float), (size_t)frames * ch, wav);
 
+        // ブロックごとに吸い出すのでEVQ_CAPを超えることはない
+        AppEvent ev;
+        while (evq_pop(&st.evq, &ev)) {
+            if (log) {
+                fprintf(log, "%lld\t%u\t%u\t%u\t%u\n",
+                    (long long)ev.sample, ev.track, ev.on, ev.note, ev.vel);
+            }
+            (*eventCount)++;
+        }
+        // 進まなくなったら（ポーズ中など）終える
+        if (st.musicPos == before) break;
+    }
+    return rendered;
+}
+
+/**
+* @brief オーディオデバイスを使わずに曲全体をレンダリングする
+*
+* audio_cbと同じmix_audio（push_midi_rangeを含む）をblockFramesずつ待ち無しで回し、
+* ミックス結果をfloat32のWAVに、発行したAppEventをテキストログに書き出す。
+* 曲はループさせず、musicPosがMIDI側の曲の終わり（song_end_pos）に達したら終了する
+*
+* @param musicPath 曲のWAV
+* @param midiPath 譜面のMIDI
+* @param wavPath 出力WAV（NULLなら書き出さない）
+* @param logPath イベントログ（NULLなら書き出さない）
+* @param blockFrames 1回のミックスで処理するフレーム数（<=0ならAUDIO_BUFFER_DEFAULT）
+* @return 成功したらtrue
+*/
+bool musicEventRenderOffline(const char* musicPath, const char* midiPath,
+    const char* wavPath, const char* logPath, int blockFrames)
+{
+    if (blockFrames <= 0) blockFrames = AUDIO_BUFFER_DEFAULT;
+
+    init_state_defaults();
+    st.musicLoop = false;
+    st.spec.freq = 44100;
+    st.spec.format = AUDIO_F32SYS;
+    st.spec.channels = 2;
+    st.spec.samples = (Uint16)blockFrames;
+    st.bufferFrames = blockFrames;
+
+    if (!load_song(musicPath, midiPath, false)) {
+        return false;
+    }
+
+    FILE* wav = NULL;
+    FILE* log = NULL;
+    if (wavPath) {
+        wav = fopen(wavPath, "wb");
+        if (!wav) SDL_Log("[render] cannot open %s", wavPath);
+        else write_wav_header(wav, st.spec.channels, st.spec.freq, 0);
+    }
+    if (logPath) {
+        log = fopen(logPath, "w");
+        if (!log) SDL_Log("[render] cannot open %s", logPath);
+        else fprintf(log, "# sample\ttrack\ton\tnote\tvel\n");
+    }
+
+    int ch = st.spec.channels;
+    float* block = (float*)SDL_malloc((size_t)blockFrames * ch * sizeof(float));
+    if (!block) {
+        if (wav) fclose(wav);
+        if (log) fclose(log);
+        free_midi_song(&st.song);
+        dspChainFree(&st.dsp);
+        SDL_free(st.music);
+        st.music = NULL;
+        return false;
+    }
+
+    int64_t eventCount = 0;
+    Uint64 begin = SDL_GetPerformanceCounter();
+    int64_t renderedFrames = render_to_song_end(block, blockFrames, wav, log, &eventCount);
+    uint64_t dataBytes = wav ? (uint64_t)renderedFrames * ch * sizeof(float) : 0;
+
+    double elapsedMs = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    double songMs = (double)renderedFrames * 1000.0 / (double)st.spec.freq;
+    SDL_Log("[render] %lld frames (%.1f s), %lld events in %.1f ms (x%.1f realtime, block=%d)",
+        (long long)renderedFrames, songMs / 1000.0, (long long)eventCount, elapsedMs,
+        elapsedMs > 0.0 ? songMs / elapsedMs : 0.0, blockFrames);
+
+    if (wav) {
+        fseek(wav, 0, SEEK_SET);
+        write_wav_header(wav, ch, st.spec.freq, (uint32_t)dataBytes);
+        fclose(wav);
+    }
+    if (log) fclose(log);
+
+    SDL_free(block);
+    free_midi_song(&st.song);
+    dspChainFree(&st.dsp);
+    SDL_free(st.music);
+    st.music = NULL;
+    return true;
+}
+
+/**
+* @brief 曲から譜面の下書きを作る
+*
+* 曲はゲームと同じload_wav_as_f32（44100Hz・ステレオのfloat32）で読み、
+* オンセットとテンポを検出してType-1のSMFに書き出す。書き出したものは
+* load_midi_build_eventsで読み直して確かめる
+*
+* @param musicPath 曲のWAV
+* @param midiPath 出力するMIDI
+* @param subdivision 1拍をいくつに分けたグリッドに寄せるか（0なら寄せない）
+* @return 成功したらtrue
+*/
+bool musicEventDraftChart(const char* musicPath, const char* midiPath, int subdivision)
+{
+    SDL_AudioSpec spec;
+    SDL_zero(spec);
+    spec.freq = 44100;
+    spec.format = AUDIO_F32SYS;
+    spec.channels = 2;
+
+    float* music = NULL;
+    int frames = 0;
+    Uint64 begin = SDL_GetPerformanceCounter();
+    if (!load_wav_as_f32(musicPath, &spec, &music, &frames)) {
+        return false;
+    }
+    double loadMs = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    ChartDraft draft;
+    bool ok = chartDraftBuild(&draft, music, frames, spec.channels, spec.freq);
+    SDL_free(music);
+    if (!ok) {
+        SDL_Log("[chart] analysis failed: %s", musicPath);
+        return false;
+    }
+
+    ok = chartDraftWriteSmf(&draft, midiPath, subdivision);
+    chartDraftFree(&draft);
+    if (!ok) {
+        SDL_Log("[chart] cannot write %s", midiPath);
+        return false;
+    }
+
+    MidiSong song;
+    if (!load_midi_build_events(midiPath, spec.freq, &song)) {
+        SDL_Log("[chart] written file does not load: %s", midiPath);
+        return false;
+    }
+    double totalMs = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    SDL_Log("[chart] %s: %d tracks, %d note events (%.1f s song, load %.1f ms, total %.1f ms)",
+        midiPath, song.trackCount, song.evCount, (double)frames / spec.freq, loadMs, totalMs);
+    free_midi_song(&song);
     return true;
 }
 
@@ -280,7 +1481,12 @@ void musicEventUpdate() {
     }
     else if (start) {
         st.musicPos = 0;
+        st.musicFrac = 0;
+        st.pauseAnchorPos = 0;
+        st.pauseAnchorFrac = 0;
         st.nextEvIndex = lower_bound_note_by_sample(st.song.ev, st.song.evCount, (int64_t)st.musicPos);
+        st.synthEvIndex = st.nextEvIndex;
+        synthAllNotesOff(&st.synth);
         for (int i = 0; i < 128; i++) st.lastFiredSample[i] = -1;
         st.evq.r = 0;
         st.evq.w = 0;
@@ -288,24 +1494,62 @@ void musicEventUpdate() {
     double audioOffsetMs = st.audioOffsetMs;
     int64_t frame = music_pos_with_audio_offset(&st);
     double sec = (double)frame / (double)st.spec.freq;
+    analysisFrame = music_pos_for_midi(&st);
     SDL_UnlockAudioDevice(st.dev);
 
+    audioProfilerPoll();
+    AudioProfileStats prof;
+    audioProfilerGetStats(&prof);
+
     SDL_snprintf(info, sizeof(info),
-        "AudioOffset: %+0.2f ms | Sec: %f | Frame: %lld | Music: %s (SPACE/START) | Restart: SELECT\n",
-        audioOffsetMs, sec, (long long)frame, st.paused ? "Paused" : "Playing");
+        "AudioOffset: %+0.2f ms | Sec: %f | Frame: %lld | Music: %s (SPACE/START) | Restart: SELECT\n"
+        "Audio load p50 %.0f%% p99 %.0f%% max %.0f%% | Buffer %d | Underrun %llu | Latency %.1f ms (L)\n",
+        audioOffsetMs, sec, (long long)frame, st.paused ? "Paused" : "Playing",
+        prof.p50 * 100.0f, prof.p99 * 100.0f, prof.max * 100.0f,
+        st.bufferFrames, (unsigned long long)st.underrunCount, musicEventGetBufferLatencyMs() + st.outputLatencyMs);
 
+    // 聞こえる時刻（から先読み分を引いた時刻）になったイベントだけ発行する
     AppEvent ev;
-    while (evq_pop(&st.evq, &ev)) {
+    Uint64 deadline = SDL_GetPerformanceCounter() + (Uint64)(st.eventLookaheadMs * (double)perfFreq / 1000.0);
+    while (evq_pop_due(&st.evq, deadline, &ev)) {
         if (ev.kind == EV_MIDI_NOTE) {
             dispatch_midi_note(&st, &ev);
         }
     }
+
+    adapt_buffer_size();
+    playlist_update();
+}
+
+/**
+* @brief ポーズ状態を切り替える（オーディオデバイスをロックして呼ぶ）
+*
+* ポーズ時はローパスを閉じながらフェードアウトし、消えたところで要求時の位置へ戻す。
+* 再開時はそこからローパスを開きながらフェードインする
+*/
+static void set_paused_locked(bool paused)
+{
+    if (paused == st.paused) return;
+    if (paused) {
+        st.pauseAnchorPos = st.musicPos;
+        st.pauseAnchorFrac = st.musicFrac;
+        st.pauseTail = true;
+        synthQueueAllNotesOff(&st.synth, 0);
+        dspChainSetParam(&st.dsp, DSP_PARAM_GAIN, 0.0f);
+        dspChainSetParam(&st.dsp, DSP_PARAM_CUTOFF, PAUSE_CUTOFF_HZ);
+    }
+    else {
+        if (st.pauseTail) rewind_to_pause_anchor(&st);
+        dspChainSetParam(&st.dsp, DSP_PARAM_GAIN, 1.0f);
+        dspChainSetParam(&st.dsp, DSP_PARAM_CUTOFF, 20000.0f);
+    }
+    st.paused = paused;
 }
 
 void musicEventSetPaused(bool paused) {
     if (!st.dev) return;
     SDL_LockAudioDevice(st.dev);
-    st.paused = paused;
+    set_paused_locked(paused);
     SDL_UnlockAudioDevice(st.dev);
 }
 
@@ -321,7 +1565,7 @@ bool musicEventIsPaused(void) {
 void musicEventTogglePaused(void) {
     if (!st.dev) return;
     SDL_LockAudioDevice(st.dev);
-    st.paused = !st.paused;
+    set_paused_locked(!st.paused);
     SDL_UnlockAudioDevice(st.dev);
 }
 
@@ -348,10 +1592,341 @@ void musicEventSetMidiTrackEnabled(uint8_t track, bool enabled) {
     if (st.dev) SDL_UnlockAudioDevice(st.dev);
 }
 
+void musicEventGetAudioBufferStats(AudioBufferStats* out) {
+    if (!out) return;
+    SDL_zerop(out);
+    if (!st.dev) return;
+    SDL_LockAudioDevice(st.dev);
+    out->bufferFrames = st.bufferFrames;
+    out->bufferFloor = st.bufferFloor;
+    out->periodMs = st.spec.freq > 0 ? (double)st.bufferFrames * 1000.0 / (double)st.spec.freq : 0.0;
+    out->lastIntervalMs = st.lastCbIntervalMs;
+    out->maxIntervalMs = st.maxCbIntervalMs;
+    out->callbacks = st.cbCount;
+    out->underruns = st.underrunCount;
+    out->reopenCount = st.reopenCount;
+    out->adaptive = st.adaptiveBuffer;
+    SDL_UnlockAudioDevice(st.dev);
+}
+
+void musicEventSetAdaptiveBuffer(bool enabled) {
+    st.adaptiveBuffer = enabled;
+    st.stableSinceMs = SDL_GetTicks();
+}
+
+bool musicEventSetAudioBufferFrames(int frames) {
+    if (!st.dev) return false;
+    if (frames < AUDIO_BUFFER_MIN) frames = AUDIO_BUFFER_MIN;
+    if (frames > AUDIO_BUFFER_MAX) frames = AUDIO_BUFFER_MAX;
+    if (frames == st.bufferFrames) return true;
+    if (!reopen_audio_device(frames)) return false;
+    save_buffer_setting(st.deviceKey, st.bufferFrames, st.bufferFloor);
+    return true;
+}
+
+/**
+* @brief 再生速度を設定する（練習用のスロー再生）
+*
+* 次のバッファの間に滑らかに切り替わる。MIDIイベントも同じ速度で発行される
+*
+* @param rate 再生速度（1.0で等速、PLAYBACK_RATE_MIN～PLAYBACK_RATE_MAX）
+*/
+void musicEventSetPlaybackRate(double rate) {
+    if (rate < PLAYBACK_RATE_MIN) rate = PLAYBACK_RATE_MIN;
+    if (rate > PLAYBACK_RATE_MAX) rate = PLAYBACK_RATE_MAX;
+    uint64_t fixed = (uint64_t)(rate * (double)PLAYBACK_RATE_ONE + 0.5);
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    st.targetRateFixed = fixed;
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+}
+
+double musicEventGetPlaybackRate(void) {
+    return (double)st.targetRateFixed / (double)PLAYBACK_RATE_ONE;
+}
+
+/**
+* @brief MIDIトラックを内蔵シンセで鳴らすかどうかと、その音色を設定する
+*
+* @param track MIDIトラック番号
+* @param enabled trueで発音
+* @param patch 音色
+* @param gain 音量
+* @param pan -1（左）～1（右）
+*/
+void musicEventSetSynthTrack(uint8_t track, bool enabled, SynthPatchId patch, float gain, float pan) {
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    synthSetTrack(&st.synth, track, enabled, patch, gain, pan);
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+}
+
+/**
+* @brief 内蔵シンセ全体の音量
+*/
+void musicEventSetSynthGain(float gain) {
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    st.synthGain = gain;
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+}
+
+/**
+* @brief キャリブレーション用のクリックトラックの開始/停止
+*
+* 鳴らしている間は曲とMIDIイベントは止まる
+*
+* @param intervalMs クリックの間隔(ms)
+*/
+void musicEventSetClickTrack(bool enabled, double intervalMs) {
+    if (!st.dev) return;
+    SDL_LockAudioDevice(st.dev);
+    st.clickActive = enabled;
+    st.clickCounter = 0;
+    st.clickInterval = (int64_t)(intervalMs * (double)st.spec.freq / 1000.0);
+    if (st.clickInterval < 1) st.clickInterval = 1;
+    SDL_UnlockAudioDevice(st.dev);
+}
+
+/**
+* @brief 前回から新しく鳴ったクリックの時刻を読み出す
+*
+* @param out 時刻（PerformanceCounter、出力バッファに書いた時点）
+* @param max outの要素数
+* @param cursor 読み出し位置（呼び出し側で保持、最初は0）
+* @return 読み出した数
+*/
+int musicEventReadClicks(Uint64* out, int max, unsigned* cursor) {
+    unsigned w = (unsigned)SDL_AtomicGet(&st.clickWrite);
+    if (w - *cursor > CLICK_RING) *cursor = w - CLICK_RING;
+    int n = 0;
+    while (*cursor != w && n < max) {
+        out[n++] = st.clickTimes[*cursor & (CLICK_RING - 1)];
+        (*cursor)++;
+    }
+    return n;
+}
+
+/**
+* @brief バッファ1回分の遅れ(ms)
+*/
+double musicEventGetBufferLatencyMs(void) {
+    if (st.spec.freq <= 0) return 0.0;
+    return (double)st.bufferFrames * 1000.0 / (double)st.spec.freq;
+}
+
+/**
+* @brief デバイス側の出力レイテンシを設定する
+*
+* @param deviceMs バッファ1回分を除いた遅れ(ms)
+* @param save trueならデバイスごとに保存する
+*/
+void musicEventSetOutputLatency(double deviceMs, bool save) {
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    st.outputLatencyMs = deviceMs;
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+    if (save) save_latency_setting(st.deviceKey, deviceMs);
+}
+
+double musicEventGetOutputLatency(void) {
+    return st.outputLatencyMs;
+}
+
+/**
+* @brief MIDIイベントを聞こえる時刻よりどれだけ早く発行するか
+*
+* 0なら音と同時。アニメーションを先に動かしたい場合などに使う
+*/
+void musicEventSetEventLookahead(double ms) {
+    st.eventLookaheadMs = ms;
+}
+
+/**
+* @brief 入力イベントの時刻に聞こえていた曲位置（判定用）
+*
+* @param timestamp SDLイベントのtimestamp（SDL_GetTicksと同じms）
+* @return MIDI側の曲位置(ms)
+*/
+double musicEventSongMsAt(Uint32 timestamp) {
+    if (!st.dev || st.spec.freq <= 0) return 0.0;
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint32 ticks = SDL_GetTicks();
+    Uint64 back = (Uint64)((double)(Uint32)(ticks - timestamp) * (double)perfFreq / 1000.0);
+    return song_ms_at_counter(now > back ? now - back : 0);
+}
+
+/**
+* @brief 今聞こえている曲位置（アニメーションの時計用）
+*
+* 直前のコールバックの時刻から補間するのでフレームより細かく進む。
+* MIDIハンドラの中では、そのイベントの曲位置を返す
+*
+* @return MIDI側の曲位置(ms)
+*/
+double musicEventSongMs(void) {
+    if (dispatching) return dispatchMs;
+    if (!st.dev || st.spec.freq <= 0) return 0.0;
+    return song_ms_at_counter(SDL_GetPerformanceCounter());
+}
+
+/**
+* @brief 曲位置を拍に直す（MIDIのテンポマップに従う）
+*
+* @param ms MIDI側の曲位置(ms)
+* @return 曲頭からの拍数（4分音符単位）。テンポマップが無ければst.bpmで直す
+*/
+double musicEventMsToBeat(double ms) {
+    if (!st.dev) return ms * 120.0 / 60000.0;
+    SDL_LockAudioDevice(st.dev);
+    double beat;
+    const MidiSong* song = &st.song;
+    if (song->segCount > 0 && song->tpqn > 0) {
+        double us = ms * 1000.0;
+        int lo = 0, hi = song->segCount;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if ((double)song->seg[mid].startUs <= us) lo = mid + 1; else hi = mid;
+        }
+        const MidiTempoSeg* g = &song->seg[lo > 0 ? lo - 1 : 0];
+        beat = (double)g->startTick / (double)song->tpqn + (us - (double)g->startUs) / (double)g->tempoUsPerQN;
+    }
+    else {
+        beat = ms * (st.bpm > 0.0 ? st.bpm : 120.0) / 60000.0;
+    }
+    SDL_UnlockAudioDevice(st.dev);
+    return beat;
+}
+
+/**
+* @brief PerformanceCounterの時刻atに聞こえていた曲位置(ms)
+*
+* デバイスを開いてから最初のコールバックまでは基準の時刻が無いので、最後に分かっていた位置を返す
+*/
+static double song_ms_at_counter(Uint64 at) {
+    SDL_LockAudioDevice(st.dev);
+    double ms = st.heldSongMs;
+    if (st.lastCbCounter != 0) {
+        double rate = (double)st.rateFixed / (double)PLAYBACK_RATE_ONE;
+        double sec = ((double)at - (double)st.lastCbCounter - (double)latency_counter(&st)) / (double)perfFreq;
+        double pos = (double)st.cbStartPos + (st.paused ? 0.0 : sec * (double)st.spec.freq * rate);
+        ms = pos * 1000.0 / (double)st.spec.freq;
+    }
+    SDL_UnlockAudioDevice(st.dev);
+    return ms;
+}
+
+/**
+* @brief 音楽バスのエフェクトのパラメータを設定する（ロック無し、次のバッファから反映）
+*/
+void musicEventSetDspParam(DspParam p, float value) {
+    dspChainSetParam(&st.dsp, p, value);
+}
+
+/**
+* @brief サイドチェインダッキングのきっかけにするMIDIトラック
+*
+* @param track トラック番号（-1で無効）。下げる量はDSP_PARAM_DUCK_DEPTHで設定する
+*/
+void musicEventSetSidechainTrack(int track) {
+    SDL_AtomicSet(&st.duckTrack, track);
+}
+
+/**
+* @brief プレイリストの末尾に曲を追加する
+*
+* 次に再生する曲は再生中にワーカースレッドで読み込んでおき、今の曲の終わりで途切れなく切り替える
+*
+* @param musicPath 曲のWAV（NULLならMIDIのみ）
+* @param midiPath 譜面のMIDI
+* @return 追加できたらtrue
+*/
+bool musicEventPlaylistAdd(const char* musicPath, const char* midiPath) {
+    if (!midiPath || playlist.count >= PLAYLIST_MAX) return false;
+    PlaylistEntry* e = &playlist.entry[playlist.count++];
+    SDL_strlcpy(e->musicPath, musicPath ? musicPath : "", PLAYLIST_PATH_MAX);
+    SDL_strlcpy(e->midiPath, midiPath, PLAYLIST_PATH_MAX);
+    return true;
+}
+
+/**
+* @brief プレイリストを再生中の曲だけにする（再生中の曲は止めない）
+*/
+void musicEventPlaylistClear(void) {
+    playlist_discard_preload();
+    if (playlist.count <= 0) return;
+    if (st.dev) SDL_LockAudioDevice(st.dev);
+    int cur = st.playlistIndex;
+    st.playlistIndex = 0;
+    if (st.dev) SDL_UnlockAudioDevice(st.dev);
+    if (cur > 0 && cur < playlist.count) playlist.entry[0] = playlist.entry[cur];
+    playlist.count = 1;
+}
+
+/**
+* @brief プレイリストの最後の曲の次を先頭に戻すか
+*
+* falseなら最後の曲は（musicLoopに従って）そのままループする
+*/
+void musicEventSetPlaylistLoop(bool loop) {
+    playlist.loop = loop;
+}
+
+/**
+* @brief 再生中の曲のプレイリスト上の位置
+*/
+int musicEventPlaylistIndex(void) {
+    return st.playlistIndex;
+}
+
+int musicEventPlaylistCount(void) {
+    return playlist.count;
+}
+
+/**
+* @brief 現在の再生位置の音量(RMS)
+*/
+float musicEventGetRms(void) {
+    return musicAnalysisRms(&analysis, analysisFrame);
+}
+
+/**
+* @brief 現在の再生位置の帯域エネルギー（0～1）
+*/
+float musicEventGetBandEnergy(AnalysisBand band) {
+    return musicAnalysisBand(&analysis, band, analysisFrame);
+}
+
+/**
+* @brief 現在の再生位置を含む区間の波形の最小/最大
+*
+* @param level ピラミッドの段（0で約10ms、1段ごとに区間が倍）
+*/
+void musicEventGetPeak(int level, float* outMin, float* outMax) {
+    musicAnalysisPeak(&analysis, level, analysisFrame, outMin, outMax);
+}
+
+/**
+* @brief 曲の解析結果（未解析ならNULL）
+*/
+const MusicAnalysis* musicEventGetAnalysis(void) {
+    return analysis.rms ? &analysis : NULL;
+}
+
 char* getInfo() {
     return info;
 }
 
 void musicEventQuit() {
+    timebaseSetMusicClock(NULL, NULL);
+    preload_stop(&playlist.worker);
+    if (st.dev) SDL_PauseAudioDevice(st.dev, 1);
+    SongData* pending[2] = {
+        (SongData*)SDL_AtomicSetPtr((void**)&st.nextSong, NULL),
+        (SongData*)SDL_AtomicSetPtr((void**)&st.retiredSong, NULL),
+    };
+    for (int i = 0; i < 2; i++) {
+        if (!pending[i]) continue;
+        free_song_data(pending[i]);
+        SDL_free(pending[i]);
+    }
     free_midi_song(&st.song);
+    dspChainFree(&st.dsp);
+    musicAnalysisFree(&analysis);
 }
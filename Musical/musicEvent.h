@@ -2,9 +2,26 @@
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 #include "midi_smf.h"
+#include "musicAnalysis.h"
+#include "synth.h"
+#include "dspChain.h"
 
 #define EVQ_CAP 2048  // 十分（イベント頻度は低い）
 
+#define AUDIO_BUFFER_DEFAULT 256   // 初期バッファサイズ(frames)
+#define AUDIO_BUFFER_MIN     128   // 自動調整の下限(frames)
+#define AUDIO_BUFFER_MAX     4096  // 自動調整の上限(frames)
+#define UNDERRUN_TOLERANCE   2     // BUFFER_STABLE_MSの間にこの回数出たらバッファを大きくする
+
+#define PLAYBACK_RATE_ONE    ((uint64_t)1 << 32)  // 等速（32.32固定小数点）
+#define PLAYBACK_RATE_MIN    0.25
+#define PLAYBACK_RATE_MAX    2.0
+
+#define CLICK_RING           64    // クリックの発音時刻のリング長（2の累乗）
+
+#define PLAYLIST_MAX         32    // プレイリストの曲数の上限
+#define PLAYLIST_PATH_MAX    256
+
 typedef enum { EV_MIDI_NOTE } EvKind;
 
 typedef struct {
@@ -14,6 +31,7 @@ typedef struct {
     uint8_t note;   // 0..127
     uint8_t vel;    // 0..127
     int64_t sample; // （任意）イベントのsample位置
+    Uint64 due;     // 実際に聞こえる時刻（PerformanceCounter）
 } AppEvent;
 typedef struct {
     SDL_SpinLock lock;
@@ -21,7 +39,21 @@ typedef struct {
     AppEvent buf[EVQ_CAP];
 } EventQueue;
 
+// オーディオバッファの状態（アンダーラン検出結果）
+typedef struct {
+    int bufferFrames;        // 現在のバッファサイズ(frames)
+    int bufferFloor;         // グリッチが出た最大サイズ（これ以下には下げない）
+    double periodMs;         // バッファ1回分の周期(ms)
+    double lastIntervalMs;   // 直近のコールバック間隔(ms)
+    double maxIntervalMs;    // 最大コールバック間隔(ms)
+    uint64_t callbacks;      // コールバック回数（累計）
+    uint64_t underruns;      // アンダーラン検出回数（累計）
+    int reopenCount;         // バッファサイズ変更による再オープン回数
+    bool adaptive;           // 自動調整が有効かどうか
+} AudioBufferStats;
+
 struct AppState;
+struct SongData;
 // AppStateに追加
 typedef void (*MidiTrackHandler)(struct AppState* st, uint8_t track, uint8_t note, uint8_t vel, bool on);
 
@@ -31,7 +63,11 @@ typedef struct AppState {
 
     float* music;            // interleaved float32
     int64_t  musicFrames;         // frames (not samples)
+    bool midiOnly;                // WAVが無く、内蔵シンセだけで鳴らしている
     int64_t  musicPos;            // frame index
+    uint32_t musicFrac;           // musicPosの小数部（可変速再生用、1/2^32単位）
+    uint64_t rateFixed;           // 現在の再生速度（32.32固定小数点）
+    uint64_t targetRateFixed;     // 目標の再生速度（次のバッファ内でここへ近づける）
     bool musicLoop;
     bool paused;
 
@@ -53,10 +89,66 @@ typedef struct AppState {
 
     MidiSong song;
     int nextEvIndex;
+
+    // 内蔵シンセ（midiSongのイベントをサンプル単位で発音する）
+    Synth synth;
+    int synthEvIndex;             // 次にシンセへ渡すイベント
+    float synthGain;
+
+    // 音楽バスのエフェクト
+    DspChain dsp;
+    SDL_atomic_t duckTrack;       // サイドチェインに使うMIDIトラック（-1で無効）
+    bool pauseTail;               // ポーズ要求後、フェードアウトが終わるまで鳴らしている
+    int64_t pauseAnchorPos;       // ポーズを要求した位置（フェード後ここへ戻す）
+    uint32_t pauseAnchorFrac;
+
+    // アンダーラン検出（audio_cb内で更新）
+    int bufferFrames;             // 現在のバッファサイズ(frames)
+    Uint64 lastCbCounter;         // 前回コールバック時刻（PerformanceCounter、開いてから最初のコールバックまでは0）
+    double heldSongMs;            // lastCbCounterが0の間に返す曲位置（開き直す直前に聞こえていた位置）
+    int cbWarmup;                 // 再オープン直後に計測を捨てるコールバック数
+    bool cbThreadPolicy;          // オーディオスレッドに優先度とコアを設定済みか
+    uint64_t cbCount;
+    uint64_t underrunCount;
+    Uint64 underrunAt[UNDERRUN_TOLERANCE];  // 直近のアンダーランの時刻（PerformanceCounter、0は無し）
+    double lastCbIntervalMs;
+    double maxCbIntervalMs;
+
+    // バッファサイズ自動調整（メインスレッド側）
+    bool adaptiveBuffer;
+    int bufferFloor;
+    Uint32 stableSinceMs;
+    int reopenCount;
+    char deviceKey[256];          // 永続化用のデバイス識別子
+
+    // 出力レイテンシ（バッファ1回分を除いたデバイス側の遅れ、キャリブレーションで測る）
+    double outputLatencyMs;
+    double eventLookaheadMs;      // イベントを聞こえる時刻よりどれだけ早く発行するか
+    int64_t cbStartPos;           // 直近のバッファ先頭の曲位置（MIDI側）
+
+    // キャリブレーション用のクリック
+    bool clickActive;
+    int64_t clickInterval;        // クリック間隔(frames)
+    int64_t clickCounter;         // クリック開始からの出力フレーム数
+    Uint64 clickTimes[CLICK_RING];  // クリックを出力したバッファの時刻 + フレーム位置（PerformanceCounter）
+    SDL_atomic_t clickWrite;
+
+    // プレイリスト（次の曲はワーカーが読み込んでnextSongに置き、コールバックが曲の終わりで差し替える）
+    int playlistIndex;            // 再生中の曲のプレイリスト上の位置
+    struct SongData* nextSong;    // 差し替え待ちの曲（SDL_AtomicGetPtr/SetPtrで読み書き）
+    struct SongData* retiredSong; // 差し替えで外した曲（メインスレッドが解放する）
 } AppState;
 
 
 bool musicEventInit(const char* musicPath, const char* midiPath);
+bool musicEventRenderOffline(const char* musicPath, const char* midiPath,
+    const char* wavPath, const char* logPath, int blockFrames);
+bool musicEventDraftChart(const char* musicPath, const char* midiPath, int subdivision);
+bool musicEventPlaylistAdd(const char* musicPath, const char* midiPath);
+void musicEventPlaylistClear(void);
+void musicEventSetPlaylistLoop(bool loop);
+int musicEventPlaylistIndex(void);
+int musicEventPlaylistCount(void);
 void musicEventUpdate();
 char* getInfo();
 void musicEventQuit();
@@ -67,3 +159,30 @@ void musicEventTogglePaused(void);
 bool musicEventRegisterMidiTrackHandler(uint8_t track, MidiTrackHandler handler);
 void musicEventUnregisterMidiTrackHandler(uint8_t track);
 void musicEventSetMidiTrackEnabled(uint8_t track, bool enabled);
+
+void musicEventGetAudioBufferStats(AudioBufferStats* out);
+void musicEventSetAdaptiveBuffer(bool enabled);
+bool musicEventSetAudioBufferFrames(int frames);
+void musicEventSetPlaybackRate(double rate);
+double musicEventGetPlaybackRate(void);
+
+float musicEventGetRms(void);
+float musicEventGetBandEnergy(AnalysisBand band);
+void musicEventGetPeak(int level, float* outMin, float* outMax);
+const MusicAnalysis* musicEventGetAnalysis(void);
+
+void musicEventSetSynthTrack(uint8_t track, bool enabled, SynthPatchId patch, float gain, float pan);
+void musicEventSetSynthGain(float gain);
+
+void musicEventSetClickTrack(bool enabled, double intervalMs);
+int musicEventReadClicks(Uint64* out, int max, unsigned* cursor);
+double musicEventGetBufferLatencyMs(void);
+void musicEventSetOutputLatency(double deviceMs, bool save);
+double musicEventGetOutputLatency(void);
+void musicEventSetEventLookahead(double ms);
+double musicEventSongMsAt(Uint32 timestamp);
+double musicEventSongMs(void);
+double musicEventMsToBeat(double ms);
+
+void musicEventSetDspParam(DspParam p, float value);
+void musicEventSetSidechainTrack(int track);
@@ -0,0 +1,298 @@
+/**
+* @file offsetEstimate.c
+* @brief 曲とMIDIのずれの自動推定の実装
+*
+* 1. 粗い探索: スペクトルフラックス（OFFSET_HOP間隔）とノートオンのパルス列の相互相関をFFTで求める
+* 2. 詰めの探索: 粗い結果の周りで、短い間隔のエネルギー増分とパルス列の一致度を直接評価する
+* どちらも放物線補間でピーク位置を間隔より細かく求める
+*/
+#include "offsetEstimate.h"
+#include "onset.h"
+#include "parallel.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#define OFFSET_MEAN_RADIUS  8       // オンセット包絡から引く移動平均の半径(hops)
+#define OFFSET_MIN_CONFIDENCE 1.5f
+
+typedef struct {
+    OnsetSource src;
+    float* onset;       // [count] スペクトルフラックス
+    float* fine;        // [fineCount] エネルギー包絡
+    SDL_atomic_t failed;    // どこかの区間で作業用のメモリが取れなかった
+} OffsetJob;
+
+/**
+* @brief フレーム[begin, end)のスペクトルフラックス
+*/
+static void flux_task(void* ctx, int begin, int end) {
+    OffsetJob* job = (OffsetJob*)ctx;
+    OnsetBand band = { 1, job->src.plan->n / 2, job->onset };
+    if (!onsetFlux(&job->src, OFFSET_HOP, begin, end, false, &band, 1)) {
+        SDL_AtomicSet(&job->failed, 1);
+    }
+}
+
+/**
+* @brief 区間[begin, end)のエネルギー（OFFSET_FINE_HOPごと）
+*/
+static void energy_task(void* ctx, int begin, int end) {
+    OffsetJob* job = (OffsetJob*)ctx;
+    for (int b = begin; b < end; b++) {
+        job->fine[b] = onsetEnergy(&job->src, (int64_t)b * OFFSET_FINE_HOP, OFFSET_FINE_HOP);
+    }
+}
+
+/**
+* @brief 相関用の2本のFFTを並列に行う
+*/
+typedef struct {
+    const FFTPlan* plan;
+    float* re[2];
+    float* im[2];
+} CorrJob;
+
+static void corr_fft_task(void* ctx, int begin, int end) {
+    CorrJob* job = (CorrJob*)ctx;
+    for (int i = begin; i < end; i++) fftForward(job->plan, job->re[i], job->im[i]);
+}
+
+/**
+* @brief MIDIのノートオン位置（同じ位置は1つにまとめる）
+*
+* @return ノートオンの数（メモリが取れなければ-1）
+*/
+static int collect_note_ons(const MidiSong* song, int64_t** out) {
+    int64_t* s = (int64_t*)SDL_malloc((size_t)(song->evCount > 0 ? song->evCount : 1) * sizeof(int64_t));
+    int n = 0;
+    if (!s) return -1;
+    for (int i = 0; i < song->evCount; i++) {
+        const MidiNoteEvent* e = &song->ev[i];
+        if (!e->on || e->vel == 0) continue;
+        if (n > 0 && s[n - 1] == e->sample) continue;
+        s[n++] = e->sample;
+    }
+    *out = s;
+    return n;
+}
+
+/**
+* @brief MIDIのノート列のハッシュ（推定結果のキャッシュ照合用）
+*/
+uint32_t offsetEstimateMidiHash(const MidiSong* song) {
+    uint32_t h = 2166136261u;
+    if (!song) return h;
+    for (int i = 0; i < song->evCount; i++) {
+        const MidiNoteEvent* e = &song->ev[i];
+        uint32_t v[3] = { (uint32_t)e->sample, (uint32_t)(e->sample >> 32), (uint32_t)e->note | ((uint32_t)e->on << 8) | ((uint32_t)e->track << 16) };
+        for (int k = 0; k < 3; k++) {
+            for (int b = 0; b < 4; b++) {
+                h ^= (v[k] >> (b * 8)) & 0xFF;
+                h *= 16777619u;
+            }
+        }
+    }
+    return h;
+}
+
+/**
+* @brief 粗い探索（FFTによる相互相関）
+*
+* @param outLag ずれ(frames)
+* @param outConfidence 相関のピーク/平均
+*/
+static bool coarse_search(OffsetJob* job, int count, const int64_t* notes, int noteCount,
+    int maxLag, double* outLag, float* outConfidence) {
+    int p = 1;
+    while (p < count * 2) p <<= 1;
+
+    FFTPlan plan;
+    if (!fftPlanInit(&plan, p)) return false;
+    float* mem = (float*)SDL_calloc((size_t)p * 4, sizeof(float));
+    if (!mem) {
+        fftPlanFree(&plan);
+        return false;
+    }
+    CorrJob cj;
+    cj.plan = &plan;
+    cj.re[0] = mem;
+    cj.im[0] = mem + p;
+    cj.re[1] = mem + 2 * p;
+    cj.im[1] = mem + 3 * p;
+
+    // オンセット: 移動平均を引いて半波整流（立ち上がりだけ残す）
+    double acc = 0.0;
+    int lo = 0, hi = 0;
+    for (int t = 0; t < count; t++) {
+        while (hi < count && hi <= t + OFFSET_MEAN_RADIUS) acc += job->onset[hi++];
+        while (lo < t - OFFSET_MEAN_RADIUS) acc -= job->onset[lo++];
+        float v = job->onset[t] - (float)(acc / (double)(hi - lo));
+        cj.re[0][t] = v > 0.0f ? v : 0.0f;
+    }
+
+    // パルス列: フレームtのフラックスは時刻(t - 0.5)*hopの変化を表す
+    for (int i = 0; i < noteCount; i++) {
+        double x = (double)notes[i] / OFFSET_HOP + 0.5;
+        int k = (int)floor(x);
+        float f = (float)(x - k);
+        if (k >= 0 && k < p) cj.re[1][k] += 1.0f - f;
+        if (k + 1 >= 0 && k + 1 < p) cj.re[1][k + 1] += f;
+    }
+
+    parallelFor(2, corr_fft_task, &cj);
+
+    // corr = IFFT(O * conj(I))
+    for (int k = 0; k < p; k++) {
+        float ar = cj.re[0][k], ai = cj.im[0][k];
+        float br = cj.re[1][k], bi = cj.im[1][k];
+        cj.re[0][k] = ar * br + ai * bi;
+        cj.im[0][k] = ai * br - ar * bi;
+    }
+    fftInverse(&plan, cj.re[0], cj.im[0]);
+    const float* corr = cj.re[0];
+
+    if (maxLag > p / 2 - 1) maxLag = p / 2 - 1;
+    int best = 0;
+    float bestV = -1.0f;
+    double sum = 0.0;
+    for (int l = -maxLag; l <= maxLag; l++) {
+        float v = corr[(l + p) & (p - 1)];
+        sum += v > 0.0f ? v : 0.0f;
+        if (v > bestV) {
+            bestV = v;
+            best = l;
+        }
+    }
+    double mean = sum / (double)(2 * maxLag + 1);
+    double x = onsetParabolicPeak(corr[(best - 1 + p) & (p - 1)], bestV, corr[(best + 1 + p) & (p - 1)]);
+
+    *outLag = ((double)best + x) * OFFSET_HOP;
+    *outConfidence = mean > 0.0 ? (float)(bestV / mean) : 0.0f;
+
+    SDL_free(mem);
+    fftPlanFree(&plan);
+    return true;
+}
+
+/**
+* @brief 詰めの探索（粗い結果の±4hopをOFFSET_FINE_HOP刻みで直接評価）
+*
+* スペクトルフラックスは窓の前端で反応するので粗い結果は早めに出る。その分を含めて探す
+*/
+static double fine_search(const float* fine, int fineCount, const int64_t* notes, int noteCount, double coarseLag) {
+    enum { STEPS = 4 * OFFSET_HOP / OFFSET_FINE_HOP };
+    double score[2 * STEPS + 1];
+    int best = 0;
+    for (int i = 0; i <= 2 * STEPS; i++) {
+        double lag = coarseLag + (double)(i - STEPS) * OFFSET_FINE_HOP;
+        double s = 0.0;
+        for (int n = 0; n < noteCount; n++) {
+            // 区間bの増分は区間の中ほど(b + 0.5)の立ち上がりとみなす
+            s += onsetSampleEnv(fine, fineCount, ((double)notes[n] + lag) / OFFSET_FINE_HOP - 0.5);
+        }
+        score[i] = s;
+        if (s > score[best]) best = i;
+    }
+    double x = 0.0;
+    if (best > 0 && best < 2 * STEPS) x = onsetParabolicPeak(score[best - 1], score[best], score[best + 1]);
+    return coarseLag + ((double)(best - STEPS) + x) * OFFSET_FINE_HOP;
+}
+
+/**
+* @brief 曲とMIDIのずれを推定する
+*
+* @param music インターリーブのfloat32
+* @param frames フレーム数
+* @param channels チャンネル数
+* @param freq サンプリング周波数（songのサンプル位置と同じレート）
+* @param song MIDI
+* @param searchMs 探索範囲（±ms、0以下ならOFFSET_SEARCH_MS）
+* @param out 推定結果
+* @return 推定できたらtrue（confidenceが低い場合もfalse。メモリが取れなかった場合はout->failedも立つ）
+*/
+bool offsetEstimate(const float* music, int64_t frames, int channels, int freq,
+    const MidiSong* song, double searchMs, OffsetEstimate* out) {
+    SDL_zerop(out);
+    if (!music || frames <= OFFSET_FFT_SIZE || channels <= 0 || freq <= 0 || !song) return false;
+    if (searchMs <= 0.0) searchMs = OFFSET_SEARCH_MS;
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+
+    int64_t* notes = NULL;
+    int noteCount = collect_note_ons(song, &notes);
+    if (noteCount < 0) {
+        out->failed = true;
+        return false;
+    }
+    out->noteCount = noteCount;
+    if (noteCount < 4) {
+        SDL_free(notes);
+        return false;
+    }
+
+    OffsetJob job;
+    SDL_zero(job);
+    job.src.music = music;
+    job.src.frames = frames;
+    job.src.channels = channels;
+
+    int count = (int)(frames / OFFSET_HOP) + 1;
+    int fineCount = (int)(frames / OFFSET_FINE_HOP) + 1;
+    FFTPlan plan;
+    float window[OFFSET_FFT_SIZE];
+    job.onset = (float*)SDL_calloc((size_t)count, sizeof(float));
+    job.fine = (float*)SDL_calloc((size_t)fineCount, sizeof(float));
+    bool ok = job.onset && job.fine && fftPlanInit(&plan, OFFSET_FFT_SIZE);
+    if (!ok) {
+        SDL_free(job.onset);
+        SDL_free(job.fine);
+        SDL_free(notes);
+        out->failed = true;
+        return false;
+    }
+    fftHannWindow(window, OFFSET_FFT_SIZE);
+    job.src.plan = &plan;
+    job.src.window = window;
+
+    int threads = parallelFor(count, flux_task, &job);
+    parallelFor(fineCount, energy_task, &job);
+    fftPlanFree(&plan);
+
+    // エネルギー包絡 → 対数の増分（立ち上がり）
+    double mean = 0.0;
+    for (int b = 0; b < fineCount; b++) mean += job.fine[b];
+    float floorE = (float)(mean / fineCount) * 1.0e-3f + 1.0e-12f;
+    float prev = logf(job.fine[0] + floorE);
+    job.fine[0] = 0.0f;
+    for (int b = 1; b < fineCount; b++) {
+        float cur = logf(job.fine[b] + floorE);
+        float d = cur - prev;
+        prev = cur;
+        job.fine[b] = d > 0.0f ? d : 0.0f;
+    }
+
+    int maxLag = (int)(searchMs * freq / 1000.0 / OFFSET_HOP) + 1;
+    double lag = 0.0;
+    float confidence = 0.0f;
+    // フラックスが欠けた区間があると相関のピークがずれるので、推定しなかったことにする
+    ok = !SDL_AtomicGet(&job.failed) && coarse_search(&job, count, notes, noteCount, maxLag, &lag, &confidence);
+    out->failed = !ok;
+    if (ok) {
+        lag = fine_search(job.fine, fineCount, notes, noteCount, lag);
+        out->offsetMs = lag * 1000.0 / (double)freq;
+        out->confidence = confidence;
+    }
+
+    SDL_free(job.onset);
+    SDL_free(job.fine);
+    SDL_free(notes);
+
+    if (out->failed) {
+        SDL_Log("[offsetEstimate] out of memory");
+        return false;
+    }
+    double ms = (double)(SDL_GetPerformanceCounter() - begin) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+    SDL_Log("[offsetEstimate] offset %+.2f ms (confidence %.1f, %d notes) in %.1f ms (%d threads)",
+        out->offsetMs, out->confidence, noteCount, ms, threads);
+    return ok && confidence >= OFFSET_MIN_CONFIDENCE;
+}
@@ -0,0 +1,31 @@
+/**
+* @file offsetEstimate.h
+* @brief 曲とMIDIのずれの自動推定ヘッダ
+*
+* 曲のオンセット強度とMIDIのノートオンのパルス列の相互相関から、
+* AppState::audioOffsetMs に相当するずれを推定する
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "midi_smf.h"
+
+#define OFFSET_HOP          128     ///< 粗い探索のオンセット包絡の間隔(frames)
+#define OFFSET_FFT_SIZE     1024    ///< スペクトルフラックスのFFTサイズ
+#define OFFSET_FINE_HOP     16      ///< 詰めの探索のエネルギー包絡の間隔(frames)
+#define OFFSET_SEARCH_MS    4000.0  ///< 既定の探索範囲（±ms）
+
+/**
+* @brief 推定結果
+*/
+typedef struct {
+    double offsetMs;    ///< 曲の再生位置へ加算するずれ(ms)
+    float confidence;   ///< 相関のピーク/平均（大きいほど確か、目安として3以上）
+    int noteCount;      ///< 使ったノートオンの数
+    bool failed;        ///< メモリが取れずに推定できなかった（曲によらないので結果を覚えておかない）
+} OffsetEstimate;
+
+bool offsetEstimate(const float* music, int64_t frames, int channels, int freq,
+    const MidiSong* song, double searchMs, OffsetEstimate* out);
+uint32_t offsetEstimateMidiHash(const MidiSong* song);
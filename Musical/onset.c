@@ -0,0 +1,120 @@
+/**
+* @file onset.c
+* @brief オンセット検出の共通部分の実装
+*
+* 曲はモノラルにまとめてから窓をかけ、対数振幅スペクトルの増分（スペクトルフラックス）を帯域ごとに足す
+*/
+#include "onset.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+static inline float mono_at(const OnsetSource* src, int64_t frame) {
+    if (frame < 0 || frame >= src->frames) return 0.0f;
+    const float* f = src->music + frame * src->channels;
+    float v = 0.0f;
+    for (int c = 0; c < src->channels; c++) v += f[c];
+    return v / (float)src->channels;
+}
+
+/**
+* @brief モノラルにまとめた曲の区間[start, start + length)のエネルギー（範囲外は0）
+*/
+float onsetEnergy(const OnsetSource* src, int64_t start, int length) {
+    float e = 0.0f;
+    for (int k = 0; k < length; k++) {
+        float v = mono_at(src, start + k);
+        e += v * v;
+    }
+    return e;
+}
+
+/**
+* @brief 窓の中心をcenterに置いた対数振幅スペクトル
+*
+* @param re 作業用[plan->n]
+* @param im 作業用[plan->n]
+* @param mag 出力[plan->n / 2 + 1]
+*/
+void onsetLogSpectrum(const OnsetSource* src, int64_t center, float* re, float* im, float* mag) {
+    int n = src->plan->n;
+    int64_t start = center - n / 2;
+    for (int k = 0; k < n; k++) {
+        re[k] = mono_at(src, start + k) * src->window[k];
+        im[k] = 0.0f;
+    }
+    fftForward(src->plan, re, im);
+    for (int k = 0; k <= n / 2; k++) {
+        mag[k] = logf(1.0f + 100.0f * sqrtf(re[k] * re[k] + im[k] * im[k]));
+    }
+}
+
+/**
+* @brief フレーム[begin, end)の帯域ごとのスペクトルフラックス（フレームtは位置t*hopの窓）
+*
+* parallelForの区間ごとに呼べるよう、区間の最初のフレームの前のスペクトルも自分で求める
+*
+* @param maxFilter trueなら前のスペクトルを周波数方向に隣と最大をとってから比べる
+*                  （ピッチの揺れや下降を立ち上がりとみなさない）
+* @param bands 足すビンの範囲と出力先（fluxの[begin, end)に書く）
+* @return 作業用のメモリが取れなければfalse（何も書かない）
+*/
+bool onsetFlux(const OnsetSource* src, int hop, int begin, int end, bool maxFilter,
+    OnsetBand* bands, int bandCount) {
+    int n = src->plan->n;
+    int bins = n / 2 + 1;
+    float* buf = (float*)SDL_malloc((size_t)(2 * n + 2 * bins) * sizeof(float));
+    if (!buf) return false;
+    float* re = buf;
+    float* im = re + n;
+    float* prev = im + n;
+    float* cur = prev + bins;
+
+    onsetLogSpectrum(src, (int64_t)(begin - 1) * hop, re, im, prev);
+    for (int t = begin; t < end; t++) {
+        onsetLogSpectrum(src, (int64_t)t * hop, re, im, cur);
+        // 増分をcurに入れ直してから帯域ごとに足す（prevは次のフレームのために残す）
+        for (int k = 1; k < bins; k++) {
+            float ref = prev[k];
+            if (maxFilter) {
+                if (prev[k - 1] > ref) ref = prev[k - 1];
+                if (k + 1 < bins && prev[k + 1] > ref) ref = prev[k + 1];
+            }
+            float d = cur[k] - ref;
+            re[k] = d > 0.0f ? d : 0.0f;
+        }
+        for (int b = 0; b < bandCount; b++) {
+            float sum = 0.0f;
+            int hi = bands[b].highBin < bins - 1 ? bands[b].highBin : bins - 1;
+            for (int k = bands[b].lowBin > 1 ? bands[b].lowBin : 1; k <= hi; k++) sum += re[k];
+            bands[b].flux[t] = sum;
+        }
+        float* tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    SDL_free(buf);
+    return true;
+}
+
+/**
+* @brief 包絡vを位置x（要素単位）で線形補間して引く
+*/
+float onsetSampleEnv(const float* v, int count, double x) {
+    if (x < 0.0) return 0.0f;
+    int i = (int)x;
+    if (i >= count - 1) return 0.0f;
+    float t = (float)(x - i);
+    return v[i] + (v[i + 1] - v[i]) * t;
+}
+
+/**
+* @brief 3点の放物線補間でピーク位置のずれ（-0.5～0.5）を求める
+*/
+double onsetParabolicPeak(double l, double c, double r) {
+    double d = l - 2.0 * c + r;
+    if (d >= 0.0) return 0.0;
+    double x = 0.5 * (l - r) / d;
+    if (x < -0.5) x = -0.5;
+    if (x > 0.5) x = 0.5;
+    return x;
+}
@@ -0,0 +1,39 @@
+/**
+* @file onset.h
+* @brief オンセット検出の共通部分のヘッダ
+*
+* 曲のずれの推定（offsetEstimate）と譜面の下書き（chartDraft）で使う、
+* スペクトルフラックスと包絡のピーク探しの部品
+*/
+#pragma once
+
+#include "fft.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+* @brief スペクトルフラックスを求める曲
+*/
+typedef struct {
+    const float* music;     ///< インターリーブのfloat32
+    int64_t frames;         ///< フレーム数
+    int channels;           ///< チャンネル数
+    const FFTPlan* plan;    ///< 窓の長さのFFT（複数スレッドから共有してよい）
+    const float* window;    ///< [plan->n] 窓関数
+} OnsetSource;
+
+/**
+* @brief スペクトルフラックスを足すビンの範囲と出力先
+*/
+typedef struct {
+    int lowBin;             ///< 足す最初のビン（1以上）
+    int highBin;            ///< 足す最後のビン（plan->n / 2以下）
+    float* flux;            ///< [フレーム数] 出力
+} OnsetBand;
+
+float onsetEnergy(const OnsetSource* src, int64_t start, int length);
+void onsetLogSpectrum(const OnsetSource* src, int64_t center, float* re, float* im, float* mag);
+bool onsetFlux(const OnsetSource* src, int hop, int begin, int end, bool maxFilter,
+    OnsetBand* bands, int bandCount);
+float onsetSampleEnv(const float* v, int count, double x);
+double onsetParabolicPeak(double l, double c, double r);
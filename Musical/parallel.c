@@ -0,0 +1,65 @@
+/**
+* @file parallel.c
+* @brief 簡易並列forの実装
+*/
+#include "parallel.h"
+#include "threadPolicy.h"
+#include <SDL2/SDL.h>
+
+typedef struct {
+    ParallelTask task;
+    void* ctx;
+    int begin;
+    int end;
+} ParallelChunk;
+
+static int parallel_main(void* ud) {
+    ParallelChunk* c = (ParallelChunk*)ud;
+    threadPolicyApply(THREAD_ROLE_WORKER);
+    c->task(c->ctx, c->begin, c->end);
+    return 0;
+}
+
+/**
+* @brief [0, count) をワーカーに使えるコアの数で分割して並列に実行する
+*
+* 先頭の範囲は呼び出し元のスレッドで実行し、全範囲が終わるまで戻らない。
+* スレッドが作れなかった範囲も呼び出し元で実行するので、結果は常に揃う
+*
+* @param count 要素数
+* @param task 範囲ごとに呼ばれる処理
+* @param ctx taskに渡すポインタ
+* @return 使ったスレッド数
+*/
+int parallelFor(int count, ParallelTask task, void* ctx) {
+    if (count <= 0 || !task) return 0;
+
+    int n = threadPolicyWorkerCount();
+    if (n < 1) n = 1;
+    if (n > PARALLEL_THREAD_MAX) n = PARALLEL_THREAD_MAX;
+    if (n > count) n = count;
+
+    ParallelChunk chunk[PARALLEL_THREAD_MAX];
+    SDL_Thread* thread[PARALLEL_THREAD_MAX] = { 0 };
+
+    for (int i = 0; i < n; i++) {
+        chunk[i].task = task;
+        chunk[i].ctx = ctx;
+        chunk[i].begin = (int)((long long)count * i / n);
+        chunk[i].end = (int)((long long)count * (i + 1) / n);
+    }
+
+    for (int i = 1; i < n; i++) {
+        thread[i] = SDL_CreateThread(parallel_main, "ParallelWorker", &chunk[i]);
+        if (!thread[i]) {
+            task(ctx, chunk[i].begin, chunk[i].end);
+        }
+    }
+
+    task(ctx, chunk[0].begin, chunk[0].end);
+
+    for (int i = 1; i < n; i++) {
+        if (thread[i]) SDL_WaitThread(thread[i], NULL);
+    }
+    return n;
+}
@@ -0,0 +1,22 @@
+/**
+* @file parallel.h
+* @brief 簡易並列forヘッダ
+*
+* 解析処理などを範囲で分割して、SDLのスレッドで並列に実行する
+*/
+#pragma once
+
+#include <stdbool.h>
+
+#define PARALLEL_THREAD_MAX 16  ///< 同時に使うスレッド数の上限
+
+/**
+* @brief 並列実行する処理
+*
+* @param ctx parallelForに渡したポインタ
+* @param begin 担当範囲の先頭
+* @param end 担当範囲の終端（この値は含まない）
+*/
+typedef void (*ParallelTask)(void* ctx, int begin, int end);
+
+int parallelFor(int count, ParallelTask task, void* ctx);
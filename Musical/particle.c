@@ -1,11 +1,69 @@
+/*
+* @file particle.c
+* @brief パーティクルの実装
+*
+* 見た目とイージングが同じ設定ごとにプール（エミッタ）を持ち、粒は項目ごとの配列（SoA）に詰めて並べる。
+* 生成は末尾への追加、寿命が切れた粒は末尾と入れ替えて消すので、空きを探すことはない。
+* 位置・角度・大きさ・透明度は生まれた時刻からの割合をeasingBatchに通して毎フレーム直接求め、
+* アニメーションは使わない。描画は頂点を描画キューに渡し、テクスチャごとにまとめて描く
+*/
 #define _USE_MATH_DEFINES
 #include "particle.h"
-#include "animation.h"
 #include "easing.h"
+#include "image.h"
+#include "renderQueue.h"
+#include "timebase.h"
 #include "main.h"
 #include <math.h>
 
-static Sprite particle[PARTICLE_MAX];
+/**
+* @brief 粒の項目（PF_ALPHA1までが粒の状態、それより後はparticleUpdateで求める値と作業用）
+*/
+enum {
+	PF_BIRTH,		// 動き出す時刻（ms、プールのepochから）
+	PF_LIFE,		// 寿命（ms）
+	PF_X0, PF_Y0,	// 開始位置
+	PF_DX, PF_DY,	// 移動量
+	PF_ROT0, PF_ROT1,
+	PF_SCALE0, PF_SCALE1,
+	PF_ALPHA0, PF_ALPHA1,
+	PF_STATE_COUNT,
+	PF_X = PF_STATE_COUNT, PF_Y,
+	PF_ROT, PF_SCALE, PF_ALPHA,
+	PF_RATIO, PF_EASED,
+	PF_COUNT
+};
+
+/**
+* @brief 変化させる値（イージング関数の並び）
+*/
+enum { PE_POSITION, PE_ROTATION, PE_SCALE, PE_ALPHA, PE_COUNT };
+
+typedef struct {
+	int image;
+	SDL_Rect src;
+	SDL_FPoint pivot;
+	SDL_Color color;
+	SDL_BlendMode blendmode;
+	SDL_RendererFlip flip;
+	int layer;
+	float scaleX, scaleY;
+	Uint8 easing[PE_COUNT];			// EasingId（EASING_COUNTならcustomを使う）
+	float (*custom[PE_COUNT])(float);
+	int count;
+	int drawCount;					// 前回のparticleUpdateで値を求めた数
+	int capacity;
+	double epoch;					// PF_BIRTHの基準の時刻（floatで持つ時刻が大きくならないようにずらす）
+	double lastStart;				// 最後にparticleStartした時刻
+	float* f[PF_COUNT];
+} ParticleEmitter;
+
+#define EPOCH_REBASE_MS	60000.0		// 粒が残っているプールのepochをずらす間隔
+
+static ParticleEmitter emitters[PARTICLE_EMITTER_MAX];
+static int emitterCount;
+static double particleClock;				// パーティクルの時計（ms、1フレーム20msまで）
+static double lastTicks;
 
 ParticleSetting particleSettingDefault(const Sprite* sprite)
 {
@@ -39,64 +97,291 @@ ParticleSetting particleSettingDefault(const Sprite* sprite)
 	return s;
 }
 
+/*
+* @brief alphaToと同じ変換（1以上は不透明）
+*/
+static float alphaTarget(float alpha)
+{
+	if (alpha <= 0.0f) return 0.0f;
+	if (alpha >= 1.0f) return 255.0f;
+	return alpha * 255.0f;
+}
+
+static bool emitterReserve(ParticleEmitter* e, int count)
+{
+	if (count <= e->capacity) return true;
+	if (count > PARTICLE_EMITTER_CAPACITY) return false;
+	int capacity = e->capacity ? e->capacity : 256;
+	while (capacity < count) capacity *= 2;
+	if (capacity > PARTICLE_EMITTER_CAPACITY) capacity = PARTICLE_EMITTER_CAPACITY;
+	for (int k = 0; k < PF_COUNT; k++) {
+		float* p = (float*)SDL_realloc(e->f[k], sizeof(float) * (size_t)capacity);
+		if (!p) {
+			SDL_Log("particle: out of memory (%d particles)", capacity);
+			return false;
+		}
+		e->f[k] = p;
+	}
+	e->capacity = capacity;
+	return true;
+}
+
+/*
+* @brief プールの見た目とイージングがsettingと同じか
+*/
+static bool emitterMatches(const ParticleEmitter* e, const ParticleSetting* s, float (*const easing[PE_COUNT])(float))
+{
+	const Sprite* sp = &s->sprite;
+	if (e->image != sp->image || e->layer != sp->layer || e->blendmode != sp->blendmode || e->flip != sp->flip) return false;
+	if (!SDL_RectEquals(&e->src, &sp->src)) return false;
+	if (e->pivot.x != sp->pivot.x || e->pivot.y != sp->pivot.y) return false;
+	if (e->scaleX != sp->scaleX || e->scaleY != sp->scaleY) return false;
+	if (e->color.r != sp->color.r || e->color.g != sp->color.g || e->color.b != sp->color.b || e->color.a != sp->color.a) return false;
+	for (int c = 0; c < PE_COUNT; c++) {
+		if (e->custom[c] != easing[c]) return false;
+	}
+	return true;
+}
+
+/*
+* @brief settingと同じ見た目のプールを引く（無ければ作る、いっぱいなら空いているか一番前に使ったプールを使い回す）
+*
+* ParticleSettingのアドレスではなく中身で引くので、ローカル変数の設定を使い回しても別の見た目の粒が混ざらない
+*/
+static ParticleEmitter* emitterFor(const ParticleSetting* s)
+{
+	float (*easing[PE_COUNT])(float) = {
+		s->easingPosition, s->easingRotation, s->easingScale, s->easingAlpha
+	};
+	for (int c = 0; c < PE_COUNT; c++) {
+		if (!easing[c]) easing[c] = linear;
+	}
+	for (int i = 0; i < emitterCount; i++) {
+		if (emitterMatches(&emitters[i], s, easing)) return &emitters[i];
+	}
+
+	ParticleEmitter* e = NULL;
+	if (emitterCount < PARTICLE_EMITTER_MAX) {
+		e = &emitters[emitterCount++];
+	}
+	else {
+		for (int i = 0; i < emitterCount && !e; i++) {
+			if (emitters[i].count == 0) e = &emitters[i];
+		}
+		if (!e) {
+			e = &emitters[0];
+			for (int i = 1; i < emitterCount; i++) {
+				if (emitters[i].lastStart < e->lastStart) e = &emitters[i];
+			}
+			SDL_Log("particle: all %d emitters are busy, dropping %d particles of the oldest", PARTICLE_EMITTER_MAX, e->count);
+		}
+	}
+	e->count = e->drawCount = 0;
+	e->image = s->sprite.image;
+	e->src = s->sprite.src;
+	e->pivot = s->sprite.pivot;
+	e->color = s->sprite.color;
+	e->blendmode = s->sprite.blendmode;
+	e->flip = s->sprite.flip;
+	e->layer = s->sprite.layer;
+	e->scaleX = s->sprite.scaleX;
+	e->scaleY = s->sprite.scaleY;
+	for (int c = 0; c < PE_COUNT; c++) {
+		e->custom[c] = easing[c];
+		e->easing[c] = (Uint8)easingIdOf(easing[c]);
+	}
+	return e;
+}
+
 void particleStart(const ParticleSetting* s)
 {
-	int count = 0;
+	ParticleEmitter* e = emitterFor(s);
+	if (!e || s->count <= 0) return;
+	int count = s->count;
+	if (!emitterReserve(e, e->count + count)) {
+		count = e->capacity - e->count;
+	}
 	int interval = s->duration / s->count;
-	for (int i = 0; i < PARTICLE_MAX; i++) {
-		Sprite* p = &particle[i];
-		if (p->isEnabled == false) {
-			*p = s->sprite;
-			p->position = s->position;
-			float r = randomFloat() * M_PI * 2;
-			float radius = lerp(0, s->radius, randomFloat());
-			p->position.x += cosf(r) * radius;
-			p->position.y += sinf(r) * radius;
-
-			float rotation = lerp(s->minRotation, s->maxRotation, randomFloat());
-			float speed = lerp(s->minPosition, s->maxPosition, randomFloat());
-			float scale = lerp(s->minScale, s->maxScale, randomFloat());
-			float alpha = lerp(s->minAlpha, s->maxAlpha, randomFloat());
-			int lifeTime = (int)lerp((float)s->minLifeTime, (float)s->maxLifeTime, randomFloat());
-			int delay = interval * count;
-			moveAdd(p, cosf(rotation) * speed, sinf(rotation) * speed);
-			setDuration(lifeTime);
-			setEasing(s->easingPosition);
-			setDelay(delay);
-
-			p->rotation = rotation;
-			rotateTo(p, s->rotation);
-			setDuration(lifeTime);
-			setEasing(s->easingRotation);
-			setDelay(delay);
-
-			p->scale = scale;
-			scaleTo(p, s->scale);
-			setDuration(lifeTime);
-			setEasing(s->easingScale);
-			setDelay(delay);
-
-			p->color.a = (int)alpha;
-			alphaTo(p, s->alpha);
-			p->color.a = 0;
-			setDuration(lifeTime);
-			setEasing(s->easingAlpha);
-			setDelay(delay);
-
-			setOnFinished(disable);
-
-			if (++count >= s->count) {
-				break;
+	if (e->count == 0) e->epoch = particleClock;
+	e->lastStart = particleClock;
+	double start = particleClock - e->epoch;
+	float alpha1 = alphaTarget(s->alpha);
+	for (int i = 0; i < count; i++) {
+		int k = e->count++;
+		float r = randomFloat() * M_PI * 2;
+		float radius = lerp(0, s->radius, randomFloat());
+		float rotation = lerp(s->minRotation, s->maxRotation, randomFloat());
+		float speed = lerp(s->minPosition, s->maxPosition, randomFloat());
+		float scale = lerp(s->minScale, s->maxScale, randomFloat());
+		float alpha = lerp(s->minAlpha, s->maxAlpha, randomFloat());
+		int lifeTime = (int)lerp((float)s->minLifeTime, (float)s->maxLifeTime, randomFloat());
+
+		e->f[PF_BIRTH][k] = (float)(start + interval * i);
+		e->f[PF_LIFE][k] = (float)(lifeTime > 1 ? lifeTime : 1);
+		e->f[PF_X0][k] = s->position.x + cosf(r) * radius;
+		e->f[PF_Y0][k] = s->position.y + sinf(r) * radius;
+		e->f[PF_DX][k] = cosf(rotation) * speed;
+		e->f[PF_DY][k] = sinf(rotation) * speed;
+		e->f[PF_ROT0][k] = rotation;
+		e->f[PF_ROT1][k] = s->rotation;
+		e->f[PF_SCALE0][k] = scale;
+		e->f[PF_SCALE1][k] = s->scale;
+		e->f[PF_ALPHA0][k] = (float)(int)alpha;
+		e->f[PF_ALPHA1][k] = alpha1;
+	}
+}
+
+/*
+* @brief 割合をイージングに通す（組み込みの関数はまとめて計算する）
+*/
+static void ease(const ParticleEmitter* e, int c, const float* ratio, float* out, int n)
+{
+	if (e->easing[c] < EASING_COUNT) {
+		easingBatch((EasingId)e->easing[c], ratio, out, n);
+	}
+	else {
+		for (int k = 0; k < n; k++) out[k] = e->custom[c](ratio[k]);
+	}
+}
+
+/*
+* @brief 開始値と終了値の間の値を求める
+*/
+static void lerpChannel(const float* restrict a, const float* restrict b, const float* restrict t, float* restrict out, int n)
+{
+	for (int k = 0; k < n; k++) {
+		out[k] = a[k] + (b[k] - a[k]) * t[k];
+	}
+}
+
+/*
+* @brief パーティクルの更新（easingUpdateの後に1フレームに1回呼ぶ）
+*/
+void particleUpdate(void)
+{
+	double now = timebaseNow(TIMEBASE_TICKS);
+	if (lastTicks > 0.0) {
+		double delta = now - lastTicks;
+		particleClock += delta > 20.0 ? 20.0 : delta;
+	}
+	lastTicks = now;
+
+	for (int i = 0; i < emitterCount; i++) {
+		ParticleEmitter* e = &emitters[i];
+		float* birth = e->f[PF_BIRTH];
+		float* life = e->f[PF_LIFE];
+
+		// 粒が絶えないプールも、時刻がepochから離れすぎないようにずらす
+		if (e->count > 0 && particleClock - e->epoch > EPOCH_REBASE_MS) {
+			float shift = (float)(particleClock - e->epoch);
+			for (int k = 0; k < e->count; k++) birth[k] -= shift;
+			e->epoch = particleClock;
+		}
+		float t = (float)(particleClock - e->epoch);
+
+		// 寿命の切れた粒を末尾と入れ替えて消す
+		for (int k = 0; k < e->count; ) {
+			if (t - birth[k] >= life[k]) {
+				int last = --e->count;
+				for (int p = 0; p < PF_STATE_COUNT; p++) e->f[p][k] = e->f[p][last];
+			}
+			else {
+				k++;
 			}
 		}
+		int n = e->drawCount = e->count;
+		if (n == 0) continue;
+
+		float* ratio = e->f[PF_RATIO];
+		float* eased = e->f[PF_EASED];
+		for (int k = 0; k < n; k++) {
+			float r = (t - birth[k]) / life[k];
+			ratio[k] = r < 0.0f ? 0.0f : r;
+		}
+
+		ease(e, PE_POSITION, ratio, eased, n);
+		for (int k = 0; k < n; k++) {
+			e->f[PF_X][k] = e->f[PF_X0][k] + e->f[PF_DX][k] * eased[k];
+			e->f[PF_Y][k] = e->f[PF_Y0][k] + e->f[PF_DY][k] * eased[k];
+		}
+		ease(e, PE_ROTATION, ratio, eased, n);
+		lerpChannel(e->f[PF_ROT0], e->f[PF_ROT1], eased, e->f[PF_ROT], n);
+		ease(e, PE_SCALE, ratio, eased, n);
+		lerpChannel(e->f[PF_SCALE0], e->f[PF_SCALE1], eased, e->f[PF_SCALE], n);
+		ease(e, PE_ALPHA, ratio, eased, n);
+		lerpChannel(e->f[PF_ALPHA0], e->f[PF_ALPHA1], eased, e->f[PF_ALPHA], n);
+		// 動き出す前の粒は見えない
+		for (int k = 0; k < n; k++) {
+			if (t < birth[k]) e->f[PF_ALPHA][k] = 0.0f;
+		}
 	}
 }
 
 void particleDraw(void)
 {
-	for (int i = 0; i < PARTICLE_MAX; i++) {
-		spriteDraw(&particle[i]);
+	for (int i = 0; i < emitterCount; i++) {
+		ParticleEmitter* e = &emitters[i];
+		SDL_Texture* texture = getTexture(e->image);
+		int n = e->drawCount < e->count ? e->drawCount : e->count;
+		SDL_Rect src;
+		if (!texture || n == 0 || !getImageSource(e->image, &e->src, &src)) continue;
+
+		// アトラスの画像ならページ内の位置にずらしたUV
+		int w, h;
+		SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+		float u0 = (float)src.x / w, u1 = (float)(src.x + src.w) / w;
+		float v0 = (float)src.y / h, v1 = (float)(src.y + src.h) / h;
+		if (e->flip & SDL_FLIP_HORIZONTAL) { float u = u0; u0 = u1; u1 = u; }
+		if (e->flip & SDL_FLIP_VERTICAL) { float v = v0; v0 = v1; v1 = v; }
+		// 中心からの四隅（大きさ1のとき）
+		float left = -e->src.w * e->scaleX * e->pivot.x;
+		float top = -e->src.h * e->scaleY * e->pivot.y;
+		float right = left + e->src.w * e->scaleX;
+		float bottom = top + e->src.h * e->scaleY;
+
+		for (int k = 0; k < n; k++) {
+			float a = e->f[PF_ALPHA][k];
+			if (a < 0.5f) continue;
+			float s = e->f[PF_SCALE][k];
+			float c = cosf(e->f[PF_ROT][k]) * s;
+			float sn = sinf(e->f[PF_ROT][k]) * s;
+			float x = e->f[PF_X][k], y = e->f[PF_Y][k];
+			SDL_Color color = e->color;
+			color.a = a >= 255.0f ? 255 : (Uint8)(a + 0.5f);
+			SDL_Vertex v[4];
+			v[0] = (SDL_Vertex){ { x + left * c - top * sn, y + left * sn + top * c }, color, { u0, v0 } };
+			v[1] = (SDL_Vertex){ { x + right * c - top * sn, y + right * sn + top * c }, color, { u1, v0 } };
+			v[2] = (SDL_Vertex){ { x + right * c - bottom * sn, y + right * sn + bottom * c }, color, { u1, v1 } };
+			v[3] = (SDL_Vertex){ { x + left * c - bottom * sn, y + left * sn + bottom * c }, color, { u0, v1 } };
+			renderQueueSubmitQuad(texture, e->blendmode, v, e->layer, 0);
+		}
+	}
+}
+
+/*
+* @brief 動いている粒の数
+*/
+int particleCount(void)
+{
+	int n = 0;
+	for (int i = 0; i < emitterCount; i++) {
+		n += emitters[i].count;
+	}
+	return n;
+}
+
+/*
+* @brief パーティクルのプールを解放する
+*/
+void particleQuit(void)
+{
+	for (int i = 0; i < emitterCount; i++) {
+		for (int k = 0; k < PF_COUNT; k++) {
+			SDL_free(emitters[i].f[k]);
+		}
 	}
+	SDL_zero(emitters);
+	emitterCount = 0;
 }
 
 void particleSetPosition(ParticleSetting* setting, float min, float max, float(*easing)(float))
@@ -1,7 +1,8 @@
 #pragma once
 #include "sprite.h"
 
-#define PARTICLE_MAX	2000
+#define PARTICLE_EMITTER_MAX		16		// ڂƃC[WOݒ育Ƃ̃v[̐
+#define PARTICLE_EMITTER_CAPACITY	16384	// 1̃v[̗̏
 
 typedef struct ParticleSetting {
 	Sprite sprite;
@@ -34,7 +35,10 @@ typedef struct ParticleSetting {
 
 ParticleSetting particleSettingDefault(const Sprite* sprite);
 void particleStart(const ParticleSetting* setting);
+void particleUpdate(void);
 void particleDraw(void);
+int particleCount(void);
+void particleQuit(void);
 void particleSetPosition(ParticleSetting* setting, float min, float max, float(*easing)(float));
 void particleSetScale(ParticleSetting* setting, float min, float max, float to, float(*easing)(float));
 void particleSetRotation(ParticleSetting* setting, float min, float max, float to, float(*easing)(float));
@@ -0,0 +1,263 @@
+/**
+* @file primitive.c
+* @brief 円・扇形・太い線を三角形で描く図形描画の実装
+*
+* キャッシュの表は1周の分割数+1個の単位円上の点（角度0から2πまで）。
+* 円弧は表の先頭から角度の手前までの点と、角度ちょうどの終わりの1点で作るので、角度が毎フレーム変わっても表は増えない。
+* 1周の分割数は半径で決まり（8～256の4の倍数）、表は多くてもPRIMITIVE_CACHE_MAX個で足りる
+*/
+#define _USE_MATH_DEFINES
+#include "primitive.h"
+#include "spriteBatch.h"
+#include "renderQueue.h"
+#include <stdbool.h>
+#include <math.h>
+
+/**
+* @brief 単位円上の点の表
+*/
+typedef struct {
+    int segments;           ///< 1周の分割数
+    SDL_FPoint* unit;
+    Uint32 used;            ///< 最後に使った順番
+} PrimitiveShape;
+
+static PrimitiveShape cache[PRIMITIVE_CACHE_MAX];
+static int cacheCount;
+static Uint32 useCount;
+static SDL_Vertex* verts;   ///< 組み立て用（次の図形でも使い回す）
+static int* indices;
+static int vcap, icap;
+
+static bool reserve(int nv, int ni) {
+    if (nv > vcap) {
+        int nc = vcap ? vcap : 256;
+        while (nc < nv) nc *= 2;
+        SDL_Vertex* v = (SDL_Vertex*)SDL_realloc(verts, (size_t)nc * sizeof(SDL_Vertex));
+        if (!v) return false;
+        verts = v;
+        vcap = nc;
+    }
+    if (ni > icap) {
+        int nc = icap ? icap : 768;
+        while (nc < ni) nc *= 2;
+        int* i = (int*)SDL_realloc(indices, (size_t)nc * sizeof(int));
+        if (!i) return false;
+        indices = i;
+        icap = nc;
+    }
+    return true;
+}
+
+/**
+* @brief 半径から1周の分割数を決める
+*
+* 弦と円の隙間がPRIMITIVE_TOLERANCE以下になる数を4の倍数に切り上げたもの
+*/
+static int segments_for(float radius) {
+    float step = radius > PRIMITIVE_TOLERANCE * 2.0f
+        ? 2.0f * acosf(1.0f - PRIMITIVE_TOLERANCE / radius) : (float)M_PI / 2.0f;
+    int full = (int)ceilf(2.0f * (float)M_PI / step);
+    full = (full + 3) & ~3;
+    if (full < PRIMITIVE_SEGMENT_MIN) full = PRIMITIVE_SEGMENT_MIN;
+    if (full > PRIMITIVE_SEGMENT_MAX) full = PRIMITIVE_SEGMENT_MAX;
+    return full;
+}
+
+/**
+* @brief 1周の分割数の表を探す（無ければ作る）
+*/
+static const SDL_FPoint* shape_for(int segments) {
+    PrimitiveShape* s = NULL;
+    for (int i = 0; i < cacheCount; i++) {
+        if (cache[i].segments == segments) {
+            cache[i].used = ++useCount;
+            return cache[i].unit;
+        }
+    }
+    if (cacheCount < PRIMITIVE_CACHE_MAX) {
+        s = &cache[cacheCount++];
+    }
+    else {
+        s = &cache[0];
+        for (int i = 1; i < PRIMITIVE_CACHE_MAX; i++) {
+            if (cache[i].used < s->used) s = &cache[i];
+        }
+        SDL_free(s->unit);
+    }
+    s->unit = (SDL_FPoint*)SDL_malloc((size_t)(segments + 1) * sizeof(SDL_FPoint));
+    if (!s->unit) {
+        s->segments = 0;
+        return NULL;
+    }
+    s->segments = segments;
+    s->used = ++useCount;
+    for (int i = 0; i < segments; i++) {
+        double a = 2.0 * M_PI * i / segments;
+        s->unit[i] = (SDL_FPoint){ (float)cos(a), (float)sin(a) };
+    }
+    s->unit[segments] = s->unit[0];
+    return s->unit;
+}
+
+/**
+* @brief 円弧の点を作る（開始の角度だけ回した単位円上のn+1点）
+*
+* 途中の点は1周の表から取り、最後の点だけ角度ちょうどの位置を求める
+*
+* @param radius 半径（分割数を決める）
+* @param start 開始の角度
+* @param angle 円弧の角度（0より大きく2π以下）
+* @param out n+1点（PRIMITIVE_SEGMENT_MAX+1点入る配列）
+* @return 分割数n（表が作れなければ0）
+*/
+static int arc_points(float radius, float start, float angle, SDL_FPoint* out) {
+    int full = segments_for(radius);
+    const SDL_FPoint* unit = shape_for(full);
+    if (!unit) return 0;
+    // 2πちょうどで1つ多くならないように少しだけ切り下げる
+    int n = (int)ceilf(full * angle / (2.0f * (float)M_PI) - 1e-3f);
+    if (n < 1) n = 1;
+    if (n > full) n = full;
+    float c = cosf(start), s = sinf(start);
+    for (int i = 0; i <= n; i++) {
+        SDL_FPoint u = i < n || n == full ? unit[i] : (SDL_FPoint){ cosf(angle), sinf(angle) };
+        out[i] = (SDL_FPoint){ u.x * c - u.y * s, u.x * s + u.y * c };
+    }
+    return n;
+}
+
+/**
+* @brief 角度を0～2πの範囲の開始と幅にそろえる
+*/
+static bool normalize(float* start, float* angle) {
+    if (*angle < 0.0f) {
+        *start += *angle;
+        *angle = -*angle;
+    }
+    if (*angle <= 0.0f) return false;
+    if (*angle > 2.0f * (float)M_PI) *angle = 2.0f * (float)M_PI;
+    return true;
+}
+
+static void submit(SDL_BlendMode mode, int nv, int ni) {
+    // ためたスプライトより後に描かれるように、先にspriteBatchへ渡しておく
+    renderQueueCommit();
+    spriteBatchAddGeometry(NULL, mode, verts, nv, indices, ni);
+}
+
+/**
+* @brief 扇形を塗りつぶす（中心からの扇の三角形）
+*
+* @param x 中心x
+* @param y 中心y
+* @param radius 半径
+* @param start 開始の角度（ラジアン、x軸から時計回り）
+* @param angle 扇形の角度（ラジアン、2πで円）
+* @param color 色
+* @param mode ブレンドモード
+*/
+void primitiveArc(float x, float y, float radius, float start, float angle, SDL_Color color, SDL_BlendMode mode) {
+    if (radius <= 0.0f || color.a == 0 || !normalize(&start, &angle)) return;
+    SDL_FPoint p[PRIMITIVE_SEGMENT_MAX + 1];
+    int n = arc_points(radius, start, angle, p);
+    if (n == 0 || !reserve(n + 2, n * 3)) return;
+
+    verts[0] = (SDL_Vertex){ { x, y }, color, { 0, 0 } };
+    for (int i = 0; i <= n; i++) {
+        verts[i + 1] = (SDL_Vertex){ { x + p[i].x * radius, y + p[i].y * radius }, color, { 0, 0 } };
+    }
+    for (int i = 0; i < n; i++) {
+        indices[i * 3] = 0;
+        indices[i * 3 + 1] = i + 1;
+        indices[i * 3 + 2] = i + 2;
+    }
+    submit(mode, n + 2, n * 3);
+}
+
+/**
+* @brief 円を塗りつぶす
+*
+* @param x 中心x
+* @param y 中心y
+* @param radius 半径
+* @param color 色
+* @param mode ブレンドモード
+*/
+void primitiveCircle(float x, float y, float radius, SDL_Color color, SDL_BlendMode mode) {
+    primitiveArc(x, y, radius, 0.0f, 2.0f * (float)M_PI, color, mode);
+}
+
+/**
+* @brief 輪（円弧の太い線）を描く（内側と外側の点を交互に結んだ帯の三角形）
+*
+* @param x 中心x
+* @param y 中心y
+* @param radius 線の中心の半径
+* @param width 線の太さ
+* @param start 開始の角度（ラジアン、x軸から時計回り）
+* @param angle 円弧の角度（ラジアン、2πで1周）
+* @param color 色
+* @param mode ブレンドモード
+*/
+void primitiveRing(float x, float y, float radius, float width, float start, float angle,
+    SDL_Color color, SDL_BlendMode mode) {
+    if (radius <= 0.0f || width <= 0.0f || color.a == 0 || !normalize(&start, &angle)) return;
+    float outer = radius + width * 0.5f;
+    float inner = SDL_max(radius - width * 0.5f, 0.0f);
+    SDL_FPoint p[PRIMITIVE_SEGMENT_MAX + 1];
+    int n = arc_points(outer, start, angle, p);
+    if (n == 0 || !reserve((n + 1) * 2, n * 6)) return;
+
+    for (int i = 0; i <= n; i++) {
+        verts[i * 2] = (SDL_Vertex){ { x + p[i].x * outer, y + p[i].y * outer }, color, { 0, 0 } };
+        verts[i * 2 + 1] = (SDL_Vertex){ { x + p[i].x * inner, y + p[i].y * inner }, color, { 0, 0 } };
+    }
+    for (int i = 0; i < n; i++) {
+        int* k = indices + i * 6;
+        int o = i * 2;
+        k[0] = o; k[1] = o + 2; k[2] = o + 1;
+        k[3] = o + 1; k[4] = o + 2; k[5] = o + 3;
+    }
+    submit(mode, (n + 1) * 2, n * 6);
+}
+
+/**
+* @brief 太い線を描く（線の向きに垂直に太さを付けた四角形）
+*
+* @param x1 始点x
+* @param y1 始点y
+* @param x2 終点x
+* @param y2 終点y
+* @param width 線の太さ
+* @param color 色
+* @param mode ブレンドモード
+*/
+void primitiveLine(float x1, float y1, float x2, float y2, float width, SDL_Color color, SDL_BlendMode mode) {
+    float dx = x2 - x1, dy = y2 - y1;
+    float len = sqrtf(dx * dx + dy * dy);
+    if (len <= 0.0f || width <= 0.0f || color.a == 0 || !reserve(4, 6)) return;
+    float nx = -dy / len * width * 0.5f, ny = dx / len * width * 0.5f;
+    verts[0] = (SDL_Vertex){ { x1 + nx, y1 + ny }, color, { 0, 0 } };
+    verts[1] = (SDL_Vertex){ { x2 + nx, y2 + ny }, color, { 0, 0 } };
+    verts[2] = (SDL_Vertex){ { x2 - nx, y2 - ny }, color, { 0, 0 } };
+    verts[3] = (SDL_Vertex){ { x1 - nx, y1 - ny }, color, { 0, 0 } };
+    indices[0] = 0; indices[1] = 1; indices[2] = 2;
+    indices[3] = 0; indices[4] = 2; indices[5] = 3;
+    submit(mode, 4, 6);
+}
+
+/**
+* @brief キャッシュと組み立て用の配列を解放する
+*/
+void primitiveQuit(void) {
+    for (int i = 0; i < cacheCount; i++) {
+        SDL_free(cache[i].unit);
+    }
+    cacheCount = 0;
+    SDL_free(verts);
+    SDL_free(indices);
+    verts = NULL;
+    indices = NULL;
+    vcap = icap = 0;
+}
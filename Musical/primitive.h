@@ -0,0 +1,24 @@
+/**
+* @file primitive.h
+* @brief 円・扇形・太い線を三角形で描く図形描画のヘッダ
+*
+* 塗りつぶしの円と扇形は中心からの扇（ファン）、輪と太い線は帯（ストリップ）の三角形にして、
+* テクスチャ無しのバッチとしてspriteBatchにためる。続けて描いた図形は1回のSDL_RenderGeometryになる。
+* 円周の分割数は半径から決め（弦と円の隙間がPRIMITIVE_TOLERANCE以下）、
+* 分割数ごとに1周分の単位円上の点の表をキャッシュして、描くときは拡大と回転だけで済ませる（円弧は表の一部を使う）
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+
+#define PRIMITIVE_TOLERANCE     0.25f   ///< 弦と円の隙間の上限（ピクセル）
+#define PRIMITIVE_SEGMENT_MIN   8       ///< 1周の分割数の下限
+#define PRIMITIVE_SEGMENT_MAX   256     ///< 1周の分割数の上限
+#define PRIMITIVE_CACHE_MAX     64      ///< キャッシュする表の数（超えたら一番使われていないものを入れ替える）
+
+void primitiveCircle(float x, float y, float radius, SDL_Color color, SDL_BlendMode mode);
+void primitiveArc(float x, float y, float radius, float start, float angle, SDL_Color color, SDL_BlendMode mode);
+void primitiveRing(float x, float y, float radius, float width, float start, float angle,
+    SDL_Color color, SDL_BlendMode mode);
+void primitiveLine(float x1, float y1, float x2, float y2, float width, SDL_Color color, SDL_BlendMode mode);
+void primitiveQuit(void);
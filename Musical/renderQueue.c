@@ -0,0 +1,267 @@
+/**
+* @file renderQueue.c
+* @brief 並べ替えてから描く描画キューの実装
+*
+* キーは上の桁から レイヤー(8) ブレンドモード(3) テクスチャ(10) 奥行き(24) 追加順(19) のビット。
+* 追加順は四角形の番号そのものなので、キーだけを並べ替えれば四角形が引ける。
+* 並べ替えは8ビットずつ8回の基数ソートで、全部同じ値の桁は飛ばす
+*/
+#include "renderQueue.h"
+#include "spriteBatch.h"
+#include "image.h"
+#include <string.h>
+
+#define KEY_LAYER_SHIFT     56
+#define KEY_BLEND_SHIFT     53
+#define KEY_TEXTURE_SHIFT   43
+#define KEY_DEPTH_SHIFT     19
+#define KEY_INDEX_MASK      ((Uint64)RENDER_QUEUE_ITEM_MAX - 1)
+
+/**
+* @brief ためている四角形
+*/
+typedef struct {
+    SDL_Texture* texture;
+    SDL_BlendMode mode;
+    SDL_Vertex v[4];
+} RenderItem;
+
+static RenderItem* items;
+static Uint64* keys;
+static Uint64* sorted;              ///< 基数ソートの作業用
+static int count, capacity;
+static SDL_Texture* textures[RENDER_QUEUE_TEXTURE_MAX];    ///< 今回ためたテクスチャ（見つけた順の番号をキーに使う）
+static int textureCount;
+static SDL_FRect viewport;
+static bool viewportValid;          ///< フレームの最初に論理サイズを取り直す
+static bool disabled;               ///< trueなら並べ替えも間引きもせずにspriteBatchに渡す
+static int submittedLast, culledLast;   ///< 前回のflipまでの数
+static int submittedFrame, culledFrame;
+
+static bool queue_reserve(int n) {
+    if (n <= capacity) return true;
+    int nc = capacity ? capacity * 2 : 1024;
+    while (nc < n) nc *= 2;
+    RenderItem* ni = (RenderItem*)SDL_realloc(items, (size_t)nc * sizeof(RenderItem));
+    if (!ni) return false;
+    items = ni;
+    Uint64* nk = (Uint64*)SDL_realloc(keys, (size_t)nc * sizeof(Uint64));
+    if (!nk) return false;
+    keys = nk;
+    Uint64* ns = (Uint64*)SDL_realloc(sorted, (size_t)nc * sizeof(Uint64));
+    if (!ns) return false;
+    sorted = ns;
+    capacity = nc;
+    return true;
+}
+
+static Uint64 texture_index(SDL_Texture* t) {
+    for (int i = 0; i < textureCount; i++) {
+        if (textures[i] == t) return (Uint64)i;
+    }
+    if (textureCount == RENDER_QUEUE_TEXTURE_MAX) return RENDER_QUEUE_TEXTURE_MAX - 1;
+    textures[textureCount] = t;
+    return (Uint64)textureCount++;
+}
+
+static Uint64 blend_index(SDL_BlendMode mode) {
+    switch (mode) {
+    case SDL_BLENDMODE_NONE:  return 0;
+    case SDL_BLENDMODE_BLEND: return 1;
+    case SDL_BLENDMODE_ADD:   return 2;
+    case SDL_BLENDMODE_MOD:   return 3;
+    case SDL_BLENDMODE_MUL:   return 4;
+    default:                  return 5;
+    }
+}
+
+/**
+* @brief floatの大小と同じ順になる24ビットの値
+*/
+static Uint64 depth_bits(float depth) {
+    Uint32 u;
+    memcpy(&u, &depth, sizeof(u));
+    u = (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    return (Uint64)(u >> 8);
+}
+
+static void update_viewport(void) {
+    SDL_Renderer* renderer = getRenderer();
+    int w = 0, h = 0;
+    SDL_RenderGetLogicalSize(renderer, &w, &h);
+    if (w <= 0 || h <= 0) SDL_GetRendererOutputSize(renderer, &w, &h);
+    viewport = (SDL_FRect){ 0, 0, (float)w, (float)h };
+    viewportValid = true;
+}
+
+/**
+* @brief 8ビットずつの基数ソート（LSD）
+*/
+static void radix_sort(Uint64* a, Uint64* tmp, int n) {
+    int hist[8][256];
+    memset(hist, 0, sizeof(hist));
+    for (int i = 0; i < n; i++) {
+        Uint64 k = a[i];
+        for (int b = 0; b < 8; b++) hist[b][(k >> (b * 8)) & 0xff]++;
+    }
+    Uint64* src = a;
+    Uint64* dst = tmp;
+    for (int b = 0; b < 8; b++) {
+        int* h = hist[b];
+        if (h[(src[0] >> (b * 8)) & 0xff] == n) continue;
+        int sum = 0;
+        for (int d = 0; d < 256; d++) {
+            int c = h[d];
+            h[d] = sum;
+            sum += c;
+        }
+        for (int i = 0; i < n; i++) {
+            Uint64 k = src[i];
+            dst[h[(k >> (b * 8)) & 0xff]++] = k;
+        }
+        Uint64* t = src; src = dst; dst = t;
+    }
+    if (src != a) memcpy(a, src, (size_t)n * sizeof(Uint64));
+}
+
+/**
+* @brief 頂点4つの四角形をためる
+*
+* @param texture テクスチャ
+* @param mode ブレンドモード
+* @param quad 頂点（左上・右上・右下・左下の順）
+* @param layer レイヤー（0～255、大きいほど手前）
+* @param depth 同じレイヤー・テクスチャの中での奥行き（小さいほど先に描く）
+*/
+void renderQueueSubmitQuad(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex quad[4], int layer, float depth) {
+    if (!texture) return;
+    if (disabled) {
+        spriteBatchAddQuad(texture, mode, quad);
+        return;
+    }
+    submittedFrame++;
+
+    // 透明なもの・画面の外のものは描かない
+    if (quad[0].color.a == 0 && quad[1].color.a == 0 && quad[2].color.a == 0 && quad[3].color.a == 0) {
+        culledFrame++;
+        return;
+    }
+    if (!viewportValid) update_viewport();
+    float x0 = quad[0].position.x, x1 = x0, y0 = quad[0].position.y, y1 = y0;
+    for (int k = 1; k < 4; k++) {
+        x0 = SDL_min(x0, quad[k].position.x);
+        x1 = SDL_max(x1, quad[k].position.x);
+        y0 = SDL_min(y0, quad[k].position.y);
+        y1 = SDL_max(y1, quad[k].position.y);
+    }
+    if (x1 <= viewport.x || y1 <= viewport.y || x0 >= viewport.x + viewport.w || y0 >= viewport.y + viewport.h ||
+        x0 == x1 || y0 == y1) {
+        culledFrame++;
+        return;
+    }
+
+    if (count == RENDER_QUEUE_ITEM_MAX) renderQueueFlush();
+    if (!queue_reserve(count + 1)) return;
+    RenderItem* it = &items[count];
+    it->texture = texture;
+    it->mode = mode;
+    SDL_memcpy(it->v, quad, sizeof(it->v));
+    Uint64 l = (Uint64)(layer < 0 ? 0 : layer > 255 ? 255 : layer);
+    keys[count] = (l << KEY_LAYER_SHIFT) | (blend_index(mode) << KEY_BLEND_SHIFT) |
+        (texture_index(texture) << KEY_TEXTURE_SHIFT) | (depth_bits(depth) << KEY_DEPTH_SHIFT) | (Uint64)count;
+    count++;
+}
+
+/**
+* @brief SDL_RenderCopyExFと同じ引数で四角形をためる
+*
+* @param texture テクスチャ
+* @param mode ブレンドモード
+* @param src 描画元矩形（NULLなら全体）
+* @param dst 出力先矩形
+* @param angle 時計回りの角度（度）
+* @param center 回転の中心（dstの左上から、NULLならdstの中央）
+* @param flip 上下、左右反転フラグ
+* @param color 色と透明度
+* @param layer レイヤー（0～255、大きいほど手前）
+* @param depth 同じレイヤー・テクスチャの中での奥行き（小さいほど先に描く）
+*/
+void renderQueueSubmit(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color, int layer, float depth) {
+    if (color.a == 0 && !disabled) {
+        submittedFrame++;
+        culledFrame++;
+        return;
+    }
+    SDL_Vertex q[4];
+    if (spriteBatchMakeQuad(texture, src, dst, angle, center, flip, color, q)) {
+        renderQueueSubmitQuad(texture, mode, q, layer, depth);
+    }
+}
+
+/**
+* @brief ためた四角形をキーの順に並べてspriteBatchに渡す（まだ描かない）
+*
+* 図形などをspriteBatchに直接足す前に呼ぶと、それより前にためた分が先に描かれる
+*/
+void renderQueueCommit(void) {
+    if (count == 0) return;
+    radix_sort(keys, sorted, count);
+    for (int i = 0; i < count; i++) {
+        const RenderItem* it = &items[keys[i] & KEY_INDEX_MASK];
+        spriteBatchAddQuad(it->texture, it->mode, it->v);
+    }
+    count = 0;
+    textureCount = 0;
+}
+
+/**
+* @brief ためた四角形をキーの順に並べてspriteBatchに渡し、描く
+*/
+void renderQueueFlush(void) {
+    renderQueueCommit();
+    spriteBatchFlush();
+}
+
+/**
+* @brief フレームの終わり（flipから呼ばれる）
+*/
+void renderQueueEndFrame(void) {
+    renderQueueFlush();
+    spriteBatchEndFrame();
+    submittedLast = submittedFrame;
+    culledLast = culledFrame;
+    submittedFrame = culledFrame = 0;
+    viewportValid = false;
+}
+
+/**
+* @brief 並べ替えを使うかどうか（falseなら追加した順にそのまま描く、見比べる用）
+*/
+void renderQueueSetEnabled(bool enabled) {
+    renderQueueFlush();
+    disabled = !enabled;
+}
+
+/**
+* @brief 前のフレームの数
+*
+* @param submitted 追加された四角形の数
+* @param culled そのうち画面の外・透明で描かなかった数
+*/
+void renderQueueStats(int* submitted, int* culled) {
+    if (submitted) *submitted = submittedLast;
+    if (culled) *culled = culledLast;
+}
+
+/**
+* @brief キューを解放する
+*/
+void renderQueueQuit(void) {
+    SDL_free(items);
+    SDL_free(keys);
+    SDL_free(sorted);
+    items = NULL;
+    keys = sorted = NULL;
+    count = capacity = textureCount = 0;
+}
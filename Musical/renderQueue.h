@@ -0,0 +1,36 @@
+/**
+* @file renderQueue.h
+* @brief 並べ替えてから描く描画キューのヘッダ
+*
+* スプライトやパーティクルの四角形を、レイヤー・ブレンドモード・テクスチャ・奥行き・追加順の
+* 64ビットのキーと一緒にためておき、キーの順に並べ替えてからspriteBatchに渡す。
+* 画面（論理サイズ）の外にあるものと透明度0のものは、ためる時点で捨てる。
+*
+* 同じレイヤーの中ではブレンドモードとテクスチャでまとめるので、追加した順は保たれない。
+* 重なり順が決まっているものは別のレイヤーにするか、同じテクスチャにして奥行きで決める。
+* image.cの描画関数（drawImage・fillRectなど）はためた分を先に描く。
+* それ以外で直接描くもの（DFA_Updateなど）の前にはrenderQueueFlushを呼ぶこと
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define RENDER_LAYER_BACKGROUND     0x20    ///< 背景
+#define RENDER_LAYER_BACK_EFFECT    0x60    ///< キャラクターの後ろの演出
+#define RENDER_LAYER_DEFAULT        0x80    ///< キャラクター（Spriteの初期値）
+#define RENDER_LAYER_EFFECT         0xA0    ///< キャラクターの前の演出
+#define RENDER_LAYER_OVERLAY        0xE0    ///< フェードなど画面全体にかぶせるもの
+
+#define RENDER_QUEUE_TEXTURE_MAX    1024    ///< 1回に並べ替えるテクスチャの種類（超えた分は同じ扱い）
+#define RENDER_QUEUE_ITEM_MAX       (1 << 19)   ///< 1回にためられる数（超えたらその場で描く）
+
+void renderQueueSubmit(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color, int layer, float depth);
+void renderQueueSubmitQuad(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex quad[4], int layer, float depth);
+void renderQueueCommit(void);
+void renderQueueFlush(void);
+void renderQueueEndFrame(void);
+void renderQueueSetEnabled(bool enabled);
+void renderQueueStats(int* submitted, int* culled);
+void renderQueueQuit(void);
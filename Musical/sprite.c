@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include "sprite.h"
 #include "image.h"
+#include "renderQueue.h"
 
 /**
 * @brief スプライトの初期化
@@ -64,6 +65,10 @@ void spriteInit(Sprite *s, int id, float srcX, float srcY, float srcW, float src
     //反転フラグ
     s->flip = SDL_FLIP_NONE;
 
+    //描画のレイヤーと奥行き
+    s->layer = RENDER_LAYER_DEFAULT;
+    s->depth = 0;
+
     //速度と加速度
     s->v = s->accel = (Vector2){ 0,0 };
 
@@ -71,6 +76,30 @@ void spriteInit(Sprite *s, int id, float srcX, float srcY, float srcW, float src
     s->pause = true;
 }
 
+/**
+* @brief 名前で画像を読み込んでスプライトを初期化
+*
+* アトラスのフレーム表に.asepriteのフレームがあれば、1枚の大きさをフレームの幅にして
+* .asepriteのフレームの長さどおりにループするアニメーションをセットする
+*
+* @param s スプライト
+* @param name 画像の名前（拡張子は無くてもよい）
+*/
+void spriteInitNamed(Sprite *s, const char *name) {
+    int id = loadImage(name);
+    int w, h;
+    getImageSize(id, &w, &h);
+    int frames = getImageFrameCount(id);
+    spriteInit(s, id, 0, 0, w / frames, h);
+    if (frames > 1) {
+        int total = 0;
+        for (int i = 0; i < frames; i++) {
+            total += getImageFrameDuration(id, i);
+        }
+        spriteAnimeInitTimed(s, frames, total > 0 ? (double)total / frames : 100.0, -1, TIMEBASE_TICKS);
+    }
+}
+
 /**
 * @brief スプライトのアニメーションで使用する値の初期化
 *
@@ -85,10 +114,77 @@ void spriteAnimeInit(Sprite *s, int frameMax, int interval, int loopCount) {
     s->frameMax = frameMax;
     s->interval = interval;
     s->loopCount = loopCount;
+    s->timebase = TIMEBASE_FRAME;
+    s->animeOrigin = 0.0;
+    s->animeInterval = 0.0;
     s->pause = false;
     s->isEnabled = true;
 }
 
+/**
+* @brief 時計で進むスプライトのアニメーションの初期化
+*
+* 描画の回数ではなく時計の時刻からコマを決めるので、フレームレートが揺れても曲とずれない。
+* MIDIハンドラの中で呼べば、そのイベントの時刻を開始にする
+*
+* @param s スプライト
+* @param frameMax アニメーション枚数
+* @param interval 1枚の長さ（TIMEBASE_TICKS・MUSICはms、BEATSは拍。画像にフレームの長さがあれば平均の長さ）
+* @param loopCount アニメーションループ回数（負ならループし続ける）
+* @param base 時間の基準
+*/
+void spriteAnimeInitTimed(Sprite *s, int frameMax, double interval, int loopCount, Timebase base) {
+    spriteAnimeInit(s, frameMax, 1, loopCount);
+    if (base == TIMEBASE_FRAME || interval <= 0.0) {
+        s->interval = interval >= 1.0 ? (int)interval : 1;
+        return;
+    }
+    s->timebase = base;
+    s->animeOrigin = timebaseSample(base);
+    s->animeInterval = interval;
+}
+
+/**
+* @brief 始めからの位置のコマ
+*
+* 画像のフレーム表にコマ数と同じだけフレームがあれば、1周をフレームの長さの比で分ける（無ければ等分）
+*
+* @param pos 始めからの位置（1枚の平均の長さが1）
+*/
+static int spriteFrameAt(const Sprite *s, double pos) {
+    double cycle = fmod(pos, (double)s->frameMax);
+    if (getImageFrameCount(s->image) != s->frameMax) return (int)cycle;
+    int total = 0;
+    for (int i = 0; i < s->frameMax; i++) {
+        total += getImageFrameDuration(s->image, i);
+    }
+    if (total <= 0) return (int)cycle;
+    double t = cycle * total / s->frameMax;
+    for (int i = 0; i < s->frameMax; i++) {
+        t -= getImageFrameDuration(s->image, i);
+        if (t < 0.0) return i;
+    }
+    return s->frameMax - 1;
+}
+
+/**
+* @brief 時計で進むアニメーション
+*
+* 一時停止中は時計を止めないので、再開すると経過した分だけ進んだコマになる
+*/
+static void spriteAnimeTimed(Sprite *s) {
+    double pos = (timebaseNow(s->timebase) - s->animeOrigin) / s->animeInterval;
+    if (pos < 0.0) pos = 0.0;
+    if (s->loopCount > 0 && pos >= (double)s->loopCount * s->frameMax) {
+        s->frame = s->frameMax - 1;
+        s->isEnabled = false;
+    }
+    else {
+        s->frame = spriteFrameAt(s, pos);
+    }
+    s->src.x = s->src.w * s->frame;
+}
+
 /*
 * @brief スプライトのアニメーション（X方向のアニメーション）
 *
@@ -102,6 +198,11 @@ void spriteAnime(Sprite *s) {
     if (s->pause)
         return;
 
+    if (s->timebase != TIMEBASE_FRAME) {
+        if (s->loopCount != 0 && s->frameMax > 0) spriteAnimeTimed(s);
+        return;
+    }
+
     if (s->loopCount != 0) {
         s->frame = (++(s->count) / s->interval) % s->frameMax;
 
@@ -146,11 +247,8 @@ void spriteDrawOffset(Sprite *s, float x, float y) {
         dst.x += x;
         dst.y += y;
         spriteAnime(s);
-        setAlpha(s->image, (int)s->color.a);
-        setColor(s->image, s->color.r, s->color.g, s->color.b);
-        setBlendMode(s->image, s->blendmode);
-        drawImage(s->image, &s->src, &dst,
-            s->rotation / M_PI * 180, &s->center, s->flip);
+        drawImageColored(s->image, &s->src, &dst,
+            s->rotation / M_PI * 180, &s->center, s->flip, s->color, s->blendmode, s->layer, s->depth);
     }
 }
 /**
@@ -171,11 +269,8 @@ void spriteDrawEx(Sprite* s, Vector2 position, float rotation, float scale) {
         s->dst.y = position.y - s->center.y;
         SDL_FRect dst = s->dst;
         spriteAnime(s);
-        setAlpha(s->image, s->color.a);
-        setColor(s->image, s->color.r, s->color.g, s->color.b);
-        setBlendMode(s->image, s->blendmode);
-        drawImage(s->image, &s->src, &dst,
-            rotation / M_PI * 180, &s->center, s->flip);
+        drawImageColored(s->image, &s->src, &dst,
+            rotation / M_PI * 180, &s->center, s->flip, s->color, s->blendmode, s->layer, s->depth);
     }
 }
 
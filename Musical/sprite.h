@@ -9,6 +9,7 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include "vector2.h"
+#include "timebase.h"
 
 /**
 * @brief スプライトの構造体
@@ -30,6 +31,9 @@ typedef struct {
     int frameMax;           ///< アニメーションのフレーム最大数
     int interval;           ///< アニメーション間隔
     int loopCount;          ///< アニメーションのループ回数
+    Timebase timebase;      ///< アニメーションの時計（TIMEBASE_FRAMEならcountで数える）
+    double animeOrigin;     ///< 時計を使う場合の開始時刻
+    double animeInterval;   ///< 時計を使う場合の1枚の長さ（時計の単位）
     bool pause;             ///< アニメーションがポーズ中かどうかのフラグ
     bool isEnabled;         ///< 表示のONOFFフラグ
     float rotation;        ///< 角度（ラジアン）
@@ -42,13 +46,17 @@ typedef struct {
     SDL_Color color;        ///< 色
     SDL_BlendMode blendmode;///< ブレンドモード
     SDL_RendererFlip flip;  ///< 反転
+    int layer;              ///< 描画のレイヤー（RENDER_LAYER_～、大きいほど手前）
+    float depth;            ///< 同じレイヤー・画像の中での奥行き（小さいほど先に描く）
 } Sprite;
 
 void spriteDraw(Sprite *s);
 void spriteDrawOffset(Sprite *s, float x, float y);
 void spriteDrawEx(Sprite* s, Vector2 position, float rotation, float scale);
 void spriteInit(Sprite *s, int id, float srcX, float srcY, float srcW, float srcH);
+void spriteInitNamed(Sprite *s, const char *name);
 void spriteAnimeInit(Sprite *s, int frameMax, int interval, int loopCount);
+void spriteAnimeInitTimed(Sprite *s, int frameMax, double interval, int loopCount, Timebase base);
 void spriteAnime(Sprite* s);
 void spriteSetCollision(Sprite *s, float w, float h);
 bool spriteIntersectsRect(const Sprite *s1, const Sprite *s2);
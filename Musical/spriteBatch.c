@@ -0,0 +1,275 @@
+/**
+* @file spriteBatch.c
+* @brief スプライトをまとめて描くバッチの実装
+*
+* バッチはテクスチャとブレンドモードごとの頂点列・インデックス列（DFA_DrawListのページと同じ形）で、
+* 追加した順に並ぶ。新しい四角形は、後ろからさかのぼって同じテクスチャ・ブレンドモードのバッチに足す。
+* 途中のバッチの範囲と重なる場合は、前のバッチに入れると重なり順が変わるので、末尾に新しいバッチを作る。
+* そのため重ならない限りは種類ごとにまとまり、描画の呼び出しはバッチの数だけになる
+*/
+#define _USE_MATH_DEFINES
+#include "spriteBatch.h"
+#include "image.h"
+#include <math.h>
+
+/**
+* @brief テクスチャとブレンドモードが同じ四角形の集まり
+*/
+typedef struct {
+    SDL_Texture* texture;
+    SDL_BlendMode mode;
+    SDL_FRect bounds;               ///< 入っている四角形を囲む範囲
+    SDL_Vertex* v;
+    int vlen, vcap;
+    int* i;
+    int ilen, icap;
+} SpriteBatch;
+
+static SpriteBatch* batches;
+static int batchCount;              ///< 使っているバッチの数
+static int batchCapacity;           ///< 確保したバッチの数（頂点列は次のフレームも使い回す）
+static bool disabled;               ///< trueなら追加のたびにすぐ描く
+static int drawCalls;               ///< 前回のflipまでのSDL_RenderGeometryの回数
+static int drawCallsFrame;
+
+static bool batch_reserve(SpriteBatch* b, int addV, int addI) {
+    if (b->vlen + addV > b->vcap) {
+        int nc = (b->vcap == 0) ? 1024 : b->vcap * 2;
+        while (nc < b->vlen + addV) nc *= 2;
+        SDL_Vertex* v = (SDL_Vertex*)SDL_realloc(b->v, (size_t)nc * sizeof(SDL_Vertex));
+        if (!v) return false;
+        b->v = v;
+        b->vcap = nc;
+    }
+    if (b->ilen + addI > b->icap) {
+        int nc = (b->icap == 0) ? 1536 : b->icap * 2;
+        while (nc < b->ilen + addI) nc *= 2;
+        int* i = (int*)SDL_realloc(b->i, (size_t)nc * sizeof(int));
+        if (!i) return false;
+        b->i = i;
+        b->icap = nc;
+    }
+    return true;
+}
+
+static bool overlaps(const SDL_FRect* a, const SDL_FRect* b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w &&
+        a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+/**
+* @brief 四角形を足すバッチを選ぶ（無ければ末尾に作る）
+*/
+static SpriteBatch* batch_for(SDL_Texture* texture, SDL_BlendMode mode, const SDL_FRect* bounds) {
+    int stop = batchCount - SPRITE_BATCH_LOOKBACK;
+    for (int k = batchCount - 1; k >= 0 && k >= stop; k--) {
+        SpriteBatch* b = &batches[k];
+        if (b->texture == texture && b->mode == mode) return b;
+        if (overlaps(&b->bounds, bounds)) break;
+    }
+    if (batchCount == batchCapacity) {
+        int nc = batchCapacity ? batchCapacity * 2 : 16;
+        SpriteBatch* nb = (SpriteBatch*)SDL_realloc(batches, (size_t)nc * sizeof(SpriteBatch));
+        if (!nb) return NULL;
+        SDL_memset(nb + batchCapacity, 0, (size_t)(nc - batchCapacity) * sizeof(SpriteBatch));
+        batches = nb;
+        batchCapacity = nc;
+    }
+    SpriteBatch* b = &batches[batchCount++];
+    b->texture = texture;
+    b->mode = mode;
+    b->bounds = *bounds;
+    b->vlen = b->ilen = 0;
+    return b;
+}
+
+/**
+* @brief 三角形の集まりを足す
+*
+* @param texture テクスチャ（NULLなら頂点の色だけで塗る）
+* @param mode ブレンドモード
+* @param v 頂点（色と透明度は頂点に入れる）
+* @param vcount 頂点の数
+* @param indices 三角形ごとの頂点の番号（3つずつ）
+* @param icount 番号の数
+*/
+void spriteBatchAddGeometry(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex* v, int vcount,
+    const int* indices, int icount) {
+    if (vcount <= 0 || icount <= 0) return;
+    float x0 = v[0].position.x, x1 = x0, y0 = v[0].position.y, y1 = y0;
+    for (int k = 1; k < vcount; k++) {
+        x0 = SDL_min(x0, v[k].position.x);
+        x1 = SDL_max(x1, v[k].position.x);
+        y0 = SDL_min(y0, v[k].position.y);
+        y1 = SDL_max(y1, v[k].position.y);
+    }
+    SDL_FRect bounds = { x0, y0, x1 - x0, y1 - y0 };
+
+    SpriteBatch* b = batch_for(texture, mode, &bounds);
+    if (!b || !batch_reserve(b, vcount, icount)) return;
+    float bx1 = SDL_max(b->bounds.x + b->bounds.w, x1);
+    float by1 = SDL_max(b->bounds.y + b->bounds.h, y1);
+    b->bounds.x = SDL_min(b->bounds.x, x0);
+    b->bounds.y = SDL_min(b->bounds.y, y0);
+    b->bounds.w = bx1 - b->bounds.x;
+    b->bounds.h = by1 - b->bounds.y;
+
+    int base = b->vlen;
+    SDL_memcpy(b->v + base, v, sizeof(SDL_Vertex) * (size_t)vcount);
+    b->vlen += vcount;
+    int* idx = b->i + b->ilen;
+    for (int k = 0; k < icount; k++) idx[k] = base + indices[k];
+    b->ilen += icount;
+
+    if (disabled) spriteBatchFlush();
+}
+
+/**
+* @brief 頂点4つ（左上・右上・右下・左下の順）の四角形を足す
+*
+* @param texture テクスチャ
+* @param mode ブレンドモード
+* @param quad 頂点（色と透明度は頂点に入れる）
+*/
+void spriteBatchAddQuad(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex quad[4]) {
+    static const int indices[6] = { 0, 1, 2, 0, 2, 3 };
+    if (!texture) return;
+    spriteBatchAddGeometry(texture, mode, quad, 4, indices, 6);
+}
+
+/**
+* @brief SDL_RenderCopyExFと同じ引数から頂点4つ（左上・右上・右下・左下の順）を作る
+*
+* @param texture テクスチャ
+* @param src 描画元矩形（NULLなら全体）
+* @param dst 出力先矩形
+* @param angle 時計回りの角度（度）
+* @param center 回転の中心（dstの左上から、NULLならdstの中央）
+* @param flip 上下、左右反転フラグ
+* @param color 色と透明度
+* @param quad 作った頂点
+* @return テクスチャの大きさがわからなければfalse
+*/
+bool spriteBatchMakeQuad(SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color, SDL_Vertex quad[4]) {
+    int w, h;
+    if (!texture || SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0 || w <= 0 || h <= 0) return false;
+
+    SDL_Rect s = src ? *src : (SDL_Rect){ 0, 0, w, h };
+    float u0 = (float)s.x / w, u1 = (float)(s.x + s.w) / w;
+    float v0 = (float)s.y / h, v1 = (float)(s.y + s.h) / h;
+    if (flip & SDL_FLIP_HORIZONTAL) { float t = u0; u0 = u1; u1 = t; }
+    if (flip & SDL_FLIP_VERTICAL) { float t = v0; v0 = v1; v1 = t; }
+
+    float cx = center ? center->x : dst->w * 0.5f;
+    float cy = center ? center->y : dst->h * 0.5f;
+    float px = dst->x + cx, py = dst->y + cy;
+    float left = -cx, top = -cy, right = dst->w - cx, bottom = dst->h - cy;
+
+    SDL_Vertex* q = quad;
+    if (angle == 0.0) {
+        q[0].position = (SDL_FPoint){ px + left, py + top };
+        q[1].position = (SDL_FPoint){ px + right, py + top };
+        q[2].position = (SDL_FPoint){ px + right, py + bottom };
+        q[3].position = (SDL_FPoint){ px + left, py + bottom };
+    }
+    else {
+        float r = (float)(angle * M_PI / 180.0);
+        float c = cosf(r), sn = sinf(r);
+        q[0].position = (SDL_FPoint){ px + left * c - top * sn, py + left * sn + top * c };
+        q[1].position = (SDL_FPoint){ px + right * c - top * sn, py + right * sn + top * c };
+        q[2].position = (SDL_FPoint){ px + right * c - bottom * sn, py + right * sn + bottom * c };
+        q[3].position = (SDL_FPoint){ px + left * c - bottom * sn, py + left * sn + bottom * c };
+    }
+    q[0].tex_coord = (SDL_FPoint){ u0, v0 };
+    q[1].tex_coord = (SDL_FPoint){ u1, v0 };
+    q[2].tex_coord = (SDL_FPoint){ u1, v1 };
+    q[3].tex_coord = (SDL_FPoint){ u0, v1 };
+    q[0].color = q[1].color = q[2].color = q[3].color = color;
+    return true;
+}
+
+/**
+* @brief SDL_RenderCopyExFと同じ引数で四角形を足す
+*
+* @param texture テクスチャ
+* @param mode ブレンドモード
+* @param src 描画元矩形（NULLなら全体）
+* @param dst 出力先矩形
+* @param angle 時計回りの角度（度）
+* @param center 回転の中心（dstの左上から、NULLならdstの中央）
+* @param flip 上下、左右反転フラグ
+* @param color 色と透明度
+*/
+void spriteBatchAdd(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color) {
+    SDL_Vertex q[4];
+    if (spriteBatchMakeQuad(texture, src, dst, angle, center, flip, color, q)) {
+        spriteBatchAddQuad(texture, mode, q);
+    }
+}
+
+/**
+* @brief ためた四角形を描く（バッチごとに1回のSDL_RenderGeometry）
+*/
+void spriteBatchFlush(void) {
+    if (batchCount == 0) return;
+    SDL_Renderer* renderer = getRenderer();
+    for (int k = 0; k < batchCount; k++) {
+        SpriteBatch* b = &batches[k];
+        if (b->ilen == 0) continue;
+        // 頂点の色を使うのでテクスチャの色・透明度の設定は関係なく、ブレンドモードだけ合わせる
+        if (b->texture) {
+            SDL_SetTextureBlendMode(b->texture, b->mode);
+            (void)SDL_RenderGeometry(renderer, b->texture, b->v, b->vlen, b->i, b->ilen);
+        }
+        else {
+            // テクスチャが無い場合は描画のブレンドモードが使われるので、その間だけ切り替える
+            SDL_BlendMode prev;
+            SDL_GetRenderDrawBlendMode(renderer, &prev);
+            SDL_SetRenderDrawBlendMode(renderer, b->mode);
+            (void)SDL_RenderGeometry(renderer, NULL, b->v, b->vlen, b->i, b->ilen);
+            SDL_SetRenderDrawBlendMode(renderer, prev);
+        }
+        drawCallsFrame++;
+        b->vlen = b->ilen = 0;
+    }
+    batchCount = 0;
+}
+
+/**
+* @brief バッチを使うかどうか（falseなら足すたびにすぐ描く、見比べる用）
+*/
+void spriteBatchSetEnabled(bool enabled) {
+    spriteBatchFlush();
+    disabled = !enabled;
+}
+
+/**
+* @brief 前のフレームのSDL_RenderGeometryの回数（flipで数え直す）
+*/
+int spriteBatchDrawCalls(void) {
+    return drawCalls;
+}
+
+/**
+* @brief フレームの終わり（flipから呼ばれる）
+*/
+void spriteBatchEndFrame(void) {
+    spriteBatchFlush();
+    drawCalls = drawCallsFrame;
+    drawCallsFrame = 0;
+}
+
+/**
+* @brief バッチの頂点列を解放する
+*/
+void spriteBatchQuit(void) {
+    for (int k = 0; k < batchCapacity; k++) {
+        SDL_free(batches[k].v);
+        SDL_free(batches[k].i);
+    }
+    SDL_free(batches);
+    batches = NULL;
+    batchCount = batchCapacity = 0;
+}
@@ -0,0 +1,28 @@
+/**
+* @file spriteBatch.h
+* @brief スプライトをまとめて描くバッチのヘッダ
+*
+* 四角形をCPUで頂点に変換し（回転・中心点・反転）、色と透明度は頂点の色に入れて、
+* テクスチャとブレンドモードが同じものを1つの頂点列にためてSDL_RenderGeometryで描く。
+* スプライトとパーティクルは描画キュー（renderQueue）で並べ替えてからここに入る。
+* 円や太い線（primitive）はテクスチャ無しのバッチとして直接入る
+*/
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+#define SPRITE_BATCH_LOOKBACK   8       ///< 追加先を探すときにさかのぼるバッチの数
+
+void spriteBatchAdd(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color);
+bool spriteBatchMakeQuad(SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color, SDL_Vertex quad[4]);
+void spriteBatchAddQuad(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex quad[4]);
+void spriteBatchAddGeometry(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex* v, int vcount,
+    const int* indices, int icount);
+void spriteBatchFlush(void);
+void spriteBatchEndFrame(void);
+void spriteBatchSetEnabled(bool enabled);
+int spriteBatchDrawCalls(void);
+void spriteBatchQuit(void);
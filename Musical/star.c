@@ -1,5 +1,6 @@
 #include "star.h"
 #include "sprite.h"
+#include "renderQueue.h"
 #include "animation.h"
 #include "easing.h"
 #include "main.h"
@@ -14,11 +15,12 @@ void starInit()
     {
         Sprite* e = &stars[i];
         spriteInit(e, image, 0, 0, 16, 16);
+        e->layer = RENDER_LAYER_BACKGROUND;
         float scale = 0.05f + randomFloat() * 0.1f;
         e->scale = scale;
         e->color.a = 64 + randomFloat() * 192;
         scaleAdd(e, scale);
-        setDuration(500 + rand() % 1000);
+        setDurationBeats((float)(1 + rand() % 2));
         setEasing(linear);
         setLoopType(PING_PONG);
         setLoop();
@@ -0,0 +1,392 @@
+/**
+* @file synth.c
+* @brief 内蔵MIDIシンセの実装
+*
+* イベントはsynthQueue*でバッファ内のフレーム位置付きで予約し、synthRenderが
+* その位置で区切りながら描画するので、発音タイミングはサンプル単位で正確になる。
+* 正弦波は多項式近似なので、テーブル参照（gather）無しでSIMD化できる
+*/
+#include "synth.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNTH_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SYNTH_SIMD_NEON 1
+#endif
+
+enum { SYNTH_EV_NOTE_OFF, SYNTH_EV_NOTE_ON, SYNTH_EV_ALL_OFF };
+enum { STAGE_OFF, STAGE_ATTACK, STAGE_DECAY, STAGE_RELEASE };
+
+#define SYNTH_SILENT 1.0e-4f
+
+static const SynthPatch patches[SYNTH_PATCH_MAX] = {
+    //  ratio  index  attack  decay  sus   release gain
+    {   1.0f,  0.9f,    2.0f, 600.0f, 0.25f, 180.0f, 0.8f }, // PIANO
+    {   0.5f,  1.2f,    3.0f, 250.0f, 0.50f,  80.0f, 0.9f }, // BASS
+    {   3.5f,  1.6f,    1.0f, 900.0f, 0.00f, 600.0f, 0.6f }, // BELL
+    {   1.0f,  0.3f,  250.0f, 800.0f, 0.80f, 500.0f, 0.5f }, // PAD
+    {   2.0f,  1.0f,    1.0f, 120.0f, 0.00f,  60.0f, 0.8f }, // PLUCK
+    {   3.7f,  3.0f,    0.5f,  60.0f, 0.00f,  40.0f, 0.9f }, // PERC
+};
+
+/**
+* @brief シンセを初期化する（全トラック無効）
+*
+* @param freq 出力のサンプリング周波数
+*/
+void synthInit(Synth* s, int freq) {
+    SDL_zerop(s);
+    s->freq = freq > 0 ? freq : 44100;
+    for (int t = 0; t < 128; t++) {
+        s->trackPatch[t] = SYNTH_PATCH_PIANO;
+        s->trackGainL[t] = s->trackGainR[t] = 0.70710678f;
+    }
+}
+
+/**
+* @brief トラックの発音設定
+*
+* @param enabled falseならそのトラックのノートは無視する（鳴っている音はリリース）
+* @param patch 音色
+* @param gain 音量
+* @param pan -1（左）～1（右）
+*/
+void synthSetTrack(Synth* s, uint8_t track, bool enabled, SynthPatchId patch, float gain, float pan) {
+    if (track >= 128) return;
+    if (patch < 0 || patch >= SYNTH_PATCH_MAX) patch = SYNTH_PATCH_PIANO;
+    if (pan < -1.0f) pan = -1.0f;
+    if (pan > 1.0f) pan = 1.0f;
+
+    // 等パワーパン
+    float a = (pan + 1.0f) * 0.25f * 3.14159265f;
+    s->trackOn[track] = enabled;
+    s->trackPatch[track] = (uint8_t)patch;
+    s->trackGainL[track] = gain * cosf(a);
+    s->trackGainR[track] = gain * sinf(a);
+
+    if (!enabled) {
+        for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+            if (s->stage[v] != STAGE_OFF && s->track[v] == track) s->stage[v] = STAGE_RELEASE;
+        }
+    }
+}
+
+bool synthTrackEnabled(const Synth* s, uint8_t track) {
+    return track < 128 && s->trackOn[track];
+}
+
+/**
+* @brief ノートイベントを予約する
+*
+* 最後の1つは全ノートオフ用に空けておくので、積めるのはSYNTH_EVENT_MAX - 1個まで
+*
+* @param frame 次のsynthRenderで描画するバッファ内の位置（昇順に積むこと）
+*/
+void synthQueueNote(Synth* s, int frame, uint8_t track, uint8_t note, uint8_t vel, bool on) {
+    if (track >= 128 || !s->trackOn[track]) return;
+    if (s->queueCount >= SYNTH_EVENT_MAX - 1) return;
+    SynthEvent* e = &s->queue[s->queueCount++];
+    e->frame = frame;
+    e->kind = (on && vel > 0) ? SYNTH_EV_NOTE_ON : SYNTH_EV_NOTE_OFF;
+    e->track = track;
+    e->note = note;
+    e->vel = vel;
+}
+
+/**
+* @brief 全ノートのリリースを予約する（ループで先頭へ戻るときなど）
+*
+* ノートで埋まっていても空けておいた最後の場所に積める。そこも使っていれば、
+* 最後は全ノートオフでその後に積んだものは無いので、積まなくても同じ
+*/
+void synthQueueAllNotesOff(Synth* s, int frame) {
+    if (s->queueCount >= SYNTH_EVENT_MAX) return;
+    SynthEvent* e = &s->queue[s->queueCount++];
+    SDL_zerop(e);
+    e->frame = frame;
+    e->kind = SYNTH_EV_ALL_OFF;
+}
+
+/**
+* @brief 全ボイスを即座に止め、予約も破棄する
+*/
+void synthAllNotesOff(Synth* s) {
+    for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+        s->stage[v] = STAGE_OFF;
+        s->env[v] = 0.0f;
+    }
+    s->active = 0;
+    s->queueCount = 0;
+}
+
+int synthActiveVoices(const Synth* s) {
+    return s->active;
+}
+
+/**
+* @brief 割り当てるボイスを選ぶ（空き → 同じ音の再発音 → リリース中で一番小さい音 → 一番古い音）
+*/
+static int pick_voice(Synth* s, uint8_t track, uint8_t note) {
+    int freeV = -1, sameV = -1, quietV = -1, oldV = -1;
+    float quiet = 2.0f;
+    uint32_t oldest = 0;
+    for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+        uint8_t stg = s->stage[v];
+        if (stg == STAGE_OFF) {
+            if (freeV < 0) freeV = v;
+            continue;
+        }
+        if (s->track[v] == track && s->note[v] == note) sameV = v;
+        if (stg == STAGE_RELEASE && s->env[v] < quiet) {
+            quiet = s->env[v];
+            quietV = v;
+        }
+        uint32_t age = s->ageCounter - s->age[v];
+        if (oldV < 0 || age > oldest) {
+            oldest = age;
+            oldV = v;
+        }
+    }
+    if (sameV >= 0) return sameV;
+    if (freeV >= 0) return freeV;
+    s->stolen++;
+    return quietV >= 0 ? quietV : oldV;
+}
+
+static void note_on(Synth* s, const SynthEvent* e) {
+    int v = pick_voice(s, e->track, e->note);
+    const SynthPatch* p = &patches[s->trackPatch[e->track]];
+    float fs = (float)s->freq;
+    float hz = 440.0f * powf(2.0f, ((float)e->note - 69.0f) / 12.0f);
+    float vel = (float)e->vel / 127.0f;
+
+    if (s->stage[v] == STAGE_OFF) {
+        s->active++;
+        s->phase[v] = 0.0f;
+        s->modPhase[v] = 0.0f;
+        s->env[v] = 0.0f;
+    }
+    // スチール/再発音時は位相と現在のエンベロープを引き継いでクリックを抑える
+    s->inc[v] = hz / fs;
+    s->modInc[v] = hz * p->ratio / fs;
+    s->modIndex[v] = p->index;
+    s->amp[v] = vel * vel * p->gain;
+    s->gainL[v] = s->trackGainL[e->track];
+    s->gainR[v] = s->trackGainR[e->track];
+    s->attackStep[v] = 1000.0f / (p->attackMs * fs);
+    s->decayFrames[v] = p->decayMs * fs / 1000.0f;
+    s->sustain[v] = p->sustain;
+    s->releaseFrames[v] = p->releaseMs * fs / 1000.0f;
+    s->stage[v] = STAGE_ATTACK;
+    s->note[v] = e->note;
+    s->track[v] = e->track;
+    s->age[v] = s->ageCounter++;
+}
+
+static void apply_event(Synth* s, const SynthEvent* e) {
+    switch (e->kind) {
+    case SYNTH_EV_NOTE_ON:
+        note_on(s, e);
+        break;
+    case SYNTH_EV_NOTE_OFF:
+        for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+            if (s->stage[v] != STAGE_OFF && s->stage[v] != STAGE_RELEASE &&
+                s->track[v] == e->track && s->note[v] == e->note) {
+                s->stage[v] = STAGE_RELEASE;
+            }
+        }
+        break;
+    case SYNTH_EV_ALL_OFF:
+        for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+            if (s->stage[v] != STAGE_OFF) s->stage[v] = STAGE_RELEASE;
+        }
+        break;
+    }
+}
+
+/**
+* @brief len フレーム後のエンベロープ値を求め、段階を進める
+*/
+static float envelope_end(Synth* s, int v, int len) {
+    float e = s->env[v];
+    switch (s->stage[v]) {
+    case STAGE_ATTACK:
+        e += s->attackStep[v] * (float)len;
+        if (e >= 1.0f) {
+            e = 1.0f;
+            s->stage[v] = STAGE_DECAY;
+        }
+        break;
+    case STAGE_DECAY: {
+        float sus = s->sustain[v];
+        e = sus + (e - sus) * expf(-(float)len / s->decayFrames[v]);
+        if (sus <= 0.0f && e < SYNTH_SILENT) e = 0.0f;
+        break;
+    }
+    case STAGE_RELEASE:
+        e *= expf(-(float)len / s->releaseFrames[v]);
+        if (e < SYNTH_SILENT) e = 0.0f;
+        break;
+    }
+    return e;
+}
+
+/**
+* @brief sin(2πx)の近似（xは周期単位、任意の範囲）
+*/
+static inline float sin_turns(float x) {
+    float t = x - floorf(x + 0.5f);
+    float s = 2.0f * t;
+    float y = 4.0f * s * (1.0f - fabsf(s));
+    return y + 0.225f * (y * fabsf(y) - y);
+}
+
+/**
+* @brief 1ボイスをlenフレーム分描画してL/Rに加算する
+*/
+static void render_voice(Synth* s, int v, float* L, float* R, int len) {
+    float p = s->phase[v], pi = s->inc[v];
+    float m = s->modPhase[v], mi = s->modInc[v];
+    float idx = s->modIndex[v];
+    float e0 = s->env[v];
+    float e1 = envelope_end(s, v, len);
+    float es = (e1 - e0) / (float)len;
+    float amp = s->amp[v];
+    float gl = s->gainL[v], gr = s->gainR[v];
+
+    int k = 0;
+#if defined(SYNTH_SIMD_SSE)
+    const __m128 ramp = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 vIdx = _mm_set1_ps(idx), vAmp = _mm_set1_ps(amp);
+    const __m128 vgl = _mm_set1_ps(gl), vgr = _mm_set1_ps(gr);
+    const __m128 rp = _mm_mul_ps(ramp, _mm_set1_ps(pi));
+    const __m128 rm = _mm_mul_ps(ramp, _mm_set1_ps(mi));
+    const __m128 re = _mm_mul_ps(ramp, _mm_set1_ps(es));
+#define SYNTH_SIN4(x, out) do { \
+        __m128 a_ = _mm_add_ps(x, half); \
+        __m128 f_ = _mm_cvtepi32_ps(_mm_cvttps_epi32(a_)); \
+        f_ = _mm_sub_ps(f_, _mm_and_ps(_mm_cmpgt_ps(f_, a_), one)); \
+        __m128 s_ = _mm_add_ps(_mm_sub_ps(x, f_), _mm_sub_ps(x, f_)); \
+        __m128 y_ = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), s_), _mm_sub_ps(one, _mm_and_ps(s_, absMask))); \
+        out = _mm_add_ps(y_, _mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(y_, _mm_and_ps(y_, absMask)), y_))); \
+    } while (0)
+    for (; k + 4 <= len; k += 4) {
+        float kf = (float)k;
+        __m128 P = _mm_add_ps(_mm_set1_ps(p + kf * pi), rp);
+        __m128 M = _mm_add_ps(_mm_set1_ps(m + kf * mi), rm);
+        __m128 E = _mm_add_ps(_mm_set1_ps(e0 + kf * es), re);
+        __m128 mod, car;
+        SYNTH_SIN4(M, mod);
+        __m128 arg = _mm_add_ps(P, _mm_mul_ps(_mm_mul_ps(mod, vIdx), E));
+        SYNTH_SIN4(arg, car);
+        __m128 out = _mm_mul_ps(_mm_mul_ps(car, E), vAmp);
+        _mm_storeu_ps(L + k, _mm_add_ps(_mm_loadu_ps(L + k), _mm_mul_ps(out, vgl)));
+        _mm_storeu_ps(R + k, _mm_add_ps(_mm_loadu_ps(R + k), _mm_mul_ps(out, vgr)));
+    }
+#undef SYNTH_SIN4
+#elif defined(SYNTH_SIMD_NEON)
+    const float rampArr[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    const float32x4_t ramp = vld1q_f32(rampArr);
+    const float32x4_t half = vdupq_n_f32(0.5f), one = vdupq_n_f32(1.0f);
+    const float32x4_t vIdx = vdupq_n_f32(idx), vAmp = vdupq_n_f32(amp);
+    const float32x4_t vgl = vdupq_n_f32(gl), vgr = vdupq_n_f32(gr);
+    const float32x4_t rp = vmulq_n_f32(ramp, pi);
+    const float32x4_t rm = vmulq_n_f32(ramp, mi);
+    const float32x4_t re = vmulq_n_f32(ramp, es);
+#define SYNTH_SIN4(x, out) do { \
+        float32x4_t a_ = vaddq_f32(x, half); \
+        float32x4_t f_ = vcvtq_f32_s32(vcvtq_s32_f32(a_)); \
+        f_ = vsubq_f32(f_, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(f_, a_), vreinterpretq_u32_f32(one)))); \
+        float32x4_t s_ = vmulq_n_f32(vsubq_f32(x, f_), 2.0f); \
+        float32x4_t y_ = vmulq_f32(vmulq_n_f32(s_, 4.0f), vsubq_f32(one, vabsq_f32(s_))); \
+        out = vaddq_f32(y_, vmulq_n_f32(vsubq_f32(vmulq_f32(y_, vabsq_f32(y_)), y_), 0.225f)); \
+    } while (0)
+    for (; k + 4 <= len; k += 4) {
+        float kf = (float)k;
+        float32x4_t P = vaddq_f32(vdupq_n_f32(p + kf * pi), rp);
+        float32x4_t M = vaddq_f32(vdupq_n_f32(m + kf * mi), rm);
+        float32x4_t E = vaddq_f32(vdupq_n_f32(e0 + kf * es), re);
+        float32x4_t mod, car;
+        SYNTH_SIN4(M, mod);
+        float32x4_t arg = vaddq_f32(P, vmulq_f32(vmulq_f32(mod, vIdx), E));
+        SYNTH_SIN4(arg, car);
+        float32x4_t out = vmulq_f32(vmulq_f32(car, E), vAmp);
+        vst1q_f32(L + k, vaddq_f32(vld1q_f32(L + k), vmulq_f32(out, vgl)));
+        vst1q_f32(R + k, vaddq_f32(vld1q_f32(R + k), vmulq_f32(out, vgr)));
+    }
+#undef SYNTH_SIN4
+#endif
+    for (; k < len; k++) {
+        float kf = (float)k;
+        float E = e0 + kf * es;
+        float mod = sin_turns(m + kf * mi) * idx * E;
+        float out = sin_turns(p + kf * pi + mod) * E * amp;
+        L[k] += out * gl;
+        R[k] += out * gr;
+    }
+
+    p += pi * (float)len;
+    m += mi * (float)len;
+    s->phase[v] = p - floorf(p);
+    s->modPhase[v] = m - floorf(m);
+    s->env[v] = e1;
+
+    if (e1 <= 0.0f && s->stage[v] != STAGE_ATTACK) {
+        s->stage[v] = STAGE_OFF;
+        s->active--;
+    }
+}
+
+/**
+* @brief 予約イベントを処理しながらframesフレーム分を描画し、outに加算する
+*
+* @param out インターリーブのfloat32（加算する）
+* @param channels 出力チャンネル数（1ならL/Rの平均）
+* @param gain 全体の音量
+*/
+void synthRender(Synth* s, float* out, int frames, int channels, float gain) {
+    float L[SYNTH_BLOCK];
+    float R[SYNTH_BLOCK];
+    int qi = 0;
+    int pos = 0;
+
+    while (pos < frames) {
+        while (qi < s->queueCount && s->queue[qi].frame <= pos) {
+            apply_event(s, &s->queue[qi++]);
+        }
+        int next = pos + SYNTH_BLOCK;
+        if (next > frames) next = frames;
+        if (qi < s->queueCount && s->queue[qi].frame < next) next = s->queue[qi].frame;
+        int len = next - pos;
+
+        if (s->active > 0) {
+            SDL_memset(L, 0, (size_t)len * sizeof(float));
+            SDL_memset(R, 0, (size_t)len * sizeof(float));
+            for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+                if (s->stage[v] != STAGE_OFF) render_voice(s, v, L, R, len);
+            }
+
+            float* o = out + (size_t)pos * channels;
+            if (channels == 1) {
+                for (int k = 0; k < len; k++) o[k] += (L[k] + R[k]) * 0.5f * gain;
+            }
+            else {
+                for (int k = 0; k < len; k++) {
+                    o[k * channels] += L[k] * gain;
+                    o[k * channels + 1] += R[k] * gain;
+                }
+            }
+        }
+        pos = next;
+    }
+
+    // バッファ外の位置で積まれたものは末尾で処理する
+    while (qi < s->queueCount) apply_event(s, &s->queue[qi++]);
+    s->queueCount = 0;
+}
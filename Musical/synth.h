@@ -0,0 +1,99 @@
+/**
+* @file synth.h
+* @brief 内蔵MIDIシンセ（2オペレータFM）ヘッダ
+*
+* MidiSongのノートイベントからトラック単位で音を生成する。
+* ボイスはSoAで持ち、1ボイスずつ4フレーム単位のSIMDで描画する
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYNTH_VOICE_MAX     48      ///< 同時発音数
+#define SYNTH_EVENT_MAX     512     ///< 1バッファで予約できるイベント数（最後の1つは全ノートオフ用）
+#define SYNTH_BLOCK         64      ///< エンベロープの更新間隔(frames)
+
+/**
+* @brief 音色
+*/
+typedef enum {
+    SYNTH_PATCH_PIANO,
+    SYNTH_PATCH_BASS,
+    SYNTH_PATCH_BELL,
+    SYNTH_PATCH_PAD,
+    SYNTH_PATCH_PLUCK,
+    SYNTH_PATCH_PERC,
+    SYNTH_PATCH_MAX
+} SynthPatchId;
+
+/**
+* @brief 音色のパラメータ
+*/
+typedef struct {
+    float ratio;        ///< モジュレータ周波数/キャリア周波数
+    float index;        ///< 変調の深さ（周期単位）
+    float attackMs;
+    float decayMs;      ///< サステインレベルへの時定数
+    float sustain;      ///< 0～1
+    float releaseMs;    ///< ノートオフ後の時定数
+    float gain;
+} SynthPatch;
+
+/**
+* @brief 予約イベント（バッファ内のフレーム位置で処理する）
+*/
+typedef struct {
+    int frame;
+    uint8_t kind;       ///< ノートオン/オフ/全ノートオフ
+    uint8_t track;
+    uint8_t note;
+    uint8_t vel;
+} SynthEvent;
+
+/**
+* @brief シンセ本体
+*/
+typedef struct {
+    int freq;
+
+    // ボイス（SoA）
+    float phase[SYNTH_VOICE_MAX];       ///< キャリアの位相（周期単位）
+    float inc[SYNTH_VOICE_MAX];         ///< 1フレームあたりの位相増分
+    float modPhase[SYNTH_VOICE_MAX];
+    float modInc[SYNTH_VOICE_MAX];
+    float modIndex[SYNTH_VOICE_MAX];
+    float env[SYNTH_VOICE_MAX];
+    float amp[SYNTH_VOICE_MAX];
+    float gainL[SYNTH_VOICE_MAX];
+    float gainR[SYNTH_VOICE_MAX];
+    float attackStep[SYNTH_VOICE_MAX];  ///< アタックの1フレームあたりの増分
+    float decayFrames[SYNTH_VOICE_MAX];
+    float sustain[SYNTH_VOICE_MAX];
+    float releaseFrames[SYNTH_VOICE_MAX];
+    uint8_t stage[SYNTH_VOICE_MAX];
+    uint8_t note[SYNTH_VOICE_MAX];
+    uint8_t track[SYNTH_VOICE_MAX];
+    uint32_t age[SYNTH_VOICE_MAX];      ///< 発音順（ボイススチール用）
+    uint32_t ageCounter;
+    int active;                         ///< 発音中のボイス数
+    uint64_t stolen;                    ///< スチールした回数（累計）
+
+    // トラックごとの設定
+    bool trackOn[128];
+    uint8_t trackPatch[128];
+    float trackGainL[128];
+    float trackGainR[128];
+
+    SynthEvent queue[SYNTH_EVENT_MAX];
+    int queueCount;
+} Synth;
+
+void synthInit(Synth* s, int freq);
+void synthSetTrack(Synth* s, uint8_t track, bool enabled, SynthPatchId patch, float gain, float pan);
+bool synthTrackEnabled(const Synth* s, uint8_t track);
+void synthQueueNote(Synth* s, int frame, uint8_t track, uint8_t note, uint8_t vel, bool on);
+void synthQueueAllNotesOff(Synth* s, int frame);
+void synthAllNotesOff(Synth* s);
+void synthRender(Synth* s, float* out, int frames, int channels, float gain);
+int synthActiveVoices(const Synth* s);
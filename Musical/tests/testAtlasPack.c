@@ -0,0 +1,254 @@
+/**
+* @file testAtlasPack.c
+* @brief atlasPackのzlib展開と.asepriteの読み取り（セル・レイヤー・パレット）のテスト
+*
+* 静的関数を使うので、tools/atlasPack.cをmainの名前を替えて取り込む
+*/
+#include "testUtil.h"
+#define main atlasPackMain
+#include "tools/atlasPack.c"
+#undef main
+
+// zlib.compress(b"abcabcabcabcabc hello hello", 9)
+static const Uint8 fixedZ[] = {
+    0x78, 0xda, 0x4b, 0x4c, 0x4a, 0x4e, 0x44, 0x42, 0x0a, 0x19, 0xa9, 0x39,
+    0x39, 0xf9, 0x10, 0x12, 0x00, 0x8d, 0xef, 0x0a, 0x27
+};
+
+/**
+* @brief 展開できたバイト数を返し、壊れたものや出力に収まらないものは0を返す
+*/
+static void test_inflate(void) {
+    static const char fixed[] = "abcabcabcabcabc hello hello";
+    Uint8 out[64];
+    TEST_CHECK(zlib_inflate(fixedZ, sizeof(fixedZ), out, sizeof(out)) == sizeof(fixed) - 1);
+    TEST_CHECK(memcmp(out, fixed, sizeof(fixed) - 1) == 0);
+    TEST_CHECK(zlib_inflate(fixedZ, sizeof(fixedZ) / 2, out, sizeof(out)) == 0);
+    TEST_CHECK(zlib_inflate(fixedZ, sizeof(fixedZ), out, sizeof(fixed) - 2) == 0);
+
+    Uint8 bad[sizeof(fixedZ)];
+    memcpy(bad, fixedZ, sizeof(bad));
+    bad[1] ^= 1;
+    TEST_CHECK(zlib_inflate(bad, sizeof(bad), out, sizeof(out)) == 0);
+}
+
+/* =========================================================
+   テスト用の.aseprite（1フレーム）を組み立てる
+   ========================================================= */
+
+typedef struct {
+    Uint8 buf[4096];
+    size_t len;
+    int chunks;
+} AseBuilder;
+
+static void put8(AseBuilder* b, int v) {
+    b->buf[b->len++] = (Uint8)v;
+}
+
+static void put16(AseBuilder* b, int v) {
+    put8(b, v & 0xFF);
+    put8(b, (v >> 8) & 0xFF);
+}
+
+static void put32(AseBuilder* b, Uint32 v) {
+    put16(b, (int)(v & 0xFFFF));
+    put16(b, (int)(v >> 16));
+}
+
+static void set32(AseBuilder* b, size_t at, Uint32 v) {
+    for (int k = 0; k < 4; k++) b->buf[at + k] = (Uint8)(v >> (k * 8));
+}
+
+/**
+* @brief 見出し（headerFlagsはレイヤーの不透明度が有効かのフラグ）とフレームの見出し
+*/
+static void ase_begin(AseBuilder* b, int w, int h, int depth, Uint32 headerFlags) {
+    SDL_zerop(b);
+    put32(b, 0);
+    put16(b, 0xA5E0);
+    put16(b, 1);
+    put16(b, w);
+    put16(b, h);
+    put16(b, depth);
+    put32(b, headerFlags);
+    b->len = 128;
+    put32(b, 0);
+    put16(b, 0xF1FA);
+    put16(b, 0);
+    put16(b, 100);
+    b->len = 128 + 16;
+}
+
+static size_t chunk_begin(AseBuilder* b, int type) {
+    size_t at = b->len;
+    put32(b, 0);
+    put16(b, type);
+    b->chunks++;
+    return at;
+}
+
+static void chunk_end(AseBuilder* b, size_t at) {
+    set32(b, at, (Uint32)(b->len - at));
+}
+
+static void ase_end(AseBuilder* b) {
+    set32(b, 0, (Uint32)b->len);
+    set32(b, 128, (Uint32)(b->len - 128));
+    b->buf[128 + 6] = (Uint8)b->chunks;
+    set32(b, 128 + 12, (Uint32)b->chunks);
+}
+
+/**
+* @brief レイヤー（group=trueならグループ、levelは階層）
+*/
+static void add_layer(AseBuilder* b, bool visible, bool group, int level, int opacity) {
+    size_t at = chunk_begin(b, 0x2004);
+    put16(b, visible ? 1 : 0);
+    put16(b, group ? 1 : 0);
+    put16(b, level);
+    put16(b, 0);
+    put16(b, 0);
+    put16(b, 0);
+    put8(b, opacity);
+    b->len += 3;
+    put16(b, 0);
+    chunk_end(b, at);
+}
+
+/**
+* @brief 位置(0,0)・1x1の無圧縮のセル（画素はdepth/8バイト）
+*/
+static void add_cel(AseBuilder* b, int layer, const Uint8* pixel, int bytes) {
+    size_t at = chunk_begin(b, 0x2005);
+    put16(b, layer);
+    put16(b, 0);
+    put16(b, 0);
+    put8(b, 255);
+    put16(b, 0);
+    b->len += 7;
+    put16(b, 1);
+    put16(b, 1);
+    for (int k = 0; k < bytes; k++) put8(b, pixel[k]);
+    chunk_end(b, at);
+}
+
+/**
+* @brief 組み立てたものを読み、左上の画素を返す
+*/
+static bool parse_pixel(AseBuilder* b, Uint8 rgba[4]) {
+    ase_end(b);
+    PackItem item;
+    SDL_zero(item);
+    if (!parse_aseprite("test", b->buf, b->len, &item)) return false;
+    memcpy(rgba, item.surface->pixels, 4);
+    SDL_FreeSurface(item.surface);
+    return true;
+}
+
+static const Uint8 red[4] = { 255, 0, 0, 255 };
+
+/**
+* @brief レイヤーの不透明度は、見出しのフラグで有効になっているときだけ使う
+*/
+static void test_layer_opacity_flag(void) {
+    AseBuilder b;
+    Uint8 px[4];
+    ase_begin(&b, 1, 1, 32, 0);
+    add_layer(&b, true, false, 0, 128);
+    add_cel(&b, 0, red, 4);
+    TEST_CHECK(parse_pixel(&b, px));
+    TEST_CHECK(px[0] == 255 && px[3] == 255);
+
+    ase_begin(&b, 1, 1, 32, 1);
+    add_layer(&b, true, false, 0, 128);
+    add_cel(&b, 0, red, 4);
+    TEST_CHECK(parse_pixel(&b, px));
+    TEST_CHECK(px[0] == 255 && px[3] == 128);
+}
+
+/**
+* @brief 隠れたグループの中のレイヤーは、自分が見えていても重ねない
+*/
+static void test_hidden_group(void) {
+    AseBuilder b;
+    Uint8 px[4];
+    for (int groupVisible = 0; groupVisible < 2; groupVisible++) {
+        ase_begin(&b, 1, 1, 32, 1);
+        add_layer(&b, true, true, 0, 255);
+        add_layer(&b, groupVisible != 0, true, 1, 255);
+        add_layer(&b, true, false, 2, 255);
+        add_layer(&b, true, false, 0, 255);
+        add_cel(&b, 2, red, 4);
+        TEST_CHECK(parse_pixel(&b, px));
+        TEST_CHECK(px[3] == (groupVisible ? 255 : 0));
+    }
+
+    // グループの後の同じ階層のレイヤーは、グループの見え方に引きずられない
+    ase_begin(&b, 1, 1, 32, 1);
+    add_layer(&b, false, true, 0, 255);
+    add_layer(&b, true, false, 1, 255);
+    add_layer(&b, true, false, 0, 255);
+    add_cel(&b, 2, red, 4);
+    TEST_CHECK(parse_pixel(&b, px));
+    TEST_CHECK(px[3] == 255);
+}
+
+/**
+* @brief 新しい形式のパレットはfirst～lastの番号だけ書き換える（パレット全体の大きさの数だけ読まない）
+*/
+static void test_palette_range(void) {
+    AseBuilder b;
+    Uint8 px[4];
+    for (int index = 1; index <= 2; index++) {
+        ase_begin(&b, 1, 1, 8, 1);
+        size_t at = chunk_begin(&b, 0x2019);
+        put32(&b, 256);
+        put32(&b, 1);
+        put32(&b, 1);
+        b.len += 8;
+        const Uint8 entry[6] = { 0, 0, 255, 0, 0, 255 };
+        for (int k = 0; k < 6; k++) put8(&b, entry[k]);
+        // チャンクの後ろの余りは番号2の色ではない
+        const Uint8 tail[6] = { 0, 0, 0, 0, 255, 255 };
+        for (int k = 0; k < 6; k++) put8(&b, tail[k]);
+        chunk_end(&b, at);
+        add_layer(&b, true, false, 0, 255);
+        const Uint8 pixel = (Uint8)index;
+        add_cel(&b, 0, &pixel, 1);
+        TEST_CHECK(parse_pixel(&b, px));
+        if (index == 1) TEST_CHECK(px[0] == 255 && px[3] == 255);
+        else TEST_CHECK(px[3] == 0);
+    }
+}
+
+/**
+* @brief リンクされたセルは参照先のフレーム番号まで無ければ壊れているとみなす
+*/
+static void test_short_linked_cel(void) {
+    static AseFile a;
+    static const Uint8* cels[2 * ASE_LAYER_MAX];
+    static size_t celLength[2 * ASE_LAYER_MAX];
+    a.cel = cels;
+    a.celLength = celLength;
+    a.path = "test";
+    a.w = a.h = 1;
+    a.depth = 32;
+    a.layerCount = 1;
+    a.layers[0].visible = true;
+    a.layers[0].opacity = 255;
+    // レイヤー0、位置(0,0)、不透明度255、種類1（リンク）、参照先のフレーム番号は切れている
+    Uint8 cel[18] = { 0, 0, 0, 0, 0, 0, 255, 1, 0 };
+    TEST_CHECK(!draw_cel(&a, 1, cel, 16));
+    // 参照先が前のフレームに無いだけなら、壊れてはいない（何も重ねない）
+    TEST_CHECK(draw_cel(&a, 1, cel, sizeof(cel)));
+}
+
+int main(void) {
+    test_inflate();
+    test_short_linked_cel();
+    test_layer_opacity_flag();
+    test_hidden_group();
+    test_palette_range();
+    return testResult("testAtlasPack");
+}
@@ -0,0 +1,82 @@
+/**
+* @file testAudioProfiler.c
+* @brief オーディオコールバックの負荷の集計（パーセンタイル・古い計測値の入れ替え）のテスト
+*/
+#include "testUtil.h"
+#include "audioProfiler.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+
+#define FREQ    48000
+
+/**
+* @brief 負荷率loadのコールバックを1回記録する（周期1秒）
+*/
+static void record(float load) {
+    Uint64 perfFreq = SDL_GetPerformanceFrequency();
+    audioProfilerRecord(0, (Uint64)((double)load * (double)perfFreq + 0.5), FREQ, FREQ);
+}
+
+static int cmp_float(const void* a, const void* b) {
+    float A = *(const float*)a;
+    float B = *(const float*)b;
+    return (A > B) - (A < B);
+}
+
+/**
+* @brief 並べ替えて求めたパーセンタイルと1%刻みで一致する
+*/
+static void test_percentiles(void) {
+    static float loads[AUDIO_PROFILE_RING];
+    audioProfilerReset();
+    Uint32 state = 3;
+    for (int i = 0; i < AUDIO_PROFILE_RING; i++) {
+        state = state * 1664525u + 1013904223u;
+        loads[i] = (float)(state >> 8) / (float)(1u << 24) * 1.2f;
+        record(loads[i]);
+    }
+    audioProfilerPoll();
+    AudioProfileStats s;
+    audioProfilerGetStats(&s);
+
+    qsort(loads, AUDIO_PROFILE_RING, sizeof(float), cmp_float);
+    TEST_CHECK(s.count == AUDIO_PROFILE_RING);
+    TEST_NEAR(s.p50, loads[(AUDIO_PROFILE_RING - 1) / 2], 0.005 + 1e-6);
+    TEST_NEAR(s.p99, loads[(int)((AUDIO_PROFILE_RING - 1) * 0.99)], 0.005 + 1e-6);
+    TEST_NEAR(s.max, loads[AUDIO_PROFILE_RING - 1], 1e-4);
+    int inBins = 0;
+    for (int b = 0; b < AUDIO_PROFILE_BINS; b++) inBins += s.histogram[b];
+    TEST_CHECK(inBins == AUDIO_PROFILE_RING);
+}
+
+/**
+* @brief 新しい計測値で埋まれば、古いものは集計（最大値も）から外れる
+*/
+static void test_window_slides(void) {
+    audioProfilerReset();
+    record(0.95f);
+    for (int i = 1; i < AUDIO_PROFILE_RING; i++) record(0.1f);
+    audioProfilerPoll();
+    AudioProfileStats s;
+    audioProfilerGetStats(&s);
+    TEST_NEAR(s.max, 0.95, 1e-4);
+    TEST_NEAR(s.p50, 0.105, 1e-4);
+
+    for (int i = 0; i < AUDIO_PROFILE_RING / 2; i++) record(0.3f);
+    audioProfilerPoll();
+    audioProfilerGetStats(&s);
+    // 半分ずつなので中央値は小さい方、99パーセンタイルは最大値を超えない
+    TEST_NEAR(s.max, 0.3, 1e-4);
+    TEST_NEAR(s.p50, 0.105, 1e-4);
+    TEST_NEAR(s.p99, 0.3, 1e-4);
+    TEST_NEAR(s.mean, 0.2, 1e-4);
+    TEST_CHECK(s.histogram[2] == AUDIO_PROFILE_RING / 2 && s.histogram[6] == AUDIO_PROFILE_RING / 2);
+    TEST_CHECK(s.histogram[AUDIO_PROFILE_BINS - 1] == 0);
+    TEST_CHECK(s.total == AUDIO_PROFILE_RING * 3 / 2);
+}
+
+int main(void) {
+    test_percentiles();
+    test_window_slides();
+    return testResult("testAudioProfiler");
+}
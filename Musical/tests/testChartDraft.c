@@ -0,0 +1,101 @@
+/**
+* @file testChartDraft.c
+* @brief 譜面の下書きのテスト
+*
+* 書き出したSMFをload_midi_build_eventsで読み戻し、ノートが元のオンセットの位置に鳴ることを確かめる
+*/
+#include "testUtil.h"
+#include "chartDraft.h"
+#include "midi_smf.h"
+#include <SDL2/SDL.h>
+
+#define FREQ        48000
+#define SMF_PATH    "testChartDraft.mid"
+
+/**
+* @brief 下書きを書き出して読み戻し、ノートオンの位置を元のオンセットと比べる
+*
+* @param pickupTol 弱起の中で許すずれ(frames)
+* @param tol 1拍目以降で許すずれ(frames)
+*/
+static void check_round_trip(const ChartDraft* d, int subdivision, double pickupTol, double tol) {
+    TEST_CHECK(chartDraftWriteSmf(d, SMF_PATH, subdivision));
+    MidiSong song;
+    TEST_CHECK(load_midi_build_events(SMF_PATH, FREQ, &song));
+    TEST_CHECK(song.trackCount == 1 + CHART_LANE_MAX);
+
+    int found = 0;
+    for (int i = 0; i < d->count; i++) {
+        const ChartOnset* o = &d->onsets[i];
+        int64_t best = -1;
+        for (int k = 0; k < song.evCount; k++) {
+            const MidiNoteEvent* e = &song.ev[k];
+            if (!e->on || e->track != 1 + o->lane) continue;
+            if (best < 0 || llabs(e->sample - o->frame) < llabs(best - o->frame)) best = e->sample;
+        }
+        TEST_CHECK(best >= 0);
+        if (best < 0) continue;
+        found++;
+        TEST_NEAR((double)best, (double)o->frame, (double)o->frame < d->beatFrame ? pickupTol : tol);
+    }
+    TEST_CHECK(found == d->count);
+    free_midi_song(&song);
+    remove(SMF_PATH);
+}
+
+static void test_smf_round_trip(void) {
+    // 120BPM（1拍24000frames）、最初の拍は0.3拍目
+    ChartOnset onsets[] = {
+        { 1200, CHART_LANE_ALL, 100 },      // 弱起の中（1拍目の0.25拍前）
+        { 5400, CHART_LANE_LOW, 90 },       // 弱起の中（1拍目の0.075拍前）
+        { 7200, CHART_LANE_ALL, 120 },      // 1拍目
+        { 13200, CHART_LANE_HIGH, 60 },     // 16分1つ後
+        { 31200, CHART_LANE_ALL, 110 },     // 2拍目
+        { 44000, CHART_LANE_LOW, 80 },      // グリッドから外れた位置
+        { 79200, CHART_LANE_ALL, 127 },
+    };
+    ChartDraft d;
+    SDL_zero(d);
+    d.freq = FREQ;
+    d.frames = FREQ * 4;
+    d.bpm = 120.0;
+    d.beatFrame = 7200.0;
+    d.onsets = onsets;
+    d.count = (int)SDL_arraysize(onsets);
+
+    double beatLen = 60.0 * FREQ / d.bpm;
+    double pickupTick = d.beatFrame / CHART_TPQN;
+    double tick = beatLen / CHART_TPQN;
+
+    // グリッドに寄せないときは1tick以内
+    check_round_trip(&d, 0, pickupTick, tick);
+    // 弱起は弱起の長さの1/4、以降は1拍の1/4の刻みに寄る
+    check_round_trip(&d, 4, d.beatFrame / 8.0 + pickupTick, beatLen / 8.0 + tick);
+}
+
+static void test_tempo_detection(void) {
+    // 120BPMのクリック（最初の拍は0.1秒後）
+    int64_t frames = (int64_t)FREQ * 20;
+    float* music = (float*)SDL_calloc((size_t)frames, sizeof(float));
+    TEST_CHECK(music != NULL);
+    if (!music) return;
+    for (int64_t beat = FREQ / 10; beat < frames; beat += FREQ / 2) {
+        for (int i = 0; i < 400 && beat + i < frames; i++) {
+            music[beat + i] = 0.8f * sinf(2.0f * 3.14159265f * 1000.0f * (float)i / FREQ) * expf(-(float)i / 100.0f);
+        }
+    }
+
+    ChartDraft d;
+    TEST_CHECK(chartDraftBuild(&d, music, frames, 1, FREQ));
+    TEST_NEAR(d.bpm, 120.0, 1.0);
+    TEST_NEAR(d.beatFrame, FREQ / 10, FREQ * 0.01);
+    TEST_CHECK(d.count >= 35);
+    chartDraftFree(&d);
+    SDL_free(music);
+}
+
+int main(void) {
+    test_smf_round_trip();
+    test_tempo_detection();
+    return testResult("testChartDraft");
+}
@@ -0,0 +1,46 @@
+/**
+* @file testEasing.c
+* @brief easingBatch・easingEvalと元のeasing関数の比較
+*/
+#include "testUtil.h"
+#include "easing.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#define GRID    20001                   ///< 0〜1を等分した点の数
+#define EXTRA   8                       ///< 端のすぐ内側・範囲外の点
+#define TOL     2e-5f
+
+static float t[GRID + EXTRA];
+static float batch[GRID + EXTRA];
+
+int main(void) {
+    for (int i = 0; i < GRID; i++) t[i] = (float)i / (GRID - 1);
+    static const float extra[EXTRA] = { 1e-6f, 1e-4f, 1.0f - 1e-6f, 1.0f - 1e-4f, 0.5f - 1e-6f, 0.5f + 1e-6f, -0.5f, 1.5f };
+    for (int i = 0; i < EXTRA; i++) t[GRID + i] = extra[i];
+    // 4で割り切れない個数にして、SIMDの後の端数も通す
+    int count = GRID + EXTRA - 1;
+
+    for (int id = 0; id < EASING_COUNT; id++) {
+        float (*f)(float n) = easingFunction((EasingId)id);
+        TEST_CHECK(easingIdOf(f) == (EasingId)id);
+        easingBatch((EasingId)id, t, batch, count);
+        float worst = 0.0f, worstT = 0.0f;
+        for (int i = 0; i < count; i++) {
+            float want = f(t[i]);
+            float err = fmaxf(fabsf(batch[i] - want), fabsf(easingEval((EasingId)id, t[i]) - want));
+            if (err > worst) {
+                worst = err;
+                worstT = t[i];
+            }
+        }
+        if (worst > TOL) SDL_Log("easing %d: error %g at t=%g", id, worst, worstT);
+        TEST_CHECK(worst <= TOL);
+
+        // 端は元の関数とぴったり同じ値（Expoなら0と1、ElasticとBounceは元の式どおり少し外れる）
+        float ends[6] = { 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f };
+        easingBatch((EasingId)id, ends, ends, 6);
+        for (int i = 0; i < 6; i++) TEST_CHECK(ends[i] == f((float)(i % 2)));
+    }
+    return testResult("testEasing");
+}
@@ -0,0 +1,75 @@
+/**
+* @file testFft.c
+* @brief FFTを素朴なDFTと比べるテスト
+*/
+#include "testUtil.h"
+#include "fft.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#define N_MAX   4096
+
+static float re[N_MAX], im[N_MAX];
+static float srcRe[N_MAX], srcIm[N_MAX];
+
+/**
+* @brief -1～1の決まった並びの乱数
+*/
+static float noise(Uint32* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / (float)(1u << 23) - 1.0f;
+}
+
+/**
+* @brief X[k] = Σ x[j] e^(-2πijk/n) をdoubleで直接求めて、FFTの結果との差の最大を返す
+*/
+static double dft_error(int n) {
+    double worst = 0.0;
+    for (int k = 0; k < n; k++) {
+        double sr = 0.0, si = 0.0;
+        for (int j = 0; j < n; j++) {
+            double a = -2.0 * M_PI * (double)((Sint64)j * k % n) / n;
+            sr += srcRe[j] * cos(a) - srcIm[j] * sin(a);
+            si += srcRe[j] * sin(a) + srcIm[j] * cos(a);
+        }
+        worst = fmax(worst, fmax(fabs(sr - re[k]), fabs(si - im[k])));
+    }
+    return worst;
+}
+
+static void check_size(int n) {
+    FFTPlan plan;
+    TEST_CHECK(fftPlanInit(&plan, n));
+    if (plan.n != n) return;
+    Uint32 state = (Uint32)n;
+    for (int i = 0; i < n; i++) {
+        srcRe[i] = re[i] = noise(&state);
+        srcIm[i] = im[i] = noise(&state);
+    }
+    fftForward(&plan, re, im);
+    // 値の大きさはsqrt(n)程度、単精度の丸めは段の数に比例して積もる
+    double tol = 2e-7 * sqrt((double)n) * (plan.log2n + 1);
+    double err = dft_error(n);
+    if (err > tol) SDL_Log("fft %d: error %g (tolerance %g)", n, err, tol);
+    TEST_CHECK(err <= tol);
+
+    // 逆変換で元に戻る
+    fftInverse(&plan, re, im);
+    double back = 0.0;
+    for (int i = 0; i < n; i++) {
+        back = fmax(back, fmax(fabs(re[i] - srcRe[i]), fabs(im[i] - srcIm[i])));
+    }
+    TEST_CHECK(back <= 1e-5);
+    fftPlanFree(&plan);
+}
+
+int main(void) {
+    for (int n = 2; n <= N_MAX; n *= 2) check_size(n);
+
+    // 2の累乗以外は作らない
+    FFTPlan plan;
+    TEST_CHECK(!fftPlanInit(&plan, 0));
+    TEST_CHECK(!fftPlanInit(&plan, 1));
+    TEST_CHECK(!fftPlanInit(&plan, 12));
+    return testResult("testFft");
+}
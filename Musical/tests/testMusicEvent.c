@@ -0,0 +1,215 @@
+/**
+* @file testMusicEvent.c
+* @brief 曲の再生位置（ミックス・ループ・差し替え・時計）のテスト
+*
+* 静的関数とstを直接使うので、musicEvent.cをそのまま取り込む。デバイスは開かない
+*/
+#include "testUtil.h"
+#include "musicEvent.c"
+
+#define FREQ        48000
+#define SONG_LEN    1000
+#define BLOCK       256
+
+static float songA[SONG_LEN];
+static float songB[SONG_LEN];
+
+/**
+* @brief モノラル・等速でstを作る（DSPチェインはステレオのときだけ通るので、出力は曲の値 * musicGain）
+*/
+static void setup(const float* music, int64_t offsetFrames) {
+    dspChainFree(&st.dsp);
+    init_state_defaults();
+    perfFreq = SDL_GetPerformanceFrequency();
+    st.spec.freq = FREQ;
+    st.spec.channels = 1;
+    st.music = (float*)music;
+    st.musicFrames = SONG_LEN;
+    st.musicGain = 1.0f;
+    st.audioOffsetFrames = offsetFrames;
+    synthInit(&st.synth, FREQ);
+    dspChainInit(&st.dsp, FREQ);
+    for (int i = 0; i < 128; i++) st.lastFiredSample[i] = -1;
+}
+
+static void render(float* out, int frames) {
+    for (int i = 0; i < frames; i += BLOCK) {
+        mix_audio(&st, out + i, frames - i < BLOCK ? frames - i : BLOCK);
+    }
+}
+
+/**
+* @brief ループしてもWAVが途切れずに続く（オフセットが正でも負でも）
+*/
+static void test_loop_is_continuous(void) {
+    static const int64_t offsets[] = { 0, 100, -100 };
+    for (int k = 0; k < 3; k++) {
+        setup(songA, offsets[k]);
+        float out[SONG_LEN * 3];
+        render(out, SONG_LEN * 3);
+        int bad = 0;
+        for (int i = 0; i < SONG_LEN * 3; i++) {
+            int64_t pos = ((int64_t)i + offsets[k]) % SONG_LEN;
+            if (pos < 0) pos += SONG_LEN;
+            if (fabsf(out[i] - songA[pos]) > 1e-6f) bad++;
+        }
+        TEST_CHECK(bad == 0);
+    }
+}
+
+/**
+* @brief 次の曲があれば、WAVの終わりでループせずに差し替わる
+*/
+static void test_gapless_swap(void) {
+    static const int64_t offsets[] = { 0, 100, -100 };
+    for (int k = 0; k < 3; k++) {
+        setup(songA, offsets[k]);
+        SongData next;
+        SDL_zero(next);
+        next.index = 1;
+        next.music = songB;
+        next.frames = SONG_LEN;
+        SDL_AtomicSetPtr((void**)&st.nextSong, &next);
+
+        float out[SONG_LEN * 2];
+        render(out, SONG_LEN * 2);
+        // WAVの最後のフレームの次から次の曲の先頭（次の曲はそのままループする）
+        int swapAt = (int)(SONG_LEN - offsets[k]);
+        TEST_CHECK(st.playlistIndex == 1);
+        TEST_CHECK(SDL_AtomicGetPtr((void**)&st.retiredSong) == &next);
+        TEST_NEAR(out[swapAt - 1], songA[SONG_LEN - 1], 1e-6);
+        int bad = 0;
+        for (int i = swapAt; i < SONG_LEN * 2; i++) {
+            if (fabsf(out[i] - songB[(i - swapAt) % SONG_LEN]) > 1e-6f) bad++;
+        }
+        TEST_CHECK(bad == 0);
+    }
+}
+
+/**
+* @brief ループ1回ごとにイベントが1回ずつ、順番どおりに出る
+*/
+static void test_loop_events(void) {
+    MidiNoteEvent ev[2] = {
+        { 0, 150, 1, 1, 60, 100 },
+        { 0, 950, 1, 1, 62, 100 },
+    };
+    setup(songA, -100);
+    st.song.ev = ev;
+    st.song.evCount = 2;
+
+    float out[SONG_LEN * 3];
+    int notes[8];
+    int n = 0;
+    for (int i = 0; i < SONG_LEN * 3; i += BLOCK) {
+        mix_audio(&st, out + i, SONG_LEN * 3 - i < BLOCK ? SONG_LEN * 3 - i : BLOCK);
+        AppEvent e;
+        while (evq_pop(&st.evq, &e)) {
+            if (n < 8) notes[n] = e.note;
+            n++;
+        }
+    }
+    // 3000フレームでWAVは3周弱（MIDI側は0～1100、100～1100、100～1000）
+    TEST_CHECK(n == 6);
+    for (int i = 0; i < n && i < 8; i++) TEST_CHECK(notes[i] == (i % 2 == 0 ? 60 : 62));
+}
+
+/**
+* @brief デバイスを開いてから最初のコールバックまでは、最後に分かっていた曲位置を返す
+*/
+static void test_clock_before_first_callback(void) {
+    setup(songA, 0);
+    st.bufferFrames = BLOCK;
+    st.cbStartPos = 4800;
+    st.lastCbCounter = 0;
+    st.heldSongMs = 123.0;
+    TEST_NEAR(song_ms_at_counter(SDL_GetPerformanceCounter()), 123.0, 1e-9);
+
+    // コールバックが来たらそこから進む
+    Uint64 now = SDL_GetPerformanceCounter();
+    st.lastCbCounter = now;
+    double ms = song_ms_at_counter(now + latency_counter(&st));
+    TEST_NEAR(ms, 100.0, 1e-6);
+}
+
+/**
+* @brief オフラインのレンダリングはMIDI側の曲の終わりで止まり、WAVの最後のフレームまで書き出す
+*
+* オフセットが正ならWAVの先頭offset分は曲の開始前、負なら曲の先頭が-offset分遅れて鳴る
+*/
+static void test_offline_render_ends(void) {
+    static const int64_t offsets[] = { 100, 0, -100 };
+    for (int k = 0; k < 3; k++) {
+        setup(songA, offsets[k]);
+        st.musicLoop = false;
+        FILE* fp = tmpfile();
+        TEST_CHECK(fp != NULL);
+        if (!fp) return;
+
+        float block[BLOCK];
+        int64_t events = 0;
+        int64_t frames = render_to_song_end(block, BLOCK, fp, NULL, &events);
+        int64_t expected = SONG_LEN - offsets[k];
+        TEST_CHECK(frames == expected);
+        TEST_CHECK(ftell(fp) == (long)(expected * (int64_t)sizeof(float)));
+
+        // 最後に書いたフレームはWAVの最後のフレーム
+        float last = 0.0f;
+        fseek(fp, -(long)sizeof(float), SEEK_END);
+        TEST_CHECK(fread(&last, sizeof(float), 1, fp) == 1);
+        TEST_NEAR(last, songA[SONG_LEN - 1], 1e-6);
+        fclose(fp);
+    }
+}
+
+/**
+* @brief コールバックの間隔を空けて、時刻tにアンダーランを1回起こす
+*/
+static void underrun_at(Uint64 t) {
+    st.lastCbCounter = t - perfFreq / 10;
+    measure_callback_interval(&st, BLOCK, t);
+}
+
+/**
+* @brief 1回だけのアンダーランは、時間が経てばバッファを小さくするのを止めない
+*/
+static void test_isolated_underrun(void) {
+    setup(songA, 0);
+    st.bufferFrames = 1024;
+    st.bufferFloor = 0;
+    st.stableSinceMs = 0;
+    const Uint32 nowMs = 100000;
+    const Uint64 now = perfFreq * 1000;
+    const Uint64 sec = perfFreq;
+
+    TEST_CHECK(next_buffer_frames(now, nowMs) == 512);
+
+    // 直後は小さくしないが、BUFFER_STABLE_MS経てば小さくする
+    underrun_at(now - sec);
+    TEST_CHECK(st.underrunCount == 1);
+    TEST_CHECK(next_buffer_frames(now, nowMs) == 1024);
+    TEST_CHECK(next_buffer_frames(now + 10 * sec, nowMs + 10000) == 512);
+
+    // 2時間後にもう1回出ても、1回ずつなので大きくしない
+    underrun_at(now + 7200 * sec);
+    TEST_CHECK(next_buffer_frames(now + 7200 * sec, nowMs + 7200000) == 1024);
+
+    // 続けて出たら大きくする
+    underrun_at(now + 7201 * sec);
+    TEST_CHECK(next_buffer_frames(now + 7201 * sec, nowMs + 7201000) == 2048);
+}
+
+int main(void) {
+    for (int i = 0; i < SONG_LEN; i++) {
+        songA[i] = (float)i / SONG_LEN;
+        songB[i] = -(float)i / SONG_LEN;
+    }
+    test_loop_is_continuous();
+    test_gapless_swap();
+    test_loop_events();
+    test_clock_before_first_callback();
+    test_offline_render_ends();
+    test_isolated_underrun();
+    dspChainFree(&st.dsp);
+    return testResult("testMusicEvent");
+}
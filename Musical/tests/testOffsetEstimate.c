@@ -0,0 +1,135 @@
+/**
+* @file testOffsetEstimate.c
+* @brief 曲とMIDIのずれの推定のテスト（合成したクリックの曲で向きと精度を確かめる）
+*/
+#include "testUtil.h"
+#include "offsetEstimate.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+#define FREQ        44100
+#define SECONDS     30
+#define NOTE_COUNT  80
+
+/**
+* @brief MIDIのノートオンの時刻(frames)（間隔をばらつかせて、周期的な取り違えが起きないようにする）
+*/
+static void make_notes(int64_t* notes) {
+    Uint32 state = 7;
+    int64_t t = FREQ;
+    for (int n = 0; n < NOTE_COUNT; n++) {
+        notes[n] = t;
+        state = state * 1664525u + 1013904223u;
+        t += FREQ / 4 + (int64_t)((state >> 8) % (FREQ / 5));
+    }
+}
+
+/**
+* @brief 曲の中のクリックがMIDIよりdelayMs遅れている曲を作る（musicとsong->evはSDL_freeする）
+*/
+static bool make_click_song(double delayMs, int64_t frames, float** outMusic, MidiSong* song) {
+    float* music = (float*)SDL_calloc((size_t)frames * 2, sizeof(float));
+    MidiNoteEvent* ev = (MidiNoteEvent*)SDL_calloc(NOTE_COUNT * 2, sizeof(MidiNoteEvent));
+    TEST_CHECK(music && ev);
+    if (!music || !ev) {
+        SDL_free(music);
+        SDL_free(ev);
+        return false;
+    }
+
+    // 小さな持続音と雑音の上にクリックを重ねる
+    Uint32 state = 1;
+    for (int64_t i = 0; i < frames; i++) {
+        state = state * 1664525u + 1013904223u;
+        float v = 0.1f * sinf((float)i * 0.05f) + 0.01f * ((float)(state >> 8) / (float)(1u << 24) - 0.5f);
+        music[i * 2] = music[i * 2 + 1] = v;
+    }
+    SDL_zerop(song);
+    song->ev = ev;
+    int64_t delay = (int64_t)floor(delayMs * FREQ / 1000.0 + 0.5);
+    int64_t notes[NOTE_COUNT];
+    make_notes(notes);
+    for (int n = 0; n < NOTE_COUNT; n++) {
+        int64_t t = notes[n];
+        ev[song->evCount++] = (MidiNoteEvent){ 0, t, 1, 1, 36, 100 };
+        ev[song->evCount++] = (MidiNoteEvent){ 0, t + 2000, 1, 0, 36, 0 };
+        for (int k = 0; k < 3000; k++) {
+            int64_t w = t + delay + k;
+            if (w < 0 || w >= frames) continue;
+            float v = 0.8f * expf(-(float)k / 600.0f) * sinf((float)k * 0.02f);
+            music[w * 2] += v;
+            music[w * 2 + 1] += v;
+        }
+    }
+    *outMusic = music;
+    return true;
+}
+
+/**
+* @brief 曲の中のクリックがMIDIよりdelayMs遅れている曲で推定する
+*/
+static void check_delay(double delayMs) {
+    int64_t frames = (int64_t)FREQ * SECONDS;
+    float* music;
+    MidiSong song;
+    if (!make_click_song(delayMs, frames, &music, &song)) return;
+
+    OffsetEstimate e;
+    TEST_CHECK(offsetEstimate(music, frames, 2, FREQ, &song, 0.0, &e));
+    // 曲がMIDIより遅れていれば、曲の再生位置へ足すずれは正
+    if (fabs(e.offsetMs - delayMs) > 1.0) SDL_Log("offset %g ms: estimated %g ms", delayMs, e.offsetMs);
+    TEST_NEAR(e.offsetMs, delayMs, 1.0);
+    TEST_CHECK(e.confidence >= 3.0f);
+    TEST_CHECK(e.noteCount == NOTE_COUNT);
+    TEST_CHECK(!e.failed);
+
+    SDL_free(music);
+    SDL_free(song.ev);
+}
+
+static SDL_malloc_func realMalloc;
+static SDL_calloc_func realCalloc;
+static SDL_realloc_func realRealloc;
+static SDL_free_func realFree;
+
+/**
+* @brief スペクトルフラックスの作業用バッファ（onsetFlux）の大きさのときだけ失敗するmalloc
+*/
+static void* SDLCALL flux_failing_malloc(size_t size) {
+    const int bins = OFFSET_FFT_SIZE / 2 + 1;
+    if (size == (size_t)(2 * OFFSET_FFT_SIZE + 2 * bins) * sizeof(float)) return NULL;
+    return realMalloc(size);
+}
+
+/**
+* @brief スペクトルフラックスの一部が求められなければ、ずれは0・confidenceは0で失敗を知らせる
+*/
+static void test_flux_failure(void) {
+    int64_t frames = (int64_t)FREQ * SECONDS;
+    float* music;
+    MidiSong song;
+    if (!make_click_song(123.4, frames, &music, &song)) return;
+
+    SDL_GetMemoryFunctions(&realMalloc, &realCalloc, &realRealloc, &realFree);
+    SDL_SetMemoryFunctions(flux_failing_malloc, realCalloc, realRealloc, realFree);
+    OffsetEstimate e;
+    bool ok = offsetEstimate(music, frames, 2, FREQ, &song, 0.0, &e);
+    SDL_SetMemoryFunctions(realMalloc, realCalloc, realRealloc, realFree);
+
+    TEST_CHECK(!ok);
+    TEST_CHECK(e.failed);
+    TEST_CHECK(e.confidence == 0.0f);
+    TEST_CHECK(e.offsetMs == 0.0);
+
+    SDL_free(music);
+    SDL_free(song.ev);
+}
+
+int main(void) {
+    check_delay(0.0);
+    check_delay(123.4);
+    check_delay(-37.5);
+    check_delay(512.0);
+    test_flux_failure();
+    return testResult("testOffsetEstimate");
+}
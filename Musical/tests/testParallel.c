@@ -0,0 +1,48 @@
+/**
+* @file testParallel.c
+* @brief 並列forとスレッドの割り当てのテスト
+*/
+#include "testUtil.h"
+#include "parallel.h"
+#include "threadPolicy.h"
+#include <SDL2/SDL.h>
+
+#define MAX_COUNT 1000
+
+static SDL_atomic_t hits[MAX_COUNT];
+
+static void count_task(void* ctx, int begin, int end) {
+    (void)ctx;
+    for (int i = begin; i < end; i++) SDL_AtomicAdd(&hits[i], 1);
+}
+
+/**
+* @brief どの要素もちょうど1回ずつ処理される
+*/
+static void check_cover(int count) {
+    for (int i = 0; i < MAX_COUNT; i++) SDL_AtomicSet(&hits[i], 0);
+    int threads = parallelFor(count, count_task, NULL);
+    TEST_CHECK(threads >= 1 && threads <= threadPolicyWorkerCount());
+    TEST_CHECK(threads <= count);
+    int bad = 0;
+    for (int i = 0; i < MAX_COUNT; i++) {
+        if (SDL_AtomicGet(&hits[i]) != (i < count ? 1 : 0)) bad++;
+    }
+    TEST_CHECK(bad == 0);
+}
+
+int main(void) {
+    // threadPolicyInitを呼ぶまで（--render・--chart）は、ワーカーの優先度もコアも変えない
+    check_cover(MAX_COUNT);
+    TEST_CHECK(!threadPolicyGetResult(THREAD_ROLE_WORKER, NULL));
+    TEST_CHECK(threadPolicyWorkerCount() == SDL_GetCPUCount());
+
+    // 割り当てた後は、ワーカー用のコアの数を超えてスレッドを作らない
+    threadPolicyInit();
+    TEST_CHECK(threadPolicyWorkerCount() >= 1);
+    check_cover(MAX_COUNT);
+    check_cover(7);
+    check_cover(1);
+    TEST_CHECK(parallelFor(0, count_task, NULL) == 0);
+    return testResult("testParallel");
+}
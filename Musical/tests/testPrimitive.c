@@ -0,0 +1,82 @@
+/**
+* @file testPrimitive.c
+* @brief 図形描画の点の位置と表のキャッシュのテスト
+*
+* キャッシュの数を見るのでprimitive.cを取り込み、spriteBatchに渡された頂点をここで受け取る
+*/
+#include "testUtil.h"
+#include "primitive.c"
+
+static SDL_Vertex lastVerts[PRIMITIVE_SEGMENT_MAX * 2 + 2];
+static int lastVertCount, lastIndexCount;
+
+void renderQueueCommit(void) {
+}
+
+void spriteBatchAddGeometry(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex* v, int vcount,
+    const int* indices, int icount) {
+    (void)texture;
+    (void)mode;
+    (void)indices;
+    lastVertCount = vcount;
+    lastIndexCount = icount;
+    SDL_memcpy(lastVerts, v, (size_t)vcount * sizeof(SDL_Vertex));
+}
+
+static const SDL_Color white = { 255, 255, 255, 255 };
+
+/**
+* @brief 扇形の縁の点が円の上にあり、両端が開始と終わりの角度ちょうどにある
+*/
+static void check_arc(float radius, float start, float angle) {
+    primitiveArc(100.0f, 50.0f, radius, start, angle, white, SDL_BLENDMODE_BLEND);
+    int n = lastVertCount - 2;
+    TEST_CHECK(n >= 1);
+    TEST_CHECK(lastIndexCount == n * 3);
+    TEST_NEAR(lastVerts[0].position.x, 100.0f, 1e-4);
+    TEST_NEAR(lastVerts[0].position.y, 50.0f, 1e-4);
+    int bad = 0;
+    for (int i = 1; i < lastVertCount; i++) {
+        float dx = lastVerts[i].position.x - 100.0f, dy = lastVerts[i].position.y - 50.0f;
+        if (fabsf(sqrtf(dx * dx + dy * dy) - radius) > radius * 1e-5f) bad++;
+    }
+    TEST_CHECK(bad == 0);
+    TEST_NEAR(lastVerts[1].position.x, 100.0f + radius * cosf(start), radius * 1e-5);
+    TEST_NEAR(lastVerts[1].position.y, 50.0f + radius * sinf(start), radius * 1e-5);
+    TEST_NEAR(lastVerts[n + 1].position.x, 100.0f + radius * cosf(start + angle), radius * 1e-5);
+    TEST_NEAR(lastVerts[n + 1].position.y, 50.0f + radius * sinf(start + angle), radius * 1e-5);
+}
+
+static void test_arc_points(void) {
+    check_arc(100.0f, 0.0f, 2.0f * (float)M_PI);
+    check_arc(100.0f, 0.3f, 1.0f);
+    check_arc(5.0f, -1.0f, 0.01f);
+    check_arc(300.0f, 2.0f, 6.0f);
+    // 1周の円は最初と最後の点が重なり、分割数は1周の表と同じ
+    primitiveCircle(0.0f, 0.0f, 100.0f, white, SDL_BLENDMODE_BLEND);
+    TEST_CHECK(lastVertCount - 2 == segments_for(100.0f));
+    TEST_CHECK(lastVerts[1].position.x == lastVerts[lastVertCount - 1].position.x);
+    TEST_CHECK(lastVerts[1].position.y == lastVerts[lastVertCount - 1].position.y);
+}
+
+/**
+* @brief 角度が毎フレーム変わる円弧でも、表は半径の分割数ごとに1つしか作らない
+*/
+static void test_cache_per_segment_count(void) {
+    primitiveQuit();
+    for (int frame = 0; frame < 1000; frame++) {
+        float angle = 0.001f + frame * 0.0061f;
+        primitiveArc(0.0f, 0.0f, 80.0f, 0.0f, angle, white, SDL_BLENDMODE_BLEND);
+        primitiveRing(0.0f, 0.0f, 79.5f, 1.0f, frame * 0.01f, angle, white, SDL_BLENDMODE_BLEND);
+    }
+    TEST_CHECK(cacheCount == 1);
+    primitiveCircle(0.0f, 0.0f, 3.0f, white, SDL_BLENDMODE_BLEND);
+    TEST_CHECK(cacheCount == 2);
+}
+
+int main(void) {
+    test_arc_points();
+    test_cache_per_segment_count();
+    primitiveQuit();
+    return testResult("testPrimitive");
+}
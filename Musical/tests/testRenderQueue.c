@@ -0,0 +1,161 @@
+/**
+* @file testRenderQueue.c
+* @brief 描画キューのキーの詰め方と基数ソートの順番のテスト
+*
+* キーと画面の範囲を直接使うのでrenderQueue.cを取り込み、spriteBatchに渡された順番をここで受け取る
+*/
+#include "testUtil.h"
+#include "renderQueue.c"
+#include <stdlib.h>
+
+#define TEX(n)      ((SDL_Texture*)(uintptr_t)(0x100 * ((n) + 1)))
+#define ITEM_COUNT  5000
+
+/**
+* @brief テスト用に追加した四角形の属性（番号は頂点のtex_coord.xに入れて渡す）
+*/
+typedef struct {
+    int layer;
+    SDL_BlendMode mode;
+    int texture;
+    float depth;
+    int index;
+    int firstSeen;          ///< そのテクスチャを最初に追加した順番
+} Item;
+
+static Item submitted[ITEM_COUNT];
+static int received[ITEM_COUNT];
+static int receivedCount;
+
+SDL_Renderer* getRenderer(void) {
+    return NULL;
+}
+
+void spriteBatchAddQuad(SDL_Texture* texture, SDL_BlendMode mode, const SDL_Vertex quad[4]) {
+    (void)texture;
+    (void)mode;
+    if (receivedCount < ITEM_COUNT) received[receivedCount++] = (int)quad[0].tex_coord.x;
+}
+
+bool spriteBatchMakeQuad(SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    double angle, const SDL_FPoint* center, SDL_RendererFlip flip, SDL_Color color, SDL_Vertex quad[4]) {
+    (void)texture; (void)src; (void)dst; (void)angle; (void)center; (void)flip; (void)color; (void)quad;
+    return false;
+}
+
+void spriteBatchFlush(void) {
+}
+
+void spriteBatchEndFrame(void) {
+}
+
+/**
+* @brief 画面を640x480にして、空のキューから始める
+*/
+static void reset(void) {
+    count = 0;
+    textureCount = 0;
+    receivedCount = 0;
+    viewport = (SDL_FRect){ 0, 0, 640, 480 };
+    viewportValid = true;
+}
+
+static void submit(const Item* it, float x, float y, Uint8 alpha) {
+    SDL_Vertex q[4];
+    SDL_zeroa(q);
+    q[0].position = (SDL_FPoint){ x, y };
+    q[1].position = (SDL_FPoint){ x + 8, y };
+    q[2].position = (SDL_FPoint){ x + 8, y + 8 };
+    q[3].position = (SDL_FPoint){ x, y + 8 };
+    for (int k = 0; k < 4; k++) {
+        q[k].color = (SDL_Color){ 255, 255, 255, alpha };
+        q[k].tex_coord.x = (float)it->index;
+    }
+    renderQueueSubmitQuad(TEX(it->texture), it->mode, q, it->layer, it->depth);
+}
+
+/**
+* @brief 期待する順番（レイヤー、ブレンドモード、テクスチャを見つけた順、奥行き、追加順）
+*/
+static int by_expected(const void* a, const void* b) {
+    const Item* x = (const Item*)a;
+    const Item* y = (const Item*)b;
+    if (x->layer != y->layer) return x->layer < y->layer ? -1 : 1;
+    Uint64 bx = blend_index(x->mode), by = blend_index(y->mode);
+    if (bx != by) return bx < by ? -1 : 1;
+    if (x->firstSeen != y->firstSeen) return x->firstSeen < y->firstSeen ? -1 : 1;
+    if (x->depth != y->depth) return x->depth < y->depth ? -1 : 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+/**
+* @brief 奥行きのビットはfloatの大小と同じ順（負の数も）
+*/
+static void test_depth_bits(void) {
+    static const float depths[] = { -1e30f, -1000.0f, -1.5f, -1e-20f, 0.0f, 1e-20f, 0.25f, 1.0f, 1000.0f, 1e30f };
+    for (int i = 1; i < (int)SDL_arraysize(depths); i++) {
+        TEST_CHECK(depth_bits(depths[i - 1]) < depth_bits(depths[i]));
+    }
+    TEST_CHECK(depth_bits(1e30f) < (1ull << 24));
+}
+
+/**
+* @brief ばらばらに追加した四角形がキーの順にそろう
+*/
+static void test_sort_order(void) {
+    static const SDL_BlendMode modes[] = { SDL_BLENDMODE_ADD, SDL_BLENDMODE_BLEND, SDL_BLENDMODE_NONE, SDL_BLENDMODE_MOD };
+    static const int layers[] = { RENDER_LAYER_EFFECT, RENDER_LAYER_BACKGROUND, RENDER_LAYER_DEFAULT, RENDER_LAYER_OVERLAY };
+    int firstSeen[16];
+    int seen = 0;
+    for (int t = 0; t < 16; t++) firstSeen[t] = -1;
+
+    reset();
+    Uint32 state = 12345;
+    for (int i = 0; i < ITEM_COUNT; i++) {
+        state = state * 1664525u + 1013904223u;
+        Item* it = &submitted[i];
+        it->layer = layers[(state >> 8) % 4];
+        it->mode = modes[(state >> 12) % 4];
+        it->texture = (int)((state >> 16) % 16);
+        // 奥行きは同じ値も多くなるように粗くする
+        it->depth = (float)((int)((state >> 20) % 9) - 4) * 0.5f;
+        it->index = i;
+        if (firstSeen[it->texture] < 0) firstSeen[it->texture] = seen++;
+        it->firstSeen = firstSeen[it->texture];
+        submit(it, (float)(i % 600), (float)(i % 400), 255);
+    }
+    renderQueueCommit();
+    TEST_CHECK(receivedCount == ITEM_COUNT);
+
+    qsort(submitted, ITEM_COUNT, sizeof(Item), by_expected);
+    int bad = 0;
+    for (int i = 0; i < ITEM_COUNT && i < receivedCount; i++) {
+        if (received[i] != submitted[i].index) bad++;
+    }
+    TEST_CHECK(bad == 0);
+}
+
+/**
+* @brief 透明なものと画面の外のものはためない
+*/
+static void test_culling(void) {
+    reset();
+    Item it = { RENDER_LAYER_DEFAULT, SDL_BLENDMODE_BLEND, 0, 0.0f, 0, 0 };
+    submit(&it, 10, 10, 0);
+    it.index = 1;
+    submit(&it, -20, 10, 255);
+    it.index = 2;
+    submit(&it, 10, 480, 255);
+    it.index = 3;
+    submit(&it, 636, 476, 255);
+    renderQueueCommit();
+    TEST_CHECK(receivedCount == 1 && received[0] == 3);
+}
+
+int main(void) {
+    test_depth_bits();
+    test_sort_order();
+    test_culling();
+    renderQueueQuit();
+    return testResult("testRenderQueue");
+}
@@ -0,0 +1,104 @@
+/**
+* @file testSpriteBatch.c
+* @brief スプライトのバッチのまとめ方（さかのぼって足す・重なったら新しく作る）のテスト
+*
+* バッチの中身を見るのでspriteBatch.cを取り込む。描く前に中身を確かめて捨てるので、描画はしない
+*/
+#include "testUtil.h"
+#include "spriteBatch.c"
+
+#define TEX(n)  ((SDL_Texture*)(uintptr_t)(0x100 * (n)))
+
+SDL_Renderer* getRenderer(void) {
+    return NULL;
+}
+
+/**
+* @brief (x, y)に大きさ10の四角形を足す
+*/
+static void add(int tex, SDL_BlendMode mode, float x, float y) {
+    SDL_Vertex q[4];
+    SDL_zeroa(q);
+    q[0].position = (SDL_FPoint){ x, y };
+    q[1].position = (SDL_FPoint){ x + 10, y };
+    q[2].position = (SDL_FPoint){ x + 10, y + 10 };
+    q[3].position = (SDL_FPoint){ x, y + 10 };
+    spriteBatchAddQuad(TEX(tex), mode, q);
+}
+
+/**
+* @brief 描かずにバッチを空にする
+*/
+static void reset(void) {
+    for (int k = 0; k < batchCount; k++) batches[k].vlen = batches[k].ilen = 0;
+    batchCount = 0;
+}
+
+static void test_merge_past_disjoint(void) {
+    // 重ならなければ、間に別のテクスチャがあっても前のバッチに足す
+    reset();
+    add(1, SDL_BLENDMODE_BLEND, 0, 0);
+    add(2, SDL_BLENDMODE_BLEND, 100, 0);
+    add(1, SDL_BLENDMODE_BLEND, 200, 0);
+    TEST_CHECK(batchCount == 2);
+    TEST_CHECK(batches[0].texture == TEX(1) && batches[0].vlen == 8 && batches[0].ilen == 12);
+    // 2つ目の四角形の番号は頂点列の続きから
+    TEST_CHECK(batches[0].i[6] == 4 && batches[0].i[11] == 7);
+    TEST_NEAR(batches[0].bounds.w, 210.0, 1e-6);
+}
+
+static void test_overlap_keeps_order(void) {
+    // 間のバッチと重なるなら、前に入れると重なり順が変わるので新しく作る
+    reset();
+    add(1, SDL_BLENDMODE_BLEND, 0, 0);
+    add(2, SDL_BLENDMODE_BLEND, 5, 5);
+    add(1, SDL_BLENDMODE_BLEND, 8, 8);
+    TEST_CHECK(batchCount == 3);
+    TEST_CHECK(batches[2].texture == TEX(1));
+    // 直前のバッチと同じなら重なっていても足す
+    add(1, SDL_BLENDMODE_BLEND, 9, 9);
+    TEST_CHECK(batchCount == 3 && batches[2].vlen == 8);
+}
+
+static void test_blend_mode_splits(void) {
+    reset();
+    add(1, SDL_BLENDMODE_BLEND, 0, 0);
+    add(1, SDL_BLENDMODE_ADD, 100, 0);
+    add(1, SDL_BLENDMODE_BLEND, 200, 0);
+    TEST_CHECK(batchCount == 2);
+    TEST_CHECK(batches[1].mode == SDL_BLENDMODE_ADD);
+}
+
+static void test_lookback_limit(void) {
+    // SPRITE_BATCH_LOOKBACK個前まではさかのぼる
+    reset();
+    for (int k = 0; k < SPRITE_BATCH_LOOKBACK; k++) add(1 + k, SDL_BLENDMODE_BLEND, 20.0f * k, 0);
+    add(1, SDL_BLENDMODE_BLEND, 0, 100);
+    TEST_CHECK(batchCount == SPRITE_BATCH_LOOKBACK);
+
+    // それより前は探さない
+    reset();
+    for (int k = 0; k <= SPRITE_BATCH_LOOKBACK; k++) add(1 + k, SDL_BLENDMODE_BLEND, 20.0f * k, 0);
+    add(1, SDL_BLENDMODE_BLEND, 0, 100);
+    TEST_CHECK(batchCount == SPRITE_BATCH_LOOKBACK + 2);
+    TEST_CHECK(batches[SPRITE_BATCH_LOOKBACK + 1].texture == TEX(1));
+}
+
+static void test_untextured_quad_ignored(void) {
+    reset();
+    SDL_Vertex q[4];
+    SDL_zeroa(q);
+    spriteBatchAddQuad(NULL, SDL_BLENDMODE_BLEND, q);
+    TEST_CHECK(batchCount == 0);
+}
+
+int main(void) {
+    test_merge_past_disjoint();
+    test_overlap_keeps_order();
+    test_blend_mode_splits();
+    test_lookback_limit();
+    test_untextured_quad_ignored();
+    reset();
+    spriteBatchQuit();
+    return testResult("testSpriteBatch");
+}
@@ -0,0 +1,48 @@
+/**
+* @file testSynth.c
+* @brief シンセの予約イベントがあふれたときの全ノートオフのテスト
+*
+* 予約の中身を見るのでsynth.cを取り込む
+*/
+#include "testUtil.h"
+#include "synth.c"
+
+#define FREQ    48000
+
+static Synth synth;
+
+/**
+* @brief ノートで埋まっていても全ノートオフは積めて、積んであったイベントも消さない
+*/
+static void test_all_off_when_full(void) {
+    synthInit(&synth, FREQ);
+    synthSetTrack(&synth, 0, true, SYNTH_PATCH_PIANO, 1.0f, 0.0f);
+    synthQueueNote(&synth, 0, 0, 60, 100, true);
+    for (int i = 0; i < SYNTH_EVENT_MAX; i++) synthQueueNote(&synth, 10, 0, 61, 0, false);
+    TEST_CHECK(synth.queueCount == SYNTH_EVENT_MAX - 1);
+    TEST_CHECK(synth.queue[SYNTH_EVENT_MAX - 2].kind == SYNTH_EV_NOTE_OFF);
+
+    synthQueueAllNotesOff(&synth, 20);
+    TEST_CHECK(synth.queueCount == SYNTH_EVENT_MAX);
+    TEST_CHECK(synth.queue[SYNTH_EVENT_MAX - 2].kind == SYNTH_EV_NOTE_OFF);
+    TEST_CHECK(synth.queue[SYNTH_EVENT_MAX - 1].kind == SYNTH_EV_ALL_OFF);
+    TEST_CHECK(synth.queue[SYNTH_EVENT_MAX - 1].frame == 20);
+
+    // 2つ目は積めないが、最後はもう全ノートオフなので何も変わらない
+    synthQueueAllNotesOff(&synth, 30);
+    TEST_CHECK(synth.queueCount == SYNTH_EVENT_MAX);
+    TEST_CHECK(synth.queue[SYNTH_EVENT_MAX - 1].frame == 20);
+
+    static float out[256 * 2];
+    synthRender(&synth, out, 256, 2, 1.0f);
+    TEST_CHECK(synth.queueCount == 0);
+    TEST_CHECK(synth.active == 1);
+    for (int v = 0; v < SYNTH_VOICE_MAX; v++) {
+        TEST_CHECK(synth.stage[v] == STAGE_OFF || synth.stage[v] == STAGE_RELEASE);
+    }
+}
+
+int main(void) {
+    test_all_off_when_full();
+    return testResult("testSynth");
+}
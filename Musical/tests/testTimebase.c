@@ -0,0 +1,53 @@
+/**
+* @file testTimebase.c
+* @brief 曲の時計のループ・シーク補正のテスト
+*/
+#include "testUtil.h"
+#include "timebase.h"
+#include <SDL2/SDL.h>
+
+#define STEP_MS     40.0
+#define SLACK_MS    150.0               ///< SDL_Delayが寝過ごしてもよい分
+
+static double fakeSongMs;
+
+static double fake_song_ms(void) {
+    return fakeSongMs;
+}
+
+/**
+* @brief STEP_MS待ってから曲の位置をsongにして読み、前回から実際に経った分だけ進んでいること
+*/
+static double step(double prev, double song) {
+    SDL_Delay((Uint32)STEP_MS);
+    fakeSongMs = song;
+    double ms = timebaseSample(TIMEBASE_MUSIC);
+    TEST_CHECK(ms >= prev + STEP_MS - 1.0 && ms <= prev + STEP_MS + SLACK_MS);
+    // 拍も同じだけ進む（既定のテンポ）
+    TEST_NEAR(timebaseSample(TIMEBASE_BEATS), ms * TIMEBASE_DEFAULT_BPM / 60000.0, 1e-9);
+    return ms;
+}
+
+int main(void) {
+    fakeSongMs = 5000.0;
+    timebaseSetMusicClock(fake_song_ms, NULL);
+    double ms = timebaseSample(TIMEBASE_MUSIC);
+    TEST_NEAR(ms, 5000.0, 1e-9);
+
+    // 普通に進む
+    double prev = ms;
+    ms = step(ms, fakeSongMs + STEP_MS);
+    TEST_NEAR(ms, prev + STEP_MS, 1e-9);
+    // ループで先頭に戻っても、止まらずに経った分だけ進む
+    ms = step(ms, 10.0);
+    // シークで大きく進んでも同じ
+    ms = step(ms, 60000.0);
+    // 飛んだ後は曲の位置どおりに進む
+    prev = ms;
+    ms = step(ms, fakeSongMs + STEP_MS);
+    TEST_NEAR(ms, prev + STEP_MS, 1e-9);
+    // 時計を替えても続きになる
+    timebaseSetMusicClock(fake_song_ms, NULL);
+    ms = step(ms, 0.0);
+    return testResult("testTimebase");
+}
@@ -0,0 +1,44 @@
+/**
+* @file testUtil.h
+* @brief テスト用の簡易チェックマクロ
+*
+* テストは1ファイル1実行ファイルで、失敗したチェックを標準エラーに出して終了コードで返す
+*/
+#pragma once
+
+#define SDL_MAIN_HANDLED
+#include <stdio.h>
+#include <math.h>
+
+static int testFailures;
+
+/**
+* @brief 条件が偽なら失敗として記録する
+*/
+#define TEST_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        testFailures++; \
+    } \
+} while (0)
+
+/**
+* @brief 2つの値の差がtol以下であること
+*/
+#define TEST_NEAR(a, b, tol) do { \
+    double test_a_ = (double)(a), test_b_ = (double)(b); \
+    if (!(fabs(test_a_ - test_b_) <= (double)(tol))) { \
+        fprintf(stderr, "%s:%d: %s = %.9g, expected %s = %.9g (tol %g)\n", \
+            __FILE__, __LINE__, #a, test_a_, #b, test_b_, (double)(tol)); \
+        testFailures++; \
+    } \
+} while (0)
+
+/**
+* @brief main の最後で返す値
+*/
+static int testResult(const char* name) {
+    if (testFailures) fprintf(stderr, "%s: %d check(s) failed\n", name, testFailures);
+    else printf("%s: ok\n", name);
+    return testFailures ? 1 : 0;
+}
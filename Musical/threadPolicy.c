@@ -0,0 +1,242 @@
+/**
+* @file threadPolicy.c
+* @brief スレッドの優先度とCPUの割り当ての実装
+*
+* コアの速さはLinuxならcpu_capacity（無ければcpuinfo_max_freq）で比べ、
+* big.LITTLEでは速いコアからオーディオ、描画の順に割り当てる。
+* 速さが分からない場合は番号の大きいコアから使う（cpu0は割り込みを受けやすい）
+*/
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include "threadPolicy.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define THREAD_POLICY_LINUX 1
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define THREAD_POLICY_WIN32 1
+#endif
+
+#define THREAD_POLICY_CPU_MAX 64
+
+static bool initialized;
+static int cpuCount;
+static int audioCore = -1;
+static int renderCore = -1;
+static uint64_t roleMask[THREAD_ROLE_MAX];
+static ThreadPolicyResult result[THREAD_ROLE_MAX];
+static SDL_SpinLock resultLock;
+
+static const char* roleName[THREAD_ROLE_MAX] = { "audio", "render", "worker" };
+
+#if THREAD_POLICY_LINUX
+/**
+* @brief sysfsの数値を1つ読む（無ければ-1）
+*/
+static long read_sys_long(const char* fmt, int cpu) {
+    char path[128];
+    SDL_snprintf(path, sizeof(path), fmt, cpu);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    long v = -1;
+    if (fscanf(fp, "%ld", &v) != 1) v = -1;
+    fclose(fp);
+    return v;
+}
+#endif
+
+/**
+* @brief コアの速さの目安（分からなければ0）
+*/
+static long core_speed(int cpu) {
+#if THREAD_POLICY_LINUX
+    long v = read_sys_long("/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    if (v < 0) v = read_sys_long("/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+    return v > 0 ? v : 0;
+#else
+    (void)cpu;
+    return 0;
+#endif
+}
+
+/**
+* @brief プロセスが使ってよいCPU（cgroupやtasksetで絞られていることがある）
+*/
+static uint64_t allowed_cpus(int count) {
+    uint64_t all = count >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1);
+#if THREAD_POLICY_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        uint64_t m = 0;
+        for (int i = 0; i < count; i++) {
+            if (CPU_ISSET(i, &set)) m |= (uint64_t)1 << i;
+        }
+        if (m) return m;
+    }
+#endif
+    return all;
+}
+
+/**
+* @brief コアの割り当てを決める（スレッドを作る前にメインスレッドで1回呼ぶ）
+*/
+void threadPolicyInit(void) {
+    if (initialized) return;
+    initialized = true;
+
+    cpuCount = SDL_GetCPUCount();
+    if (cpuCount > THREAD_POLICY_CPU_MAX) cpuCount = THREAD_POLICY_CPU_MAX;
+    uint64_t all = allowed_cpus(cpuCount);
+
+    // 速い順（同じなら番号の大きい順）に並べて、先頭をオーディオ、次を描画にする
+    int order[THREAD_POLICY_CPU_MAX];
+    long speed[THREAD_POLICY_CPU_MAX];
+    int n = 0;
+    for (int i = 0; i < cpuCount; i++) {
+        speed[i] = core_speed(i);
+        if (all & ((uint64_t)1 << i)) order[n++] = i;
+    }
+    if (n < THREAD_POLICY_MIN_CORES) {
+        SDL_Log("[threadPolicy] %d cores: priority only, no core separation", n);
+        return;
+    }
+    for (int i = 1; i < n; i++) {
+        int c = order[i];
+        int j = i - 1;
+        while (j >= 0 && (speed[order[j]] < speed[c] || (speed[order[j]] == speed[c] && order[j] < c))) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = c;
+    }
+    audioCore = order[0];
+    renderCore = order[1];
+
+    roleMask[THREAD_ROLE_AUDIO] = (uint64_t)1 << audioCore;
+    roleMask[THREAD_ROLE_RENDER] = (uint64_t)1 << renderCore;
+    roleMask[THREAD_ROLE_WORKER] = all & ~(roleMask[THREAD_ROLE_AUDIO] | roleMask[THREAD_ROLE_RENDER]);
+
+    SDL_Log("[threadPolicy] %d cores: audio=cpu%d render=cpu%d workers=0x%llx%s", n, audioCore, renderCore,
+        (unsigned long long)roleMask[THREAD_ROLE_WORKER], speed[order[0]] > 0 ? "" : " (core speeds unknown)");
+}
+
+/**
+* @brief 呼び出したスレッドをmaskのCPUに割り当てる
+*/
+static bool pin_current_thread(uint64_t mask) {
+    if (mask == 0) return false;
+#if THREAD_POLICY_LINUX
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < cpuCount; i++) {
+        if (mask & ((uint64_t)1 << i)) CPU_SET(i, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif THREAD_POLICY_WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+#else
+    // macOSなどはコアを指定できない（スケジューラに任せる）
+    return false;
+#endif
+}
+
+/**
+* @brief 呼び出したスレッドをSCHED_FIFOにする（権限が無ければfalse）
+*/
+static bool set_realtime(void) {
+#if THREAD_POLICY_LINUX
+    struct sched_param param;
+    int lo = sched_get_priority_min(SCHED_FIFO);
+    int hi = sched_get_priority_max(SCHED_FIFO);
+    int prio = THREAD_POLICY_FIFO_PRIORITY;
+    if (prio < lo) prio = lo;
+    if (prio > hi) prio = hi;
+    SDL_zero(param);
+    param.sched_priority = prio;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+* @brief 呼び出したスレッドに役割の設定を適用する（各スレッドの先頭で呼ぶ）
+*
+* オーディオ: SCHED_FIFO → だめならSDL_THREAD_PRIORITY_TIME_CRITICAL<br>
+* 描画: SDL_THREAD_PRIORITY_HIGH<br>
+* ワーカー: SDL_THREAD_PRIORITY_LOW<br>
+* どれも失敗したら既定のまま動かす。
+* threadPolicyInitを呼んでいなければ何もしない（--render・--chartのようにゲームを動かさないときは、
+* 全部のコアを同じ優先度で使う）
+*
+* @param role スレッドの役割
+*/
+void threadPolicyApply(ThreadRole role) {
+    if (role < 0 || role >= THREAD_ROLE_MAX || !initialized) return;
+
+    ThreadPolicyResult r;
+    SDL_zero(r);
+    r.applied = true;
+
+    if (role == THREAD_ROLE_AUDIO) {
+        r.realtime = set_realtime();
+        r.priorityOk = r.realtime || SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL) == 0;
+    }
+    else {
+        SDL_ThreadPriority p = role == THREAD_ROLE_RENDER ? SDL_THREAD_PRIORITY_HIGH : SDL_THREAD_PRIORITY_LOW;
+        r.priorityOk = SDL_SetThreadPriority(p) == 0;
+    }
+    r.pinned = pin_current_thread(roleMask[role]);
+    r.mask = r.pinned ? roleMask[role] : 0;
+
+    // ワーカーは何本もあるので最初の1本だけログに出す
+    SDL_AtomicLock(&resultLock);
+    bool first = !result[role].applied;
+    result[role] = r;
+    SDL_AtomicUnlock(&resultLock);
+    if (!first) return;
+
+    const char* prio = r.realtime ? "SCHED_FIFO" : (r.priorityOk ? "SDL priority" : "default priority");
+    if (r.pinned) {
+        SDL_Log("[threadPolicy] %s: %s, cpu mask 0x%llx", roleName[role], prio, (unsigned long long)r.mask);
+    }
+    else {
+        SDL_Log("[threadPolicy] %s: %s, %s", roleName[role], prio,
+            roleMask[role] == 0 ? "no core separation" : "affinity not available");
+    }
+}
+
+/**
+* @brief 並列処理に使うとよいスレッド数
+*
+* コアを分けていればワーカー用のコアの数（それ以上作るとワーカーのコアに詰め込まれる）、
+* そうでなければCPU数
+*/
+int threadPolicyWorkerCount(void) {
+    uint64_t m = initialized ? roleMask[THREAD_ROLE_WORKER] : 0;
+    if (m == 0) return SDL_GetCPUCount();
+    int n = 0;
+    for (; m; m &= m - 1) n++;
+    return n;
+}
+
+/**
+* @brief 役割ごとに実際に適用された設定
+*
+* @return 一度でも適用していればtrue
+*/
+bool threadPolicyGetResult(ThreadRole role, ThreadPolicyResult* out) {
+    if (role < 0 || role >= THREAD_ROLE_MAX) return false;
+    SDL_AtomicLock(&resultLock);
+    ThreadPolicyResult r = result[role];
+    SDL_AtomicUnlock(&resultLock);
+    if (out) *out = r;
+    return r.applied;
+}
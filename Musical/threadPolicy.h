@@ -0,0 +1,41 @@
+/**
+* @file threadPolicy.h
+* @brief スレッドの優先度とCPUの割り当てヘッダ
+*
+* オーディオのスレッドは実時間優先度で専用のコアに、描画（メインループ）は別のコアに置き、
+* フォントのラスタライズや解析などのワーカーはそれ以外のコアで動かす。
+* 使えない機能は順に諦め、実際にどうなったかをログに出す
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THREAD_POLICY_FIFO_PRIORITY 20  ///< オーディオのSCHED_FIFOの優先度（取れる範囲に丸める）
+#define THREAD_POLICY_MIN_CORES     3   ///< これより少ないコア数ではコアを分けない
+
+/**
+* @brief スレッドの役割
+*/
+typedef enum {
+    THREAD_ROLE_AUDIO,      ///< SDLのオーディオコールバック
+    THREAD_ROLE_RENDER,     ///< メインループ（入力・更新・描画）
+    THREAD_ROLE_WORKER,     ///< フォント・先読み・解析などのワーカー
+    THREAD_ROLE_MAX
+} ThreadRole;
+
+/**
+* @brief 実際に適用された設定
+*/
+typedef struct {
+    bool applied;           ///< 一度でも適用したか
+    bool realtime;          ///< SCHED_FIFOが使えた
+    bool priorityOk;        ///< SDL_SetThreadPriorityが成功した
+    bool pinned;            ///< CPUの割り当てが成功した
+    uint64_t mask;          ///< 割り当てたCPU（ビットごと、0なら割り当てなし）
+} ThreadPolicyResult;
+
+void threadPolicyInit(void);
+void threadPolicyApply(ThreadRole role);
+int threadPolicyWorkerCount(void);
+bool threadPolicyGetResult(ThreadRole role, ThreadPolicyResult* out);
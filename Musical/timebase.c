@@ -0,0 +1,127 @@
+/**
+* @file timebase.c
+* @brief アニメーションの時間の基準の実装
+*
+* 曲の時計は登録された関数から読む（musicEventInitが登録する）。
+* timebaseUpdateでフレームに1回読んだ値をtimebaseNowが返すので、同じフレームの描画とアニメーションは同じ時刻を見る。
+* アニメーションを作るときの開始時刻はtimebaseSampleでその場で読む（MIDIハンドラの中ならイベントの時刻になる）
+*/
+#include "timebase.h"
+#include <SDL2/SDL.h>
+
+static double (*songMsFn)(void);
+static double (*msToBeatFn)(double ms);
+
+static bool sampled;
+static bool rebase;             ///< 次に読んだ値を前回の値につなげる
+static double lastSongMs;       ///< 前回読んだ曲の位置
+static double lastSongBeat;
+static Uint64 lastSampleCounter; ///< 前回読んだときのSDL_GetPerformanceCounter
+static double msOffset;         ///< ループ・シークで飛んだ分の補正
+static double beatOffset;
+
+static Uint32 frameTicks;
+static double frameMs;
+static double frameBeats;
+static double frameCount;
+
+/**
+* @brief 曲の時計を登録する
+*
+* @param songMs 今聞こえている曲の位置(ms)を返す関数（NULLで登録解除）
+* @param msToBeat 曲の位置(ms)を拍に直す関数（NULLならTIMEBASE_DEFAULT_BPM）
+*/
+void timebaseSetMusicClock(double (*songMs)(void), double (*msToBeat)(double ms)) {
+    songMsFn = songMs;
+    msToBeatFn = msToBeat;
+    // 時計が替わっても、次に読んだ値を前回の続きにする
+    rebase = sampled;
+}
+
+/**
+* @brief 曲の時計が登録されているか
+*/
+bool timebaseHasMusicClock(void) {
+    return songMsFn != NULL;
+}
+
+/**
+* @brief 曲の位置(ms)を拍に直す
+*/
+static double song_beat(double ms) {
+    return msToBeatFn ? msToBeatFn(ms) : ms * TIMEBASE_DEFAULT_BPM / 60000.0;
+}
+
+/**
+* @brief 曲の時計を読んで、飛びを補正した連続な時刻にする
+*
+* 飛んだときは、前回の値から実際に経った時間だけ進んだ位置につなげる（前回の値にそのままつなぐと1フレーム分止まる）
+*/
+static void sample_music(double* ms, double* beats) {
+    double song = songMsFn ? songMsFn() : (double)SDL_GetTicks();
+    double beat = song_beat(song);
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if (sampled) {
+        double d = song - lastSongMs;
+        if (rebase || d < -TIMEBASE_JUMP_BACK_MS || d > TIMEBASE_JUMP_AHEAD_MS) {
+            double dt = now > lastSampleCounter
+                ? (double)(now - lastSampleCounter) * 1000.0 / (double)SDL_GetPerformanceFrequency() : 0.0;
+            msOffset += lastSongMs + dt - song;
+            beatOffset += lastSongBeat + (song_beat(lastSongMs + dt) - song_beat(lastSongMs)) - beat;
+        }
+    }
+    sampled = true;
+    rebase = false;
+    lastSongMs = song;
+    lastSongBeat = beat;
+    lastSampleCounter = now;
+    *ms = song + msOffset;
+    *beats = beat + beatOffset;
+}
+
+/**
+* @brief このフレームの時刻を読む（easingUpdateから1フレームに1回呼ばれる）
+*/
+void timebaseUpdate(void) {
+    frameTicks = SDL_GetTicks();
+    sample_music(&frameMs, &frameBeats);
+    frameCount += 1.0;
+}
+
+/**
+* @brief このフレームの時刻（timebaseUpdateで読んだ値）
+*
+* @param base 時間の基準
+* @return TIMEBASE_FRAMEはフレーム数、TICKSとMUSICはms、BEATSは拍
+*/
+double timebaseNow(Timebase base) {
+    switch (base) {
+    case TIMEBASE_FRAME: return frameCount;
+    case TIMEBASE_TICKS: return (double)frameTicks;
+    case TIMEBASE_MUSIC: return frameMs;
+    case TIMEBASE_BEATS: return frameBeats;
+    }
+    return 0.0;
+}
+
+/**
+* @brief 今の時刻をその場で読む
+*
+* @param base 時間の基準
+* @return timebaseNowと同じ単位
+*/
+double timebaseSample(Timebase base) {
+    double ms, beats;
+    switch (base) {
+    case TIMEBASE_FRAME: return frameCount;
+    case TIMEBASE_TICKS: return (double)SDL_GetTicks();
+    case TIMEBASE_MUSIC:
+        sample_music(&ms, &beats);
+        return ms;
+    case TIMEBASE_BEATS:
+        sample_music(&ms, &beats);
+        return beats;
+    }
+    return 0.0;
+}
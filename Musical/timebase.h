@@ -0,0 +1,30 @@
+/**
+* @file timebase.h
+* @brief アニメーションの時間の基準ヘッダ
+*
+* SDL_GetTicksのほかに、曲の再生位置（オーディオのサンプル位置から補間したms）と拍を時計として使える。
+* 曲のループやシークで再生位置が飛んでも、時計は飛んだ分をずらして連続に保つ
+*/
+#pragma once
+
+#include <stdbool.h>
+
+#define TIMEBASE_JUMP_BACK_MS    100.0   ///< これより大きく戻ったらループ・シークとみなす
+#define TIMEBASE_JUMP_AHEAD_MS   2000.0  ///< これより大きく進んだらシークとみなす
+#define TIMEBASE_DEFAULT_BPM     120.0   ///< 曲の時計が無いときの拍の速さ
+
+/**
+* @brief 時間の基準
+*/
+typedef enum {
+    TIMEBASE_FRAME,     ///< 描画1回で1つ進む（spriteAnimeの従来の動き）
+    TIMEBASE_TICKS,     ///< SDL_GetTicks(ms)
+    TIMEBASE_MUSIC,     ///< 曲の再生位置(ms)
+    TIMEBASE_BEATS      ///< 曲の拍（テンポ変化に従う）
+} Timebase;
+
+void timebaseSetMusicClock(double (*songMs)(void), double (*msToBeat)(double ms));
+bool timebaseHasMusicClock(void);
+void timebaseUpdate(void);
+double timebaseNow(Timebase base);
+double timebaseSample(Timebase base);
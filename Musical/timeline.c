@@ -0,0 +1,530 @@
+/**
+* @file timeline.c
+* @brief キーフレームのタイムラインの実装
+*
+* 組み立て中のキーは「どのSpriteのどの値を、いつから、どれだけの時間で、いくつへ」の並びで持つ。
+* timelineBakeでSpriteと値の組（トラック）ごとにキーを時刻順に並べ、一定間隔で値を焼き込む。
+* 最初のキーより前の値は再生開始時のSpriteの値（base）にするので、
+* そのようなトラックは「値 + 重み×base」の2本のサンプル列を持つ。
+* 再生中はサンプル列の隣り合う2点の線形補間だけで、イージング関数は呼ばない
+*/
+#include "timeline.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+
+/**
+* @brief 組み立て中のキー
+*/
+typedef struct {
+    Uint8 target;
+    Uint8 prop;
+    float start;
+    float duration;                 ///< 0ならその時刻に値を置くだけ
+    float to;
+    float (*easing)(float ratio);
+} TimelineKey;
+
+/**
+* @brief 焼き込んだトラック（Spriteと値の組）
+*/
+typedef struct {
+    Uint8 target;
+    Uint8 prop;
+    int value;                      ///< samplesの中の値の列の先頭
+    int weight;                     ///< baseに掛ける重みの列の先頭（-1なら無し）
+} TimelineTrack;
+
+struct Timeline {
+    Timebase base;
+    float rate;                     ///< 時計の1単位あたりのサンプル数
+    float length;                   ///< 長さ（時計の単位）
+    int sampleCount;                ///< 1本の列のサンプル数
+    bool loop;
+    void (*onFinished)();
+    int targetCount;
+    int trackCount;
+    TimelineTrack track[TIMELINE_TRACK_MAX];
+    float* samples;
+};
+
+/**
+* @brief 再生中のタイムライン
+*/
+typedef struct {
+    const Timeline* timeline;
+    Sprite* target[TIMELINE_TARGET_MAX];
+    float base[TIMELINE_TRACK_MAX]; ///< 再生開始時のSpriteの値（重みのあるトラックだけ）
+    double time;                    ///< 再生位置（負なら開始前）
+    double origin;                  ///< 前回進めたときの時計の値
+    bool dead;                      ///< 更新中に止められ、ループの後で片付ける
+} TimelineInstance;
+
+/**
+* @brief 直列・並列のグループ
+*/
+typedef struct {
+    bool parallel;
+    float start;
+    float end;                      ///< 直列なら次の要素の開始時刻、並列なら要素の終わりの最大
+} TimelineGroup;
+
+static struct {
+    TimelineKey key[TIMELINE_KEY_MAX];
+    int keyCount;
+    TimelineGroup group[TIMELINE_DEPTH_MAX];
+    int depth;
+    int target;
+    bool loop;
+    void (*onFinished)();
+    bool overflow;
+} build;
+
+static TimelineInstance instances[TIMELINE_INSTANCE_MAX];
+static int instanceCount;
+static bool updating;
+
+/**
+* @brief タイムラインの組み立てを始める（一番外側は直列のグループ）
+*/
+void timelineBegin(void) {
+    SDL_zero(build);
+    build.depth = 1;
+}
+
+/**
+* @brief 今のグループで次の要素が始まる時刻
+*/
+static float placeStart(void) {
+    const TimelineGroup* g = &build.group[build.depth - 1];
+    return g->parallel ? g->start : g->end;
+}
+
+/**
+* @brief 今のグループに、endで終わる要素を置いたことにする
+*/
+static void placeEnd(float end) {
+    TimelineGroup* g = &build.group[build.depth - 1];
+    if (g->parallel) {
+        if (end > g->end) g->end = end;
+    }
+    else {
+        g->end = end;
+    }
+}
+
+static void openGroup(bool parallel) {
+    if (build.depth >= TIMELINE_DEPTH_MAX) {
+        build.overflow = true;
+        return;
+    }
+    float start = placeStart();
+    build.group[build.depth++] = (TimelineGroup){ parallel, start, start };
+}
+
+/**
+* @brief 直列のグループを始める（中の要素は前の要素が終わってから始まる）
+*/
+void timelineSequence(void) {
+    openGroup(false);
+}
+
+/**
+* @brief 並列のグループを始める（中の要素は同時に始まり、一番長いものが終わるまで続く）
+*/
+void timelineParallel(void) {
+    openGroup(true);
+}
+
+/**
+* @brief グループを閉じる
+*/
+void timelineEnd(void) {
+    if (build.depth <= 1) return;
+    float end = build.group[--build.depth].end;
+    placeEnd(end);
+}
+
+/**
+* @brief 以降のキーで動かすSpriteを選ぶ
+*
+* @param target timelinePlayに渡す配列の番号（0から）
+*/
+void timelineTarget(int target) {
+    if (target < 0 || target >= TIMELINE_TARGET_MAX) {
+        build.overflow = true;
+        return;
+    }
+    build.target = target;
+}
+
+static void addKey(TimelineProperty prop, float to, float duration, float (*easing)(float ratio)) {
+    if (build.keyCount >= TIMELINE_KEY_MAX || prop < 0 || prop >= TIMELINE_PROPERTY_COUNT) {
+        build.overflow = true;
+        return;
+    }
+    float start = placeStart();
+    build.key[build.keyCount++] = (TimelineKey){
+        (Uint8)build.target, (Uint8)prop, start, duration, to, easing
+    };
+    placeEnd(start + duration);
+}
+
+/**
+* @brief 値を変化させるキーを置く（前のキーの値、無ければ再生開始時の値から）
+*
+* @param prop 変化させる値
+* @param to 目標の値
+* @param duration 長さ（時計の単位）
+* @param easing イージング関数（NULLならlinear）
+*/
+void timelineTo(TimelineProperty prop, float to, float duration, float (*easing)(float ratio)) {
+    addKey(prop, to, duration > 0.0f ? duration : 0.0f, easing);
+}
+
+/**
+* @brief その時刻に値を置く（長さ0のキー）
+*
+* @param prop 変化させる値
+* @param value 値
+*/
+void timelineSet(TimelineProperty prop, float value) {
+    addKey(prop, value, 0.0f, NULL);
+}
+
+/**
+* @brief 何もしない時間を置く
+*
+* @param duration 長さ（時計の単位）
+*/
+void timelineWait(float duration) {
+    float start = placeStart();
+    placeEnd(start + (duration > 0.0f ? duration : 0.0f));
+}
+
+/**
+* @brief 最後まで再生したら先頭に戻るようにする
+*/
+void timelineLoop(void) {
+    build.loop = true;
+}
+
+/**
+* @brief 最後まで再生したときに呼ぶ関数を設定する（引数は1つ目のSprite）
+*
+* @param onFinished 設定したい関数
+*/
+void timelineOnFinished(void (*onFinished)()) {
+    build.onFinished = onFinished;
+}
+
+/**
+* @brief 組み立てたキーをサンプル列に焼き込む
+*
+* 同じトラックのキーは重ならないように置くこと（重なった場合は後のキーがその時点の値から始める）
+*
+* @param base 時間の基準（キーの長さの単位）
+* @return 焼き込んだタイムライン（失敗したらNULL）。timelineFreeで解放する
+*/
+Timeline* timelineBake(Timebase base) {
+    while (build.depth > 1) timelineEnd();
+    if (build.overflow) {
+        SDL_Log("timelineBake: too many keys, targets or nested groups");
+        return NULL;
+    }
+
+    Timeline* t = (Timeline*)SDL_calloc(1, sizeof(Timeline));
+    if (!t) return NULL;
+    t->base = base;
+    t->rate = base == TIMEBASE_BEATS ? (float)TIMELINE_RATE_BEATS :
+              base == TIMEBASE_FRAME ? (float)TIMELINE_RATE_FRAME : (float)TIMELINE_RATE_MS;
+    t->length = build.group[0].end;
+    t->sampleCount = (int)ceilf(t->length * t->rate) + 1;
+    if (t->sampleCount < 2) t->sampleCount = 2;
+    t->loop = build.loop && t->length > 0.0f;
+    t->onFinished = build.onFinished;
+
+    // キーの順にトラックを作り、トラックごとのキーを時刻順に並べる
+    int order[TIMELINE_KEY_MAX];
+    int trackOf[TIMELINE_KEY_MAX];
+    int trackFirst[TIMELINE_TRACK_MAX + 1];
+    int curves = 0;
+    for (int k = 0; k < build.keyCount; k++) {
+        const TimelineKey* key = &build.key[k];
+        int tr = 0;
+        while (tr < t->trackCount &&
+            (t->track[tr].target != key->target || t->track[tr].prop != key->prop)) tr++;
+        if (tr == t->trackCount) {
+            if (t->trackCount >= TIMELINE_TRACK_MAX) {
+                SDL_Log("timelineBake: too many tracks (max %d)", TIMELINE_TRACK_MAX);
+                SDL_free(t);
+                return NULL;
+            }
+            t->track[tr] = (TimelineTrack){ key->target, key->prop, 0, -1 };
+            t->trackCount++;
+            if (key->target + 1 > t->targetCount) t->targetCount = key->target + 1;
+        }
+        trackOf[k] = tr;
+    }
+    int n = 0;
+    for (int tr = 0; tr < t->trackCount; tr++) {
+        int first = n;
+        for (int k = 0; k < build.keyCount; k++) {
+            if (trackOf[k] != tr) continue;
+            int j = n++;
+            while (j > first && build.key[order[j - 1]].start > build.key[k].start) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = k;
+        }
+        // 先頭で値を置いていなければ、再生開始時の値を使う
+        const TimelineKey* head = &build.key[order[first]];
+        bool weighted = !(head->duration == 0.0f && head->start <= 0.0f);
+        t->track[tr].value = curves++;
+        t->track[tr].weight = weighted ? curves++ : -1;
+        trackFirst[tr] = first;
+    }
+    trackFirst[t->trackCount] = n;
+
+    t->samples = (float*)SDL_malloc(sizeof(float) * (size_t)curves * (size_t)t->sampleCount);
+    if (!t->samples) {
+        SDL_Log("timelineBake: out of memory");
+        SDL_free(t);
+        return NULL;
+    }
+    for (int tr = 0; tr < t->trackCount; tr++) {
+        float* value = t->samples + (size_t)t->track[tr].value * t->sampleCount;
+        float* weight = t->track[tr].weight >= 0 ? t->samples + (size_t)t->track[tr].weight * t->sampleCount : NULL;
+        int k = trackFirst[tr], kEnd = trackFirst[tr + 1];
+        float v0 = 0.0f, w0 = 1.0f;
+        for (int s = 0; s < t->sampleCount; s++) {
+            float time = (float)s / t->rate;
+            // 終わったキーの値を確定させる
+            while (k < kEnd && build.key[order[k]].start + build.key[order[k]].duration <= time) {
+                v0 = build.key[order[k]].to;
+                w0 = 0.0f;
+                k++;
+            }
+            float v = v0, w = w0;
+            if (k < kEnd && build.key[order[k]].start <= time) {
+                const TimelineKey* key = &build.key[order[k]];
+                float r = (time - key->start) / key->duration;
+                float e = key->easing ? key->easing(r) : r;
+                v = v0 + (key->to - v0) * e;
+                w = w0 * (1.0f - e);
+            }
+            value[s] = v;
+            if (weight) weight[s] = w;
+        }
+    }
+    return t;
+}
+
+/**
+* @brief タイムラインを解放する（再生中のものは止める）
+*/
+void timelineFree(Timeline* t) {
+    if (!t) return;
+    for (int k = instanceCount - 1; k >= 0; k--) {
+        if (instances[k].timeline == t) {
+            instances[k].dead = true;
+            if (!updating) instances[k] = instances[--instanceCount];
+        }
+    }
+    SDL_free(t->samples);
+    SDL_free(t);
+}
+
+/**
+* @brief タイムラインの長さ（時計の単位）
+*/
+float timelineLength(const Timeline* t) {
+    return t ? t->length : 0.0f;
+}
+
+static Uint8 channelFromFloat(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (Uint8)(v + 0.5f);
+}
+
+static float readProp(const Sprite* g, int prop) {
+    switch (prop) {
+    case TIMELINE_POSITION_X: return g->position.x;
+    case TIMELINE_POSITION_Y: return g->position.y;
+    case TIMELINE_SCALE: return g->scale;
+    case TIMELINE_SCALE_X: return g->scaleX;
+    case TIMELINE_SCALE_Y: return g->scaleY;
+    case TIMELINE_ROTATION: return g->rotation;
+    case TIMELINE_ALPHA: return g->color.a / 255.0f;
+    case TIMELINE_COLOR_R: return g->color.r;
+    case TIMELINE_COLOR_G: return g->color.g;
+    case TIMELINE_COLOR_B: return g->color.b;
+    }
+    return 0.0f;
+}
+
+static void writeProp(Sprite* g, int prop, float v) {
+    switch (prop) {
+    case TIMELINE_POSITION_X: g->position.x = v; break;
+    case TIMELINE_POSITION_Y: g->position.y = v; break;
+    case TIMELINE_SCALE: g->scale = v; break;
+    case TIMELINE_SCALE_X: g->scaleX = v; break;
+    case TIMELINE_SCALE_Y: g->scaleY = v; break;
+    case TIMELINE_ROTATION: g->rotation = v; break;
+    case TIMELINE_ALPHA: g->color.a = channelFromFloat(v * 255.0f); break;
+    case TIMELINE_COLOR_R: g->color.r = channelFromFloat(v); break;
+    case TIMELINE_COLOR_G: g->color.g = channelFromFloat(v); break;
+    case TIMELINE_COLOR_B: g->color.b = channelFromFloat(v); break;
+    }
+}
+
+/**
+* @brief 再生位置timeの値を全てのトラックについてSpriteに書く
+*/
+static void apply(const TimelineInstance* in, double time) {
+    const Timeline* t = in->timeline;
+    double pos = time * t->rate;
+    int s = 0;
+    float f = 0.0f;
+    if (pos >= (double)(t->sampleCount - 1)) {
+        s = t->sampleCount - 2;
+        f = 1.0f;
+    }
+    else if (pos > 0.0) {
+        s = (int)pos;
+        f = (float)(pos - s);
+    }
+    for (int tr = 0; tr < t->trackCount; tr++) {
+        const TimelineTrack* track = &t->track[tr];
+        const float* value = t->samples + (size_t)track->value * t->sampleCount + s;
+        float v = value[0] + (value[1] - value[0]) * f;
+        if (track->weight >= 0) {
+            const float* weight = t->samples + (size_t)track->weight * t->sampleCount + s;
+            v += (weight[0] + (weight[1] - weight[0]) * f) * in->base[tr];
+        }
+        writeProp(in->target[track->target], track->prop, v);
+    }
+}
+
+static bool drives(const TimelineInstance* in, const Sprite* g) {
+    for (int i = 0; i < in->timeline->targetCount; i++) {
+        if (in->target[i] == g) return true;
+    }
+    return false;
+}
+
+static void kill(int k) {
+    if (updating) {
+        instances[k].dead = true;
+    }
+    else {
+        instances[k] = instances[--instanceCount];
+    }
+}
+
+/**
+* @brief タイムラインを再生する
+*
+* 同じSpriteを動かしているタイムラインは止める。開始時刻はその場で時計を読むので、
+* MIDIハンドラの中で呼べばイベントの時刻から始まる
+*
+* @param t タイムライン
+* @param targets 動かすSprite（timelineTargetの番号順）
+* @param count targetsの数
+* @return 再生を始めたらtrue
+*/
+bool timelinePlay(const Timeline* t, Sprite** targets, int count) {
+    if (!t || count < t->targetCount) return false;
+    for (int i = 0; i < t->targetCount; i++) {
+        timelineStop(targets[i]);
+    }
+    if (instanceCount >= TIMELINE_INSTANCE_MAX) {
+        SDL_Log("timelinePlay: too many timelines (max %d)", TIMELINE_INSTANCE_MAX);
+        return false;
+    }
+    TimelineInstance* in = &instances[instanceCount++];
+    in->timeline = t;
+    for (int i = 0; i < t->targetCount; i++) {
+        in->target[i] = targets[i];
+    }
+    for (int tr = 0; tr < t->trackCount; tr++) {
+        const TimelineTrack* track = &t->track[tr];
+        in->base[tr] = track->weight >= 0 ? readProp(targets[track->target], track->prop) : 0.0f;
+    }
+    in->time = 0.0;
+    in->origin = timebaseSample(t->base);
+    in->dead = false;
+    apply(in, 0.0);
+    return true;
+}
+
+/**
+* @brief gを動かしているタイムラインを止める（値はその時点のまま）
+*/
+void timelineStop(Sprite* g) {
+    for (int k = instanceCount - 1; k >= 0; k--) {
+        if (!instances[k].dead && drives(&instances[k], g)) kill(k);
+    }
+}
+
+/**
+* @brief 全てのタイムラインを止める
+*/
+void timelineStopAll(void) {
+    for (int k = instanceCount - 1; k >= 0; k--) {
+        kill(k);
+    }
+}
+
+/**
+* @brief gを動かしているタイムラインがあるか
+*/
+bool timelineIsPlaying(Sprite* g) {
+    for (int k = 0; k < instanceCount; k++) {
+        if (!instances[k].dead && drives(&instances[k], g)) return true;
+    }
+    return false;
+}
+
+/**
+* @brief タイムラインの更新（easingUpdateの後に1フレームに1回呼ぶ）
+*/
+void timelineUpdate(void) {
+    // ループ中に再生を始めたものは次のフレームから
+    int count = instanceCount;
+    updating = true;
+    for (int k = 0; k < count; k++) {
+        TimelineInstance* in = &instances[k];
+        if (in->dead) continue;
+        const Timeline* t = in->timeline;
+
+        double now = timebaseNow(t->base);
+        double delta = now - in->origin;
+        in->origin = now;
+        // SDL_GetTicksで進めるものは、アニメーションと同じく1フレーム20msまで
+        if (t->base == TIMEBASE_TICKS && delta > 20.0) delta = 20.0;
+        in->time += delta;
+
+        if (in->time < (double)t->length) {
+            apply(in, in->time);
+        }
+        else if (t->loop) {
+            in->time = fmod(in->time, (double)t->length);
+            apply(in, in->time);
+        }
+        else {
+            apply(in, t->length);
+            in->dead = true;
+            if (t->onFinished) t->onFinished(in->target[0]);
+        }
+    }
+    updating = false;
+
+    // 終わったもの・止められたものを片付ける
+    int n = 0;
+    for (int k = 0; k < instanceCount; k++) {
+        if (!instances[k].dead) instances[n++] = instances[k];
+    }
+    instanceCount = n;
+}
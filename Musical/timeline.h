@@ -0,0 +1,73 @@
+/**
+* @file timeline.h
+* @brief キーフレームのタイムラインヘッダ
+*
+* 複数のSpriteの値の変化を、直列・並列のグループで組み立てて1つのタイムラインにする。
+* 組み立てたものはtimelineBakeで値ごとの一定間隔のサンプル列に焼き込み、
+* 再生中は1つの再生位置から各値を1回ずつ引くだけで、アニメーションは作らない
+*
+* 使い方:
+*   timelineBegin();                       // 直列のグループで始まる
+*   timelineSet(TIMELINE_SCALE, 0.5f);
+*   timelineParallel();
+*       timelineTo(TIMELINE_SCALE, 1.0f, 3000, easeOutQuint);
+*       timelineTarget(1);
+*       timelineTo(TIMELINE_ALPHA, 1.0f, 500, easeInOutSine);
+*   timelineEnd();
+*   Timeline* t = timelineBake(TIMEBASE_TICKS);
+*   timelinePlay(t, (Sprite*[]){ &a, &b }, 2);
+*/
+#pragma once
+
+#include <stdbool.h>
+#include "sprite.h"
+#include "timebase.h"
+
+#define TIMELINE_TARGET_MAX     8       ///< 1つのタイムラインで動かせるSpriteの数
+#define TIMELINE_TRACK_MAX      32      ///< 1つのタイムラインの値（Spriteと値の組）の数
+#define TIMELINE_KEY_MAX        256     ///< 組み立て中のキーの数
+#define TIMELINE_DEPTH_MAX      16      ///< グループの入れ子の深さ
+#define TIMELINE_INSTANCE_MAX   256     ///< 同時に再生できる数
+
+#define TIMELINE_RATE_MS        0.24    ///< ms単位の時計での1単位あたりのサンプル数（240Hz）
+#define TIMELINE_RATE_BEATS     48.0    ///< 拍単位の時計での1拍あたりのサンプル数
+#define TIMELINE_RATE_FRAME     1.0     ///< フレーム単位の時計での1フレームあたりのサンプル数
+
+/**
+* @brief タイムラインで変化させる値
+*/
+typedef enum {
+    TIMELINE_POSITION_X,
+    TIMELINE_POSITION_Y,
+    TIMELINE_SCALE,
+    TIMELINE_SCALE_X,
+    TIMELINE_SCALE_Y,
+    TIMELINE_ROTATION,
+    TIMELINE_ALPHA,             ///< 0～1
+    TIMELINE_COLOR_R,           ///< 0～255
+    TIMELINE_COLOR_G,
+    TIMELINE_COLOR_B,
+    TIMELINE_PROPERTY_COUNT
+} TimelineProperty;
+
+typedef struct Timeline Timeline;
+
+void timelineBegin(void);
+void timelineSequence(void);
+void timelineParallel(void);
+void timelineEnd(void);
+void timelineTarget(int target);
+void timelineTo(TimelineProperty prop, float to, float duration, float (*easing)(float ratio));
+void timelineSet(TimelineProperty prop, float value);
+void timelineWait(float duration);
+void timelineLoop(void);
+void timelineOnFinished(void (*onFinished)());
+Timeline* timelineBake(Timebase base);
+void timelineFree(Timeline* t);
+float timelineLength(const Timeline* t);
+
+bool timelinePlay(const Timeline* t, Sprite** targets, int count);
+void timelineStop(Sprite* g);
+void timelineStopAll(void);
+bool timelineIsPlaying(Sprite* g);
+void timelineUpdate(void);
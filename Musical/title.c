@@ -4,15 +4,18 @@
  */
 #define _USE_MATH_DEFINES
 #include "title.h"       
+#include "mainGame.h"
 #include "main.h"
 #include "sprite.h"            
 #include "image.h"                         
 #include "key.h"                                
 #include "mouse.h"   
 #include "animation.h"        
+#include "timeline.h"
 #include "easing.h"       
 #include "gamepad.h"
 #include "dynamic_font_atlas.h"
+#include "renderQueue.h"
 #include <SDL2/SDL_mixer.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -43,6 +46,8 @@ static Mix_Music* trackbgm;
 static Mix_Chunk* trackSE;
 static DFA_FontID text;
 static DFA_TextLayout layoutCenterMiddle;
+static Timeline* fadeIn;        ///< 開始時のフェードイン
+static Timeline* exitEffect;    ///< 決定時の演出（startTextの回転とフェードアウト）
 
 static bool isRunning;   ///< ループ状態チェック変数
 
@@ -69,6 +74,7 @@ static void start() {
 static void init(){
 
     stopAnimationAll();
+    timelineStopAll();
 
     layoutCenterMiddle = DFA_TextLayoutDefault();
     layoutCenterMiddle.align = DFA_ALIGN_CENTER;
@@ -113,6 +119,7 @@ static void init(){
     fade.position.x = WINDOW_WIDTH / 2;
     fade.position.y = WINDOW_HEIGHT / 2;
     fade.scale = WINDOW_WIDTH / fade.src.w;
+    fade.layer = RENDER_LAYER_OVERLAY;
 
     //fieldの初期化
     spriteInit(&field, loadImage("img/field.png"), 0, 0, 256, 256);
@@ -126,6 +133,7 @@ static void init(){
     halo1.scale = 3.8f;
     halo1.color.a = 6;
     halo1.blendmode = SDL_BLENDMODE_ADD;
+    halo1.layer = RENDER_LAYER_BACKGROUND;
     halo3 = halo2 = halo1;
     halo2.scale *= 1.2f;
     halo3.scale *= 1.4f;
@@ -139,10 +147,27 @@ static void init(){
     trackSE = Mix_LoadWAV("sound/決定ボタンを押す41.mp3");
     Mix_VolumeChunk(trackSE, (int)(MIX_MAX_VOLUME * 0.75f));
 
+    //演出の組み立て
+    timelineBegin();
+    timelineTo(TIMELINE_ALPHA, 0, 500, NULL);
+    timelineOnFinished(start);
+    fadeIn = timelineBake(TIMEBASE_TICKS);
+
+    timelineBegin();
+    timelineParallel();
+        timelineSet(TIMELINE_ROTATION, -M_PI / 6);
+        timelineTo(TIMELINE_ROTATION, 0, 500, easeOutElastic);
+        timelineTarget(1);
+        timelineTo(TIMELINE_ALPHA, 1, 1000, NULL);
+    timelineEnd();
+    timelineOnFinished(end);
+    exitEffect = timelineBake(TIMEBASE_TICKS);
+
     //フェードインの開始
-    alphaTo(&fade, 0);
-    setDuration(500);
-    setOnFinished(start);
+    timelinePlay(fadeIn, (Sprite*[]) { &fade }, 1);
+
+    //メインゲームの画像を先に読んでおく
+    mainGamePreload();
 
     SDL_ShowCursor(SDL_DISABLE);
 
@@ -193,14 +218,7 @@ static void update(){
         if(enter){
             Mix_PlayChannel(-1, trackSE, 0);
 
-            startText.rotation = -M_PI / 6;
-            rotateTo(&startText, 0);
-            setDuration(500);
-            setEasing(easeOutElastic);
-
-            alphaTo(&fade, 1);
-            setDuration(1000);
-            setOnFinished(end);
+            timelinePlay(exitEffect, (Sprite*[]) { &startText, &fade }, 2);
 
             nowSequence = EXIT;
         }
@@ -270,6 +288,7 @@ static void draw(){
         titleText.color, &layoutCenterMiddle,
         "HI-SCORE  %05d", getHiScore());
 
+    renderQueueFlush();
     DFA_Update(64);
 
     spriteDraw(&fade);
@@ -284,11 +303,23 @@ static void draw(){
 static void quit() {
     Mix_FreeMusic(trackbgm);
     Mix_FreeChunk(trackSE);
+    timelineFree(fadeIn);
+    timelineFree(exitEffect);
+    fadeIn = exitEffect = NULL;
     DFA_Quit();
     TTF_Quit();
     freeImage();
 }
 
+/**
+ * @brief タイトルで使う画像をワーカーで先に読んでおく
+ */
+void titlePreload(void) {
+    loadImageAsync("img/white.png");
+    loadImageAsync("img/field.png");
+    loadImageAsync("img/circle256x256.png");
+}
+
 /**
  * @brief タイトル処理
  */
@@ -307,6 +338,7 @@ void title(){
         draw();
 
         easingUpdate();
+        timelineUpdate();
         eventInput(&isRunning);
 
         //入力の更新
@@ -4,4 +4,5 @@
  */
 #pragma once
 
-void title(void);
\ No newline at end of file
+void title(void);
+void titlePreload(void);
\ No newline at end of file
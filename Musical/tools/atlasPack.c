@@ -0,0 +1,498 @@
+/**
+* @file atlasPack.c
+* @brief テクスチャアトラスを作るビルド用ツール
+*
+* atlasPack 出力(拡張子無し) ページの大きさ 画像...<br>
+* PNGなどの画像と.asepriteファイルを1枚または数枚のページに詰め、ページのPNGとフレーム表を書き出す。
+* .asepriteは見えているレイヤーを合成したフレームを横に並べ（spriteAnimeと同じ並び）、フレームの長さを表に書く。
+* 同じ名前のPNGも渡された場合は、書き出したPNGではなく.asepriteの方を詰める。
+* 表の書式（1行1項目、名前は引数に渡したパスのまま）:
+*   page ページのファイル名
+*   region 名前 ページ x y 幅 高さ フレーム数 フレームの長さ(ms)...
+* 各画像の周りには1ピクセルの余白に縁の色を伸ばしておく（拡大・線形補間で隣がにじまないように）
+*/
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <zlib.h>
+
+#define PAGE_MAX        16
+#define PADDING         1       ///< 画像の周りの余白（縁の色を伸ばす）
+#define ASE_FRAME_MAX   64      ///< image.hのIMAGE_FRAME_MAXと同じ
+#define ASE_LAYER_MAX   256
+
+/**
+* @brief 詰める画像（RGBA32の画素、.asepriteならフレームを横に並べたもの）
+*/
+typedef struct {
+    const char* name;
+    SDL_Surface* surface;
+    int frames;
+    int duration[ASE_FRAME_MAX];
+    int page;
+    int x, y;
+} PackItem;
+
+/* =========================================================
+   zlib（.asepriteのセルの展開用）
+   ========================================================= */
+
+/**
+* @brief zlibの圧縮データを展開する
+*
+* @return 展開したバイト数（壊れている・outCapに収まらないときは0）
+*/
+static size_t zlib_inflate(const Uint8* src, size_t len, Uint8* out, size_t outCap) {
+    uLongf outLen = (uLongf)outCap;
+    if (uncompress(out, &outLen, src, (uLong)len) != Z_OK) return 0;
+    return (size_t)outLen;
+}
+
+/* =========================================================
+   .aseprite
+   ========================================================= */
+
+typedef struct {
+    bool visible;
+    bool group;
+    Uint8 opacity;
+} AseLayer;
+
+static Uint16 rd16(const Uint8* p) { return (Uint16)(p[0] | (p[1] << 8)); }
+static Uint32 rd32(const Uint8* p) { return (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24); }
+
+/**
+* @brief セルの画素を1つRGBAにする
+*/
+static void ase_pixel(const Uint8* p, int depth, const SDL_Color* palette, int transparent, Uint8 rgba[4]) {
+    if (depth == 32) {
+        memcpy(rgba, p, 4);
+    }
+    else if (depth == 16) {
+        rgba[0] = rgba[1] = rgba[2] = p[0];
+        rgba[3] = p[1];
+    }
+    else {
+        SDL_Color c = palette[p[0]];
+        rgba[0] = c.r; rgba[1] = c.g; rgba[2] = c.b;
+        rgba[3] = p[0] == transparent ? 0 : c.a;
+    }
+}
+
+/**
+* @brief srcをdstの上に重ねる（通常の合成、opacityは0～255）
+*/
+static void blend_over(Uint8* dst, const Uint8 src[4], int opacity) {
+    int sa = src[3] * opacity / 255;
+    if (sa == 0) return;
+    int da = dst[3];
+    int oa = sa + da * (255 - sa) / 255;
+    for (int c = 0; c < 3; c++) {
+        dst[c] = (Uint8)((src[c] * sa + dst[c] * da * (255 - sa) / 255) / oa);
+    }
+    dst[3] = (Uint8)oa;
+}
+
+/**
+* @brief 読み込み中の.asepriteの状態
+*/
+typedef struct {
+    const char* path;
+    int w, h;
+    int depth;
+    int transparent;
+    bool layerOpacity;          ///< レイヤーの不透明度が有効か（見出しのフラグ1）
+    AseLayer layers[ASE_LAYER_MAX];
+    int layerCount;
+    bool levelVisible[ASE_LAYER_MAX];   ///< 直前に読んだ階層ごとのレイヤーが親も含めて見えているか
+    SDL_Color palette[256];
+    const Uint8** cel;          ///< フレーム×レイヤーのセルのデータ（リンクされたセルの参照先）
+    size_t* celLength;
+    SDL_Surface* sheet;
+} AseFile;
+
+/**
+* @brief セルを1つ、シートのフレームの位置に重ねる
+*
+* @param d セルのチャンクのデータ（チャンクの見出し6バイトの後ろ）
+* @param dlen データの長さ
+* @return 壊れていなければtrue
+*/
+static bool draw_cel(AseFile* a, int frame, const Uint8* d, size_t dlen) {
+    int layer = rd16(d);
+    int cx = (Sint16)rd16(d + 2), cy = (Sint16)rd16(d + 4);
+    int celType = rd16(d + 7);
+    int bpp = a->depth / 8;
+    if (layer >= a->layerCount || !a->layers[layer].visible || a->layers[layer].group) return true;
+    int opacity = d[6] * a->layers[layer].opacity / 255;
+
+    if (celType == 1) {
+        // リンクされたセル：前のフレームの同じレイヤーのセルをもう一度重ねる
+        if (dlen < 18) return false;
+        int src = rd16(d + 16);
+        const Uint8* linked = src < frame ? a->cel[src * ASE_LAYER_MAX + layer] : NULL;
+        if (!linked || rd16(linked + 7) == 1) return true;
+        return draw_cel(a, frame, linked, a->celLength[src * ASE_LAYER_MAX + layer]);
+    }
+    if ((celType != 0 && celType != 2) || dlen < 20) {
+        fprintf(stderr, "atlasPack: %s: skipped cel type %d\n", a->path, celType);
+        return true;
+    }
+    int cw = rd16(d + 16), ch = rd16(d + 18);
+    size_t need = (size_t)cw * ch * bpp;
+    const Uint8* px;
+    Uint8* unpacked = NULL;
+    if (celType == 0) {
+        if (dlen < 20 + need) return false;
+        px = d + 20;
+    }
+    else {
+        unpacked = (Uint8*)malloc(need ? need : 1);
+        if (!unpacked || zlib_inflate(d + 20, dlen - 20, unpacked, need) != need) {
+            fprintf(stderr, "atlasPack: %s: broken compressed cel\n", a->path);
+            free(unpacked);
+            return false;
+        }
+        px = unpacked;
+    }
+    Uint8* dst = (Uint8*)a->sheet->pixels;
+    for (int y = 0; y < ch; y++) {
+        int ty = cy + y;
+        if (ty < 0 || ty >= a->h) continue;
+        for (int x = 0; x < cw; x++) {
+            int tx = cx + x;
+            if (tx < 0 || tx >= a->w) continue;
+            Uint8 rgba[4];
+            ase_pixel(px + ((size_t)y * cw + x) * bpp, a->depth, a->palette, a->transparent, rgba);
+            blend_over(dst + ty * a->sheet->pitch + (frame * a->w + tx) * 4, rgba, opacity);
+        }
+    }
+    free(unpacked);
+    return true;
+}
+
+/**
+* @brief レイヤーのチャンク(0x2004)を読む
+*
+* グループの中のレイヤーは、グループが隠れていれば自分のフラグによらず隠れている
+*/
+static void read_layer(AseFile* a, const Uint8* d) {
+    AseLayer* l = &a->layers[a->layerCount++];
+    int level = rd16(d + 4);
+    l->visible = (rd16(d) & 1) != 0;
+    if (level > 0) l->visible = l->visible && level <= ASE_LAYER_MAX && a->levelVisible[level - 1];
+    if (level < ASE_LAYER_MAX) a->levelVisible[level] = l->visible;
+    l->group = rd16(d + 2) == 1;
+    l->opacity = a->layerOpacity ? d[12] : 255;
+}
+
+/**
+* @brief 新しい形式のパレットのチャンク(0x2019)を読む（first～lastの番号を書き換える）
+*/
+static void read_palette(AseFile* a, const Uint8* d, size_t dlen) {
+    Uint32 first = rd32(d + 4);
+    Uint32 last = rd32(d + 8);
+    const Uint8* e = d + 20;
+    for (Uint32 i = first; i <= last && i < 256 && e + 6 <= d + dlen; i++) {
+        a->palette[i] = (SDL_Color){ e[2], e[3], e[4], e[5] };
+        int flags = rd16(e);
+        e += 6;
+        if (flags & 1) {
+            if (e + 2 > d + dlen) break;
+            e += 2 + rd16(e);
+        }
+    }
+}
+
+/**
+* @brief .asepriteの中身を読み、見えているレイヤーを合成したフレームを横に並べた画像にする
+*/
+static bool parse_aseprite(const char* path, const Uint8* data, size_t size, PackItem* item) {
+    bool ok = false;
+    AseFile* a = (AseFile*)calloc(1, sizeof(AseFile));
+    if (!a) goto done;
+    a->path = path;
+    if (size < 128 || rd16(data + 4) != 0xA5E0) {
+        fprintf(stderr, "atlasPack: %s is not an aseprite file\n", path);
+        goto done;
+    }
+    int frames = rd16(data + 6);
+    a->w = rd16(data + 8);
+    a->h = rd16(data + 10);
+    a->depth = rd16(data + 12);
+    a->layerOpacity = (rd32(data + 14) & 1) != 0;
+    a->transparent = data[28];
+    if (frames <= 0 || frames > ASE_FRAME_MAX || a->w <= 0 || a->h <= 0 ||
+        (a->depth != 32 && a->depth != 16 && a->depth != 8)) {
+        fprintf(stderr, "atlasPack: %s: unsupported format (%d frames, %dbpp)\n", path, frames, a->depth);
+        goto done;
+    }
+    a->cel = (const Uint8**)calloc((size_t)frames * ASE_LAYER_MAX, sizeof(Uint8*));
+    a->celLength = (size_t*)calloc((size_t)frames * ASE_LAYER_MAX, sizeof(size_t));
+    a->sheet = SDL_CreateRGBSurfaceWithFormat(0, a->w * frames, a->h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!a->cel || !a->celLength || !a->sheet) goto done;
+    SDL_FillRect(a->sheet, NULL, 0);
+
+    size_t pos = 128;
+    for (int f = 0; f < frames; f++) {
+        if (pos + 16 > size) goto done;
+        const Uint8* fh = data + pos;
+        Uint32 frameBytes = rd32(fh);
+        if (rd16(fh + 4) != 0xF1FA || frameBytes < 16 || pos + frameBytes > size) goto done;
+        int chunks = rd16(fh + 6);
+        if (chunks == 0xFFFF) chunks = (int)rd32(fh + 12);
+        item->duration[f] = rd16(fh + 8);
+
+        size_t cp = pos + 16;
+        for (int c = 0; c < chunks && cp + 6 <= pos + frameBytes; c++) {
+            Uint32 chunkSize = rd32(data + cp);
+            int type = rd16(data + cp + 4);
+            const Uint8* d = data + cp + 6;
+            if (chunkSize < 6 || cp + chunkSize > pos + frameBytes) goto done;
+            size_t dlen = chunkSize - 6;
+
+            if (type == 0x2004 && a->layerCount < ASE_LAYER_MAX && dlen >= 18) {
+                read_layer(a, d);
+            }
+            else if (type == 0x2019 && dlen >= 20) {
+                read_palette(a, d, dlen);
+            }
+            else if (type == 0x0004 && dlen >= 4) {
+                // 古い形式のパレット（新しい形式が無いときだけ使われる）
+                int packets = rd16(d);
+                const Uint8* e = d + 2;
+                int index = 0;
+                for (int i = 0; i < packets && e + 2 <= d + dlen; i++) {
+                    index += e[0];
+                    int count = e[1] ? e[1] : 256;
+                    e += 2;
+                    for (int k = 0; k < count && index < 256 && e + 3 <= d + dlen; k++, e += 3) {
+                        a->palette[index++] = (SDL_Color){ e[0], e[1], e[2], 255 };
+                    }
+                }
+            }
+            else if (type == 0x2005 && dlen >= 16) {
+                int layer = rd16(d);
+                if (layer < ASE_LAYER_MAX) {
+                    a->cel[f * ASE_LAYER_MAX + layer] = d;
+                    a->celLength[f * ASE_LAYER_MAX + layer] = dlen;
+                }
+                if (!draw_cel(a, f, d, dlen)) goto done;
+            }
+            cp += chunkSize;
+        }
+        pos += frameBytes;
+    }
+    item->surface = a->sheet;
+    item->frames = frames;
+    a->sheet = NULL;
+    ok = true;
+
+done:
+    if (!ok) fprintf(stderr, "atlasPack: failed to read %s\n", path);
+    if (a) {
+        SDL_FreeSurface(a->sheet);
+        free(a->cel);
+        free(a->celLength);
+        free(a);
+    }
+    return ok;
+}
+
+/**
+* @brief .asepriteのファイルを読む（parse_aseprite）
+*/
+static bool load_aseprite(const char* path, PackItem* item) {
+    size_t size;
+    Uint8* data = (Uint8*)SDL_LoadFile(path, &size);
+    if (!data) {
+        fprintf(stderr, "atlasPack: cannot read %s\n", path);
+        return false;
+    }
+    bool ok = parse_aseprite(path, data, size, item);
+    SDL_free(data);
+    return ok;
+}
+
+/* =========================================================
+   詰め込み
+   ========================================================= */
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && SDL_strcasecmp(s + n - m, suffix) == 0;
+}
+
+/**
+* @brief 同じ名前の.asepriteも渡されているか（書き出したPNGより元の.asepriteを使う）
+*/
+static bool has_aseprite_source(const char* png, char** names, int count) {
+    const char* dot = strrchr(png, '.');
+    size_t stem = dot ? (size_t)(dot - png) : strlen(png);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(names[i], png, stem) == 0 &&
+            (SDL_strcasecmp(names[i] + stem, ".aseprite") == 0 || SDL_strcasecmp(names[i] + stem, ".ase") == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int by_height(const void* a, const void* b) {
+    const PackItem* x = *(const PackItem* const*)a;
+    const PackItem* y = *(const PackItem* const*)b;
+    if (x->surface->h != y->surface->h) return y->surface->h - x->surface->h;
+    return y->surface->w - x->surface->w;
+}
+
+/**
+* @brief 画像をページに写して、周りの余白に縁の色を伸ばす
+*/
+static void blit_extruded(SDL_Surface* page, const PackItem* it) {
+    const SDL_Surface* s = it->surface;
+    Uint8* dst = (Uint8*)page->pixels;
+    const Uint8* src = (const Uint8*)s->pixels;
+    for (int y = -PADDING; y < s->h + PADDING; y++) {
+        int sy = y < 0 ? 0 : y >= s->h ? s->h - 1 : y;
+        for (int x = -PADDING; x < s->w + PADDING; x++) {
+            int sx = x < 0 ? 0 : x >= s->w ? s->w - 1 : x;
+            memcpy(dst + (it->y + y) * page->pitch + (it->x + x) * 4, src + sy * s->pitch + sx * 4, 4);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: atlasPack <output> <page size> <image>...\n");
+        return 1;
+    }
+    const char* output = argv[1];
+    int pageSize = atoi(argv[2]);
+    if (pageSize < 64) pageSize = 1024;
+
+    SDL_SetMainReady();
+    if (IMG_Init(IMG_INIT_PNG) == 0) {
+        fprintf(stderr, "atlasPack: %s\n", IMG_GetError());
+        return 1;
+    }
+
+    int count = argc - 3;
+    PackItem* items = (PackItem*)calloc((size_t)count, sizeof(PackItem));
+    PackItem** order = (PackItem**)calloc((size_t)count, sizeof(PackItem*));
+    if (!items || !order) return 1;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        PackItem* it = &items[n];
+        it->name = argv[3 + i];
+        if (strchr(it->name, ' ')) {
+            fprintf(stderr, "atlasPack: skipped %s (space in name)\n", it->name);
+            continue;
+        }
+        if (has_suffix(it->name, ".aseprite") || has_suffix(it->name, ".ase")) {
+            if (!load_aseprite(it->name, it)) continue;
+        }
+        else if (has_aseprite_source(it->name, argv + 3, count)) {
+            continue;
+        }
+        else {
+            SDL_Surface* s = IMG_Load(it->name);
+            if (!s) {
+                fprintf(stderr, "atlasPack: %s: %s\n", it->name, IMG_GetError());
+                continue;
+            }
+            it->surface = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(s);
+            if (!it->surface) continue;
+            it->frames = 1;
+        }
+        if (it->surface->w + PADDING * 2 > pageSize || it->surface->h + PADDING * 2 > pageSize) {
+            // ページに入らないものは表に載せず、実行時は1枚のテクスチャとして読む
+            fprintf(stderr, "atlasPack: %s does not fit in a %d page, left out\n", it->name, pageSize);
+            // この枠は次の画像が使うので、片付けのときに二重に解放しないよう空にしておく
+            SDL_FreeSurface(it->surface);
+            memset(it, 0, sizeof *it);
+            continue;
+        }
+        order[n++] = it;
+    }
+    qsort(order, (size_t)n, sizeof(PackItem*), by_height);
+
+    // 高さ順に棚へ並べる
+    int pages = 0;
+    int shelfX = 0, shelfY = 0, shelfH = 0;
+    for (int i = 0; i < n; i++) {
+        PackItem* it = order[i];
+        int w = it->surface->w + PADDING * 2, h = it->surface->h + PADDING * 2;
+        if (pages == 0 || shelfX + w > pageSize) {
+            shelfY += shelfH;
+            shelfX = 0;
+            shelfH = 0;
+        }
+        if (pages == 0 || shelfY + h > pageSize) {
+            if (pages == PAGE_MAX) {
+                fprintf(stderr, "atlasPack: more than %d pages\n", PAGE_MAX);
+                return 1;
+            }
+            pages++;
+            shelfX = shelfY = shelfH = 0;
+        }
+        it->page = pages - 1;
+        it->x = shelfX + PADDING;
+        it->y = shelfY + PADDING;
+        shelfX += w;
+        if (h > shelfH) shelfH = h;
+    }
+
+    char path[1024];
+    const char* slash = strrchr(output, '/');
+    const char* base = slash ? slash + 1 : output;
+    for (int p = 0; p < pages; p++) {
+        SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, pageSize, pageSize, 32, SDL_PIXELFORMAT_RGBA32);
+        if (!page) return 1;
+        SDL_FillRect(page, NULL, 0);
+        for (int i = 0; i < n; i++) {
+            if (order[i]->page == p) blit_extruded(page, order[i]);
+        }
+        snprintf(path, sizeof(path), "%s%d.png", output, p);
+        if (IMG_SavePNG(page, path) != 0) {
+            fprintf(stderr, "atlasPack: cannot write %s: %s\n", path, IMG_GetError());
+            return 1;
+        }
+        SDL_FreeSurface(page);
+    }
+
+    snprintf(path, sizeof(path), "%s.txt", output);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "atlasPack: cannot write %s\n", path);
+        return 1;
+    }
+    fprintf(fp, "# atlasPack %d\n", pageSize);
+    for (int p = 0; p < pages; p++) {
+        fprintf(fp, "page %s%d.png\n", base, p);
+    }
+    for (int i = 0; i < count; i++) {
+        const PackItem* it = &items[i];
+        if (!it->surface) continue;
+        bool packed = false;
+        for (int k = 0; k < n; k++) packed |= order[k] == it;
+        if (!packed) continue;
+        fprintf(fp, "region %s %d %d %d %d %d %d", it->name, it->page, it->x, it->y,
+            it->surface->w, it->surface->h, it->frames);
+        for (int f = 0; f < it->frames; f++) {
+            fprintf(fp, " %d", it->frames > 1 ? it->duration[f] : 0);
+        }
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    printf("atlasPack: %d images in %d page(s) -> %s\n", n, pages, path);
+
+    for (int i = 0; i < count; i++) SDL_FreeSurface(items[i].surface);
+    free(items);
+    free(order);
+    IMG_Quit();
+    return 0;
+}